@@ -0,0 +1,689 @@
+// bench.c - End-to-end benchmarks for the gitignore tool
+//
+// Runs the real binary against synthetic workloads and reports the wall
+// time of each command as JSON: median, p95, min, max and mean over
+// repeated runs. Every workload is generated from a fixed seed, so two
+// releases benchmarked on the same machine see byte-identical inputs.
+//
+// Startup benchmarks also report how many system calls the command made
+// (counted with ptrace, so Linux only; other platforms report none).
+//
+// Workloads live in a scratch directory with its own $HOME, so the
+// user's config, templates and cache are never touched. sync downloads
+// from tests/mock_server through GITIGNORE_TEMPLATE_URL.
+//
+//   bench [--tool PATH] [--server PATH] [--runs N] [--quick] [--filter TEXT] [--out FILE]
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#ifdef __linux__
+#include <sys/ptrace.h>
+#endif
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_SEED          0x9e3779b97f4a7c15ULL
+#define BENCH_MAX_RESULTS   64
+#define BENCH_MAX_SAMPLES   1000
+#define SERVER_TEMPLATES    20
+#define SERVER_LINES        2000
+#define CUSTOM_TEMPLATES    500
+#define CUSTOM_LINES        200
+
+typedef struct {
+    char name[32];
+    char workload[96];
+    double samples[BENCH_MAX_SAMPLES];
+    int count;
+    int failures;
+    long syscalls;          // -1 when not counted
+} bench_result_t;
+
+static const char *g_tool = "./gitignore";
+static const char *g_server = "./tests/mock_server";
+static int g_runs = 15;
+static int g_quick = 0;
+static const char *g_filter = NULL;
+static char g_root[256];
+static char g_home[300];
+static char *g_env[5];
+
+static bench_result_t g_results[BENCH_MAX_RESULTS];
+static int g_result_count = 0;
+
+
+// ---------------------------------------------------------------------------
+// Deterministic workload generation
+
+static uint64_t g_rng;
+
+static uint64_t rng_next(void) {
+    // xorshift64*
+    g_rng ^= g_rng >> 12;
+    g_rng ^= g_rng << 25;
+    g_rng ^= g_rng >> 27;
+    return g_rng * 0x2545f4914f6cdd1dULL;
+}
+
+static const char *words[] = {
+    "build", "cache", "tmp", "out", "logs", "data", "coverage", "vendor",
+    "assets", "target", "dist", "gen", "reports", "node", "venv", "obj",
+};
+static const char *exts[] = {
+    "log", "tmp", "o", "so", "pyc", "class", "bak", "swp", "cache", "out",
+    "dll", "exe", "map", "lock", "db", "sqlite",
+};
+#define COUNT_OF(a) ((int)(sizeof(a) / sizeof((a)[0])))
+
+// One plausible .gitignore line; mostly unique so dedup has real work
+static int gen_line(char *buf, size_t size, long i) {
+    uint64_t r = rng_next();
+    const char *w = words[r % COUNT_OF(words)];
+    const char *e = exts[(r >> 8) % COUNT_OF(exts)];
+
+    switch ((r >> 16) % 10) {
+    case 0:  return snprintf(buf, size, "# %s section %ld\n", w, i);
+    case 1:  return snprintf(buf, size, "%s%ld/\n", w, i);
+    case 2:  return snprintf(buf, size, "/%s/%s%ld.%s\n", w, w, i, e);
+    case 3:  return snprintf(buf, size, "*.%s%ld\n", e, i);
+    case 4:  return snprintf(buf, size, "!%s/keep%ld.%s\n", w, i, e);
+    case 5:  return snprintf(buf, size, "\n");
+    case 6:  return snprintf(buf, size, "**/%s%ld/*.%s\n", w, i, e);
+    default: return snprintf(buf, size, "%s_%ld.%s\n", w, i, e);
+    }
+}
+
+static char* gen_body(long lines, uint64_t seed, size_t *size) {
+    size_t cap = (size_t)lines * 48 + 64;
+    char *body = malloc(cap);
+    if (!body) return NULL;
+
+    g_rng = seed;
+    size_t len = 0;
+    for (long i = 0; i < lines; i++) {
+        len += (size_t)gen_line(body + len, cap - len, i);
+    }
+    body[len] = '\0';
+    *size = len;
+    return body;
+}
+
+static int write_file(const char *path, const char *data, size_t size) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return 1;
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            close(fd);
+            return 1;
+        }
+        data += n;
+        size -= (size_t)n;
+    }
+    return close(fd);
+}
+
+static int write_lines(const char *path, long lines, uint64_t seed) {
+    size_t size;
+    char *body = gen_body(lines, seed, &size);
+    if (!body) return 1;
+    int rc = write_file(path, body, size);
+    free(body);
+    return rc;
+}
+
+static int copy_file(const char *from, const char *to) {
+    int in = open(from, O_RDONLY);
+    if (in < 0) return 1;
+    struct stat st;
+    if (fstat(in, &st) != 0) {
+        close(in);
+        return 1;
+    }
+    char *data = malloc((size_t)st.st_size + 1);
+    ssize_t got = data ? read(in, data, (size_t)st.st_size) : -1;
+    close(in);
+    int rc = got == st.st_size ? write_file(to, data, (size_t)got) : 1;
+    free(data);
+    return rc;
+}
+
+static int mkdir_p(const char *path) {
+    char buf[512];
+    snprintf(buf, sizeof(buf), "%s", path);
+    for (char *p = buf + 1; *p; p++) {
+        if (*p != '/') continue;
+        *p = '\0';
+        if (mkdir(buf, 0755) != 0 && errno != EEXIST) return 1;
+        *p = '/';
+    }
+    return mkdir(buf, 0755) != 0 && errno != EEXIST;
+}
+
+static int rm_entry(const char *path, const struct stat *st, int flag, struct FTW *ftw) {
+    (void)st;
+    (void)ftw;
+    return flag == FTW_DP ? rmdir(path) : unlink(path);
+}
+
+static void rm_rf(const char *path) {
+    nftw(path, rm_entry, 32, FTW_DEPTH | FTW_PHYS);
+}
+
+// Remove what is inside a directory but keep the directory
+static void empty_dir(const char *path) {
+    rm_rf(path);
+    mkdir_p(path);
+}
+
+// ---------------------------------------------------------------------------
+// Stand-in template host
+
+static pid_t g_server_pid = -1;
+static char g_server_url[64];
+
+// Write the upstream templates and start the mock server on a free port
+static int server_start(void) {
+    char dir[400];
+    snprintf(dir, sizeof(dir), "%s/upstream", g_root);
+    mkdir_p(dir);
+    for (int i = 0; i < SERVER_TEMPLATES; i++) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/Bench%02d.gitignore", dir, i);
+        if (write_lines(path, SERVER_LINES, BENCH_SEED + 1000 + (uint64_t)i) != 0) return 1;
+    }
+
+    int out[2];
+    if (pipe(out) != 0) return 1;
+
+    g_server_pid = fork();
+    if (g_server_pid < 0) return 1;
+    if (g_server_pid == 0) {
+        dup2(out[1], STDOUT_FILENO);
+        close(out[0]);
+        close(out[1]);
+        execl(g_server, g_server, "--root", dir, "--port", "0", (char *)NULL);
+        _exit(127);
+    }
+    close(out[1]);
+
+    // The server prints the port it bound once it is listening
+    char line[16] = "";
+    ssize_t n = read(out[0], line, sizeof(line) - 1);
+    close(out[0]);
+    int port = n > 0 ? atoi(line) : 0;
+    if (port <= 0) {
+        fprintf(stderr, "bench: could not start %s\n", g_server);
+        return 1;
+    }
+
+    snprintf(g_server_url, sizeof(g_server_url), "GITIGNORE_TEMPLATE_URL=http://127.0.0.1:%d/", port);
+    return 0;
+}
+
+static void server_stop(void) {
+    if (g_server_pid <= 0) return;
+    kill(g_server_pid, SIGTERM);
+    waitpid(g_server_pid, NULL, 0);
+}
+
+// ---------------------------------------------------------------------------
+// Running the tool
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1e6;
+}
+
+// Run the tool once in cwd; returns the wall time or -1 if it failed
+static double run_tool(const char *cwd, char *const args[]) {
+    char *argv[64];
+    int argc = 0;
+    argv[argc++] = (char *)g_tool;
+    for (int i = 0; args[i] && argc < 63; i++) argv[argc++] = args[i];
+    argv[argc] = NULL;
+
+    double start = now_ms();
+    pid_t pid = fork();
+    if (pid < 0) return -1;
+    if (pid == 0) {
+        // Nothing but async-signal-safe calls between fork and exec
+        int null_fd = open("/dev/null", O_RDWR);
+        if (chdir(cwd) != 0 || null_fd < 0) _exit(127);
+        dup2(null_fd, STDIN_FILENO);
+        dup2(null_fd, STDOUT_FILENO);
+        dup2(null_fd, STDERR_FILENO);
+        execve(g_tool, argv, g_env);
+        _exit(127);
+    }
+
+    int status;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) return -1;
+    }
+    double elapsed = now_ms() - start;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? elapsed : -1;
+}
+
+// System calls one run makes from exec to exit, or -1 if they cannot be
+// counted. Only the main thread is followed; startup commands have no others.
+static long count_syscalls(const char *cwd, char *const args[]) {
+#ifdef __linux__
+    char *argv[64];
+    int argc = 0;
+    argv[argc++] = (char *)g_tool;
+    for (int i = 0; args[i] && argc < 63; i++) argv[argc++] = args[i];
+    argv[argc] = NULL;
+
+    pid_t pid = fork();
+    if (pid < 0) return -1;
+    if (pid == 0) {
+        int null_fd = open("/dev/null", O_RDWR);
+        if (chdir(cwd) != 0 || null_fd < 0) _exit(127);
+        dup2(null_fd, STDIN_FILENO);
+        dup2(null_fd, STDOUT_FILENO);
+        dup2(null_fd, STDERR_FILENO);
+        if (ptrace(PTRACE_TRACEME, 0, NULL, NULL) != 0) _exit(127);
+        execve(g_tool, argv, g_env);
+        _exit(127);
+    }
+
+    // The child stops with SIGTRAP once execve has succeeded
+    int status;
+    if (waitpid(pid, &status, 0) < 0 || !WIFSTOPPED(status)) return -1;
+    ptrace(PTRACE_SETOPTIONS, pid, NULL, (void *)(long)(PTRACE_O_TRACESYSGOOD | PTRACE_O_EXITKILL));
+
+    // Each call stops twice, on entry and on exit; exit_group only enters
+    long stops = 0;
+    int sig = 0;
+    while (ptrace(PTRACE_SYSCALL, pid, NULL, (void *)(long)sig) == 0) {
+        if (waitpid(pid, &status, 0) < 0 || WIFEXITED(status) || WIFSIGNALED(status)) break;
+        sig = 0;
+        if (WSTOPSIG(status) == (SIGTRAP | 0x80)) stops++;
+        else sig = WSTOPSIG(status);
+    }
+    if (!WIFEXITED(status)) {
+        kill(pid, SIGKILL);
+        waitpid(pid, &status, 0);
+        return -1;
+    }
+    return (stops + 1) / 2;
+#else
+    (void)cwd;
+    (void)args;
+    return -1;
+#endif
+}
+
+typedef void (*bench_setup_fn)(void *arg);
+
+// Run a command g_runs times after one warm-up, calling setup (untimed)
+// before each run
+static void bench(const char *name, const char *workload, const char *cwd,
+                  char *const args[], bench_setup_fn setup, void *arg) {
+    if (g_filter && !strstr(name, g_filter)) return;
+    if (g_result_count == BENCH_MAX_RESULTS) return;
+
+    bench_result_t *r = &g_results[g_result_count++];
+    memset(r, 0, sizeof(*r));
+    snprintf(r->name, sizeof(r->name), "%s", name);
+    snprintf(r->workload, sizeof(r->workload), "%s", workload);
+    r->syscalls = -1;
+
+    fprintf(stderr, "  %-14s %-32s", name, workload);
+    for (int i = -1; i < g_runs && i < BENCH_MAX_SAMPLES; i++) {
+        if (setup) setup(arg);
+        double ms = run_tool(cwd, args);
+        if (i < 0) continue;
+        if (ms < 0) r->failures++;
+        else r->samples[r->count++] = ms;
+    }
+    fprintf(stderr, " %d runs%s\n", r->count, r->failures ? " (with failures)" : "");
+}
+
+// ---------------------------------------------------------------------------
+// Workloads
+
+typedef struct {
+    char dir[400];
+    char fixture[400];      // copied over dir/.gitignore before each run, if set
+    char extra[400];        // directory emptied before each run, if set
+} reset_t;
+
+static void reset_dir(void *arg) {
+    reset_t *r = arg;
+    char path[512];
+    snprintf(path, sizeof(path), "%s/.gitignore", r->dir);
+    if (r->fixture[0]) copy_file(r->fixture, path);
+    else unlink(path);
+    if (r->extra[0]) empty_dir(r->extra);
+
+    // Auto-backups would pile up across runs
+    snprintf(path, sizeof(path), "%s/.config/gitignore/backups", g_home);
+    empty_dir(path);
+}
+
+static void bench_existing_file(void) {
+    static const long sizes[] = { 100, 10000, 100000, 1000000 };
+    int count = g_quick ? 3 : 4;
+
+    for (int s = 0; s < count; s++) {
+        reset_t r;
+        memset(&r, 0, sizeof(r));
+        snprintf(r.dir, sizeof(r.dir), "%s/existing-%ld", g_root, sizes[s]);
+        snprintf(r.fixture, sizeof(r.fixture), "%s/fixture-%ld.gitignore", g_root, sizes[s]);
+        mkdir_p(r.dir);
+        write_lines(r.fixture, sizes[s], BENCH_SEED + (uint64_t)s);
+
+        char workload[64];
+        snprintf(workload, sizeof(workload), "existing_lines=%ld", sizes[s]);
+
+        char *init_args[] = { "init", "python", "node", "rust", NULL };
+        bench("init", workload, r.dir, init_args, reset_dir, &r);
+
+        char *append_args[] = { "append", "c", "go", NULL };
+        bench("append", workload, r.dir, append_args, reset_dir, &r);
+
+        char *add_args[] = { "--add", "bench-output/", "*.benchtmp", "notes.local", NULL };
+        bench("add", workload, r.dir, add_args, reset_dir, &r);
+    }
+}
+
+static void bench_custom_templates(void) {
+    char dir[400];
+    snprintf(dir, sizeof(dir), "%s/.config/gitignore/templates", g_home);
+    mkdir_p(dir);
+
+    for (int i = 0; i < CUSTOM_TEMPLATES; i++) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/custom%03d.gitignore", dir, i);
+        write_lines(path, CUSTOM_LINES, BENCH_SEED + 5000 + (uint64_t)i);
+    }
+
+    reset_t r;
+    memset(&r, 0, sizeof(r));
+    snprintf(r.dir, sizeof(r.dir), "%s/custom", g_root);
+    mkdir_p(r.dir);
+
+    char workload[64];
+    snprintf(workload, sizeof(workload), "custom_templates=%d", CUSTOM_TEMPLATES);
+
+    char *list_args[] = { "list", NULL };
+    bench("list", workload, r.dir, list_args, NULL, NULL);
+
+    char *stats_args[] = { "list", "--stats", NULL };
+    bench("list_stats", workload, r.dir, stats_args, NULL, NULL);
+
+    // init with 50 of them into a fresh file
+    static char names[50][16];
+    char *init_args[52];
+    init_args[0] = "init";
+    for (int i = 0; i < 50; i++) {
+        snprintf(names[i], sizeof(names[i]), "custom%03d", i * 7);
+        init_args[i + 1] = names[i];
+    }
+    init_args[51] = NULL;
+    snprintf(workload, sizeof(workload), "custom_templates=50x%d_lines", CUSTOM_LINES);
+    bench("init_custom", workload, r.dir, init_args, reset_dir, &r);
+}
+
+static void bench_sync(void) {
+    reset_t cold;
+    memset(&cold, 0, sizeof(cold));
+    snprintf(cold.dir, sizeof(cold.dir), "%s/sync", g_root);
+    snprintf(cold.extra, sizeof(cold.extra), "%s/.config/gitignore/cache", g_home);
+    mkdir_p(cold.dir);
+
+    static char names[SERVER_TEMPLATES][16];
+    char *args[SERVER_TEMPLATES + 2];
+    args[0] = "sync";
+    for (int i = 0; i < SERVER_TEMPLATES; i++) {
+        snprintf(names[i], sizeof(names[i]), "Bench%02d", i);
+        args[i + 1] = names[i];
+    }
+    args[SERVER_TEMPLATES + 1] = NULL;
+
+    char workload[64];
+    snprintf(workload, sizeof(workload), "templates=%dx%d_lines", SERVER_TEMPLATES, SERVER_LINES);
+
+    bench("sync_cold", workload, cold.dir, args, reset_dir, &cold);
+
+    // The warm runs find every template in the cache populated above
+    reset_t warm = cold;
+    warm.extra[0] = '\0';
+    run_tool(warm.dir, args);
+    bench("sync_warm", workload, warm.dir, args, reset_dir, &warm);
+}
+
+typedef struct {
+    char dir[400];
+    int projects;
+} monorepo_t;
+
+// Remove the .gitignore files auto --recursive wrote, so every run
+// generates them instead of finding them up to date (exit 3)
+static void reset_monorepo(void *arg) {
+    monorepo_t *m = arg;
+    char path[512];
+    snprintf(path, sizeof(path), "%s/.gitignore", m->dir);
+    unlink(path);
+    for (int p = 0; p < m->projects; p++) {
+        snprintf(path, sizeof(path), "%s/svc%03d/.gitignore", m->dir, p);
+        unlink(path);
+    }
+
+    snprintf(path, sizeof(path), "%s/.config/gitignore/backups", g_home);
+    empty_dir(path);
+}
+
+static void bench_auto(void) {
+    reset_t single;
+    memset(&single, 0, sizeof(single));
+    snprintf(single.dir, sizeof(single.dir), "%s/auto", g_root);
+    mkdir_p(single.dir);
+
+    static const char *markers[] = { "package.json", "requirements.txt", "Cargo.toml", "go.mod" };
+    for (int i = 0; i < COUNT_OF(markers); i++) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", single.dir, markers[i]);
+        write_file(path, "", 0);
+    }
+
+    char *auto_args[] = { "auto", NULL };
+    bench("auto", "markers=4", single.dir, auto_args, reset_dir, &single);
+
+    // A monorepo: subprojects of mixed languages with plain files below
+    monorepo_t m;
+    memset(&m, 0, sizeof(m));
+    snprintf(m.dir, sizeof(m.dir), "%s/monorepo", g_root);
+    m.projects = g_quick ? 50 : 200;
+    const char *mono = m.dir;
+    int projects = m.projects, files = 100;
+    g_rng = BENCH_SEED + 77;
+    for (int p = 0; p < projects; p++) {
+        char dir[512], path[600];
+        snprintf(dir, sizeof(dir), "%s/svc%03d/src", mono, p);
+        mkdir_p(dir);
+        snprintf(path, sizeof(path), "%s/svc%03d/%s", mono, p, markers[rng_next() % COUNT_OF(markers)]);
+        write_file(path, "", 0);
+        for (int f = 0; f < files; f++) {
+            snprintf(path, sizeof(path), "%s/file%03d.%s", dir, f, exts[f % COUNT_OF(exts)]);
+            write_file(path, "", 0);
+        }
+    }
+
+    char workload[64];
+    snprintf(workload, sizeof(workload), "subprojects=%d,files=%d", projects, projects * files);
+    char *recursive_args[] = { "auto", "--recursive", NULL };
+    bench("auto_recursive", workload, mono, recursive_args, reset_monorepo, &m);
+}
+
+// Commands hooks and editors run constantly: their cost is mostly startup
+static void bench_startup(void) {
+    reset_t r;
+    memset(&r, 0, sizeof(r));
+    snprintf(r.dir, sizeof(r.dir), "%s/startup", g_root);
+    snprintf(r.fixture, sizeof(r.fixture), "%s/fixture-startup.gitignore", g_root);
+    mkdir_p(r.dir);
+    write_lines(r.fixture, 100, BENCH_SEED + 99);
+
+    // check exits 1 when nothing matches; give it a rule that does
+    FILE *f = fopen(r.fixture, "a");
+    if (f) {
+        fputs("build/\n", f);
+        fclose(f);
+    }
+
+    static const struct {
+        const char *name;
+        char *args[4];
+    } commands[] = {
+        { "startup_help",    { "--help", NULL } },
+        { "startup_version", { "--version", NULL } },
+        { "startup_pattern", { "*.benchtmp", NULL } },
+        { "startup_check",   { "check", "build/out.o", "src/main.c", NULL } },
+    };
+
+    for (int i = 0; i < COUNT_OF(commands); i++) {
+        int before = g_result_count;
+        bench(commands[i].name, "existing_lines=100", r.dir, commands[i].args, reset_dir, &r);
+        if (g_result_count == before) continue;
+
+        reset_dir(&r);
+        g_results[before].syscalls = count_syscalls(r.dir, commands[i].args);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Reporting
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+// Nearest-rank percentile of sorted samples
+static double percentile(const double *sorted, int n, double p) {
+    if (n == 0) return 0;
+    int rank = (int)(p * n + 0.999999);
+    if (rank < 1) rank = 1;
+    if (rank > n) rank = n;
+    return sorted[rank - 1];
+}
+
+static void report(FILE *out) {
+    time_t now = time(NULL);
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    fprintf(out, "{\n  \"tool\": \"%s\",\n  \"timestamp\": \"%s\",\n  \"runs\": %d,\n",
+            g_tool, stamp, g_runs);
+    fprintf(out, "  \"seed\": \"0x%llx\",\n  \"benchmarks\": [\n", (unsigned long long)BENCH_SEED);
+
+    for (int i = 0; i < g_result_count; i++) {
+        bench_result_t *r = &g_results[i];
+        qsort(r->samples, (size_t)r->count, sizeof(double), cmp_double);
+
+        double sum = 0;
+        for (int j = 0; j < r->count; j++) sum += r->samples[j];
+
+        fprintf(out, "    {\"name\": \"%s\", \"workload\": \"%s\", \"runs\": %d, \"failures\": %d, "
+                     "\"median_ms\": %.3f, \"p95_ms\": %.3f, \"min_ms\": %.3f, \"max_ms\": %.3f, "
+                     "\"mean_ms\": %.3f",
+                r->name, r->workload, r->count, r->failures,
+                percentile(r->samples, r->count, 0.5), percentile(r->samples, r->count, 0.95),
+                r->count ? r->samples[0] : 0, r->count ? r->samples[r->count - 1] : 0,
+                r->count ? sum / r->count : 0);
+        if (r->syscalls >= 0) fprintf(out, ", \"syscalls\": %ld", r->syscalls);
+        fprintf(out, "}%s\n", i + 1 < g_result_count ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *out_path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--tool") == 0 && i + 1 < argc) g_tool = argv[++i];
+        else if (strcmp(argv[i], "--server") == 0 && i + 1 < argc) g_server = argv[++i];
+        else if (strcmp(argv[i], "--runs") == 0 && i + 1 < argc) g_runs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) g_filter = argv[++i];
+        else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) out_path = argv[++i];
+        else if (strcmp(argv[i], "--quick") == 0) g_quick = 1;
+        else {
+            fprintf(stderr, "usage: %s [--tool PATH] [--server PATH] [--runs N] [--quick] "
+                            "[--filter TEXT] [--out FILE]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (g_runs < 1) g_runs = 1;
+
+    // Children are exec'd by absolute path from other directories
+    static char tool[4096];
+    if (!realpath(g_tool, tool)) {
+        fprintf(stderr, "bench: cannot find %s\n", g_tool);
+        return 1;
+    }
+    g_tool = tool;
+
+    snprintf(g_root, sizeof(g_root), "/tmp/gitignore-bench.XXXXXX");
+    if (!mkdtemp(g_root)) {
+        perror("bench: mkdtemp");
+        return 1;
+    }
+    snprintf(g_home, sizeof(g_home), "%s/home", g_root);
+    char cache_dir[400];
+    snprintf(cache_dir, sizeof(cache_dir), "%s/.config/gitignore/cache", g_home);
+    mkdir_p(cache_dir);
+
+    static char env_home[320];
+    snprintf(env_home, sizeof(env_home), "HOME=%s", g_home);
+    g_env[0] = env_home;
+    g_env[1] = "PATH=/usr/bin:/bin";
+    g_env[2] = "LC_ALL=C";
+
+    if (server_start() != 0) {
+        server_stop();
+        rm_rf(g_root);
+        return 1;
+    }
+    g_env[3] = g_server_url;
+    g_env[4] = NULL;
+
+    fprintf(stderr, "Benchmarking %s (%d runs each) in %s\n", g_tool, g_runs, g_root);
+    bench_existing_file();
+    bench_custom_templates();
+    bench_sync();
+    bench_auto();
+    bench_startup();
+
+    FILE *out = out_path ? fopen(out_path, "w") : stdout;
+    if (!out) {
+        perror("bench: output");
+        server_stop();
+        rm_rf(g_root);
+        return 1;
+    }
+    report(out);
+    if (out != stdout) {
+        fclose(out);
+        fprintf(stderr, "Results written to %s\n", out_path);
+    }
+
+    server_stop();
+    rm_rf(g_root);
+
+    int failures = 0;
+    for (int i = 0; i < g_result_count; i++) failures += g_results[i].failures;
+    return failures ? 1 : 0;
+}
@@ -2,6 +2,11 @@
 #ifndef GITIGNORE_H
 #define GITIGNORE_H
 
+// POSIX/GNU interfaces (mmap, pread, flock, ...) are used throughout
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -12,6 +17,9 @@
 #include <curl/curl.h>
 #include <dirent.h>
 #include <time.h>
+#include <stdint.h>
+#include <sys/uio.h>
+#include <stdarg.h>
 
 // Include strings.h for strcasecmp on systems where it's needed
 #ifdef __linux__
@@ -33,7 +41,13 @@ int strcasecmp(const char *s1, const char *s2);
 #define MAX_PATH_LEN 512
 #define MAX_LINE_LEN 1024
 #define CACHE_DURATION 86400
+#define MAX_PARALLEL 16
+#ifndef GITHUB_RAW_URL
 #define GITHUB_RAW_URL "https://raw.githubusercontent.com/github/gitignore/main/"
+#endif
+#ifndef GITHUB_ARCHIVE_URL
+#define GITHUB_ARCHIVE_URL "https://codeload.github.com/github/gitignore/tar.gz/refs/heads/main"
+#endif
 
 // ANSI Color codes
 #define COLOR_RED     "\x1b[31m"
@@ -52,6 +66,10 @@ int strcasecmp(const char *s1, const char *s2);
 #define BACKUP_DIR "backups"
 #define AUTO_TEMPLATE "auto.gitignore"
 #define CONFIG_FILE "config.conf"
+#define TEMPLATE_URL_ENV "GITIGNORE_TEMPLATE_URL"
+#define TEMPLATE_SOURCE_ENV "GITIGNORE_TEMPLATE_SOURCE"
+#define ARCHIVE_URL_ENV "GITIGNORE_ARCHIVE_URL"
+#define SOCKET_ENV "GITIGNORE_SOCKET"
 #define GLOBAL_GITIGNORE ".gitignore_global"
 
 // Error codes
@@ -64,14 +82,23 @@ typedef enum {
     ERR_CURL_INIT_FAILED,
     ERR_OUT_OF_MEMORY,
     ERR_INVALID_ARGUMENT,
-    ERR_CACHE_ERROR
+    ERR_CACHE_ERROR,
+    ERR_UNCHANGED               // not an error: the output already had this content
 } error_code_t;
 
+// Exit status of init, append, sync and batch when no file needed changing
+#define EXIT_UNCHANGED 3
+
+// --timings output formats
+#define TIMINGS_TABLE 1
+#define TIMINGS_JSON  2
+
 // Merge strategies
 typedef enum {
     MERGE_APPEND,
     MERGE_REPLACE,
-    MERGE_SMART
+    MERGE_SMART,
+    MERGE_MINIMAL           // SMART, then drop new rules other rules already cover
 } merge_strategy_t;
 
 // Config structure
@@ -81,18 +108,313 @@ typedef struct {
     int auto_backup;
     int cache_enabled;
     int cache_duration;
+    int max_parallel;
+    int timings;            // TIMINGS_TABLE or TIMINGS_JSON when reporting
+    int fsync_writes;
+    int minimal_merge;
+    char template_url[MAX_PATH_LEN];    // base URL templates are fetched from
+    char template_source[MAX_PATH_LEN]; // local clone or tarball used instead
+    char archive_url[MAX_PATH_LEN];     // whole repository, for cache prefetch
     int verbose;
     int quiet;
     int use_color;
+    int use_color_set;      // use_color came from the config file
 } config_t;
 
+// Per-process paths under $HOME, resolved on first use. Directories are
+// only created by the commands that write into them (app_paths_ensure).
+typedef struct {
+    char home[MAX_PATH_LEN];
+    char config_dir[MAX_PATH_LEN];      // ~/.config/gitignore
+    char templates_dir[MAX_PATH_LEN];
+    char cache_dir[MAX_PATH_LEN];
+    char backup_dir[MAX_PATH_LEN];
+    char config_file[MAX_PATH_LEN];
+    unsigned ensured;                   // APP_DIR_* known to exist
+} app_paths_t;
+
+#define APP_DIR_CONFIG    0x1
+#define APP_DIR_TEMPLATES 0x2
+#define APP_DIR_CACHE     0x4
+#define APP_DIR_BACKUP    0x8
+
+// Cache lookup results
+typedef enum {
+    CACHE_MISS,
+    CACHE_FRESH,
+    CACHE_STALE
+} cache_state_t;
+
+// HTTP validators stored alongside each cached template
+typedef struct {
+    char etag[128];
+    char last_modified[64];
+    char commit[64];        // upstream commit of a prefetched template, else empty
+    time_t fetched_at;
+    size_t size;
+} cache_meta_t;
+
+// Entry returned by the packed cache store; data points into the mapping
+typedef struct {
+    const char *data;
+    size_t size;
+    uint64_t content_hash;
+    cache_meta_t meta;
+} pack_entry_t;
+
+// Hash set of normalized patterns used for SMART merge deduplication
+typedef struct {
+    uint64_t hash;
+    const char *data;
+    size_t len;
+} pattern_entry_t;
+
+// A whole file's bytes, mapped or read; see fileview.c
+typedef struct {
+    const char *data;           // not NUL-terminated when mapped
+    size_t size;
+    void *map;
+    char *owned;
+} file_view_t;
+
+// Bump allocator for one command's transient tables; see arena.c
+typedef struct arena_block arena_block_t;
+
+typedef struct {
+    arena_block_t *head;        // block being filled; older ones follow
+    size_t next_size;
+    void *last;                 // most recent allocation, can grow in place
+} arena_t;
+
+// make dev builds count heap allocations for --timings
+#if defined(DEBUG) && defined(__GLIBC__)
+#define GITIGNORE_ALLOC_COUNTS 1
+#else
+#define GITIGNORE_ALLOC_COUNTS 0
+#endif
+
+typedef struct {
+    pattern_entry_t *slots;
+    size_t capacity;
+    size_t count;
+    arena_t *arena;             // slots come from here when set
+} pattern_set_t;
+
+// Segmented receive buffer; see stream.c
+typedef struct stream_block stream_block_t;
+
+typedef struct {
+    stream_block_t *head;
+    stream_block_t *tail;
+    stream_block_t *cur;         // line cursor
+    size_t cur_off;
+    stream_block_t *scan_block;  // where an incomplete line search stopped
+    size_t scan_off;
+    size_t size;
+    size_t next_block;
+    int blocks;
+} stream_buf_t;
+
+// Template download job for the concurrent fetch engine
+typedef struct fetch_job {
+    const char *lang;
+    const cache_meta_t *validators;  // optional: revalidate instead of refetch
+    void (*on_data)(struct fetch_job *job, void *ctx);  // optional: body grew or job finished
+    void *ctx;
+    stream_buf_t body;
+    long http_code;
+    int not_modified;                // server answered 304, body is empty
+    int finished;
+    cache_meta_t meta;               // validators returned by the server
+    error_code_t status;
+} fetch_job_t;
+
+// A template body that is either borrowed (cache mapping, built-in) or owned
+typedef struct {
+    const char *data;
+    size_t size;
+    char *owned;
+} template_body_t;
+
+// Built-in templates are pre-split at build time (scripts/gen_templates.c)
+#define BUILTIN_LINE_COMMENT 0x1
+
+typedef struct {
+    uint64_t hash;          // hash_bytes() of the normalized pattern
+    uint32_t offset;        // line start within the template body
+    uint32_t len;           // line length without its newline
+    uint32_t norm_offset;   // normalized pattern, as normalize_pattern()
+    uint32_t norm_len;
+    uint32_t flags;         // BUILTIN_LINE_COMMENT for comments and blanks
+} builtin_line_t;
+
+typedef struct {
+    const char *name;
+    const char *content;
+    size_t size;
+    const builtin_line_t *lines;
+    int line_count;
+    int pattern_count;
+} builtin_template_t;
+
+// A template ready to merge: a body in memory or a pre-split built-in
+typedef struct {
+    const char *name;
+    const char *data;
+    size_t size;
+    const builtin_template_t *builtin;
+} resolved_template_t;
+
+// Called just before merge_resolved() replaces an existing output
+typedef void (*merge_write_fn)(const char *output);
+
+// One directory to update in batch mode
+typedef struct {
+    const char *path;
+    const char **templates;
+    int template_count;
+} batch_target_t;
+
+// A subproject found by the recursive walker
+typedef struct {
+    char *path;             // relative to the walk's start directory
+    uint32_t langs;         // bitmask over project languages
+} project_root_t;
+
+// Why minimization drops a rule; see minimize.c
+typedef struct {
+    int by;                 // rule that makes it redundant, or -1 to keep it
+    int inside;             // it only matches inside a directory "by" excludes
+} rule_cover_t;
+
+// One directory entry handed to a walk_tree() visitor
+typedef struct {
+    const char *name;
+    int is_dir;
+    int descend;            // the visitor clears this to prune a directory
+} walk_entry_t;
+
+typedef void (*walk_visit_fn)(void *ctx, int worker, int dirfd, const char *path,
+                              walk_entry_t *entries, int count, uint32_t *state);
+
+// A file under construction: spans referencing caller-held bytes plus
+// the formatted text the buffer owns
+typedef struct {
+    struct iovec *iov;
+    int count;
+    int cap;
+    size_t size;
+    char **owned;
+    int owned_count;
+    arena_t *arena;             // spans and formatted text live here when set
+} out_buf_t;
+
+// Template sections init, append and sync write; see sections.c
+typedef enum {
+    SECTION_LINE_OTHER = 0,
+    SECTION_LINE_HEADER,        // "# ===== name ====="
+    SECTION_LINE_END,           // "# ===== end name [hash] ====="
+    SECTION_LINE_MARKER         // "# Added by gitignore tool" and the like
+} section_line_t;
+
+typedef enum {
+    SECTION_KEEP = 0,
+    SECTION_REPLACE,
+    SECTION_DROP
+} section_action_t;
+
+typedef struct {
+    const char *name;           // points into the file
+    size_t name_len;
+    size_t start;               // blank lines before the header
+    size_t body;                // first line after the header
+    size_t end;                 // past the end marker, or the last body line
+    uint64_t hash;              // template body hash from the end marker
+    int managed;                // has an end marker; older sections do not
+    int marker;                 // a marker line, not a section
+    section_action_t action;
+    int slot;                   // merge slot that claimed it, or -1
+} section_t;
+
+typedef struct {
+    const char *data;
+    size_t size;
+    section_t *items;           // in file order
+    int count;
+} section_index_t;
+
+typedef int (*section_render_fn)(out_buf_t *out, int slot, void *ctx);
+
+// One compiled ignore rule; see matcher.c
+#define RULE_NEGATE     0x1     // "!pattern" re-includes
+#define RULE_DIR_ONLY   0x2     // "pattern/" only matches directories
+#define RULE_ANCHORED   0x4     // has a slash: matched against the whole path
+#define RULE_GLOB       0x8     // needs the wildcard matcher
+
+typedef struct {
+    char *pattern;          // without "!", leading or trailing "/"; NUL-terminated
+    uint32_t len;
+    uint32_t flags;
+    const char *text;       // the line as written, for --explain
+    uint32_t text_len;
+    int source;             // index into ignore_matcher_t.sources
+    int line;               // 1-based line within the source
+    int next;               // earlier rule with the same table key, or -1
+    char first;             // literal first byte a match must start with, or 0
+    char last;              // literal last byte a match must end with, or 0
+} ignore_rule_t;
+
+typedef struct {
+    uint64_t hash;
+    const char *key;
+    uint32_t len;
+    int head;               // latest rule with this key
+} rule_slot_t;
+
+typedef struct {
+    rule_slot_t *slots;
+    size_t capacity;
+    size_t count;
+} rule_table_t;
+
+typedef struct {
+    ignore_rule_t *rules;   // in file order; later rules win
+    int count;
+    int cap;
+    rule_table_t names;     // literal basenames
+    rule_table_t paths;     // literal anchored paths
+    rule_table_t exts;      // "*.ext" suffixes, keyed by the last extension
+    int *globs;             // indexes of wildcard rules, ascending
+    int glob_count;
+    int glob_cap;
+    char **sources;
+    int source_count;
+    char **buffers;         // file contents the rule texts point into
+    int buffer_count;
+} ignore_matcher_t;
+
+// Per-transfer timing record reported by --timings
+typedef struct {
+    char lang[64];
+    double namelookup;
+    double connect;
+    double appconnect;
+    double starttransfer;
+    double total;
+    size_t bytes;
+    long http_code;
+    long http_version;
+    int reused;
+    double start_ms;        // on the --timings timeline
+} fetch_timing_t;
+
 // Function declarations
 void show_help(void);
 void show_version(void);
 int parse_flags(int argc, char *argv[]);
 int init_gitignore(char **langs, int count, int dry_run);
 int sync_gitignore(char **langs, int count, int dry_run);
-int list_templates(const char *filter, int show_local, int show_builtin);
+int list_templates(const char *filter, int show_local, int show_builtin, int show_stats);
 int show_template(const char *lang);
 int append_gitignore(char **langs, int count, merge_strategy_t strategy, int dry_run);
 
@@ -100,6 +422,7 @@ int append_gitignore(char **langs, int count, merge_strategy_t strategy, int dry
 int add_patterns(char **patterns, int count, int dry_run);
 
 int auto_detect(int dry_run);
+int auto_detect_recursive(int dry_run);
 int interactive_mode(void);
 int global_init(void);
 int global_add(char **langs, int count);
@@ -107,23 +430,150 @@ int backup_gitignore(void);
 int restore_gitignore(const char *backup_name);
 int list_backups(void);
 int init_cache(void);
-int get_cached_template(const char *lang, char **content);
+int get_cached_template(const char *lang, const char **content, size_t *size);
+cache_state_t cache_lookup(const char *lang, const char **content, size_t *size, cache_meta_t *meta);
 int cache_template(const char *lang, const char *content);
+int cache_store(const char *lang, const char *content, size_t size, const cache_meta_t *meta);
+int cache_store_iov(const char *lang, const struct iovec *iov, int iovcnt, const cache_meta_t *meta);
+int cache_touch(const char *lang, const cache_meta_t *meta);
 int clear_cache(void);
+int compact_cache(void);
+int pack_get(const char *name, pack_entry_t *entry);
+int pack_put(const char *name, const char *data, size_t size, const cache_meta_t *meta);
+int pack_put_iov(const char *name, const struct iovec *iov, int iovcnt, const cache_meta_t *meta);
+int pack_touch(const char *name, const cache_meta_t *meta);
+int pack_compact(size_t *reclaimed);
+int pack_clear(int *removed);
+void pack_close(void);
 config_t* load_config(void);
+void config_apply_env(config_t *config);
 void free_config(config_t *config);
 int save_config(config_t *config);
 void apply_config(config_t *config);
+int path_join(char *out, const char *dir, const char *name);
+const app_paths_t* app_paths(void);
+int app_paths_ensure(unsigned dirs);
 char* get_config_path(void);
 char* get_cache_path(void);
 char* get_backup_path(void);
-char* get_template_path(const char *lang);
+int template_path(const char *lang, char *out);
 int file_exists(const char *path);
+int64_t stat_mtime_ns(const struct stat *st);
+int make_dirs(const char *path);
+uint64_t hash_bytes(const void *data, size_t len);
+uint64_t hash_bytes_update(uint64_t h, const void *data, size_t len);
 int create_empty_gitignore(void);
+merge_strategy_t merge_default_strategy(int exists);
 int merge_templates(char **langs, int count, const char *output, merge_strategy_t strategy);
-int download_template(const char *lang, char *buffer, size_t *size);
+error_code_t merge_resolved(const resolved_template_t *templates, int count,
+                            const char *output, merge_strategy_t strategy, merge_write_fn before_write);
+int batch_apply(const char *manifest, int dry_run);
+int batch_apply_targets(const batch_target_t *targets, int count, int dry_run);
+uint32_t project_indicator_mask(const char *name);
+uint32_t project_root_mask(uint32_t langs);
+const char* project_lang_name(int bit);
+int walk_default_threads(void);
+int walk_tree(const char *start, int threads, walk_visit_fn visit, void *ctx);
+int walk_projects(const char *start, int threads, project_root_t **roots, int *count);
+void free_project_roots(project_root_t *roots, int count);
+int download_template(const char *lang, template_body_t *body);
+int source_enabled(void);
+int source_lookup(const char *name, const char **data, size_t *size);
+void source_close(void);
+uint64_t tar_octal(const char *field, size_t len);
+int tar_pax_value(const char *data, size_t size, const char *key, char *out, size_t out_len);
+int prefetch_cache(int force);
+void prefetch_reset(void);
+int prefetch_pinned(const char *commit);
+int serve_forward(int argc, char *argv[], int *status);
+int serve_daemon(const char *socket_path, int idle_seconds);
+const char* serve_file(const char *path, size_t *size);
+const ignore_matcher_t* serve_rules(char **sources, int count);
+void template_body_free(template_body_t *body);
+int fetch_init(void);
+int fetch_header_value(const char *line, size_t len, const char *name, char *dst, size_t dst_len);
+void fetch_cleanup(void);
+int fetch_templates(fetch_job_t *jobs, int count, int max_parallel);
+void fetch_report_timings(FILE *out, int json);
+double timing_elapsed_ms(void);
+int timing_begin(const char *name);
+void timing_end(int id);
+void timing_note(int id, const char *fmt, ...);
+void timing_json_string(FILE *out, const char *s);
+void timing_report(FILE *out, int json);
+void timing_reset(void);
+void stream_init(stream_buf_t *sb);
+void stream_free(stream_buf_t *sb);
+int stream_append(stream_buf_t *sb, const char *data, size_t len);
+int stream_next_line(stream_buf_t *sb, int final, const char **line, size_t *len);
+int stream_iov(const stream_buf_t *sb, struct iovec *iov, int max);
+char* stream_flatten(const stream_buf_t *sb, size_t *size);
 char** remove_duplicates(char **langs, int *count);
 int is_comment(const char *line);
+int is_comment_span(const char *line, size_t len);
+char* read_file(const char *path, size_t *size);
+void file_view_init(file_view_t *fv);
+int file_view_open(file_view_t *fv, const char *path);
+int file_view_fd(file_view_t *fv, int fd);
+void file_view_close(file_view_t *fv);
+char* file_view_detach(file_view_t *fv, size_t *size);
+int file_view_next_line(const file_view_t *fv, size_t *pos, const char **line, size_t *len);
+void merge_template_content(out_buf_t *out, const char *content, size_t size, pattern_set_t *seen);
+void out_init(out_buf_t *ob);
+void out_init_arena(out_buf_t *ob, arena_t *arena);
+void out_free(out_buf_t *ob);
+int out_add(out_buf_t *ob, const void *data, size_t len);
+int out_add_line(out_buf_t *ob, const char *line, size_t len, const char *end);
+int out_printf(out_buf_t *ob, const char *fmt, ...);
+char* out_flatten(const out_buf_t *ob);
+int out_equals(const out_buf_t *ob, const void *data, size_t size);
+int out_commit(out_buf_t *ob, const char *path);
+section_line_t section_line(const char *p, size_t len, const char **name, size_t *name_len,
+                            uint64_t *hash);
+int section_index_build(section_index_t *idx, arena_t *arena, const char *data, size_t size);
+int section_claim(section_index_t *idx, const char *name, int slot);
+int section_current(const section_index_t *idx, int section, uint64_t hash);
+int section_keep(section_index_t *idx, int section, pattern_set_t *seen);
+int section_release(section_index_t *idx, int slot, pattern_set_t *seen);
+int section_dirty(const section_index_t *idx);
+int section_seed(const section_index_t *idx, pattern_set_t *seen);
+void section_begin(out_buf_t *out, const char *name);
+void section_end(out_buf_t *out, const char *name, uint64_t hash);
+int section_rewrite(const section_index_t *idx, out_buf_t *out, pattern_set_t *seen,
+                    section_render_fn render, void *ctx);
+const char* normalize_pattern(const char *line, size_t len, size_t *out_len);
+void pattern_set_init(pattern_set_t *set);
+void pattern_set_init_arena(pattern_set_t *set, arena_t *arena);
+int pattern_set_reserve(pattern_set_t *set, size_t patterns);
+size_t count_lines(const char *data, size_t size);
+void arena_init(arena_t *a);
+void arena_free(arena_t *a);
+void* arena_alloc(arena_t *a, size_t size);
+void* arena_calloc(arena_t *a, size_t count, size_t size);
+void* arena_realloc(arena_t *a, void *ptr, size_t old_size, size_t new_size);
+char* arena_vprintf(arena_t *a, size_t *len, const char *fmt, va_list ap);
+#if GITIGNORE_ALLOC_COUNTS
+uint64_t heap_alloc_count(void);
+#endif
+void pattern_set_free(pattern_set_t *set);
+int pattern_set_contains(const pattern_set_t *set, const char *line, size_t len);
+int pattern_set_insert(pattern_set_t *set, const char *line, size_t len);
+int pattern_set_insert_hashed(pattern_set_t *set, const char *norm, size_t len, uint64_t hash);
+int pattern_set_remove(pattern_set_t *set, const char *line, size_t len);
+int pattern_set_add_lines(pattern_set_t *set, const char *data, size_t size);
+void matcher_init(ignore_matcher_t *m);
+void matcher_free(ignore_matcher_t *m);
+int matcher_add_buffer(ignore_matcher_t *m, const char *source, const char *data, size_t size);
+int matcher_add_file(ignore_matcher_t *m, const char *path);
+int matcher_check(const ignore_matcher_t *m, char *path, size_t len, int is_dir);
+int matcher_match_all(const ignore_matcher_t *m, const char *path, size_t len, size_t base,
+                      int is_dir, int *rules, int max);
+int matcher_glob(const char *pattern, const char *text);
+int matcher_minimize(const ignore_matcher_t *m, const unsigned char *fixed, rule_cover_t *covers);
+int minimize_gitignore(const char *path, int dry_run);
+int matcher_is_ignored(const ignore_matcher_t *m, int rule);
+int audit_gitignore(const char *path);
+int check_paths(char **paths, int count, char **sources, int source_count, int nul, int explain);
 void print_error(const char *msg, error_code_t code);
 void print_success(const char *msg);
 void print_warning(const char *msg);
@@ -134,6 +584,10 @@ int is_language_name(const char *name);
 int is_path_or_pattern(const char *name);
 // Add this near the top of the file, after other #includes
 const char* get_builtin_template(const char *name);
+const builtin_template_t* find_builtin_template(const char *name);
+void merge_builtin_template(out_buf_t *out, const builtin_template_t *t, pattern_set_t *seen);
+int is_builtin_template(const char *name);
+const char** get_builtin_template_names(void);
 // FIXED: New function to check if name is a command
 int is_command_name(const char *name);
 
@@ -0,0 +1,486 @@
+// gen_templates.c - Build-time generator for src/templates.c
+//
+// Usage: gen_templates <templates-dir> <output.c>
+//
+// Embeds every <name>.gitignore in the templates directory, reads the
+// optional "aliases" file next to them and emits:
+//   - one string constant per template
+//   - a line table per template: offsets, lengths, a comment/blank flag
+//     and the hash of each normalized pattern, so merges never re-parse
+//     built-ins at runtime
+//   - a name table sorted case-insensitively
+//   - a perfect hash (hash and displace) over the case-folded names and
+//     aliases, so get_builtin_template() costs one hash and one strcmp
+//
+// Built with the host compiler by scripts/generate_templates.sh; it only
+// needs libc.
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#define MAX_NAME 64
+#define MAX_DISPLACE 1000000
+
+// Must match builtin_hash() in the generated code
+static uint64_t hash_key(const char *key, uint64_t seed) {
+    uint64_t h = 14695981039346656037ULL ^ (seed * 0x9E3779B97F4A7C15ULL);
+    for (const unsigned char *p = (const unsigned char *)key; *p; p++) {
+        h ^= *p;
+        h *= 1099511628211ULL;
+    }
+    h ^= h >> 29;
+    return h;
+}
+
+typedef struct {
+    char name[MAX_NAME];     // display name (file basename)
+    char folded[MAX_NAME];
+    char ident[MAX_NAME + 16];
+    char *content;
+    size_t size;
+} template_t;
+
+typedef struct {
+    char folded[MAX_NAME];
+    int target;              // index into the sorted template table
+} template_key_t;
+
+static template_t *templates;
+static int template_count;
+static template_key_t *keys;
+static int key_count;
+
+static void die(const char *msg, const char *arg) {
+    fprintf(stderr, "gen_templates: %s%s%s\n", msg, arg ? ": " : "", arg ? arg : "");
+    exit(1);
+}
+
+static void fold(char *dst, const char *src) {
+    size_t i = 0;
+    for (; src[i] && i < MAX_NAME - 1; i++) dst[i] = (char)tolower((unsigned char)src[i]);
+    dst[i] = '\0';
+}
+
+static char* slurp(const char *path, size_t *size) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+
+    size_t cap = 4096, len = 0;
+    char *buf = malloc(cap);
+    size_t n;
+    while (buf && (n = fread(buf + len, 1, cap - len - 1, f)) > 0) {
+        len += n;
+        if (cap - len - 1 == 0) {
+            cap *= 2;
+            buf = realloc(buf, cap);
+        }
+    }
+    fclose(f);
+    if (!buf) die("out of memory", NULL);
+
+    buf[len] = '\0';
+    *size = len;
+    return buf;
+}
+
+static int cmp_template(const void *a, const void *b) {
+    return strcmp(((const template_t *)a)->folded, ((const template_t *)b)->folded);
+}
+
+static int find_template(const char *folded) {
+    for (int i = 0; i < template_count; i++) {
+        if (strcmp(templates[i].folded, folded) == 0) return i;
+    }
+    return -1;
+}
+
+static void add_key(const char *folded, int target) {
+    for (int i = 0; i < key_count; i++) {
+        if (strcmp(keys[i].folded, folded) == 0) die("duplicate template name or alias", folded);
+    }
+    keys = realloc(keys, (size_t)(key_count + 1) * sizeof(*keys));
+    if (!keys) die("out of memory", NULL);
+    snprintf(keys[key_count].folded, MAX_NAME, "%s", folded);
+    keys[key_count].target = target;
+    key_count++;
+}
+
+static void load_templates(const char *dir) {
+    DIR *d = opendir(dir);
+    if (!d) die("cannot open templates directory", dir);
+
+    struct dirent *e;
+    while ((e = readdir(d)) != NULL) {
+        size_t len = strlen(e->d_name);
+        const char *ext = ".gitignore";
+        size_t ext_len = strlen(ext);
+        if (len <= ext_len || strcmp(e->d_name + len - ext_len, ext) != 0) continue;
+        if (len - ext_len >= MAX_NAME) die("template name too long", e->d_name);
+
+        templates = realloc(templates, (size_t)(template_count + 1) * sizeof(*templates));
+        if (!templates) die("out of memory", NULL);
+        template_t *t = &templates[template_count++];
+        memset(t, 0, sizeof(*t));
+
+        snprintf(t->name, MAX_NAME, "%.*s", (int)(len - ext_len), e->d_name);
+        fold(t->folded, t->name);
+
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s", dir, e->d_name);
+        t->content = slurp(path, &t->size);
+        if (!t->content) die("cannot read", path);
+
+        // Every line, the last included, ends with a newline
+        if (t->size == 0 || t->content[t->size - 1] != '\n') {
+            t->content = realloc(t->content, t->size + 2);
+            if (!t->content) die("out of memory", NULL);
+            t->content[t->size++] = '\n';
+            t->content[t->size] = '\0';
+        }
+    }
+    closedir(d);
+
+    if (template_count == 0) die("no .gitignore files found in", dir);
+
+    qsort(templates, (size_t)template_count, sizeof(*templates), cmp_template);
+
+    for (int i = 0; i < template_count; i++) {
+        if (i > 0 && strcmp(templates[i - 1].folded, templates[i].folded) == 0) {
+            die("templates differ only in case", templates[i].name);
+        }
+
+        // Unique C identifier, e.g. "c++" -> "c___template_3"
+        char *p = templates[i].ident;
+        for (const char *s = templates[i].folded; *s; s++) {
+            *p++ = isalnum((unsigned char)*s) ? *s : '_';
+        }
+        snprintf(p, 16, "_template_%d", i);
+
+        add_key(templates[i].folded, i);
+    }
+}
+
+// Alias file lines: "alias = template" (blank lines and # comments ignored)
+static void load_aliases(const char *dir) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/aliases", dir);
+
+    size_t size;
+    char *data = slurp(path, &size);
+    if (!data) return;
+
+    char *save = NULL;
+    for (char *line = strtok_r(data, "\n", &save); line; line = strtok_r(NULL, "\n", &save)) {
+        while (isspace((unsigned char)*line)) line++;
+        if (*line == '\0' || *line == '#') continue;
+
+        char alias[MAX_NAME], target[MAX_NAME];
+        if (sscanf(line, "%63[^= \t] = %63s", alias, target) != 2) die("bad alias line", line);
+
+        char fa[MAX_NAME], ft[MAX_NAME];
+        fold(fa, alias);
+        fold(ft, target);
+
+        int t = find_template(ft);
+        if (t < 0) die("alias points at unknown template", line);
+        add_key(fa, t);
+    }
+
+    free(data);
+}
+
+static void emit_string(FILE *out, const char *data, size_t size) {
+    fputs("\"", out);
+    for (size_t i = 0; i < size; i++) {
+        unsigned char c = (unsigned char)data[i];
+        if (c == '\n') {
+            fputs(i + 1 < size ? "\\n\"\n\"" : "\\n", out);
+        } else if (c == '\\' || c == '"') {
+            fprintf(out, "\\%c", c);
+        } else if (c == '?' && i > 0 && data[i - 1] == '?') {
+            fputs("\\?", out);     // no trigraphs
+        } else if (c < 0x20 || c >= 0x7f) {
+            fprintf(out, "\\%03o", c);
+        } else {
+            fputc(c, out);
+        }
+    }
+    fputs("\"", out);
+}
+
+// Must match hash_bytes() in src/utils.c
+static uint64_t hash_pattern(const char *data, size_t len) {
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)data[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+// Same rules as is_comment_span() and normalize_pattern() in the tool
+static int is_comment_line(const char *line, size_t len) {
+    size_t i = 0;
+    while (i < len && (line[i] == ' ' || line[i] == '\t')) i++;
+    return i == len || line[i] == '#' || line[i] == '\r';
+}
+
+static size_t normalize(const char *line, size_t len, size_t *start) {
+    size_t s = 0;
+    while (s < len && (line[s] == ' ' || line[s] == '\t')) s++;
+    line += s;
+    len -= s;
+
+    while (len > 0 && line[len - 1] == '\r') len--;
+    while (len > 0 && (line[len - 1] == ' ' || line[len - 1] == '\t')) {
+        if (len > 1 && line[len - 2] == '\\') break;
+        len--;
+    }
+
+    *start = s;
+    return len;
+}
+
+// Returns the number of pattern lines
+static int emit_lines(FILE *out, const template_t *t, int *line_count) {
+    int lines = 0, patterns = 0;
+
+    fprintf(out, "static const builtin_line_t %s_lines[] = {\n", t->ident);
+    for (size_t off = 0; off < t->size;) {
+        const char *line = t->content + off;
+        const char *nl = memchr(line, '\n', t->size - off);
+        size_t len = (size_t)(nl - line);
+
+        if (is_comment_line(line, len)) {
+            fprintf(out, "    {0, %zu, %zu, 0, 0, BUILTIN_LINE_COMMENT},\n", off, len);
+        } else {
+            size_t start;
+            size_t norm_len = normalize(line, len, &start);
+            fprintf(out, "    {0x%016llxULL, %zu, %zu, %zu, %zu, 0},\n",
+                    (unsigned long long)hash_pattern(line + start, norm_len),
+                    off, len, off + start, norm_len);
+            patterns++;
+        }
+
+        lines++;
+        off += len + 1;
+    }
+    if (lines == 0) fprintf(out, "    {0, 0, 0, 0, 0, BUILTIN_LINE_COMMENT},\n");
+    fprintf(out, "};\n\n");
+
+    *line_count = lines;
+    return patterns;
+}
+
+// Hash and displace: keys are grouped into buckets by one hash, then the
+// largest buckets first search for a seed that sends all their keys to
+// free slots. The table has exactly one slot per key.
+static void build_hash(uint32_t *bucket_count_out, uint32_t **displace_out, int **slot_out) {
+    uint32_t m = (uint32_t)key_count;
+    uint32_t nb = (m + 3) / 4;
+
+    int *bucket_of = malloc((size_t)key_count * sizeof(int));
+    int *order = malloc(nb * sizeof(int));
+    int *bucket_size = calloc(nb, sizeof(int));
+    uint32_t *displace = calloc(nb, sizeof(uint32_t));
+    int *slot = malloc(m * sizeof(int));
+    int *trial = malloc(m * sizeof(int));
+    if (!bucket_of || !order || !bucket_size || !displace || !slot || !trial) die("out of memory", NULL);
+
+    for (uint32_t i = 0; i < m; i++) slot[i] = -1;
+    for (int k = 0; k < key_count; k++) {
+        bucket_of[k] = (int)(hash_key(keys[k].folded, 0) % nb);
+        bucket_size[bucket_of[k]]++;
+    }
+
+    // Largest buckets first
+    for (uint32_t b = 0; b < nb; b++) order[b] = (int)b;
+    for (uint32_t i = 1; i < nb; i++) {
+        int b = order[i];
+        uint32_t j = i;
+        while (j > 0 && bucket_size[order[j - 1]] < bucket_size[b]) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = b;
+    }
+
+    for (uint32_t oi = 0; oi < nb; oi++) {
+        int b = order[oi];
+        if (bucket_size[b] == 0) break;
+
+        uint32_t d;
+        for (d = 1; d < MAX_DISPLACE; d++) {
+            int placed = 0, ok = 1;
+            for (int k = 0; k < key_count && ok; k++) {
+                if (bucket_of[k] != b) continue;
+                uint32_t s = (uint32_t)(hash_key(keys[k].folded, d) % m);
+                if (slot[s] >= 0) ok = 0;
+                for (int p = 0; p < placed && ok; p++) {
+                    if (trial[p] == (int)s) ok = 0;
+                }
+                trial[placed++] = (int)s;
+            }
+            if (ok) break;
+        }
+        if (d == MAX_DISPLACE) die("could not build a perfect hash", NULL);
+
+        displace[b] = d;
+        for (int k = 0; k < key_count; k++) {
+            if (bucket_of[k] == b) slot[hash_key(keys[k].folded, d) % m] = k;
+        }
+    }
+
+    free(bucket_of);
+    free(order);
+    free(bucket_size);
+    free(trial);
+
+    *bucket_count_out = nb;
+    *displace_out = displace;
+    *slot_out = slot;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s <templates-dir> <output.c>\n", argv[0]);
+        return 1;
+    }
+
+    load_templates(argv[1]);
+    load_aliases(argv[1]);
+
+    uint32_t nb;
+    uint32_t *displace;
+    int *slot;
+    build_hash(&nb, &displace, &slot);
+
+    size_t max_key = 0;
+    for (int k = 0; k < key_count; k++) {
+        size_t len = strlen(keys[k].folded);
+        if (len > max_key) max_key = len;
+    }
+
+    FILE *out = fopen(argv[2], "w");
+    if (!out) die("cannot write", argv[2]);
+
+    fprintf(out,
+        "// templates.c - Auto-generated built-in templates\n"
+        "// DO NOT EDIT MANUALLY - Generated by scripts/generate_templates.sh\n"
+        "\n"
+        "#include \"gitignore.h\"\n"
+        "\n"
+        "// Perfect hash slot: a case-folded name or alias and its template\n"
+        "typedef struct {\n"
+        "    const char *key;\n"
+        "    int template_index;\n"
+        "} builtin_slot_t;\n"
+        "\n");
+
+    int *line_counts = malloc((size_t)template_count * sizeof(int));
+    int *pattern_counts = malloc((size_t)template_count * sizeof(int));
+    if (!line_counts || !pattern_counts) die("out of memory", NULL);
+
+    for (int i = 0; i < template_count; i++) {
+        fprintf(out, "// %s template\nstatic const char %s[] = \n", templates[i].name, templates[i].ident);
+        emit_string(out, templates[i].content, templates[i].size);
+        fprintf(out, ";\n\n");
+        pattern_counts[i] = emit_lines(out, &templates[i], &line_counts[i]);
+    }
+
+    fprintf(out, "// All built-in templates, sorted by case-folded name\n");
+    fprintf(out, "static const builtin_template_t builtin_templates[%d] = {\n", template_count);
+    for (int i = 0; i < template_count; i++) {
+        fprintf(out, "    {\"%s\", %s, sizeof(%s) - 1, %s_lines, %d, %d},\n",
+                templates[i].name, templates[i].ident, templates[i].ident,
+                templates[i].ident, line_counts[i], pattern_counts[i]);
+    }
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "static const char *builtin_names[%d] = {\n", template_count + 1);
+    for (int i = 0; i < template_count; i++) {
+        fprintf(out, "    \"%s\",\n", templates[i].name);
+    }
+    fprintf(out, "    NULL\n};\n\n");
+
+    fprintf(out, "#define BUILTIN_KEY_COUNT %d\n", key_count);
+    fprintf(out, "#define BUILTIN_BUCKET_COUNT %u\n", nb);
+    fprintf(out, "#define BUILTIN_MAX_KEY %zu\n\n", max_key);
+
+    fprintf(out, "static const uint32_t builtin_displace[BUILTIN_BUCKET_COUNT] = {");
+    for (uint32_t b = 0; b < nb; b++) {
+        fprintf(out, "%s%u", b % 12 == 0 ? "\n    " : " ", displace[b]);
+        if (b + 1 < nb) fputc(',', out);
+    }
+    fprintf(out, "\n};\n\n");
+
+    fprintf(out, "static const builtin_slot_t builtin_slots[BUILTIN_KEY_COUNT] = {\n");
+    for (int s = 0; s < key_count; s++) {
+        fprintf(out, "    {\"%s\", %d},\n", keys[slot[s]].folded, keys[slot[s]].target);
+    }
+    fprintf(out, "};\n\n");
+
+    fprintf(out,
+        "static uint64_t builtin_hash(const char *key, uint64_t seed) {\n"
+        "    uint64_t h = 14695981039346656037ULL ^ (seed * 0x9E3779B97F4A7C15ULL);\n"
+        "    for (const unsigned char *p = (const unsigned char *)key; *p; p++) {\n"
+        "        h ^= *p;\n"
+        "        h *= 1099511628211ULL;\n"
+        "    }\n"
+        "    h ^= h >> 29;\n"
+        "    return h;\n"
+        "}\n"
+        "\n"
+        "// Look up a built-in by name or alias (case-insensitive)\n"
+        "const builtin_template_t* find_builtin_template(const char *name) {\n"
+        "    char folded[BUILTIN_MAX_KEY + 1];\n"
+        "    size_t len = 0;\n"
+        "\n"
+        "    for (; name[len]; len++) {\n"
+        "        if (len == BUILTIN_MAX_KEY) return NULL;\n"
+        "        unsigned char c = (unsigned char)name[len];\n"
+        "        folded[len] = (char)(c >= 'A' && c <= 'Z' ? c + 32 : c);\n"
+        "    }\n"
+        "    folded[len] = '\\0';\n"
+        "\n"
+        "    uint32_t bucket = (uint32_t)(builtin_hash(folded, 0) %% BUILTIN_BUCKET_COUNT);\n"
+        "    uint32_t slot = (uint32_t)(builtin_hash(folded, builtin_displace[bucket]) %% BUILTIN_KEY_COUNT);\n"
+        "\n"
+        "    const builtin_slot_t *s = &builtin_slots[slot];\n"
+        "    return strcmp(s->key, folded) == 0 ? &builtin_templates[s->template_index] : NULL;\n"
+        "}\n"
+        "\n"
+        "// Get built-in template by name or alias (case-insensitive)\n"
+        "const char* get_builtin_template(const char *name) {\n"
+        "    const builtin_template_t *t = find_builtin_template(name);\n"
+        "    return t ? t->content : NULL;\n"
+        "}\n"
+        "\n"
+        "// Check if template is built-in\n"
+        "int is_builtin_template(const char *name) {\n"
+        "    return find_builtin_template(name) != NULL;\n"
+        "}\n"
+        "\n"
+        "// Get all built-in template names, sorted and NULL-terminated\n"
+        "const char** get_builtin_template_names(void) {\n"
+        "    return builtin_names;\n"
+        "}\n");
+
+    if (fclose(out) != 0) die("cannot write", argv[2]);
+
+    printf("✓ %d templates, %d aliases\n", template_count, key_count - template_count);
+
+    free(line_counts);
+    free(pattern_counts);
+    free(displace);
+    free(slot);
+    for (int i = 0; i < template_count; i++) free(templates[i].content);
+    free(templates);
+    free(keys);
+    return 0;
+}
@@ -1,10 +1,15 @@
 #!/bin/bash
 # generate_templates.sh - Auto-generate templates.c from templates/ directory
+#
+# The heavy lifting (embedding, alias table, perfect hash) is done by
+# scripts/gen_templates.c, which is compiled with the host compiler here.
 
 set -e
 
 TEMPLATE_DIR="templates"
 OUTPUT_FILE="src/templates.c"
+GENERATOR_SRC="scripts/gen_templates.c"
+HOST_CC="${CC:-cc}"
 
 echo "Generating templates.c from templates/ directory..."
 
@@ -23,91 +28,15 @@ fi
 
 echo "Found $TEMPLATE_COUNT template(s)"
 
-# Start generating templates.c
-cat > "$OUTPUT_FILE" << 'HEADER'
-// templates.c - Auto-generated built-in templates
-// DO NOT EDIT MANUALLY - Generated by scripts/generate_templates.sh
+GENERATOR=$(mktemp "${TMPDIR:-/tmp}/gen_templates.XXXXXX")
+trap 'rm -f "$GENERATOR"' EXIT
 
-#include "gitignore.h"
+"$HOST_CC" -O2 -std=c11 -o "$GENERATOR" "$GENERATOR_SRC"
 
-// Built-in template structure
-typedef struct {
-    const char *name;
-    const char *content;
-} builtin_template_t;
+# Write to a temp file so a failed run never leaves a truncated templates.c
+"$GENERATOR" "$TEMPLATE_DIR" "$OUTPUT_FILE.tmp"
+mv "$OUTPUT_FILE.tmp" "$OUTPUT_FILE"
 
-HEADER
+echo "✓ Generated $OUTPUT_FILE"
 
-# Generate template variables
-for template_file in "$TEMPLATE_DIR"/*.gitignore; do
-    if [ -f "$template_file" ]; then
-        # Extract name (remove path and .gitignore extension)
-        template_name=$(basename "$template_file" .gitignore)
-        
-        echo "  Processing: $template_name"
-        
-        # Generate C string variable
-        echo "// $template_name template" >> "$OUTPUT_FILE"
-        echo "static const char ${template_name}_template[] = " >> "$OUTPUT_FILE"
-        
-        # Read file line by line and convert to C string
-        while IFS= read -r line || [ -n "$line" ]; do
-            # Escape special characters
-            escaped_line=$(echo "$line" | sed 's/\\/\\\\/g' | sed 's/"/\\"/g')
-            echo "\"$escaped_line\\n\"" >> "$OUTPUT_FILE"
-        done < "$template_file"
-        
-        echo ";" >> "$OUTPUT_FILE"
-        echo "" >> "$OUTPUT_FILE"
-    fi
-done
-
-# Generate template array
-cat >> "$OUTPUT_FILE" << 'ARRAY_START'
-// All built-in templates
-static const builtin_template_t builtin_templates[] = {
-ARRAY_START
-
-# Add entries to array
-for template_file in "$TEMPLATE_DIR"/*.gitignore; do
-    if [ -f "$template_file" ]; then
-        template_name=$(basename "$template_file" .gitignore)
-        echo "    {\"$template_name\", ${template_name}_template}," >> "$OUTPUT_FILE"
-    fi
-done
-
-cat >> "$OUTPUT_FILE" << 'ARRAY_END'
-    {NULL, NULL}
-};
-
-// Get built-in template by name
-const char* get_builtin_template(const char *name) {
-    for (int i = 0; builtin_templates[i].name != NULL; i++) {
-        if (strcasecmp(builtin_templates[i].name, name) == 0) {
-            return builtin_templates[i].content;
-        }
-    }
-    return NULL;
-}
-
-// Check if template is built-in
-int is_builtin_template(const char *name) {
-    return get_builtin_template(name) != NULL;
-}
-
-// Get all built-in template names
-const char** get_builtin_template_names(void) {
-    static const char *names[64];
-    int count = 0;
-    
-    for (int i = 0; builtin_templates[i].name != NULL && count < 63; i++) {
-        names[count++] = builtin_templates[i].name;
-    }
-    names[count] = NULL;
-    
-    return names;
-}
-ARRAY_END
-
-echo "✓ Generated $OUTPUT_FILE with $TEMPLATE_COUNT templates"
-echo "✓ Templates: $(find "$TEMPLATE_DIR" -name "*.gitignore" -exec basename {} .gitignore \; | tr '\n' ' ')"
\ No newline at end of file
+echo "✓ Templates: $(find "$TEMPLATE_DIR" -name "*.gitignore" -exec basename {} .gitignore \; | sort | tr '\n' ' ')"
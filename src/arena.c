@@ -0,0 +1,148 @@
+// arena.c - Bump allocator for the transient data of one command
+//
+// Merges and syncs build tables whose lifetime is exactly the call that
+// builds them: the dedup set's slots, line tables, output spans and the
+// few formatted headers. Taking them from an arena turns one malloc per
+// table growth (and one free each at the end) into a pointer bump, and
+// everything is released by a single arena_free().
+//
+// Blocks grow geometrically, so even data that keeps growing costs a
+// logarithmic number of heap allocations. A request bigger than a fresh
+// block gets a block of its own. An arena is not thread-safe; code that
+// runs in batch workers keeps one per call.
+//
+// Built with -DDEBUG (make dev), this file also counts every heap
+// allocation the process makes, which --timings reports per phase.
+#include "gitignore.h"
+#include <stdarg.h>
+#include <stddef.h>
+
+#define ARENA_MIN_BLOCK (64 * 1024)
+#define ARENA_ALIGN     16
+
+struct arena_block {
+    arena_block_t *next;
+    size_t size;            // usable bytes after the header
+    size_t used;
+};
+
+// Header size rounded up so the first allocation is aligned
+#define ARENA_HEADER ((sizeof(arena_block_t) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+void arena_init(arena_t *a) {
+    a->head = NULL;
+    a->next_size = ARENA_MIN_BLOCK;
+    a->last = NULL;
+}
+
+void arena_free(arena_t *a) {
+    arena_block_t *b = a->head;
+    while (b) {
+        arena_block_t *next = b->next;
+        free(b);
+        b = next;
+    }
+    arena_init(a);
+}
+
+static char* arena_block_data(arena_block_t *b) {
+    return (char *)b + ARENA_HEADER;
+}
+
+void* arena_alloc(arena_t *a, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    if (size == 0) size = ARENA_ALIGN;
+
+    arena_block_t *b = a->head;
+    if (!b || b->size - b->used < size) {
+        size_t block = a->next_size;
+        while (block < size) block *= 2;
+
+        b = malloc(ARENA_HEADER + block);
+        if (!b) return NULL;
+        b->size = block;
+        b->used = 0;
+        b->next = a->head;
+        a->head = b;
+        a->next_size = block * 2;
+    }
+
+    void *p = arena_block_data(b) + b->used;
+    b->used += size;
+    a->last = p;
+    return p;
+}
+
+void* arena_calloc(arena_t *a, size_t count, size_t size) {
+    if (size && count > SIZE_MAX / size) return NULL;
+    void *p = arena_alloc(a, count * size);
+    if (p) memset(p, 0, count * size);
+    return p;
+}
+
+// Resize an allocation. The most recent one grows in place when its block
+// has room; anything else is copied and the old bytes are simply left.
+void* arena_realloc(arena_t *a, void *ptr, size_t old_size, size_t new_size) {
+    if (!ptr) return arena_alloc(a, new_size);
+
+    arena_block_t *b = a->head;
+    if (ptr == a->last && b) {
+        size_t offset = (size_t)((char *)ptr - arena_block_data(b));
+        size_t size = (new_size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+        if (offset + size <= b->size) {
+            b->used = offset + size;
+            return ptr;
+        }
+    }
+
+    void *p = arena_alloc(a, new_size);
+    if (p) memcpy(p, ptr, old_size < new_size ? old_size : new_size);
+    return p;
+}
+
+// Format into the arena; returns the NUL-terminated text and its length
+char* arena_vprintf(arena_t *a, size_t *len, const char *fmt, va_list ap) {
+    va_list copy;
+    va_copy(copy, ap);
+    int n = vsnprintf(NULL, 0, fmt, copy);
+    va_end(copy);
+    if (n < 0) return NULL;
+
+    char *text = arena_alloc(a, (size_t)n + 1);
+    if (!text) return NULL;
+    vsnprintf(text, (size_t)n + 1, fmt, ap);
+    if (len) *len = (size_t)n;
+    return text;
+}
+
+// ---------------------------------------------------------------------------
+// Heap allocation counts (make dev)
+
+#if GITIGNORE_ALLOC_COUNTS
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static uint64_t g_heap_allocs;
+
+// glibc routes its own allocations (strdup, vasprintf, fopen, ...)
+// through these too, so the count covers everything the process does
+void* malloc(size_t size) {
+    __atomic_fetch_add(&g_heap_allocs, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    __atomic_fetch_add(&g_heap_allocs, 1, __ATOMIC_RELAXED);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void *ptr, size_t size) {
+    __atomic_fetch_add(&g_heap_allocs, 1, __ATOMIC_RELAXED);
+    return __libc_realloc(ptr, size);
+}
+
+uint64_t heap_alloc_count(void) {
+    return __atomic_load_n(&g_heap_allocs, __ATOMIC_RELAXED);
+}
+#endif
@@ -0,0 +1,266 @@
+// audit.c - Show which .gitignore rules still match anything
+//
+// The working tree is walked in parallel and every entry is run through
+// the compiled rules. The rule that decides an entry gets the hit; the
+// other rules that matched it are recorded as overridden. Directories a
+// rule excludes are counted once and not descended into, the same way git
+// never looks inside them. Results are grouped by the "# ===== lang ====="
+// sections that init, update and sync write.
+#include "gitignore.h"
+#include <fcntl.h>
+#include <sys/time.h>
+
+#define AUDIT_MAX_MATCHES 64
+
+typedef struct {
+    long files;             // entries this rule decided
+    long dirs;
+    long long bytes;
+    long overridden;        // entries it matched where a later rule decided
+    int overridden_by;
+    long redundant;         // decided entries that the next match decides the same way
+    int covered_by;
+} audit_stat_t;
+
+typedef struct {
+    audit_stat_t *stats;
+    char *path;
+    size_t path_cap;
+    long files;
+    long dirs;
+} audit_worker_t;
+
+typedef struct {
+    const ignore_matcher_t *matcher;
+    audit_worker_t *workers;
+} audit_t;
+
+typedef struct {
+    char name[64];
+    int first_line;
+} audit_section_t;
+
+static void audit_visit(void *ctx, int worker, int dirfd, const char *path,
+                        walk_entry_t *entries, int count, uint32_t *state) {
+    audit_t *a = ctx;
+    audit_worker_t *aw = &a->workers[worker];
+    const ignore_matcher_t *m = a->matcher;
+    int matches[AUDIT_MAX_MATCHES];
+    (void)state;
+
+    size_t prefix = strcmp(path, ".") == 0 ? 0 : strlen(path) + 1;
+
+    for (int i = 0; i < count; i++) {
+        walk_entry_t *e = &entries[i];
+        if (e->is_dir && strcmp(e->name, ".git") == 0) {
+            e->descend = 0;
+            continue;
+        }
+
+        size_t name_len = strlen(e->name);
+        size_t len = prefix + name_len;
+        if (len + 1 > aw->path_cap) {
+            size_t cap = (len + 1) * 2;
+            char *grown = realloc(aw->path, cap);
+            if (!grown) continue;
+            aw->path = grown;
+            aw->path_cap = cap;
+        }
+        if (prefix > 0) {
+            memcpy(aw->path, path, prefix - 1);
+            aw->path[prefix - 1] = '/';
+        }
+        memcpy(aw->path + prefix, e->name, name_len + 1);
+
+        if (e->is_dir) aw->dirs++;
+        else aw->files++;
+
+        int n = matcher_match_all(m, aw->path, len, prefix, e->is_dir, matches, AUDIT_MAX_MATCHES);
+        if (n == 0) continue;
+
+        int decider = matches[0];
+        int ignored = matcher_is_ignored(m, decider);
+        audit_stat_t *st = &aw->stats[decider];
+
+        if (e->is_dir) {
+            st->dirs++;
+            if (ignored) e->descend = 0;
+        } else {
+            st->files++;
+            struct stat sb;
+            if (ignored && fstatat(dirfd, e->name, &sb, AT_SYMLINK_NOFOLLOW) == 0) {
+                st->bytes += sb.st_size;
+            }
+        }
+
+        for (int j = 1; j < n; j++) {
+            aw->stats[matches[j]].overridden++;
+            aw->stats[matches[j]].overridden_by = decider;
+        }
+
+        // Would the entry end up the same without this rule?
+        int fallback = n > 1 ? matcher_is_ignored(m, matches[1]) : 0;
+        if (fallback == ignored) {
+            st->redundant++;
+            st->covered_by = n > 1 ? matches[1] : -1;
+        }
+    }
+}
+
+// Section headers and end markers in source order; rules outside a
+// section are local
+static int audit_sections(const char *data, size_t size, audit_section_t **out) {
+    audit_section_t *sections = NULL;
+    int count = 0, cap = 0;
+    const char *p = data, *end = data + size;
+    int line = 0;
+
+    while (p < end) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        size_t len = nl ? (size_t)(nl - p) : (size_t)(end - p);
+        line++;
+
+        const char *name;
+        size_t name_len;
+        section_line_t kind = section_line(p, len, &name, &name_len, NULL);
+        if (kind == SECTION_LINE_HEADER || kind == SECTION_LINE_END) {
+            if (count == cap) {
+                cap = cap ? cap * 2 : 16;
+                audit_section_t *grown = realloc(sections, (size_t)cap * sizeof(audit_section_t));
+                if (!grown) break;
+                sections = grown;
+            }
+            // Rules after a section's end marker are local again
+            snprintf(sections[count].name, sizeof(sections[count].name), "%.*s",
+                     kind == SECTION_LINE_END ? 0 : (int)name_len, name);
+            sections[count].first_line = line;
+            count++;
+        }
+        p += len + (nl ? 1 : 0);
+    }
+
+    *out = sections;
+    return count;
+}
+
+static void audit_print_rule(const ignore_matcher_t *m, const ignore_rule_t *rule, const audit_stat_t *st,
+                             int *dead, int *shadowed, int *redundant) {
+    long decided = st->files + st->dirs;
+
+    printf("  %5d  %7ld  %5ld  %10lld  %.*s", rule->line, st->files, st->dirs, st->bytes,
+           (int)rule->text_len, rule->text);
+
+    if (decided == 0 && st->overridden == 0) {
+        printf("  %s(matches nothing)%s", COLOR_RED, COLOR_RESET);
+        (*dead)++;
+    } else if (decided == 0) {
+        printf("  %s(always overridden by line %d)%s", COLOR_YELLOW,
+               m->rules[st->overridden_by].line, COLOR_RESET);
+        (*shadowed)++;
+    } else if (st->redundant == decided) {
+        if (st->covered_by >= 0) {
+            printf("  %s(already covered by line %d)%s", COLOR_YELLOW,
+                   m->rules[st->covered_by].line, COLOR_RESET);
+        } else {
+            printf("  %s(re-includes nothing that was ignored)%s", COLOR_YELLOW, COLOR_RESET);
+        }
+        (*redundant)++;
+    }
+    printf("\n");
+}
+
+int audit_gitignore(const char *path) {
+    ignore_matcher_t matcher;
+    matcher_init(&matcher);
+
+    if (matcher_add_file(&matcher, path) != 0) {
+        char msg[MAX_PATH_LEN + 32];
+        snprintf(msg, sizeof(msg), "Cannot read %s", path);
+        print_error(msg, ERR_FILE_NOT_FOUND);
+        return 1;
+    }
+    if (matcher.count == 0) {
+        print_warning("No rules to audit");
+        matcher_free(&matcher);
+        return 0;
+    }
+
+    int threads = walk_default_threads();
+    audit_t audit;
+    audit.matcher = &matcher;
+    audit.workers = calloc((size_t)threads, sizeof(audit_worker_t));
+    int ok = audit.workers != NULL;
+    for (int i = 0; ok && i < threads; i++) {
+        audit.workers[i].stats = calloc((size_t)matcher.count, sizeof(audit_stat_t));
+        if (!audit.workers[i].stats) ok = 0;
+    }
+
+    struct timeval start, end;
+    gettimeofday(&start, NULL);
+
+    // Rules are relative to the directory holding the file
+    char dir[MAX_PATH_LEN];
+    const char *slash = strrchr(path, '/');
+    if (slash) snprintf(dir, sizeof(dir), "%.*s", (int)(slash - path) + (slash == path), path);
+    else snprintf(dir, sizeof(dir), ".");
+
+    if (ok && walk_tree(dir, threads, audit_visit, &audit) != 0) {
+        print_error("Could not scan directory tree", ERR_PERMISSION_DENIED);
+        ok = 0;
+    }
+    gettimeofday(&end, NULL);
+
+    audit_stat_t *totals = ok ? calloc((size_t)matcher.count, sizeof(audit_stat_t)) : NULL;
+    long files = 0, dirs = 0;
+    for (int w = 0; totals && w < threads; w++) {
+        const audit_worker_t *aw = &audit.workers[w];
+        files += aw->files;
+        dirs += aw->dirs;
+        for (int r = 0; r < matcher.count; r++) {
+            const audit_stat_t *s = &aw->stats[r];
+            audit_stat_t *t = &totals[r];
+            t->files += s->files;
+            t->dirs += s->dirs;
+            t->bytes += s->bytes;
+            t->redundant += s->redundant;
+            if (s->overridden > 0) t->overridden_by = s->overridden_by;
+            t->overridden += s->overridden;
+            if (s->redundant > 0) t->covered_by = s->covered_by;
+        }
+    }
+
+    if (totals) {
+        long ms = (end.tv_sec - start.tv_sec) * 1000 + (end.tv_usec - start.tv_usec) / 1000;
+        printf("%sAudit of %s:%s %d rules, %ld files and %ld directories checked in %ld ms\n",
+               COLOR_BOLD, path, COLOR_RESET, matcher.count, files, dirs, ms);
+
+        audit_section_t *sections = NULL;
+        int section_count = audit_sections(matcher.buffers[0], strlen(matcher.buffers[0]), &sections);
+        int dead = 0, shadowed = 0, redundant = 0;
+        int r = 0;
+
+        for (int s = -1; s < section_count; s++) {
+            int limit = s + 1 < section_count ? sections[s + 1].first_line : INT32_MAX;
+            if (r >= matcher.count || matcher.rules[r].line >= limit) continue;
+
+            printf("\n%s%s%s%s\n", COLOR_BOLD, COLOR_CYAN, s < 0 || !sections[s].name[0] ? "(local rules)" : sections[s].name, COLOR_RESET);
+            printf("  %5s  %7s  %5s  %10s  %s\n", "line", "files", "dirs", "bytes", "pattern");
+            for (; r < matcher.count && matcher.rules[r].line < limit; r++) {
+                audit_print_rule(&matcher, &matcher.rules[r], &totals[r], &dead, &shadowed, &redundant);
+            }
+        }
+
+        printf("\n%s%d rule(s) match nothing, %d are always overridden, %d are already covered%s\n",
+               COLOR_BOLD, dead, shadowed, redundant, COLOR_RESET);
+        free(sections);
+    }
+
+    for (int i = 0; audit.workers && i < threads; i++) {
+        free(audit.workers[i].stats);
+        free(audit.workers[i].path);
+    }
+    free(audit.workers);
+    free(totals);
+    matcher_free(&matcher);
+    return ok && totals ? 0 : 1;
+}
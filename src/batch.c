@@ -0,0 +1,461 @@
+// batch.c - Apply templates to many repositories from one manifest
+//
+// Manifest format, one repository per line:
+//
+//     path/to/repo  python node vscode
+//     # comments and blank lines are ignored
+//
+// Template names may also be separated by commas. Config and the cache
+// are loaded once, every distinct template is resolved once (custom,
+// built-in, then cache or network, fetched concurrently), and the merges
+// run on a pool of worker threads sharing the resolved bodies read-only.
+#include "gitignore.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+typedef struct {
+    const char *path;       // repository directory
+    int *templates;         // indices into the unique template table
+    int template_count;
+    int name_offset;        // first of its names in the parsed name list
+    int missing;            // templates that could not be resolved
+    int existed;            // .gitignore was already there
+    error_code_t status;
+} batch_repo_t;
+
+typedef struct {
+    batch_repo_t *repos;
+    int repo_count;
+    const resolved_template_t *templates;
+    atomic_int next;
+} batch_pool_t;
+
+static int batch_cmp_name(const void *a, const void *b) {
+    return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+static int batch_find_name(const char **names, int count, const char *name) {
+    const char **hit = bsearch(&name, names, (size_t)count, sizeof(char *), batch_cmp_name);
+    return hit ? (int)(hit - names) : -1;
+}
+
+// Split the manifest in place. Returns the number of repos or -1.
+static int batch_parse(char *data, batch_repo_t **repos_out, const char ***names_out, int *name_count) {
+    int repo_cap = 0, repo_count = 0;
+    int name_cap = 0, total_names = 0;
+    batch_repo_t *repos = NULL;
+    const char **names = NULL;
+
+    char *save_line = NULL;
+    for (char *line = strtok_r(data, "\n", &save_line); line; line = strtok_r(NULL, "\n", &save_line)) {
+        char *save_tok = NULL;
+        char *path = strtok_r(line, " \t\r,", &save_tok);
+        if (!path || path[0] == '#') continue;
+
+        if (repo_count == repo_cap) {
+            repo_cap = repo_cap ? repo_cap * 2 : 64;
+            batch_repo_t *grown = realloc(repos, (size_t)repo_cap * sizeof(batch_repo_t));
+            if (!grown) goto oom;
+            repos = grown;
+        }
+
+        batch_repo_t *repo = &repos[repo_count++];
+        memset(repo, 0, sizeof(*repo));
+        repo->path = path;
+        // Names are collected first and mapped to indices once all are known
+        repo->name_offset = total_names;
+
+        for (char *tok = strtok_r(NULL, " \t\r,", &save_tok); tok; tok = strtok_r(NULL, " \t\r,", &save_tok)) {
+            if (tok[0] == '#') break;
+            if (total_names == name_cap) {
+                name_cap = name_cap ? name_cap * 2 : 256;
+                const char **grown = realloc(names, (size_t)name_cap * sizeof(char *));
+                if (!grown) goto oom;
+                names = grown;
+            }
+            names[total_names++] = tok;
+            repo->template_count++;
+        }
+    }
+
+    *repos_out = repos;
+    *names_out = names;
+    *name_count = total_names;
+    return repo_count;
+
+oom:
+    free(repos);
+    free(names);
+    return -1;
+}
+
+// Resolve every distinct template once. Bodies that have to be owned
+// (custom files, downloads) are returned in owned[] for the caller to free.
+static int batch_resolve(const char **names, int count, resolved_template_t *templates, char **owned) {
+    int custom = 0, builtin = 0, cached = 0, downloaded = 0, local = 0, missing = 0;
+    int offline = source_enabled();
+
+    fetch_job_t *jobs = calloc((size_t)count, sizeof(fetch_job_t));
+    cache_meta_t *metas = calloc((size_t)count, sizeof(cache_meta_t));
+    int *job_name = calloc((size_t)count, sizeof(int));
+    int job_count = 0;
+
+    if (!jobs || !metas || !job_name) {
+        free(jobs);
+        free(metas);
+        free(job_name);
+        return 1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        resolved_template_t *t = &templates[i];
+        t->name = names[i];
+
+        char custom_path[MAX_PATH_LEN];
+        if (template_path(names[i], custom_path) == 0 && file_exists(custom_path)) {
+            owned[i] = read_file(custom_path, &t->size);
+            t->data = owned[i];
+        }
+        if (t->data) {
+            custom++;
+            continue;
+        }
+
+        t->builtin = find_builtin_template(names[i]);
+        if (t->builtin) {
+            builtin++;
+            continue;
+        }
+
+        // An offline source replaces the cache and the network entirely
+        if (offline) {
+            if (source_lookup(names[i], &t->data, &t->size) == 0) local++;
+            continue;
+        }
+
+        cache_state_t state = cache_lookup(names[i], &t->data, &t->size, &metas[i]);
+        if (state == CACHE_FRESH) {
+            cached++;
+        } else {
+            jobs[job_count].lang = names[i];
+            jobs[job_count].validators = state == CACHE_STALE ? &metas[i] : NULL;
+            job_name[job_count++] = i;
+        }
+    }
+
+    if (job_count > 0) {
+        fetch_templates(jobs, job_count, g_config ? g_config->max_parallel : MAX_PARALLEL);
+
+        for (int j = 0; j < job_count; j++) {
+            int i = job_name[j];
+            resolved_template_t *t = &templates[i];
+
+            if (jobs[j].status != ERR_SUCCESS) {
+                // A stale copy is better than nothing
+                if (t->data) cached++;
+            } else if (jobs[j].not_modified) {
+                cache_touch(names[i], &metas[i]);
+                cached++;
+            } else {
+                owned[i] = stream_flatten(&jobs[j].body, &t->size);
+                t->data = owned[i];
+                if (t->data) {
+                    cache_store(names[i], t->data, t->size, &jobs[j].meta);
+                    downloaded++;
+                }
+            }
+            stream_free(&jobs[j].body);
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (!templates[i].data && !templates[i].builtin) missing++;
+    }
+
+    if (!g_config || !g_config->quiet) {
+        printf("  Resolved %d template(s): %d built-in, %d custom, ", count - missing, builtin, custom);
+        if (offline) printf("%d from %s", local, g_config->template_source);
+        else printf("%d cached, %d downloaded", cached, downloaded);
+        if (missing > 0) {
+            printf(", %s%d missing%s", COLOR_RED, missing, COLOR_RESET);
+        }
+        printf("\n");
+    }
+
+    free(jobs);
+    free(metas);
+    free(job_name);
+    return 0;
+}
+
+static void batch_apply_repo(batch_repo_t *repo, const resolved_template_t *templates) {
+    char output[MAX_PATH_LEN];
+    struct stat st;
+
+    if (stat(repo->path, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        repo->status = ERR_FILE_NOT_FOUND;
+        return;
+    }
+    if ((size_t)snprintf(output, sizeof(output), "%s/.gitignore", repo->path) >= sizeof(output)) {
+        repo->status = ERR_INVALID_ARGUMENT;
+        return;
+    }
+
+    resolved_template_t *list = malloc((size_t)(repo->template_count > 0 ? repo->template_count : 1) *
+                                       sizeof(resolved_template_t));
+    if (!list) {
+        repo->status = ERR_OUT_OF_MEMORY;
+        return;
+    }
+
+    int n = 0;
+    for (int k = 0; k < repo->template_count; k++) {
+        const resolved_template_t *t = &templates[repo->templates[k]];
+        int repeated = 0;
+        for (int p = 0; p < k && !repeated; p++) {
+            repeated = repo->templates[p] == repo->templates[k];
+        }
+        if (repeated) continue;
+        
+        if (t->data || t->builtin) {
+            list[n++] = *t;
+        } else {
+            repo->missing++;
+        }
+    }
+
+    if (n == 0) {
+        repo->status = ERR_INVALID_TEMPLATE;
+    } else {
+        repo->existed = file_exists(output);
+        repo->status = merge_resolved(list, n, output, merge_default_strategy(repo->existed), NULL);
+    }
+
+    free(list);
+}
+
+static void* batch_worker(void *arg) {
+    batch_pool_t *pool = arg;
+
+    for (;;) {
+        int i = atomic_fetch_add(&pool->next, 1);
+        if (i >= pool->repo_count) break;
+        batch_apply_repo(&pool->repos[i], pool->templates);
+    }
+
+    return NULL;
+}
+
+static const char* batch_status_message(error_code_t status) {
+    switch (status) {
+        case ERR_FILE_NOT_FOUND:    return "no such directory or unreadable .gitignore";
+        case ERR_INVALID_ARGUMENT:  return "path too long";
+        case ERR_INVALID_TEMPLATE:  return "none of its templates were found";
+        case ERR_OUT_OF_MEMORY:     return "out of memory";
+        case ERR_PERMISSION_DENIED: return "could not write .gitignore";
+        default:                    return "failed";
+    }
+}
+
+// Resolve the distinct templates of all repos, then merge on a worker pool
+static int batch_run(batch_repo_t *repos, int repo_count, const char **names, int name_count,
+                     int dry_run) {
+    // Give each repo its own copy of its names, then sort and unique the
+    // shared list so every template is resolved exactly once
+    const char **all = malloc((size_t)(name_count > 0 ? name_count : 1) * sizeof(char *));
+    if (!all) {
+        print_error("Out of memory", ERR_OUT_OF_MEMORY);
+        return 1;
+    }
+    memcpy(all, names, (size_t)name_count * sizeof(char *));
+    qsort(all, (size_t)name_count, sizeof(char *), batch_cmp_name);
+
+    int unique = 0;
+    for (int i = 0; i < name_count; i++) {
+        if (unique == 0 || strcmp(all[unique - 1], all[i]) != 0) all[unique++] = all[i];
+    }
+
+    int *indices = malloc((size_t)(name_count > 0 ? name_count : 1) * sizeof(int));
+    if (!indices) {
+        print_error("Out of memory", ERR_OUT_OF_MEMORY);
+        free(all);
+        return 1;
+    }
+    for (int r = 0; r < repo_count; r++) {
+        int first = repos[r].name_offset;
+        for (int k = 0; k < repos[r].template_count; k++) {
+            indices[first + k] = batch_find_name(all, unique, names[first + k]);
+        }
+        repos[r].templates = indices + first;
+    }
+
+    if (dry_run) {
+        print_info("[DRY RUN] Would apply templates to:");
+        for (int r = 0; r < repo_count; r++) {
+            printf("  %s:", repos[r].path);
+            for (int k = 0; k < repos[r].template_count; k++) {
+                printf(" %s", all[repos[r].templates[k]]);
+            }
+            printf("\n");
+        }
+        free(indices);
+        free(all);
+        return 0;
+    }
+
+    if (!g_config || !g_config->quiet) {
+        printf("%sApplying templates to %d repositories...%s\n", COLOR_BOLD, repo_count, COLOR_RESET);
+    }
+
+    resolved_template_t *templates = calloc((size_t)(unique > 0 ? unique : 1), sizeof(resolved_template_t));
+    char **owned = calloc((size_t)(unique > 0 ? unique : 1), sizeof(char *));
+    if (!templates || !owned) {
+        print_error("Out of memory", ERR_OUT_OF_MEMORY);
+        free(templates);
+        free(owned);
+        free(indices);
+        free(all);
+        return 1;
+    }
+
+    if (batch_resolve(all, unique, templates, owned) != 0) {
+        print_error("Out of memory", ERR_OUT_OF_MEMORY);
+        free(templates);
+        free(owned);
+        free(indices);
+        free(all);
+        return 1;
+    }
+
+    // Merges are independent, so they fan out over a worker pool
+    batch_pool_t pool;
+    pool.repos = repos;
+    pool.repo_count = repo_count;
+    pool.templates = templates;
+    atomic_init(&pool.next, 0);
+
+    int workers = g_config && g_config->max_parallel > 0 ? g_config->max_parallel : MAX_PARALLEL;
+    if (workers > repo_count) workers = repo_count;
+
+    pthread_t *threads = malloc((size_t)workers * sizeof(pthread_t));
+    int started = 0;
+    for (int w = 0; threads && w < workers; w++) {
+        if (pthread_create(&threads[w], NULL, batch_worker, &pool) != 0) break;
+        started++;
+    }
+    if (started == 0) {
+        batch_worker(&pool);
+    }
+    for (int w = 0; w < started; w++) {
+        pthread_join(threads[w], NULL);
+    }
+    free(threads);
+
+    int ok = 0, unchanged = 0, failed = 0;
+    for (int r = 0; r < repo_count; r++) {
+        batch_repo_t *repo = &repos[r];
+
+        if (repo->status == ERR_SUCCESS || repo->status == ERR_UNCHANGED) {
+            if (repo->status == ERR_SUCCESS) ok++;
+            else unchanged++;
+            if (g_config && !g_config->quiet) {
+                printf("  %s✓%s %s (%s", COLOR_GREEN, COLOR_RESET, repo->path,
+                       repo->status == ERR_UNCHANGED ? "unchanged" :
+                       repo->existed ? "updated" : "created");
+                if (repo->missing > 0) {
+                    printf(", %s%d template(s) missing%s", COLOR_YELLOW, repo->missing, COLOR_RESET);
+                }
+                printf(")\n");
+            }
+        } else {
+            failed++;
+            if (!g_config || !g_config->quiet) {
+                printf("  %s✗%s %s: %s\n", COLOR_RED, COLOR_RESET, repo->path,
+                       batch_status_message(repo->status));
+            }
+        }
+    }
+
+    if (failed == 0) {
+        print_success("Batch complete");
+    } else {
+        print_warning("Batch finished with failures");
+    }
+    printf("  %s%d/%d%s repositories updated", COLOR_BOLD, ok, repo_count, COLOR_RESET);
+    if (unchanged > 0) printf(", %d unchanged", unchanged);
+    if (failed > 0) printf(", %d failed", failed);
+    printf("\n");
+
+    for (int i = 0; i < unique; i++) {
+        free(owned[i]);
+    }
+    free(owned);
+    free(templates);
+    free(indices);
+    free(all);
+
+    if (failed > 0) return 1;
+    return ok == 0 && unchanged > 0 ? EXIT_UNCHANGED : 0;
+}
+
+int batch_apply(const char *manifest, int dry_run) {
+    size_t size = 0;
+    char *data = read_file(manifest, &size);
+    if (!data) {
+        print_error("Could not read manifest", ERR_FILE_NOT_FOUND);
+        return 1;
+    }
+
+    batch_repo_t *repos = NULL;
+    const char **names = NULL;
+    int name_count = 0;
+    int repo_count = batch_parse(data, &repos, &names, &name_count);
+    if (repo_count < 0) {
+        print_error("Out of memory", ERR_OUT_OF_MEMORY);
+        free(data);
+        return 1;
+    }
+    if (repo_count == 0) {
+        print_warning("Manifest lists no repositories");
+        free(data);
+        return 0;
+    }
+
+    int result = batch_run(repos, repo_count, names, name_count, dry_run);
+
+    free(repos);
+    free(names);
+    free(data);
+    return result;
+}
+
+// Apply templates to a list of directories built in memory (auto --recursive)
+int batch_apply_targets(const batch_target_t *targets, int count, int dry_run) {
+    int name_count = 0;
+    for (int r = 0; r < count; r++) name_count += targets[r].template_count;
+
+    batch_repo_t *repos = calloc((size_t)(count > 0 ? count : 1), sizeof(batch_repo_t));
+    const char **names = malloc((size_t)(name_count > 0 ? name_count : 1) * sizeof(char *));
+    if (!repos || !names) {
+        print_error("Out of memory", ERR_OUT_OF_MEMORY);
+        free(repos);
+        free(names);
+        return 1;
+    }
+
+    int n = 0;
+    for (int r = 0; r < count; r++) {
+        repos[r].path = targets[r].path;
+        repos[r].name_offset = n;
+        repos[r].template_count = targets[r].template_count;
+        for (int k = 0; k < targets[r].template_count; k++) {
+            names[n++] = targets[r].templates[k];
+        }
+    }
+
+    int result = batch_run(repos, count, names, name_count, dry_run);
+
+    free(repos);
+    free(names);
+    return result;
+}
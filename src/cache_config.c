@@ -3,128 +3,138 @@
 
 // Cache functions
 int init_cache(void) {
-    char *cache_path = get_cache_path();
-    if (!cache_path) return 1;
-    
-    struct stat st = {0};
-    if (stat(cache_path, &st) == -1) {
-        mkdir(cache_path, 0755);
-    }
-    
-    free(cache_path);
-    return 0;
+    return app_paths_ensure(APP_DIR_CACHE);
 }
 
-int get_cached_template(const char *lang, char **content) {
-    if (!g_config || !g_config->cache_enabled) {
-        return 1;
+// The cache key for a template: its name when templates come from the
+// default upstream, otherwise the name qualified by a hash of the base URL,
+// so switching template_url never serves another server's body. file://
+// sources are read directly and never cached; returns nonzero for them.
+static int cache_key(const char *lang, char *key, size_t size) {
+    const char *base = g_config->template_url;
+    if (strncasecmp(base, "file:", 5) == 0) return 1;
+    
+    int n;
+    if (strcmp(base, GITHUB_RAW_URL) == 0) {
+        n = snprintf(key, size, "%s", lang);
+    } else {
+        n = snprintf(key, size, "%016llx:%s",
+                     (unsigned long long)hash_bytes(base, strlen(base)), lang);
     }
+    return n < 0 || (size_t)n >= size;
+}
+
+// Look up a cached template. content points into the cache mapping and
+// stays valid for the rest of the process. Expired entries are kept and
+// reported as CACHE_STALE together with their validators, so the caller
+// can revalidate them with a conditional request instead of downloading
+// the body again.
+cache_state_t cache_lookup(const char *lang, const char **content, size_t *size, cache_meta_t *meta) {
+    memset(meta, 0, sizeof(*meta));
+    *content = NULL;
+    *size = 0;
     
-    char *cache_path = get_cache_path();
-    if (!cache_path) return 1;
-    
-    char cache_file[MAX_PATH_LEN];
-    snprintf(cache_file, sizeof(cache_file), "%s/%s.cache", cache_path, lang);
-    free(cache_path);
-    
-    if (!file_exists(cache_file)) {
-        return 1;
+    if (!g_config || !g_config->cache_enabled) {
+        return CACHE_MISS;
     }
     
-    // Check if cache is still valid
-    struct stat st;
-    if (stat(cache_file, &st) != 0) {
-        return 1;
+    char key[MAX_PATH_LEN];
+    if (cache_key(lang, key, sizeof(key)) != 0) {
+        return CACHE_MISS;
     }
     
-    time_t now = time(NULL);
-    if (difftime(now, st.st_mtime) > g_config->cache_duration) {
-        // Cache expired
-        unlink(cache_file);
-        return 1;
+    int span = timing_begin("cache");
+    pack_entry_t entry;
+    if (pack_get(key, &entry) != 0) {
+        timing_note(span, "%s miss", lang);
+        timing_end(span);
+        return CACHE_MISS;
     }
     
-    // Read cached content
-    FILE *f = fopen(cache_file, "r");
-    if (!f) return 1;
-    
-    fseek(f, 0, SEEK_END);
-    long file_size = ftell(f);
-    fseek(f, 0, SEEK_SET);
+    *content = entry.data;
+    *size = entry.size;
+    *meta = entry.meta;
     
-    if (file_size < 0) {
-        fclose(f);
-        return 1;
-    }
-    
-    size_t size = (size_t)file_size;
-    *content = malloc(size + 1);
-    if (!*content) {
-        fclose(f);
-        return 1;
-    }
-    
-    size_t bytes_read = fread(*content, 1, size, f);
-    if (bytes_read != size) {
-        free(*content);
-        fclose(f);
-        return 1;
+    // A prefetched template stays fresh for as long as it belongs to the
+    // commit the last cache prefetch recorded; prefetch is what renews it
+    time_t now = time(NULL);
+    if (!(meta->commit[0] && prefetch_pinned(meta->commit)) &&
+        difftime(now, meta->fetched_at) > g_config->cache_duration) {
+        timing_note(span, "%s stale", lang);
+        timing_end(span);
+        if (g_config->verbose) {
+            print_info("Cached template expired, revalidating");
+        }
+        return CACHE_STALE;
     }
-    (*content)[size] = '\0';
-    fclose(f);
     
+    timing_note(span, "%s hit", lang);
+    timing_end(span);
     if (g_config->verbose) {
         print_info("Using cached template");
     }
     
-    return 0;
+    return CACHE_FRESH;
+}
+
+int get_cached_template(const char *lang, const char **content, size_t *size) {
+    cache_meta_t meta;
+    return cache_lookup(lang, content, size, &meta) == CACHE_FRESH ? 0 : 1;
 }
 
 int cache_template(const char *lang, const char *content) {
+    cache_meta_t meta;
+    memset(&meta, 0, sizeof(meta));
+    return cache_store(lang, content, strlen(content), &meta);
+}
+
+int cache_store(const char *lang, const char *content, size_t size, const cache_meta_t *meta) {
     if (!g_config || !g_config->cache_enabled) {
         return 0;
     }
     
-    char *cache_path = get_cache_path();
-    if (!cache_path) return 1;
-    
-    char cache_file[MAX_PATH_LEN];
-    snprintf(cache_file, sizeof(cache_file), "%s/%s.cache", cache_path, lang);
-    free(cache_path);
-    
-    FILE *f = fopen(cache_file, "w");
-    if (!f) return 1;
-    
-    fputs(content, f);
-    fclose(f);
+    char key[MAX_PATH_LEN];
+    if (cache_key(lang, key, sizeof(key)) != 0) {
+        return 0;
+    }
     
-    return 0;
+    return pack_put(key, content, size, meta);
 }
 
-int clear_cache(void) {
-    char *cache_path = get_cache_path();
-    if (!cache_path) return 1;
+int cache_store_iov(const char *lang, const struct iovec *iov, int iovcnt, const cache_meta_t *meta) {
+    if (!g_config || !g_config->cache_enabled) {
+        return 0;
+    }
+
+    char key[MAX_PATH_LEN];
+    if (cache_key(lang, key, sizeof(key)) != 0) {
+        return 0;
+    }
+
+    return pack_put_iov(key, iov, iovcnt, meta);
+}
+
+// Mark a stale entry fresh again after a 304, keeping its body
+int cache_touch(const char *lang, const cache_meta_t *meta) {
+    if (!g_config || !g_config->cache_enabled) {
+        return 0;
+    }
     
-    DIR *dir = opendir(cache_path);
-    if (!dir) {
-        free(cache_path);
-        print_info("Cache already empty");
+    char key[MAX_PATH_LEN];
+    if (cache_key(lang, key, sizeof(key)) != 0) {
         return 0;
     }
     
+    return pack_touch(key, meta);
+}
+
+int clear_cache(void) {
     int count = 0;
-    struct dirent *entry;
-    while ((entry = readdir(dir)) != NULL) {
-        if (strstr(entry->d_name, ".cache")) {
-            char file_path[MAX_PATH_LEN];
-            snprintf(file_path, sizeof(file_path), "%s/%s", cache_path, entry->d_name);
-            unlink(file_path);
-            count++;
-        }
+    if (pack_clear(&count) != 0) {
+        print_error("Could not clear cache", ERR_CACHE_ERROR);
+        return 1;
     }
-    
-    closedir(dir);
-    free(cache_path);
+    prefetch_reset();
     
     print_success("Cache cleared");
     printf("  Removed %d cached template(s)\n", count);
@@ -132,6 +142,38 @@ int clear_cache(void) {
     return 0;
 }
 
+int compact_cache(void) {
+    size_t reclaimed = 0;
+    if (pack_compact(&reclaimed) != 0) {
+        print_error("Could not compact cache", ERR_CACHE_ERROR);
+        return 1;
+    }
+    
+    print_success("Cache compacted");
+    printf("  Reclaimed %zu byte(s)\n", reclaimed);
+    
+    return 0;
+}
+
+// Environment overrides, which win over the config file
+void config_apply_env(config_t *config) {
+    const char *url = getenv(TEMPLATE_URL_ENV);
+    if (url && url[0]) {
+        snprintf(config->template_url, sizeof(config->template_url), "%s", url);
+    }
+    
+    const char *archive = getenv(ARCHIVE_URL_ENV);
+    if (archive && archive[0]) {
+        snprintf(config->archive_url, sizeof(config->archive_url), "%s", archive);
+    }
+    
+    // Set but empty turns a configured source off
+    const char *source = getenv(TEMPLATE_SOURCE_ENV);
+    if (source) {
+        snprintf(config->template_source, sizeof(config->template_source), "%s", source);
+    }
+}
+
 // Config functions
 config_t* load_config(void) {
     config_t *config = malloc(sizeof(config_t));
@@ -143,20 +185,26 @@ config_t* load_config(void) {
     config->auto_backup = 0;
     config->cache_enabled = 1;
     config->cache_duration = CACHE_DURATION;
+    config->max_parallel = MAX_PARALLEL;
+    config->timings = 0;
+    config->fsync_writes = 0;
+    config->minimal_merge = 0;
+    snprintf(config->template_url, sizeof(config->template_url), "%s", GITHUB_RAW_URL);
+    config->template_source[0] = '\0';
+    snprintf(config->archive_url, sizeof(config->archive_url), "%s", GITHUB_ARCHIVE_URL);
     config->verbose = 0;
     config->quiet = 0;
     config->use_color = isatty(STDOUT_FILENO);
-    
-    // Try to load config file
-    char *config_path = get_config_path();
-    if (!config_path) return config;
-    
-    char config_file[MAX_PATH_LEN];
-    snprintf(config_file, sizeof(config_file), "%s/../%s", config_path, CONFIG_FILE);
-    free(config_path);
-    
-    FILE *f = fopen(config_file, "r");
-    if (!f) return config;
+    config->use_color_set = 0;
+    
+    // Try to load config file; without one (or without HOME) the
+    // environment overrides still apply
+    const app_paths_t *paths = app_paths();
+    FILE *f = paths ? fopen(paths->config_file, "r") : NULL;
+    if (!f) {
+        config_apply_env(config);
+        return config;
+    }
     
     char line[MAX_LINE_LEN];
     while (fgets(line, sizeof(line), f)) {
@@ -177,15 +225,34 @@ config_t* load_config(void) {
                 config->cache_enabled = (strcmp(v, "true") == 0);
             } else if (strcmp(k, "cache_duration") == 0) {
                 config->cache_duration = atoi(v);
+            } else if (strcmp(k, "max_parallel") == 0) {
+                int n = atoi(v);
+                if (n >= 1) {
+                    config->max_parallel = n;
+                } else {
+                    print_warning("Ignoring max_parallel below 1 in config");
+                }
+            } else if (strcmp(k, "fsync") == 0) {
+                config->fsync_writes = (strcmp(v, "true") == 0);
+            } else if (strcmp(k, "minimal_merge") == 0) {
+                config->minimal_merge = (strcmp(v, "true") == 0);
+            } else if (strcmp(k, "template_url") == 0) {
+                snprintf(config->template_url, sizeof(config->template_url), "%s", v);
+            } else if (strcmp(k, "template_source") == 0) {
+                snprintf(config->template_source, sizeof(config->template_source), "%s", v);
+            } else if (strcmp(k, "archive_url") == 0) {
+                snprintf(config->archive_url, sizeof(config->archive_url), "%s", v);
             } else if (strcmp(k, "verbose") == 0) {
                 config->verbose = (strcmp(v, "true") == 0);
             } else if (strcmp(k, "use_color") == 0) {
                 config->use_color = (strcmp(v, "true") == 0);
+                config->use_color_set = 1;
             }
         }
     }
     
     fclose(f);
+    config_apply_env(config);
     return config;
 }
 
@@ -205,20 +272,24 @@ void free_config(config_t *config) {
 int save_config(config_t *config) {
     if (!config) return 1;
     
-    char *config_path = get_config_path();
-    if (!config_path) return 1;
-    
-    char config_file[MAX_PATH_LEN];
-    snprintf(config_file, sizeof(config_file), "%s/../%s", config_path, CONFIG_FILE);
-    free(config_path);
+    const app_paths_t *paths = app_paths();
+    if (!paths || app_paths_ensure(APP_DIR_CONFIG) != 0) return 1;
     
-    FILE *f = fopen(config_file, "w");
+    FILE *f = fopen(paths->config_file, "w");
     if (!f) return 1;
     
     fprintf(f, "# gitignore configuration file\n\n");
     fprintf(f, "auto_backup=%s\n", config->auto_backup ? "true" : "false");
     fprintf(f, "cache_enabled=%s\n", config->cache_enabled ? "true" : "false");
     fprintf(f, "cache_duration=%d\n", config->cache_duration);
+    fprintf(f, "max_parallel=%d\n", config->max_parallel);
+    fprintf(f, "fsync=%s\n", config->fsync_writes ? "true" : "false");
+    fprintf(f, "minimal_merge=%s\n", config->minimal_merge ? "true" : "false");
+    fprintf(f, "template_url=%s\n", config->template_url);
+    if (config->template_source[0]) {
+        fprintf(f, "template_source=%s\n", config->template_source);
+    }
+    fprintf(f, "archive_url=%s\n", config->archive_url);
     fprintf(f, "verbose=%s\n", config->verbose ? "true" : "false");
     fprintf(f, "use_color=%s\n", config->use_color ? "true" : "false");
     
@@ -229,10 +300,8 @@ int save_config(config_t *config) {
 void apply_config(config_t *config) {
     if (!config) return;
     
-    // Initialize cache if enabled
-    if (config->cache_enabled) {
-        init_cache();
-    }
+    // The cache directory is created by the first cache write, not here:
+    // most commands never touch the cache
     
     // Apply color settings
     if (!config->use_color) {
@@ -242,23 +311,11 @@ void apply_config(config_t *config) {
 }
 
 char* get_cache_path(void) {
-    const char *home = getenv("HOME");
-    if (!home) return NULL;
-    
-    char *path = malloc(MAX_PATH_LEN);
-    if (!path) return NULL;
-    
-    snprintf(path, MAX_PATH_LEN, "%s/%s/%s", home, CONFIG_DIR, CACHE_DIR);
-    return path;
+    const app_paths_t *paths = app_paths();
+    return paths ? strdup(paths->cache_dir) : NULL;
 }
 
 char* get_backup_path(void) {
-    const char *home = getenv("HOME");
-    if (!home) return NULL;
-    
-    char *path = malloc(MAX_PATH_LEN);
-    if (!path) return NULL;
-    
-    snprintf(path, MAX_PATH_LEN, "%s/%s/%s", home, CONFIG_DIR, BACKUP_DIR);
-    return path;
-}
\ No newline at end of file
+    const app_paths_t *paths = app_paths();
+    return paths ? strdup(paths->backup_dir) : NULL;
+}
@@ -0,0 +1,612 @@
+// cache_pack.c - Single-file, memory-mapped template cache store
+//
+// All cached templates live in one append-only file:
+//
+//   [header][slot index (open addressing on name hash)][blob][blob]...
+//
+// Slots map a template name to a blob plus its HTTP validators. Blobs are
+// keyed by content hash, so aliases and identical templates share storage.
+// Blobs are never modified once written, which lets lookups return pointers
+// straight into the mapping. Mappings replaced after the file grows are
+// kept until pack_close(), so earlier pointers stay valid for the process.
+// Writers hold an exclusive flock on the pack; lookups copy their slot
+// under a shared one, since slots are rewritten in place.
+#include "gitignore.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+
+#define PACK_FILE "templates.pack"
+#define PACK_MAGIC "GIPACK1"
+#define PACK_VERSION 2
+#define PACK_MIN_SLOTS 256
+#define PACK_NAME_LEN 64
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t slot_count;
+    uint32_t entry_count;
+    uint32_t reserved0;
+    uint64_t data_end;
+    uint64_t dead_bytes;
+    uint8_t reserved[24];
+} pack_header_t;
+
+typedef struct {
+    uint64_t name_hash;      // 0 marks an empty slot
+    uint64_t content_hash;
+    uint64_t blob_offset;
+    uint64_t blob_size;      // excluding the trailing NUL stored on disk
+    int64_t fetched_at;
+    char name[PACK_NAME_LEN];
+    char etag[128];
+    char last_modified[64];
+    char commit[64];         // set by cache prefetch
+} pack_slot_t;
+
+typedef struct pack_mapping {
+    void *addr;
+    size_t len;
+    struct pack_mapping *next;
+} pack_mapping_t;
+
+static struct {
+    int fd;
+    char path[MAX_PATH_LEN];
+    const uint8_t *map;
+    size_t map_len;
+    pack_mapping_t *retired;
+} g_pack = { .fd = -1 };
+
+static uint64_t pack_name_hash(const char *name) {
+    uint64_t h = hash_bytes(name, strlen(name));
+    return h ? h : 1;
+}
+
+static size_t pack_index_end(uint32_t slot_count) {
+    return sizeof(pack_header_t) + (size_t)slot_count * sizeof(pack_slot_t);
+}
+
+static const pack_header_t* pack_header(void) {
+    return (const pack_header_t *)g_pack.map;
+}
+
+static const pack_slot_t* pack_slots(void) {
+    return (const pack_slot_t *)(g_pack.map + sizeof(pack_header_t));
+}
+
+static int pack_header_valid(const pack_header_t *h, size_t file_size) {
+    return memcmp(h->magic, PACK_MAGIC, sizeof(PACK_MAGIC)) == 0 &&
+           h->version == PACK_VERSION &&
+           h->slot_count >= PACK_MIN_SLOTS &&
+           (h->slot_count & (h->slot_count - 1)) == 0 &&
+           pack_index_end(h->slot_count) <= h->data_end &&
+           h->data_end <= file_size;
+}
+
+// Write an empty pack with the given index size to a new, empty file
+static int pack_format(int fd, uint32_t slot_count) {
+    pack_header_t h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+    h.version = PACK_VERSION;
+    h.slot_count = slot_count;
+    h.data_end = pack_index_end(slot_count);
+
+    if (ftruncate(fd, (off_t)h.data_end) != 0) return 1;
+    if (pwrite(fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h)) return 1;
+    return 0;
+}
+
+// (Re)map the whole file. The previous mapping is retired, not unmapped.
+static int pack_remap(int force) {
+    struct stat st;
+    if (fstat(g_pack.fd, &st) != 0) return 1;
+
+    size_t len = (size_t)st.st_size;
+    if (!force && g_pack.map && len == g_pack.map_len) return 0;
+    if (len < sizeof(pack_header_t)) return 1;
+
+    void *addr = mmap(NULL, len, PROT_READ, MAP_SHARED, g_pack.fd, 0);
+    if (addr == MAP_FAILED) return 1;
+
+    if (g_pack.map) {
+        pack_mapping_t *old = malloc(sizeof(pack_mapping_t));
+        if (old) {
+            old->addr = (void *)g_pack.map;
+            old->len = g_pack.map_len;
+            old->next = g_pack.retired;
+            g_pack.retired = old;
+        } else {
+            munmap((void *)g_pack.map, g_pack.map_len);
+        }
+    }
+
+    g_pack.map = addr;
+    g_pack.map_len = len;
+    return 0;
+}
+
+// Create a uniquely named file next to the pack to build a replacement in
+static int pack_create_tmp(char *tmp_path, size_t size) {
+    snprintf(tmp_path, size, "%s.tmp.XXXXXX", g_pack.path);
+    int fd = mkstemp(tmp_path);
+    if (fd < 0) return -1;
+    if (fchmod(fd, 0644) != 0 || fcntl(fd, F_SETFD, FD_CLOEXEC) != 0) {
+        close(fd);
+        unlink(tmp_path);
+        return -1;
+    }
+    return fd;
+}
+
+// Rename the finished replacement over the pack and make it current.
+// Other processes may still map the old file, so it is never truncated or
+// rewritten in place. Caller holds the lock on the old file; the new one
+// is locked before it becomes visible under the pack name.
+static int pack_install(int fd, const char *tmp_path) {
+    if (flock(fd, LOCK_EX) != 0 || rename(tmp_path, g_pack.path) != 0) {
+        close(fd);
+        unlink(tmp_path);
+        return 1;
+    }
+
+    int old_fd = g_pack.fd;
+    g_pack.fd = fd;
+    flock(old_fd, LOCK_UN);
+    close(old_fd);
+
+    return pack_remap(1);
+}
+
+// Replace a new or unreadable pack with an empty one
+static int pack_reset_locked(void) {
+    char tmp_path[MAX_PATH_LEN + 16];
+    int fd = pack_create_tmp(tmp_path, sizeof(tmp_path));
+    if (fd < 0) return 1;
+
+    if (pack_format(fd, PACK_MIN_SLOTS) != 0) {
+        close(fd);
+        unlink(tmp_path);
+        return 1;
+    }
+    return pack_install(fd, tmp_path);
+}
+
+// Take the writer lock on the file currently named by the pack path.
+// Another process may have compacted (renamed over) or cleared the pack
+// while we waited, in which case we reopen and lock the new file.
+static int pack_lock(void) {
+    for (int attempt = 0; attempt < 8; attempt++) {
+        if (flock(g_pack.fd, LOCK_EX) != 0) return 1;
+
+        struct stat held, named;
+        if (fstat(g_pack.fd, &held) == 0 && stat(g_pack.path, &named) == 0 &&
+            held.st_ino == named.st_ino && held.st_dev == named.st_dev) {
+            pack_header_t h;
+            if ((size_t)held.st_size < sizeof(h) ||
+                pread(g_pack.fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h) ||
+                !pack_header_valid(&h, (size_t)held.st_size)) {
+                if (pack_reset_locked() != 0) break;
+                return 0;
+            }
+            return pack_remap(0);
+        }
+
+        flock(g_pack.fd, LOCK_UN);
+        int fd = open(g_pack.path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) return 1;
+        close(g_pack.fd);
+        g_pack.fd = fd;
+
+        // A pack recreated by a concurrent clear is empty until formatted
+        // on the next pass, so a failed remap here is expected
+        pack_remap(1);
+    }
+
+    flock(g_pack.fd, LOCK_UN);
+    return 1;
+}
+
+static void pack_unlock(void) {
+    flock(g_pack.fd, LOCK_UN);
+}
+
+static int pack_open(void) {
+    if (g_pack.fd >= 0) return 0;
+
+    const app_paths_t *paths = app_paths();
+    if (!paths || app_paths_ensure(APP_DIR_CACHE) != 0 ||
+        path_join(g_pack.path, paths->cache_dir, PACK_FILE) != 0) return 1;
+
+    g_pack.fd = open(g_pack.path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (g_pack.fd < 0) return 1;
+
+    // Fast path: a valid pack only needs mapping
+    struct stat st;
+    pack_header_t h;
+    if (fstat(g_pack.fd, &st) == 0 && (size_t)st.st_size >= sizeof(h) &&
+        pread(g_pack.fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h) &&
+        pack_header_valid(&h, (size_t)st.st_size) && pack_remap(0) == 0) {
+        return 0;
+    }
+
+    // New or unreadable pack: initialise it under the lock
+    if (pack_lock() != 0) {
+        close(g_pack.fd);
+        g_pack.fd = -1;
+        return 1;
+    }
+    pack_unlock();
+    return 0;
+}
+
+void pack_close(void) {
+    if (g_pack.map) munmap((void *)g_pack.map, g_pack.map_len);
+
+    pack_mapping_t *m = g_pack.retired;
+    while (m) {
+        pack_mapping_t *next = m->next;
+        munmap(m->addr, m->len);
+        free(m);
+        m = next;
+    }
+
+    if (g_pack.fd >= 0) close(g_pack.fd);
+
+    memset(&g_pack, 0, sizeof(g_pack));
+    g_pack.fd = -1;
+}
+
+// Find the slot for name, or the empty slot where it would be inserted
+static long pack_find_slot(const char *name, uint64_t name_hash, int *found) {
+    const pack_header_t *h = pack_header();
+    const pack_slot_t *slots = pack_slots();
+    uint32_t mask = h->slot_count - 1;
+
+    *found = 0;
+    for (uint32_t probe = 0; probe < h->slot_count; probe++) {
+        uint32_t i = (uint32_t)(name_hash + probe) & mask;
+        if (slots[i].name_hash == 0) return (long)i;
+        if (slots[i].name_hash == name_hash &&
+            strncmp(slots[i].name, name, PACK_NAME_LEN) == 0) {
+            *found = 1;
+            return (long)i;
+        }
+    }
+
+    return -1;
+}
+
+// Look up name. On success entry->data points into the mapping.
+int pack_get(const char *name, pack_entry_t *entry) {
+    if (strlen(name) >= PACK_NAME_LEN || pack_open() != 0) return 1;
+
+    // Writers rewrite live slots in place under the exclusive lock; the
+    // shared lock keeps the slot still while it is copied. Blobs are never
+    // modified, so the data pointer stays valid after unlocking.
+    if (flock(g_pack.fd, LOCK_SH) != 0) return 1;
+
+    // Pick up entries appended by other processes
+    const pack_header_t *h = pack_header();
+    if (h->data_end > g_pack.map_len) pack_remap(0);
+
+    int found;
+    long i = pack_find_slot(name, pack_name_hash(name), &found);
+    pack_slot_t slot;
+    if (found) slot = pack_slots()[i];
+    flock(g_pack.fd, LOCK_UN);
+
+    if (!found || slot.blob_offset + slot.blob_size + 1 > g_pack.map_len) return 1;
+
+    entry->data = (const char *)g_pack.map + slot.blob_offset;
+    entry->size = (size_t)slot.blob_size;
+    entry->content_hash = slot.content_hash;
+
+    memset(&entry->meta, 0, sizeof(entry->meta));
+    snprintf(entry->meta.etag, sizeof(entry->meta.etag), "%.*s", (int)sizeof(slot.etag), slot.etag);
+    snprintf(entry->meta.last_modified, sizeof(entry->meta.last_modified), "%.*s",
+             (int)sizeof(slot.last_modified), slot.last_modified);
+    snprintf(entry->meta.commit, sizeof(entry->meta.commit), "%.*s", (int)sizeof(slot.commit), slot.commit);
+    entry->meta.fetched_at = (time_t)slot.fetched_at;
+    entry->meta.size = entry->size;
+
+    return 0;
+}
+
+static size_t pack_iov_size(const struct iovec *iov, int iovcnt) {
+    size_t size = 0;
+    for (int k = 0; k < iovcnt; k++) size += iov[k].iov_len;
+    return size;
+}
+
+static int pack_iov_equal(const uint8_t *blob, const struct iovec *iov, int iovcnt) {
+    for (int k = 0; k < iovcnt; k++) {
+        if (memcmp(blob, iov[k].iov_base, iov[k].iov_len) != 0) return 0;
+        blob += iov[k].iov_len;
+    }
+    return 1;
+}
+
+// Offset of an existing blob with this content, or 0 if none
+static uint64_t pack_find_blob(uint64_t content_hash, size_t size,
+                               const struct iovec *iov, int iovcnt) {
+    const pack_header_t *h = pack_header();
+    const pack_slot_t *slots = pack_slots();
+
+    for (uint32_t i = 0; i < h->slot_count; i++) {
+        if (slots[i].name_hash != 0 &&
+            slots[i].content_hash == content_hash &&
+            slots[i].blob_size == size &&
+            pack_iov_equal(g_pack.map + slots[i].blob_offset, iov, iovcnt)) {
+            return slots[i].blob_offset;
+        }
+    }
+
+    return 0;
+}
+
+// Write a blob and its NUL terminator straight from the caller's segments
+static int pack_write_blob(uint64_t offset, const struct iovec *iov, int iovcnt) {
+    off_t off = (off_t)offset;
+
+    for (int k = 0; k < iovcnt; k += IOV_MAX) {
+        int n = iovcnt - k < IOV_MAX ? iovcnt - k : IOV_MAX;
+        size_t want = pack_iov_size(iov + k, n);
+        if (pwritev(g_pack.fd, iov + k, n, off) != (ssize_t)want) return 1;
+        off += (off_t)want;
+    }
+
+    return pwrite(g_pack.fd, "", 1, off) == 1 ? 0 : 1;
+}
+
+static int pack_blob_shared(uint64_t offset, long except) {
+    const pack_header_t *h = pack_header();
+    const pack_slot_t *slots = pack_slots();
+
+    for (uint32_t i = 0; i < h->slot_count; i++) {
+        if ((long)i != except && slots[i].name_hash != 0 && slots[i].blob_offset == offset) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void pack_fill_slot(pack_slot_t *slot, const char *name, const cache_meta_t *meta) {
+    snprintf(slot->name, sizeof(slot->name), "%s", name);
+    snprintf(slot->etag, sizeof(slot->etag), "%s", meta ? meta->etag : "");
+    snprintf(slot->last_modified, sizeof(slot->last_modified), "%s",
+             meta ? meta->last_modified : "");
+    snprintf(slot->commit, sizeof(slot->commit), "%s", meta ? meta->commit : "");
+    slot->fetched_at = (int64_t)time(NULL);
+}
+
+// Write slot i in place. Callers hold the exclusive lock and readers copy
+// slots under a shared one, so no reader sees a half-written slot.
+static int pack_write_slot(long i, const pack_slot_t *slot) {
+    off_t off = (off_t)(sizeof(pack_header_t) + (size_t)i * sizeof(pack_slot_t));
+    return pwrite(g_pack.fd, slot, sizeof(*slot), off) == (ssize_t)sizeof(*slot) ? 0 : 1;
+}
+
+static int pack_write_header(const pack_header_t *h) {
+    return pwrite(g_pack.fd, h, sizeof(*h), 0) == (ssize_t)sizeof(*h) ? 0 : 1;
+}
+
+static int pack_compact_locked(uint32_t slot_count);
+
+int pack_put(const char *name, const char *data, size_t size, const cache_meta_t *meta) {
+    struct iovec iov = { (void *)data, size };
+    return pack_put_iov(name, &iov, 1, meta);
+}
+
+// Store a body held in several segments (e.g. a streamed download) without
+// first joining it into one buffer
+int pack_put_iov(const char *name, const struct iovec *iov, int iovcnt, const cache_meta_t *meta) {
+    if (strlen(name) >= PACK_NAME_LEN || pack_open() != 0) return 1;
+
+    if (pack_lock() != 0) return 1;
+
+    pack_header_t h = *pack_header();
+
+    // Keep the index at most 70% full
+    if ((h.entry_count + 1) * 10 > h.slot_count * 7) {
+        if (pack_compact_locked(h.slot_count * 2) != 0) {
+            pack_unlock();
+            return 1;
+        }
+        h = *pack_header();
+    }
+
+    uint64_t name_hash = pack_name_hash(name);
+    size_t size = pack_iov_size(iov, iovcnt);
+    uint64_t content_hash = hash_bytes(NULL, 0);
+    for (int k = 0; k < iovcnt; k++) {
+        content_hash = hash_bytes_update(content_hash, iov[k].iov_base, iov[k].iov_len);
+    }
+
+    int found;
+    long i = pack_find_slot(name, name_hash, &found);
+    if (i < 0) {
+        pack_unlock();
+        return 1;
+    }
+
+    pack_slot_t slot;
+    memset(&slot, 0, sizeof(slot));
+    if (found) slot = pack_slots()[i];
+
+    uint64_t offset = pack_find_blob(content_hash, size, iov, iovcnt);
+    if (offset == 0) {
+        offset = h.data_end;
+        if (pack_write_blob(offset, iov, iovcnt) != 0) {
+            pack_unlock();
+            return 1;
+        }
+        h.data_end = (offset + size + 1 + 7) & ~(uint64_t)7;
+    }
+
+    if (found && slot.blob_offset != offset && !pack_blob_shared(slot.blob_offset, i)) {
+        h.dead_bytes += slot.blob_size + 1;
+    }
+    if (!found) h.entry_count++;
+
+    slot.name_hash = name_hash;
+    slot.content_hash = content_hash;
+    slot.blob_offset = offset;
+    slot.blob_size = size;
+    pack_fill_slot(&slot, name, meta);
+
+    int rc = pack_write_slot(i, &slot);
+    if (rc == 0) rc = pack_write_header(&h);
+    if (rc == 0) {
+        // The file may have grown by less than data_end when a blob was shared
+        struct stat st;
+        if (fstat(g_pack.fd, &st) == 0 && (uint64_t)st.st_size < h.data_end) {
+            rc = ftruncate(g_pack.fd, (off_t)h.data_end);
+        }
+    }
+    pack_remap(0);
+
+    // Reclaim space once more than half of the blob area is garbage
+    if (rc == 0 && h.dead_bytes * 2 > h.data_end - pack_index_end(h.slot_count)) {
+        pack_compact_locked(h.slot_count);
+    }
+
+    pack_unlock();
+    return rc;
+}
+
+// Refresh the validators and fetch time of an entry without touching its blob
+int pack_touch(const char *name, const cache_meta_t *meta) {
+    if (strlen(name) >= PACK_NAME_LEN || pack_open() != 0) return 1;
+
+    if (pack_lock() != 0) return 1;
+
+    int found;
+    long i = pack_find_slot(name, pack_name_hash(name), &found);
+    int rc = 1;
+    if (found) {
+        pack_slot_t slot = pack_slots()[i];
+        pack_fill_slot(&slot, name, meta);
+        rc = pack_write_slot(i, &slot);
+    }
+
+    pack_unlock();
+    return rc;
+}
+
+// Rewrite live blobs into a fresh file and rename it over the pack.
+// Caller holds the exclusive lock on the current pack.
+static int pack_compact_locked(uint32_t slot_count) {
+    const pack_header_t *old_h = pack_header();
+    const pack_slot_t *old_slots = pack_slots();
+
+    char tmp_path[MAX_PATH_LEN + 16];
+    int fd = pack_create_tmp(tmp_path, sizeof(tmp_path));
+    if (fd < 0) return 1;
+
+    if (pack_format(fd, slot_count) != 0) {
+        close(fd);
+        unlink(tmp_path);
+        return 1;
+    }
+
+    size_t index_len = pack_index_end(slot_count) - sizeof(pack_header_t);
+    pack_slot_t *slots = calloc(1, index_len);
+    if (!slots) {
+        close(fd);
+        unlink(tmp_path);
+        return 1;
+    }
+
+    pack_header_t h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+    h.version = PACK_VERSION;
+    h.slot_count = slot_count;
+    h.data_end = pack_index_end(slot_count);
+
+    int rc = 0;
+    uint32_t mask = slot_count - 1;
+
+    for (uint32_t i = 0; i < old_h->slot_count && rc == 0; i++) {
+        const pack_slot_t *src = &old_slots[i];
+        if (src->name_hash == 0) continue;
+
+        pack_slot_t slot = *src;
+
+        // Blobs shared by several names are copied once
+        uint64_t offset = 0;
+        for (uint32_t j = 0; j < slot_count; j++) {
+            if (slots[j].name_hash != 0 && slots[j].content_hash == src->content_hash &&
+                slots[j].blob_size == src->blob_size) {
+                offset = slots[j].blob_offset;
+                break;
+            }
+        }
+
+        if (offset == 0) {
+            offset = h.data_end;
+            size_t len = (size_t)src->blob_size + 1;
+            if (pwrite(fd, g_pack.map + src->blob_offset, len, (off_t)offset) != (ssize_t)len) {
+                rc = 1;
+                break;
+            }
+            h.data_end = (offset + len + 7) & ~(uint64_t)7;
+        }
+        slot.blob_offset = offset;
+
+        uint32_t k = (uint32_t)src->name_hash & mask;
+        while (slots[k].name_hash != 0) k = (k + 1) & mask;
+        slots[k] = slot;
+        h.entry_count++;
+    }
+
+    if (rc == 0 &&
+        pwrite(fd, slots, index_len, sizeof(pack_header_t)) != (ssize_t)index_len) {
+        rc = 1;
+    }
+    if (rc == 0 && pwrite(fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h)) rc = 1;
+    if (rc == 0 && ftruncate(fd, (off_t)h.data_end) != 0) rc = 1;
+    free(slots);
+
+    if (rc != 0) {
+        close(fd);
+        unlink(tmp_path);
+        return 1;
+    }
+    return pack_install(fd, tmp_path);
+}
+
+int pack_compact(size_t *reclaimed) {
+    if (pack_open() != 0) return 1;
+
+    if (pack_lock() != 0) return 1;
+
+    size_t before = g_pack.map_len;
+    int rc = pack_compact_locked(pack_header()->slot_count);
+    if (reclaimed) *reclaimed = rc == 0 && before > g_pack.map_len ? before - g_pack.map_len : 0;
+
+    pack_unlock();
+    return rc;
+}
+
+// Drop the whole cache by unlinking the pack file
+int pack_clear(int *removed) {
+    if (removed) *removed = 0;
+
+    if (pack_open() == 0) {
+        if (removed) *removed = (int)pack_header()->entry_count;
+        pack_close();
+    }
+
+    const app_paths_t *paths = app_paths();
+    char path[MAX_PATH_LEN];
+    if (!paths || path_join(path, paths->cache_dir, PACK_FILE) != 0) return 1;
+
+    if (unlink(path) != 0 && errno != ENOENT) return 1;
+    return 0;
+}
@@ -0,0 +1,134 @@
+// check.c - Report which paths a set of ignore files excludes
+//
+// Paths come from the command line or, without any, from stdin as
+// newline or NUL delimited records, so a file list of any size streams
+// through a single compiled matcher. Output is buffered and only the
+// ignored paths are written, in input order.
+#include "gitignore.h"
+
+#define CHECK_READ_SIZE (256 * 1024)
+
+typedef struct {
+    const ignore_matcher_t *matcher;
+    int nul;
+    int explain;
+    long ignored;
+} check_ctx_t;
+
+static void check_one(check_ctx_t *ctx, char *path, size_t len) {
+    if (len == 0) return;
+
+    int r = matcher_check(ctx->matcher, path, len, -1);
+    int ignored = matcher_is_ignored(ctx->matcher, r);
+    if (ignored) ctx->ignored++;
+
+    // --explain also shows paths a "!" rule re-included, like git check-ignore -v
+    if (ctx->explain && r >= 0) {
+        const ignore_rule_t *rule = &ctx->matcher->rules[r];
+        const char *source = ctx->matcher->sources[rule->source];
+        if (ctx->nul) {
+            printf("%s%c%d%c%.*s%c", source, '\0', rule->line, '\0',
+                   (int)rule->text_len, rule->text, '\0');
+        } else {
+            printf("%s:%d:%.*s\t", source, rule->line, (int)rule->text_len, rule->text);
+        }
+    } else if (!ignored) {
+        return;
+    }
+
+    fwrite(path, 1, len, stdout);
+    putchar(ctx->nul ? '\0' : '\n');
+}
+
+static int check_stdin(check_ctx_t *ctx) {
+    char delim = ctx->nul ? '\0' : '\n';
+    size_t cap = CHECK_READ_SIZE;
+    size_t have = 0;
+    char *buf = malloc(cap);
+    if (!buf) return 1;
+
+    for (;;) {
+        if (have == cap) {
+            // One record longer than the buffer
+            char *grown = realloc(buf, cap * 2);
+            if (!grown) {
+                free(buf);
+                return 1;
+            }
+            buf = grown;
+            cap *= 2;
+        }
+
+        ssize_t n = read(STDIN_FILENO, buf + have, cap - have);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            free(buf);
+            return 1;
+        }
+        if (n == 0) break;
+
+        char *p = buf;
+        char *end = buf + have + (size_t)n;
+        char *rec;
+        while ((rec = memchr(p, delim, (size_t)(end - p))) != NULL) {
+            check_one(ctx, p, (size_t)(rec - p));
+            p = rec + 1;
+        }
+
+        have = (size_t)(end - p);
+        memmove(buf, p, have);
+    }
+
+    if (have > 0) check_one(ctx, buf, have);
+    free(buf);
+    return 0;
+}
+
+// Exit status follows git check-ignore: 0 when some path is ignored, 1 when
+// none is, and 2 when the rules or input cannot be read
+int check_paths(char **paths, int count, char **sources, int source_count, int nul, int explain) {
+    ignore_matcher_t matcher;
+    matcher_init(&matcher);
+
+    char *fallback[] = { ".gitignore" };
+    if (source_count == 0) {
+        sources = fallback;
+        source_count = 1;
+    }
+
+    // Under gitignore serve the rules may already be compiled
+    const ignore_matcher_t *rules = serve_rules(sources, source_count);
+    for (int i = 0; !rules && i < source_count; i++) {
+        if (matcher_add_file(&matcher, sources[i]) != 0) {
+            char msg[MAX_PATH_LEN + 32];
+            snprintf(msg, sizeof(msg), "Cannot read %s", sources[i]);
+            print_error(msg, ERR_FILE_NOT_FOUND);
+            matcher_free(&matcher);
+            return 2;
+        }
+    }
+
+    if (!rules) rules = &matcher;
+
+    static char out[64 * 1024];
+    setvbuf(stdout, out, _IOFBF, sizeof(out));
+
+    check_ctx_t ctx = { rules, nul, explain, 0 };
+    int rc = 0;
+    if (count > 0) {
+        for (int i = 0; i < count; i++) {
+            check_one(&ctx, paths[i], strlen(paths[i]));
+        }
+    } else {
+        rc = check_stdin(&ctx);
+    }
+
+    fflush(stdout);
+    matcher_free(&matcher);
+
+    if (rc != 0) {
+        print_error("Failed to read paths from stdin", ERR_FILE_NOT_FOUND);
+        return 2;
+    }
+    return ctx.ignored > 0 ? 0 : 1;
+}
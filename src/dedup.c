@@ -0,0 +1,180 @@
+// dedup.c - Open-addressing hash set over normalized ignore patterns
+//
+// Entries reference pattern bytes owned by the caller (file buffers,
+// template strings), so inserting a line never copies it. The table
+// doubles when it passes 70% load, so there is no cap on pattern count.
+// Callers that know roughly how many patterns are coming reserve room up
+// front, and may take the slots from an arena instead of the heap.
+#include "gitignore.h"
+
+#define PATTERN_SET_MIN_CAPACITY 256
+
+// Trim a raw line to the bytes that decide what it matches: leading
+// blanks, the line terminator and unescaped trailing blanks are dropped.
+const char* normalize_pattern(const char *line, size_t len, size_t *out_len) {
+    while (len > 0 && (*line == ' ' || *line == '\t')) {
+        line++;
+        len--;
+    }
+
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) len--;
+
+    while (len > 0 && (line[len - 1] == ' ' || line[len - 1] == '\t')) {
+        if (len > 1 && line[len - 2] == '\\') break;
+        len--;
+    }
+
+    *out_len = len;
+    return line;
+}
+
+void pattern_set_init(pattern_set_t *set) {
+    set->slots = NULL;
+    set->capacity = 0;
+    set->count = 0;
+    set->arena = NULL;
+}
+
+void pattern_set_init_arena(pattern_set_t *set, arena_t *arena) {
+    pattern_set_init(set);
+    set->arena = arena;
+}
+
+void pattern_set_free(pattern_set_t *set) {
+    arena_t *arena = set->arena;
+    if (!arena) free(set->slots);
+    pattern_set_init(set);
+    set->arena = arena;
+}
+
+static int pattern_set_resize(pattern_set_t *set, size_t capacity) {
+    pattern_entry_t *slots = set->arena ? arena_calloc(set->arena, capacity, sizeof(pattern_entry_t))
+                                        : calloc(capacity, sizeof(pattern_entry_t));
+    if (!slots) return 1;
+
+    size_t mask = capacity - 1;
+    for (size_t i = 0; i < set->capacity; i++) {
+        const pattern_entry_t *e = &set->slots[i];
+        if (!e->data) continue;
+
+        size_t j = (size_t)e->hash & mask;
+        while (slots[j].data) j = (j + 1) & mask;
+        slots[j] = *e;
+    }
+
+    if (!set->arena) free(set->slots);
+    set->slots = slots;
+    set->capacity = capacity;
+    return 0;
+}
+
+static int pattern_set_grow(pattern_set_t *set) {
+    return pattern_set_resize(set, set->capacity ? set->capacity * 2 : PATTERN_SET_MIN_CAPACITY);
+}
+
+// Size the table for this many patterns at once, so filling it never
+// rehashes. An estimate is fine: the set still grows past it if needed.
+int pattern_set_reserve(pattern_set_t *set, size_t patterns) {
+    size_t capacity = set->capacity ? set->capacity : PATTERN_SET_MIN_CAPACITY;
+    while ((set->count + patterns) * 10 > capacity * 7) capacity *= 2;
+    return capacity == set->capacity ? 0 : pattern_set_resize(set, capacity);
+}
+
+// Probe for a normalized pattern; returns its slot, empty or matching
+static pattern_entry_t* pattern_set_probe(const pattern_set_t *set, const char *data,
+                                          size_t len, uint64_t hash) {
+    size_t mask = set->capacity - 1;
+    size_t i = (size_t)hash & mask;
+
+    for (;;) {
+        pattern_entry_t *e = &set->slots[i];
+        if (!e->data) return e;
+        if (e->hash == hash && e->len == len && memcmp(e->data, data, len) == 0) return e;
+        i = (i + 1) & mask;
+    }
+}
+
+int pattern_set_contains(const pattern_set_t *set, const char *line, size_t len) {
+    if (set->count == 0) return 0;
+
+    size_t norm_len;
+    const char *norm = normalize_pattern(line, len, &norm_len);
+    return pattern_set_probe(set, norm, norm_len, hash_bytes(norm, norm_len))->data != NULL;
+}
+
+// Insert a line. Returns 1 if it was new, 0 if already present and -1 on
+// allocation failure. The line's bytes must outlive the set.
+int pattern_set_insert(pattern_set_t *set, const char *line, size_t len) {
+    size_t norm_len;
+    const char *norm = normalize_pattern(line, len, &norm_len);
+    return pattern_set_insert_hashed(set, norm, norm_len, hash_bytes(norm, norm_len));
+}
+
+// Insert an already-normalized pattern whose hash is known
+int pattern_set_insert_hashed(pattern_set_t *set, const char *norm, size_t len, uint64_t hash) {
+    if ((set->count + 1) * 10 > set->capacity * 7 && pattern_set_grow(set) != 0) {
+        return -1;
+    }
+
+    pattern_entry_t *e = pattern_set_probe(set, norm, len, hash);
+    if (e->data) return 0;
+
+    e->data = norm;
+    e->len = len;
+    e->hash = hash;
+    set->count++;
+    return 1;
+}
+
+// Remove a pattern (used to roll back a section that failed mid-stream).
+// Backward-shift deletion keeps linear probe chains intact without
+// tombstones.
+int pattern_set_remove(pattern_set_t *set, const char *line, size_t len) {
+    if (set->count == 0) return 0;
+
+    size_t norm_len;
+    const char *norm = normalize_pattern(line, len, &norm_len);
+    pattern_entry_t *e = pattern_set_probe(set, norm, norm_len, hash_bytes(norm, norm_len));
+    if (!e->data) return 0;
+
+    size_t mask = set->capacity - 1;
+    size_t hole = (size_t)(e - set->slots);
+    size_t i = hole;
+
+    for (;;) {
+        i = (i + 1) & mask;
+        pattern_entry_t *next = &set->slots[i];
+        if (!next->data) break;
+
+        // Move entries whose home slot is not between the hole and i
+        size_t home = (size_t)next->hash & mask;
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            set->slots[hole] = *next;
+            hole = i;
+        }
+    }
+
+    memset(&set->slots[hole], 0, sizeof(pattern_entry_t));
+    set->count--;
+    return 1;
+}
+
+// Add every pattern line of a buffer (comments and blanks are skipped)
+int pattern_set_add_lines(pattern_set_t *set, const char *data, size_t size) {
+    const char *p = data;
+    const char *end = data + size;
+
+    while (p < end) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        const char *line_end = nl ? nl : end;
+        size_t len = (size_t)(line_end - p);
+
+        if (!is_comment_span(p, len) && pattern_set_insert(set, p, len) < 0) {
+            return 1;
+        }
+
+        p = nl ? nl + 1 : end;
+    }
+
+    return 0;
+}
@@ -2,7 +2,7 @@
 #include "gitignore.h"
 
 // List available templates
-int list_templates(const char *filter, int show_local, int show_builtin) {
+int list_templates(const char *filter, int show_local, int show_builtin, int show_stats) {
     print_info("Available templates:\n");
     
     int count = 0;
@@ -40,18 +40,27 @@ int list_templates(const char *filter, int show_local, int show_builtin) {
     if (show_builtin) {
         printf("\n%s%sBuilt-in Templates:%s\n", COLOR_BOLD, COLOR_YELLOW, COLOR_RESET);
         
-        const char *builtins[] = {
-            "python", "node", "rust", "c", "cpp", "java", "go", 
-            "ruby", "php", "swift", "kotlin", "typescript",
-            "vscode", "vim", "intellij", "macos", "linux", "windows",
-            NULL
-        };
+        const char **builtins = get_builtin_template_names();
+        int total_patterns = 0;
         
         for (int i = 0; builtins[i] != NULL; i++) {
-            if (!filter || strstr(builtins[i], filter)) {
+            if (filter && !strstr(builtins[i], filter)) continue;
+            
+            if (show_stats) {
+                // Counts come from the line tables generated at build time
+                const builtin_template_t *t = find_builtin_template(builtins[i]);
+                printf("  %s•%s %-16s %4d patterns  %4d lines  %6zu bytes\n",
+                       COLOR_GREEN, COLOR_RESET, builtins[i],
+                       t->pattern_count, t->line_count, t->size);
+                total_patterns += t->pattern_count;
+            } else {
                 printf("  %s•%s %s\n", COLOR_GREEN, COLOR_RESET, builtins[i]);
-                count++;
             }
+            count++;
+        }
+        
+        if (show_stats) {
+            printf("\n  %d pattern(s) in built-in templates\n", total_patterns);
         }
     }
     
@@ -61,35 +70,26 @@ int list_templates(const char *filter, int show_local, int show_builtin) {
 
 // Show template content
 int show_template(const char *lang) {
-    char *template_path = get_template_path(lang);
-    FILE *f = NULL;
-    
-    if (template_path && file_exists(template_path)) {
-        f = fopen(template_path, "r");
-    }
+    char path[MAX_PATH_LEN];
+    file_view_t view;
+    int found = template_path(lang, path) == 0 && file_view_open(&view, path) == 0;
     
-    if (!f) {
+    if (!found) {
         // Try built-in
         char builtin_path[MAX_PATH_LEN];
         snprintf(builtin_path, sizeof(builtin_path), "templates/%s.gitignore", lang);
-        f = fopen(builtin_path, "r");
+        found = file_view_open(&view, builtin_path) == 0;
     }
     
-    if (!f) {
+    if (!found) {
         print_error("Template not found", ERR_FILE_NOT_FOUND);
-        if (template_path) free(template_path);
         return 1;
     }
     
     printf("%s%s=== %s ===%s\n", COLOR_BOLD, COLOR_CYAN, lang, COLOR_RESET);
+    fwrite(view.data, 1, view.size, stdout);
     
-    char line[MAX_LINE_LEN];
-    while (fgets(line, sizeof(line), f)) {
-        printf("%s", line);
-    }
-    
-    fclose(f);
-    if (template_path) free(template_path);
+    file_view_close(&view);
     return 0;
 }
 
@@ -129,45 +129,151 @@ int auto_detect(int dry_run) {
     return result;
 }
 
-int detect_project_type(char ***langs, int *count) {
-    *count = 0;
+// Find every subproject below the current directory and write or update
+// a .gitignore in each, merging on the batch worker pool
+int auto_detect_recursive(int dry_run) {
+    print_info("Scanning for subprojects...");
+    
+    project_root_t *roots = NULL;
+    int root_count = 0;
+    if (walk_projects(".", walk_default_threads(), &roots, &root_count) != 0) {
+        print_error("Could not scan directory tree", ERR_PERMISSION_DENIED);
+        return 1;
+    }
     
-    struct {
-        const char *file;
-        const char *lang;
-    } indicators[] = {
-        {"package.json", "node"},
-        {"requirements.txt", "python"},
-        {"setup.py", "python"},
-        {"Pipfile", "python"},
-        {"Cargo.toml", "rust"},
-        {"go.mod", "go"},
-        {"pom.xml", "java"},
-        {"build.gradle", "java"},
-        {"Gemfile", "ruby"},
-        {"composer.json", "php"},
-        {"*.csproj", "visualstudio"},
-        {".vscode", "vscode"},
-        {".idea", "intellij"},
-        {"CMakeLists.txt", "c"},
-        {"Makefile", "c"},
-        {NULL, NULL}
-    };
+    if (root_count == 0) {
+        print_warning("No subprojects detected");
+        free(roots);
+        return 0;
+    }
+    
+    // The OS template only goes into the top-level .gitignore
+    const char *os = NULL;
+    #ifdef __APPLE__
+        os = "macos";
+    #elif __linux__
+        os = "linux";
+    #elif _WIN32
+        os = "windows";
+    #endif
+    
+    // At most one name per mask bit plus the OS template for each root
+    batch_target_t *targets = calloc((size_t)root_count, sizeof(batch_target_t));
+    const char **names = malloc((size_t)root_count * 33 * sizeof(char *));
+    if (!targets || !names) {
+        print_error("Out of memory", ERR_OUT_OF_MEMORY);
+        free(targets);
+        free(names);
+        free_project_roots(roots, root_count);
+        return 1;
+    }
+    
+    const char **next = names;
+    for (int r = 0; r < root_count; r++) {
+        targets[r].path = roots[r].path;
+        targets[r].templates = next;
+        
+        for (int bit = 0; project_lang_name(bit) != NULL; bit++) {
+            if (roots[r].langs & (1u << bit)) *next++ = project_lang_name(bit);
+        }
+        if (os && strcmp(roots[r].path, ".") == 0) *next++ = os;
+        
+        targets[r].template_count = (int)(next - targets[r].templates);
+    }
+    
+    printf("\n%sDetected %d subproject(s)%s\n", COLOR_BOLD, root_count, COLOR_RESET);
+    
+    int result = batch_apply_targets(targets, root_count, dry_run);
+    
+    free(targets);
+    free(names);
+    free_project_roots(roots, root_count);
+    return result;
+}
+
+// Languages a project indicator can point at; bit i of a mask is langs[i]
+static const char *project_langs[] = {
+    "node", "python", "rust", "go", "java", "ruby", "php",
+    "visualstudio", "vscode", "intellij", "c", NULL
+};
+
+#define LANG_BIT(i) (1u << (i))
+// Editor folders describe a workspace, not a subproject of their own
+#define EDITOR_LANGS (LANG_BIT(8) | LANG_BIT(9))
+
+// A file name, or "*.ext" for any file with that extension
+static const struct {
+    const char *file;
+    int lang;
+} indicators[] = {
+    {"package.json", 0},
+    {"requirements.txt", 1},
+    {"setup.py", 1},
+    {"Pipfile", 1},
+    {"Cargo.toml", 2},
+    {"go.mod", 3},
+    {"pom.xml", 4},
+    {"build.gradle", 4},
+    {"Gemfile", 5},
+    {"composer.json", 6},
+    {"*.csproj", 7},
+    {".vscode", 8},
+    {".idea", 9},
+    {"CMakeLists.txt", 10},
+    {"Makefile", 10},
+    {NULL, 0}
+};
+
+// Languages indicated by one directory entry
+uint32_t project_indicator_mask(const char *name) {
+    uint32_t mask = 0;
+    size_t len = 0;
     
     for (int i = 0; indicators[i].file != NULL; i++) {
-        if (file_exists(indicators[i].file)) {
-            // Check for duplicates
-            int duplicate = 0;
-            for (int j = 0; j < *count; j++) {
-                if (strcmp((*langs)[j], indicators[i].lang) == 0) {
-                    duplicate = 1;
-                    break;
-                }
-            }
-            
-            if (!duplicate) {
-                (*langs)[(*count)++] = (char*)indicators[i].lang;
+        const char *file = indicators[i].file;
+        
+        if (file[0] == '*') {
+            size_t ext_len = strlen(file + 1);
+            if (!len) len = strlen(name);
+            if (len > ext_len && strcmp(name + len - ext_len, file + 1) == 0) {
+                mask |= LANG_BIT(indicators[i].lang);
             }
+        } else if (name[0] == file[0] && strcmp(name, file) == 0) {
+            mask |= LANG_BIT(indicators[i].lang);
+        }
+    }
+    
+    return mask;
+}
+
+// The languages that make a directory a subproject root
+uint32_t project_root_mask(uint32_t langs) {
+    return langs & ~EDITOR_LANGS;
+}
+
+const char* project_lang_name(int bit) {
+    return bit >= 0 && bit < (int)(sizeof(project_langs) / sizeof(project_langs[0])) - 1 ?
+           project_langs[bit] : NULL;
+}
+
+int detect_project_type(char ***langs, int *count) {
+    *count = 0;
+    
+    // One pass over the directory instead of a stat per indicator; this
+    // also lets wildcard indicators such as *.csproj match
+    DIR *dir = opendir(".");
+    if (!dir) return 1;
+    
+    uint32_t mask = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        mask |= project_indicator_mask(entry->d_name);
+    }
+    closedir(dir);
+    
+    for (int i = 0; project_langs[i] != NULL; i++) {
+        if (mask & LANG_BIT(i)) {
+            (*langs)[(*count)++] = (char*)project_langs[i];
         }
     }
     
@@ -205,38 +311,43 @@ int add_patterns(char **patterns, int count, int dry_run) {
         return 0;
     }
     
-    // Check if .gitignore exists
-    FILE *f = fopen(".gitignore", "r");
-    int exists = (f != NULL);
-    if (f) fclose(f);
-    
-    // Open for appending
-    f = fopen(".gitignore", "a");
-    if (!f) {
-        print_error("Could not open .gitignore for writing", ERR_PERMISSION_DENIED);
+    // Keep the current contents and write the result back in one go
+    file_view_t view;
+    if (file_view_open(&view, ".gitignore") != 0 && errno != ENOENT) {
+        print_error("Could not read .gitignore", ERR_PERMISSION_DENIED);
         return 1;
     }
+    const char *existing = view.data;
+    size_t existing_size = view.size;
+    
+    out_buf_t out;
+    out_init(&out);
+    out_add(&out, existing, existing_size);
     
     // Add newline if file exists and doesn't end with one
-    if (exists) {
-        fseek(f, -1, SEEK_END);
-        char last_char = fgetc(f);
-        if (last_char != '\n') {
-            fprintf(f, "\n");
-        }
+    if (existing_size > 0 && existing[existing_size - 1] != '\n') {
+        out_add(&out, "\n", 1);
     }
     
     // Add comment header for multiple patterns
     if (count > 1) {
-        fprintf(f, "\n# Added by gitignore tool\n");
+        out_printf(&out, "\n# Added by gitignore tool\n");
     }
     
     // Add all patterns
     for (int i = 0; i < count; i++) {
-        fprintf(f, "%s\n", patterns[i]);
+        out_add(&out, patterns[i], strlen(patterns[i]));
+        out_add(&out, "\n", 1);
     }
     
-    fclose(f);
+    int rc = out_commit(&out, ".gitignore");
+    out_free(&out);
+    file_view_close(&view);
+    
+    if (rc != 0) {
+        print_error("Could not open .gitignore for writing", ERR_PERMISSION_DENIED);
+        return 1;
+    }
     
     // Print success message
     if (count == 1) {
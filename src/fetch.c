@@ -0,0 +1,539 @@
+// fetch.c - Concurrent template downloads on top of the libcurl multi interface
+#include "fetch_curl.h"
+#include <dlfcn.h>
+#include <stddef.h>
+
+curl_api_t g_curl;
+
+// Process-wide fetch context. The share handle keeps DNS results, TLS
+// sessions and open connections alive between transfers, and idle easy
+// handles are pooled so later requests skip handle setup as well.
+static struct {
+    int initialized;
+    CURLSH *share;
+    CURLM *multi;
+    CURL *idle[MAX_PARALLEL];
+    int idle_count;
+    fetch_timing_t *timings;
+    int timing_count;
+    int timing_capacity;
+} g_fetch;
+
+#ifdef GITIGNORE_CURL_LINKED
+// Built with CURL_LINK=1: point the table at the linked library
+static int fetch_load_curl(void) {
+    g_curl = (curl_api_t){
+        .global_init = curl_global_init,
+        .global_cleanup = curl_global_cleanup,
+        .easy_init = curl_easy_init,
+        .easy_setopt = curl_easy_setopt,
+        .easy_getinfo = curl_easy_getinfo,
+        .easy_perform = curl_easy_perform,
+        .easy_reset = curl_easy_reset,
+        .easy_cleanup = curl_easy_cleanup,
+        .easy_strerror = curl_easy_strerror,
+        .multi_init = curl_multi_init,
+        .multi_setopt = curl_multi_setopt,
+        .multi_add_handle = curl_multi_add_handle,
+        .multi_remove_handle = curl_multi_remove_handle,
+        .multi_perform = curl_multi_perform,
+        .multi_poll = curl_multi_poll,
+        .multi_info_read = curl_multi_info_read,
+        .multi_cleanup = curl_multi_cleanup,
+        .share_init = curl_share_init,
+        .share_setopt = curl_share_setopt,
+        .share_cleanup = curl_share_cleanup,
+        .slist_append = curl_slist_append,
+        .slist_free_all = curl_slist_free_all,
+    };
+    return 0;
+}
+#else
+// Resolve libcurl's entry points into g_curl. The library stays loaded
+// for the rest of the process.
+static int fetch_load_curl(void) {
+    static const char *names[] = { "libcurl.so.4", "libcurl.so", "libcurl.4.dylib", "libcurl.dylib", NULL };
+    static const struct {
+        const char *symbol;
+        size_t offset;
+    } entries[] = {
+#define CURL_ENTRY(field, symbol) { symbol, offsetof(curl_api_t, field) }
+        CURL_ENTRY(global_init, "curl_global_init"),
+        CURL_ENTRY(global_cleanup, "curl_global_cleanup"),
+        CURL_ENTRY(easy_init, "curl_easy_init"),
+        CURL_ENTRY(easy_setopt, "curl_easy_setopt"),
+        CURL_ENTRY(easy_getinfo, "curl_easy_getinfo"),
+        CURL_ENTRY(easy_perform, "curl_easy_perform"),
+        CURL_ENTRY(easy_reset, "curl_easy_reset"),
+        CURL_ENTRY(easy_cleanup, "curl_easy_cleanup"),
+        CURL_ENTRY(easy_strerror, "curl_easy_strerror"),
+        CURL_ENTRY(multi_init, "curl_multi_init"),
+        CURL_ENTRY(multi_setopt, "curl_multi_setopt"),
+        CURL_ENTRY(multi_add_handle, "curl_multi_add_handle"),
+        CURL_ENTRY(multi_remove_handle, "curl_multi_remove_handle"),
+        CURL_ENTRY(multi_perform, "curl_multi_perform"),
+        CURL_ENTRY(multi_poll, "curl_multi_poll"),
+        CURL_ENTRY(multi_info_read, "curl_multi_info_read"),
+        CURL_ENTRY(multi_cleanup, "curl_multi_cleanup"),
+        CURL_ENTRY(share_init, "curl_share_init"),
+        CURL_ENTRY(share_setopt, "curl_share_setopt"),
+        CURL_ENTRY(share_cleanup, "curl_share_cleanup"),
+        CURL_ENTRY(slist_append, "curl_slist_append"),
+        CURL_ENTRY(slist_free_all, "curl_slist_free_all"),
+#undef CURL_ENTRY
+    };
+
+    if (g_curl.global_init) return 0;
+
+    void *lib = NULL;
+    for (int i = 0; names[i] && !lib; i++) {
+        lib = dlopen(names[i], RTLD_NOW | RTLD_LOCAL);
+    }
+    if (!lib) return 1;
+
+    curl_api_t api;
+    for (size_t i = 0; i < sizeof(entries) / sizeof(entries[0]); i++) {
+        void *fn = dlsym(lib, entries[i].symbol);
+        if (!fn) {
+            dlclose(lib);
+            return 1;
+        }
+        memcpy((char *)&api + entries[i].offset, &fn, sizeof(fn));
+    }
+
+    g_curl = api;
+    return 0;
+}
+#endif
+
+int fetch_init(void) {
+    if (g_fetch.initialized) return 0;
+
+    if (fetch_load_curl() != 0) {
+        print_error("Could not load libcurl", ERR_CURL_INIT_FAILED);
+        return 1;
+    }
+
+    if (g_curl.global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK) {
+        print_error("Could not initialize curl", ERR_CURL_INIT_FAILED);
+        return 1;
+    }
+
+    g_fetch.share = g_curl.share_init();
+    g_fetch.multi = g_curl.multi_init();
+    if (!g_fetch.share || !g_fetch.multi) {
+        print_error("Could not initialize curl", ERR_CURL_INIT_FAILED);
+        if (g_fetch.share) g_curl.share_cleanup(g_fetch.share);
+        if (g_fetch.multi) g_curl.multi_cleanup(g_fetch.multi);
+        g_fetch.share = NULL;
+        g_fetch.multi = NULL;
+        g_curl.global_cleanup();
+        return 1;
+    }
+
+    g_curl.share_setopt(g_fetch.share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    g_curl.share_setopt(g_fetch.share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    g_curl.share_setopt(g_fetch.share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+
+    // Let transfers to the same host multiplex over one HTTP/2 connection
+    g_curl.multi_setopt(g_fetch.multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+
+    g_fetch.initialized = 1;
+    return 0;
+}
+
+void fetch_cleanup(void) {
+    if (!g_fetch.initialized) return;
+
+    for (int i = 0; i < g_fetch.idle_count; i++) {
+        g_curl.easy_cleanup(g_fetch.idle[i]);
+    }
+    g_fetch.idle_count = 0;
+
+    g_curl.multi_cleanup(g_fetch.multi);
+    g_curl.share_cleanup(g_fetch.share);
+    g_curl.global_cleanup();
+
+    free(g_fetch.timings);
+    memset(&g_fetch, 0, sizeof(g_fetch));
+}
+
+// Callback for curl to append body bytes to the owning job's stream.
+// Error pages are discarded; the merge stage is poked after every chunk.
+static size_t fetch_write_callback(char *contents, size_t size, size_t nmemb, void *userp) {
+    size_t realsize = size * nmemb;
+    fetch_job_t *job = (fetch_job_t *)userp;
+
+    if (job->http_code != 200) {
+        return realsize;
+    }
+
+    if (stream_append(&job->body, contents, realsize) != 0) {
+        print_error("Out of memory", ERR_OUT_OF_MEMORY);
+        return 0;
+    }
+
+    if (job->on_data) {
+        job->on_data(job, job->ctx);
+    }
+
+    return realsize;
+}
+
+// Copy the value of a "Name: value" header line into dst if it matches
+int fetch_header_value(const char *line, size_t len, const char *name,
+                              char *dst, size_t dst_len) {
+    size_t name_len = strlen(name);
+    if (len <= name_len || line[name_len] != ':' ||
+        strncasecmp(line, name, name_len) != 0) {
+        return 0;
+    }
+
+    const char *value = line + name_len + 1;
+    const char *end = line + len;
+    while (value < end && (*value == ' ' || *value == '\t')) value++;
+    while (end > value && (end[-1] == '\r' || end[-1] == '\n' || end[-1] == ' ')) end--;
+
+    size_t value_len = (size_t)(end - value);
+    if (value_len >= dst_len) value_len = dst_len - 1;
+    memcpy(dst, value, value_len);
+    dst[value_len] = '\0';
+    return 1;
+}
+
+// Capture the validators the server sends for the cache
+static size_t fetch_header_callback(char *buffer, size_t size, size_t nitems, void *userp) {
+    size_t len = size * nitems;
+    fetch_job_t *job = (fetch_job_t *)userp;
+
+    // Status line of each response (redirects included; the last one wins)
+    if (len > 5 && strncmp(buffer, "HTTP/", 5) == 0) {
+        const char *sp = memchr(buffer, ' ', len);
+        job->http_code = sp ? strtol(sp + 1, NULL, 10) : 0;
+        return len;
+    }
+
+    if (!fetch_header_value(buffer, len, "ETag", job->meta.etag, sizeof(job->meta.etag))) {
+        fetch_header_value(buffer, len, "Last-Modified",
+                           job->meta.last_modified, sizeof(job->meta.last_modified));
+    }
+
+    return len;
+}
+
+// Conditional request headers for a stale cache entry
+static struct curl_slist* fetch_conditional_headers(const cache_meta_t *validators) {
+    if (!validators) return NULL;
+
+    struct curl_slist *headers = NULL;
+    char header[256];
+
+    if (validators->etag[0]) {
+        snprintf(header, sizeof(header), "If-None-Match: %s", validators->etag);
+        headers = g_curl.slist_append(headers, header);
+    }
+    if (validators->last_modified[0]) {
+        snprintf(header, sizeof(header), "If-Modified-Since: %s", validators->last_modified);
+        headers = g_curl.slist_append(headers, header);
+    }
+
+    return headers;
+}
+
+static CURL* fetch_acquire_handle(fetch_job_t *job, struct curl_slist *headers) {
+    CURL *curl;
+
+    if (g_fetch.idle_count > 0) {
+        curl = g_fetch.idle[--g_fetch.idle_count];
+        g_curl.easy_reset(curl);
+    } else {
+        curl = g_curl.easy_init();
+        if (!curl) return NULL;
+    }
+
+    const char *base = g_config ? g_config->template_url : GITHUB_RAW_URL;
+    size_t base_len = strlen(base);
+    char url[MAX_PATH_LEN + 128];
+    snprintf(url, sizeof(url), "%s%s%s.gitignore", base,
+             base_len > 0 && base[base_len - 1] == '/' ? "" : "/", job->lang);
+
+    // file:// and other non-HTTP sources have no status line to parse
+    if (strncasecmp(base, "http://", 7) != 0 && strncasecmp(base, "https://", 8) != 0) {
+        job->http_code = 200;
+    }
+
+    fetch_setopt_ptr(curl, CURLOPT_URL, url);
+    fetch_setopt_ptr(curl, CURLOPT_SHARE, g_fetch.share);
+    fetch_setopt_fn(curl, CURLOPT_WRITEFUNCTION, fetch_write_callback);
+    fetch_setopt_ptr(curl, CURLOPT_WRITEDATA, (void *)job);
+    fetch_setopt_ptr(curl, CURLOPT_PRIVATE, (void *)job);
+    fetch_setopt_ptr(curl, CURLOPT_USERAGENT, "gitignore-tool/2.0");
+    fetch_setopt_long(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    fetch_setopt_long(curl, CURLOPT_TIMEOUT, 30L);
+    fetch_setopt_ptr(curl, CURLOPT_ACCEPT_ENCODING, "");
+    fetch_setopt_long(curl, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+    fetch_setopt_long(curl, CURLOPT_PIPEWAIT, 1L);
+    fetch_setopt_fn(curl, CURLOPT_HEADERFUNCTION, fetch_header_callback);
+    fetch_setopt_ptr(curl, CURLOPT_HEADERDATA, (void *)job);
+    if (headers) {
+        fetch_setopt_ptr(curl, CURLOPT_HTTPHEADER, headers);
+    }
+
+    return curl;
+}
+
+static void fetch_release_handle(CURL *curl) {
+    if (g_fetch.idle_count < MAX_PARALLEL) {
+        g_fetch.idle[g_fetch.idle_count++] = curl;
+    } else {
+        g_curl.easy_cleanup(curl);
+    }
+}
+
+static void fetch_record_timing(fetch_job_t *job, CURL *curl) {
+    if (!g_config || !g_config->timings) return;
+
+    if (g_fetch.timing_count == g_fetch.timing_capacity) {
+        int capacity = g_fetch.timing_capacity ? g_fetch.timing_capacity * 2 : 16;
+        fetch_timing_t *grown = realloc(g_fetch.timings, sizeof(fetch_timing_t) * capacity);
+        if (!grown) return;
+        g_fetch.timings = grown;
+        g_fetch.timing_capacity = capacity;
+    }
+
+    fetch_timing_t *t = &g_fetch.timings[g_fetch.timing_count++];
+    memset(t, 0, sizeof(*t));
+    snprintf(t->lang, sizeof(t->lang), "%s", job->lang);
+
+    curl_off_t downloaded = 0;
+    long connects = 0;
+    fetch_getinfo_double(curl, CURLINFO_NAMELOOKUP_TIME, &t->namelookup);
+    fetch_getinfo_double(curl, CURLINFO_CONNECT_TIME, &t->connect);
+    fetch_getinfo_double(curl, CURLINFO_APPCONNECT_TIME, &t->appconnect);
+    fetch_getinfo_double(curl, CURLINFO_STARTTRANSFER_TIME, &t->starttransfer);
+    fetch_getinfo_double(curl, CURLINFO_TOTAL_TIME, &t->total);
+    fetch_getinfo_off(curl, CURLINFO_SIZE_DOWNLOAD_T, &downloaded);
+    fetch_getinfo_long(curl, CURLINFO_NUM_CONNECTS, &connects);
+    fetch_getinfo_long(curl, CURLINFO_HTTP_VERSION, &t->http_version);
+    fetch_getinfo_long(curl, CURLINFO_RESPONSE_CODE, &t->http_code);
+
+    t->bytes = (size_t)downloaded;
+    t->reused = (connects == 0);
+    t->start_ms = timing_elapsed_ms() - t->total * 1000.0;
+}
+
+static void fetch_finish_job(fetch_job_t *job, CURL *curl, CURLcode res) {
+    fetch_record_timing(job, curl);
+    job->finished = 1;
+
+    if (res == CURLE_FILE_COULDNT_READ_FILE) {
+        if (g_config && !g_config->quiet) {
+            fprintf(stderr, "%sTemplate '%s' not found in %s%s\n",
+                    COLOR_RED, job->lang, g_config->template_url, COLOR_RESET);
+        }
+        job->status = ERR_INVALID_TEMPLATE;
+    } else if (res != CURLE_OK) {
+        if (g_config && !g_config->quiet) {
+            fprintf(stderr, "%sError downloading %s: %s%s\n",
+                    COLOR_RED, job->lang, g_curl.easy_strerror(res), COLOR_RESET);
+        }
+        job->status = ERR_NETWORK_ERROR;
+    } else {
+        long code = 0;
+        fetch_getinfo_long(curl, CURLINFO_RESPONSE_CODE, &code);
+        if (code != 0) job->http_code = code;
+
+        if (job->http_code == 304 && job->validators) {
+            // Body unchanged upstream; the caller keeps its cached copy
+            job->not_modified = 1;
+            job->status = ERR_SUCCESS;
+            return;
+        } else if (job->http_code != 200) {
+            if (g_config && !g_config->quiet) {
+                fprintf(stderr, "%sTemplate '%s' could not be fetched (HTTP %ld)%s\n",
+                        COLOR_RED, job->lang, job->http_code, COLOR_RESET);
+            }
+            job->status = ERR_INVALID_TEMPLATE;
+        } else if (job->body.size == 0) {
+            job->status = ERR_INVALID_TEMPLATE;
+        } else {
+            job->status = ERR_SUCCESS;
+        }
+    }
+}
+
+// Download every job concurrently, keeping at most max_parallel transfers
+// in flight. Jobs complete in any order; callers read results by index.
+int fetch_templates(fetch_job_t *jobs, int count, int max_parallel) {
+    if (count <= 0) return 0;
+    if (max_parallel < 1) max_parallel = MAX_PARALLEL;
+    if (max_parallel > count) max_parallel = count;
+
+    for (int i = 0; i < count; i++) {
+        stream_init(&jobs[i].body);
+        jobs[i].http_code = 0;
+        jobs[i].not_modified = 0;
+        jobs[i].finished = 0;
+        memset(&jobs[i].meta, 0, sizeof(jobs[i].meta));
+        jobs[i].status = ERR_NETWORK_ERROR;
+    }
+
+    // Callers that merge while bodies arrive have that work counted here
+    int span = timing_begin("network");
+    timing_note(span, "%d transfer(s)", count);
+    if (fetch_init() != 0) {
+        timing_end(span);
+        return 1;
+    }
+
+    CURLM *multi = g_fetch.multi;
+    CURL **handles = calloc((size_t)count, sizeof(CURL *));
+    struct curl_slist **headers = calloc((size_t)count, sizeof(struct curl_slist *));
+    if (!handles || !headers) {
+        timing_end(span);
+        print_error("Out of memory", ERR_OUT_OF_MEMORY);
+        free(handles);
+        free(headers);
+        return 1;
+    }
+
+    int next = 0;
+    int running = 0;
+    int done = 0;
+
+    while (done < count) {
+        // Top up the transfer window
+        while (running < max_parallel && next < count) {
+            headers[next] = fetch_conditional_headers(jobs[next].validators);
+            CURL *curl = fetch_acquire_handle(&jobs[next], headers[next]);
+            if (!curl) {
+                print_error("Could not initialize curl", ERR_CURL_INIT_FAILED);
+                jobs[next].status = ERR_CURL_INIT_FAILED;
+                jobs[next].finished = 1;
+                if (jobs[next].on_data) {
+                    jobs[next].on_data(&jobs[next], jobs[next].ctx);
+                }
+                next++;
+                done++;
+                continue;
+            }
+            g_curl.multi_add_handle(multi, curl);
+            handles[next] = curl;
+            next++;
+            running++;
+        }
+
+        if (running == 0) break;
+
+        int still_running = 0;
+        if (g_curl.multi_perform(multi, &still_running) != CURLM_OK) break;
+
+        CURLMsg *msg;
+        int queued;
+        while ((msg = g_curl.multi_info_read(multi, &queued)) != NULL) {
+            if (msg->msg != CURLMSG_DONE) continue;
+
+            CURL *curl = msg->easy_handle;
+            fetch_job_t *job = NULL;
+            fetch_getinfo_str(curl, CURLINFO_PRIVATE, (char **)&job);
+
+            fetch_finish_job(job, curl, msg->data.result);
+
+            g_curl.multi_remove_handle(multi, curl);
+            fetch_release_handle(curl);
+            handles[job - jobs] = NULL;
+            running--;
+            done++;
+
+            if (g_config && !g_config->quiet) {
+                print_progress(job->lang, done, count);
+            }
+
+            if (job->on_data) {
+                job->on_data(job, job->ctx);
+            }
+        }
+
+        if (still_running > 0) {
+            g_curl.multi_poll(multi, NULL, 0, 1000, NULL);
+        }
+    }
+
+    // Release transfers abandoned by a multi error
+    for (int i = 0; i < count; i++) {
+        if (handles[i]) {
+            g_curl.multi_remove_handle(multi, handles[i]);
+            g_curl.easy_cleanup(handles[i]);
+        }
+        if (!jobs[i].finished) {
+            jobs[i].finished = 1;
+            if (jobs[i].on_data) {
+                jobs[i].on_data(&jobs[i], jobs[i].ctx);
+            }
+        }
+    }
+    free(handles);
+
+    for (int i = 0; i < count; i++) {
+        g_curl.slist_free_all(headers[i]);
+    }
+    free(headers);
+    timing_end(span);
+
+    int failed = 0;
+    for (int i = 0; i < count; i++) {
+        if (jobs[i].status != ERR_SUCCESS) failed++;
+    }
+
+    return failed == count ? 1 : 0;
+}
+
+// Print per-transfer timings collected under --timings, as a table or as
+// a JSON array. Start times share the timeline of the phase spans.
+void fetch_report_timings(FILE *out, int json) {
+    if (json) {
+        fprintf(out, "[");
+        for (int i = 0; i < g_fetch.timing_count; i++) {
+            const fetch_timing_t *t = &g_fetch.timings[i];
+            fprintf(out, "%s\n  {\"template\": ", i > 0 ? "," : "");
+            timing_json_string(out, t->lang);
+            fprintf(out, ", \"status\": %ld, \"start_ms\": %.3f, \"dns_ms\": %.3f, "
+                         "\"connect_ms\": %.3f, \"tls_ms\": %.3f, \"ttfb_ms\": %.3f, "
+                         "\"total_ms\": %.3f, \"bytes\": %zu, \"reused\": %s, \"http2\": %s}",
+                    t->http_code, t->start_ms, t->namelookup * 1000.0, t->connect * 1000.0,
+                    t->appconnect * 1000.0, t->starttransfer * 1000.0, t->total * 1000.0,
+                    t->bytes, t->reused ? "true" : "false",
+                    t->http_version == CURL_HTTP_VERSION_2_0 ? "true" : "false");
+        }
+        fprintf(out, "%s]", g_fetch.timing_count > 0 ? "\n" : "");
+        return;
+    }
+
+    if (g_fetch.timing_count == 0) return;
+
+    int reused = 0;
+    double total = 0;
+    size_t bytes = 0;
+
+    fprintf(out, "\n%sNetwork timings (ms):%s\n", COLOR_BOLD, COLOR_RESET);
+    fprintf(out, "  %-20s %6s %8s %8s %8s %8s %8s %8s %10s  %s\n",
+            "template", "status", "start", "dns", "connect", "tls", "ttfb", "total", "bytes", "connection");
+
+    for (int i = 0; i < g_fetch.timing_count; i++) {
+        const fetch_timing_t *t = &g_fetch.timings[i];
+        fprintf(out, "  %-20s %6ld %8.1f %8.1f %8.1f %8.1f %8.1f %8.1f %10zu  %s%s\n",
+                t->lang, t->http_code, t->start_ms,
+                t->namelookup * 1000.0, t->connect * 1000.0,
+                t->appconnect * 1000.0, t->starttransfer * 1000.0,
+                t->total * 1000.0, t->bytes,
+                t->reused ? "reused" : "new",
+                t->http_version == CURL_HTTP_VERSION_2_0 ? " (h2)" : "");
+        if (t->reused) reused++;
+        total += t->total;
+        bytes += t->bytes;
+    }
+
+    fprintf(out, "  %d transfer(s), %d new connection(s), %d reused, %zu bytes, %.1f ms summed\n",
+            g_fetch.timing_count, g_fetch.timing_count - reused, reused,
+            bytes, total * 1000.0);
+}
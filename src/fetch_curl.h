@@ -0,0 +1,105 @@
+// fetch_curl.h - libcurl entry points for fetch.c and prefetch.c
+//
+// libcurl (and the TLS stack behind it) is loaded by fetch_init() on first
+// use, so commands that never download, and clients of gitignore serve,
+// start without it. `make CURL_LINK=1` links it instead; the table is then
+// filled from the linked symbols.
+//
+// Calls go through g_curl explicitly. The option setters are variadic, so
+// the wrappers below stand in for curl's own type checks: each one takes
+// a single argument type and refuses to compile for an option or info
+// from another class.
+#ifndef FETCH_CURL_H
+#define FETCH_CURL_H
+
+#include "gitignore.h"
+
+typedef struct {
+    CURLcode (*global_init)(long flags);
+    void (*global_cleanup)(void);
+    CURL* (*easy_init)(void);
+    CURLcode (*easy_setopt)(CURL *curl, CURLoption option, ...);
+    CURLcode (*easy_getinfo)(CURL *curl, CURLINFO info, ...);
+    CURLcode (*easy_perform)(CURL *curl);
+    void (*easy_reset)(CURL *curl);
+    void (*easy_cleanup)(CURL *curl);
+    const char* (*easy_strerror)(CURLcode code);
+    CURLM* (*multi_init)(void);
+    CURLMcode (*multi_setopt)(CURLM *multi, CURLMoption option, ...);
+    CURLMcode (*multi_add_handle)(CURLM *multi, CURL *curl);
+    CURLMcode (*multi_remove_handle)(CURLM *multi, CURL *curl);
+    CURLMcode (*multi_perform)(CURLM *multi, int *running);
+    CURLMcode (*multi_poll)(CURLM *multi, struct curl_waitfd *extra, unsigned int extra_nfds,
+                            int timeout_ms, int *numfds);
+    CURLMsg* (*multi_info_read)(CURLM *multi, int *msgs_in_queue);
+    CURLMcode (*multi_cleanup)(CURLM *multi);
+    CURLSH* (*share_init)(void);
+    CURLSHcode (*share_setopt)(CURLSH *share, CURLSHoption option, ...);
+    CURLSHcode (*share_cleanup)(CURLSH *share);
+    struct curl_slist* (*slist_append)(struct curl_slist *list, const char *s);
+    void (*slist_free_all)(struct curl_slist *list);
+} curl_api_t;
+
+extern curl_api_t g_curl;
+
+// Compile-time check that lo <= id < hi
+#define FETCH_CURL_CLASS(id, lo, hi) ((void)sizeof(char[(id) >= (lo) && (id) < (hi) ? 1 : -1]))
+
+static inline CURLcode fetch_setopt_long_(CURL *curl, CURLoption option, long value) {
+    return g_curl.easy_setopt(curl, option, value);
+}
+
+static inline CURLcode fetch_setopt_ptr_(CURL *curl, CURLoption option, const void *value) {
+    return g_curl.easy_setopt(curl, option, value);
+}
+
+static inline CURLcode fetch_setopt_fn_(CURL *curl, CURLoption option, curl_write_callback fn) {
+    return g_curl.easy_setopt(curl, option, fn);
+}
+
+static inline CURLcode fetch_getinfo_long_(CURL *curl, CURLINFO info, long *out) {
+    return g_curl.easy_getinfo(curl, info, out);
+}
+
+static inline CURLcode fetch_getinfo_double_(CURL *curl, CURLINFO info, double *out) {
+    return g_curl.easy_getinfo(curl, info, out);
+}
+
+static inline CURLcode fetch_getinfo_off_(CURL *curl, CURLINFO info, curl_off_t *out) {
+    return g_curl.easy_getinfo(curl, info, out);
+}
+
+static inline CURLcode fetch_getinfo_str_(CURL *curl, CURLINFO info, char **out) {
+    return g_curl.easy_getinfo(curl, info, out);
+}
+
+// Long options, e.g. CURLOPT_TIMEOUT
+#define fetch_setopt_long(curl, opt, value) \
+    (FETCH_CURL_CLASS(opt, CURLOPTTYPE_LONG, CURLOPTTYPE_OBJECTPOINT), \
+     fetch_setopt_long_((curl), (opt), (value)))
+
+// Strings, data pointers, lists and handles, e.g. CURLOPT_URL
+#define fetch_setopt_ptr(curl, opt, value) \
+    (FETCH_CURL_CLASS(opt, CURLOPTTYPE_OBJECTPOINT, CURLOPTTYPE_FUNCTIONPOINT), \
+     fetch_setopt_ptr_((curl), (opt), (value)))
+
+// Write and header callbacks, which share curl_write_callback's signature
+#define fetch_setopt_fn(curl, opt, fn) \
+    (FETCH_CURL_CLASS(opt, CURLOPTTYPE_FUNCTIONPOINT, CURLOPTTYPE_OFF_T), \
+     fetch_setopt_fn_((curl), (opt), (fn)))
+
+#define FETCH_CURLINFO_IS(info, type) FETCH_CURL_CLASS((info) & CURLINFO_TYPEMASK, type, (type) + 1)
+
+#define fetch_getinfo_long(curl, info, out) \
+    (FETCH_CURLINFO_IS(info, CURLINFO_LONG), fetch_getinfo_long_((curl), (info), (out)))
+
+#define fetch_getinfo_double(curl, info, out) \
+    (FETCH_CURLINFO_IS(info, CURLINFO_DOUBLE), fetch_getinfo_double_((curl), (info), (out)))
+
+#define fetch_getinfo_off(curl, info, out) \
+    (FETCH_CURLINFO_IS(info, CURLINFO_OFF_T), fetch_getinfo_off_((curl), (info), (out)))
+
+#define fetch_getinfo_str(curl, info, out) \
+    (FETCH_CURLINFO_IS(info, CURLINFO_STRING), fetch_getinfo_str_((curl), (info), (out)))
+
+#endif
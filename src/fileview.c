@@ -0,0 +1,150 @@
+// fileview.c - Read-only views of whole files, with zero-copy line slices
+//
+// A view is the file's bytes at (data, size), however they got there.
+// Regular files from FILE_VIEW_MMAP_MIN up are mapped, so a multi-megabyte
+// generated .gitignore is parsed straight out of the page cache without
+// being copied. Smaller files take a single read() into a buffer: for a
+// few kilobytes a mapping costs more (mmap, a page fault, munmap) than
+// the copy it saves. Pipes and other non-seekable inputs are read to EOF.
+//
+// Lines are handed out as (pointer, length) slices into the view, so
+// there is no line-length limit and nothing is split or truncated. The
+// data is NOT NUL-terminated when mapped.
+//
+// A mapping reflects the file as it is on disk. The tool itself replaces
+// files by renaming a new one over them (see output.c), which leaves an
+// open view of the old file intact.
+#include "gitignore.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#define FILE_VIEW_MMAP_MIN (64 * 1024)
+#define FILE_VIEW_READ_CHUNK (64 * 1024)
+
+// An empty view; closing it is a no-op
+void file_view_init(file_view_t *fv) {
+    fv->data = "";
+    fv->size = 0;
+    fv->map = NULL;
+    fv->owned = NULL;
+}
+
+// Read everything left in fd into a NUL-terminated buffer. hint is the
+// expected size (0 if unknown); with a correct hint it takes one read().
+static char* file_view_read_all(int fd, size_t hint, size_t *size) {
+    size_t cap = hint ? hint + 1 : FILE_VIEW_READ_CHUNK;
+    size_t len = 0;
+    char *data = malloc(cap);
+    if (!data) return NULL;
+
+    for (;;) {
+        if (len + 1 == cap) {
+            size_t grown = cap < FILE_VIEW_READ_CHUNK ? FILE_VIEW_READ_CHUNK : cap * 2;
+            char *bigger = realloc(data, grown);
+            if (!bigger) {
+                free(data);
+                return NULL;
+            }
+            data = bigger;
+            cap = grown;
+        }
+
+        ssize_t n = read(fd, data + len, cap - 1 - len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            free(data);
+            return NULL;
+        }
+        if (n == 0) break;
+        len += (size_t)n;
+
+        // A regular file that delivered its whole size is done; skip the
+        // read that would only confirm EOF
+        if (hint && len == hint) break;
+    }
+
+    data[len] = '\0';
+    *size = len;
+    return data;
+}
+
+// View an open descriptor; the caller keeps ownership of fd
+int file_view_fd(file_view_t *fv, int fd) {
+    file_view_init(fv);
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) return 1;
+
+    int regular = S_ISREG(st.st_mode);
+    size_t size = regular ? (size_t)st.st_size : 0;
+    if (regular && size == 0) return 0;
+
+    if (regular && size >= FILE_VIEW_MMAP_MIN) {
+        void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            madvise(map, size, MADV_SEQUENTIAL);
+            fv->map = map;
+            fv->data = map;
+            fv->size = size;
+            return 0;
+        }
+        // Some filesystems cannot map; read it instead
+    }
+
+    fv->owned = file_view_read_all(fd, size, &fv->size);
+    if (!fv->owned) return 1;
+    fv->data = fv->owned;
+    return 0;
+}
+
+// View a file by path. Returns nonzero (errno set) if it cannot be read.
+int file_view_open(file_view_t *fv, const char *path) {
+    file_view_init(fv);
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 1;
+
+    int rc = file_view_fd(fv, fd);
+    int saved = errno;
+    close(fd);
+    errno = saved;
+    return rc;
+}
+
+void file_view_close(file_view_t *fv) {
+    if (fv->map) munmap(fv->map, fv->size);
+    free(fv->owned);
+    file_view_init(fv);
+}
+
+// Take the bytes as a NUL-terminated heap buffer and leave the view
+// empty. A read buffer is handed over as is; a mapping is copied.
+char* file_view_detach(file_view_t *fv, size_t *size) {
+    char *data = fv->owned;
+    if (!data) {
+        data = malloc(fv->size + 1);
+        if (!data) return NULL;
+        memcpy(data, fv->data, fv->size);
+        data[fv->size] = '\0';
+        if (fv->map) munmap(fv->map, fv->size);
+    }
+
+    *size = fv->size;
+    file_view_init(fv);
+    return data;
+}
+
+// Next line starting at *pos, without its newline. Returns 0 once the
+// view is exhausted. A final line without a newline is still returned.
+int file_view_next_line(const file_view_t *fv, size_t *pos, const char **line, size_t *len) {
+    if (*pos >= fv->size) return 0;
+
+    const char *p = fv->data + *pos;
+    size_t left = fv->size - *pos;
+    const char *nl = memchr(p, '\n', left);
+
+    *line = p;
+    *len = nl ? (size_t)(nl - p) : left;
+    *pos += *len + (nl ? 1 : 0);
+    return 1;
+}
@@ -81,23 +81,15 @@ int global_add(char **langs, int count) {
     fprintf(f, "\n# Added by gitignore tool\n");
     
     for (int i = 0; i < count; i++) {
-        char *template_path = get_template_path(langs[i]);
-        FILE *tmpl = NULL;
+        char path[MAX_PATH_LEN];
+        file_view_t tmpl;
         
-        if (template_path && file_exists(template_path)) {
-            tmpl = fopen(template_path, "r");
-        }
-        
-        if (tmpl) {
+        if (template_path(langs[i], path) == 0 && file_view_open(&tmpl, path) == 0) {
             fprintf(f, "\n# === %s ===\n", langs[i]);
-            char line[MAX_LINE_LEN];
-            while (fgets(line, sizeof(line), tmpl)) {
-                fputs(line, f);
-            }
-            fclose(tmpl);
+            fwrite(tmpl.data, 1, tmpl.size, f);
+            if (tmpl.size > 0 && tmpl.data[tmpl.size - 1] != '\n') fputc('\n', f);
+            file_view_close(&tmpl);
         }
-        
-        if (template_path) free(template_path);
     }
     
     fclose(f);
@@ -122,10 +114,7 @@ int backup_gitignore(void) {
     }
     
     // Create backup directory if it doesn't exist
-    struct stat st = {0};
-    if (stat(backup_path, &st) == -1) {
-        mkdir(backup_path, 0755);
-    }
+    app_paths_ensure(APP_DIR_BACKUP);
     
     // Generate backup filename with timestamp
     time_t now = time(NULL);
@@ -138,10 +127,12 @@ int backup_gitignore(void) {
              t->tm_hour, t->tm_min, t->tm_sec);
     
     // Copy file
+    int span = timing_begin("backup");
     FILE *src = fopen(".gitignore", "r");
     FILE *dst = fopen(backup_file, "w");
     
     if (!src || !dst) {
+        timing_end(span);
         print_error("Could not create backup", ERR_PERMISSION_DENIED);
         if (src) fclose(src);
         if (dst) fclose(dst);
@@ -157,6 +148,7 @@ int backup_gitignore(void) {
     
     fclose(src);
     fclose(dst);
+    timing_end(span);
     free(backup_path);
     
     print_success("Backup created");
@@ -19,13 +19,25 @@ void show_help(void) {
     printf("  %s-t, -I, interactive%s Interactive template selection\n", COLOR_GREEN, COLOR_RESET);
     printf("  %s-V, --verbose%s       Verbose output\n", COLOR_GREEN, COLOR_RESET);
     printf("  %s-q, --quiet%s         Quiet mode (errors only)\n", COLOR_GREEN, COLOR_RESET);
-    printf("  %s--dry-run%s           Show what would happen without doing it\n\n", COLOR_GREEN, COLOR_RESET);
+    printf("  %s--dry-run%s           Show what would happen without doing it\n", COLOR_GREEN, COLOR_RESET);
+    printf("  %s-j, --jobs N%s        Run up to N downloads or batch merges at once (default: %d)\n", COLOR_GREEN, COLOR_RESET, MAX_PARALLEL);
+    printf("  %s--timings[=json]%s    Report time spent per phase and per download on stderr\n", COLOR_GREEN, COLOR_RESET);
+    printf("  %s--fsync%s             Flush .gitignore to disk before replacing it\n", COLOR_GREEN, COLOR_RESET);
+    printf("  %s--minimal%s           Leave out merged rules that other rules already cover\n\n", COLOR_GREEN, COLOR_RESET);
     
     printf("%sCOMMANDS:%s\n", COLOR_BOLD, COLOR_RESET);
     printf("  %sinit [langs...]%s              Create .gitignore with specified templates\n", 
            COLOR_YELLOW, COLOR_RESET);
     printf("  %ssync [langs...]%s              Download templates from GitHub\n", 
            COLOR_YELLOW, COLOR_RESET);
+    printf("  %sbatch <manifest>%s             Apply templates to every repo in a manifest\n", 
+           COLOR_YELLOW, COLOR_RESET);
+    printf("  %scheck [paths...]%s             Print the paths .gitignore excludes (stdin if none)\n", 
+           COLOR_YELLOW, COLOR_RESET);
+    printf("  %sminimize [file]%s              Remove rules that other rules already cover\n", 
+           COLOR_YELLOW, COLOR_RESET);
+    printf("  %saudit [file]%s                 Show files each rule matches, and dead rules\n", 
+           COLOR_YELLOW, COLOR_RESET);
     printf("  %sappend [langs...]%s            Append templates to existing .gitignore\n", 
            COLOR_YELLOW, COLOR_RESET);
     printf("  %supdate [langs...]%s            Smart merge templates (removes duplicates)\n", 
@@ -36,6 +48,8 @@ void show_help(void) {
            COLOR_YELLOW, COLOR_RESET);
     printf("  %sauto%s                         Auto-detect project and create .gitignore\n", 
            COLOR_YELLOW, COLOR_RESET);
+    printf("  %sauto --recursive, -r%s         Write a .gitignore for every subproject below here\n", 
+           COLOR_YELLOW, COLOR_RESET);
     printf("  %sinteractive, -t, -I%s          Interactive template selection mode\n\n", 
            COLOR_YELLOW, COLOR_RESET);
     
@@ -54,9 +68,18 @@ void show_help(void) {
            COLOR_YELLOW, COLOR_RESET);
     
     printf("%sCACHE COMMANDS:%s\n", COLOR_BOLD, COLOR_RESET);
-    printf("  %scache clear%s                  Clear template cache\n\n", 
+    printf("  %scache clear%s                  Clear template cache\n", 
+           COLOR_YELLOW, COLOR_RESET);
+    printf("  %scache compact%s                Reclaim space from replaced cache entries\n", 
+           COLOR_YELLOW, COLOR_RESET);
+    printf("  %scache prefetch [--force]%s     Cache every upstream template in one download\n\n", 
            COLOR_YELLOW, COLOR_RESET);
     
+    printf("%sDAEMON:%s\n", COLOR_BOLD, COLOR_RESET);
+    printf("  %sserve [--socket P] [--idle N]%s Keep templates and rules resident; other\n", 
+           COLOR_YELLOW, COLOR_RESET);
+    printf("                               invocations hand their command to it\n\n");
+    
     printf("%sEXAMPLES:%s\n", COLOR_BOLD, COLOR_RESET);
     printf("  %s# Create with auto template or empty%s\n", COLOR_CYAN, COLOR_RESET);
     printf("  gitignore init\n\n");
@@ -68,7 +91,8 @@ void show_help(void) {
     printf("  gitignore sync rust c cpp\n\n");
     
     printf("  %s# Auto-detect project type%s\n", COLOR_CYAN, COLOR_RESET);
-    printf("  gitignore auto\n\n");
+    printf("  gitignore auto\n");
+    printf("  gitignore auto --recursive  # Each subproject of a monorepo\n\n");
     
     printf("  %s# Interactive mode%s\n", COLOR_CYAN, COLOR_RESET);
     printf("  gitignore interactive\n");
@@ -91,10 +115,24 @@ void show_help(void) {
     printf("  %s# Append to existing .gitignore%s\n", COLOR_CYAN, COLOR_RESET);
     printf("  gitignore append python\n\n");
     
+    printf("  %s# Many repositories at once (one \"<path> <templates...>\" per line)%s\n", COLOR_CYAN, COLOR_RESET);
+    printf("  gitignore -j 8 batch repos.txt\n\n");
+    
+    printf("  %s# Test paths against the rules (-z: NUL-delimited, --explain: deciding line)%s\n", COLOR_CYAN, COLOR_RESET);
+    printf("  gitignore check build/out.o src/main.c\n");
+    printf("  git ls-files -z | gitignore check -z --explain\n");
+    printf("  find . | gitignore check --from .gitignore --from extra.ignore\n\n");
+    
+    printf("  %s# Find rules that no longer match anything in the working tree%s\n", COLOR_CYAN, COLOR_RESET);
+    printf("  gitignore audit\n");
+    printf("  gitignore --dry-run minimize   # Show redundant rules\n");
+    printf("  gitignore --minimal init python c cpp\n\n");
+    
     printf("  %s# List templates%s\n", COLOR_CYAN, COLOR_RESET);
     printf("  gitignore list\n");
     printf("  gitignore list --local\n");
-    printf("  gitignore list web          # Filter by keyword\n\n");
+    printf("  gitignore list web          # Filter by keyword\n");
+    printf("  gitignore list --stats      # Pattern counts of built-ins\n\n");
     
     printf("  %s# Show template content%s\n", COLOR_CYAN, COLOR_RESET);
     printf("  gitignore show python\n\n");
@@ -125,11 +163,18 @@ void show_help(void) {
            COLOR_MAGENTA, COLOR_RESET);
     printf("  Config file:       %s$HOME/.config/gitignore/config.conf%s\n", 
            COLOR_MAGENTA, COLOR_RESET);
-    printf("  Cache directory:   %s$HOME/.config/gitignore/cache/%s\n", 
+    printf("  Template cache:    %s$HOME/.config/gitignore/cache/templates.pack%s\n", 
            COLOR_MAGENTA, COLOR_RESET);
     printf("  Backup directory:  %s$HOME/.config/gitignore/backups/%s\n\n", 
            COLOR_MAGENTA, COLOR_RESET);
     
+    printf("%sEXIT STATUS:%s\n", COLOR_BOLD, COLOR_RESET);
+    printf("  0  Success\n");
+    printf("  1  Error (for check: no path is ignored)\n");
+    printf("  2  Usage error (check)\n");
+    printf("  %d  init, append, update, sync or batch found nothing to change;\n", EXIT_UNCHANGED);
+    printf("     .gitignore was neither written nor backed up\n\n");
+    
     printf("%sFEATURES:%s\n", COLOR_BOLD, COLOR_RESET);
     printf("  • Smart duplicate removal\n");
     printf("  • Multiple patterns support\n");
@@ -16,25 +16,19 @@ int init_gitignore(char **langs, int count, int dry_run) {
     // Check if .gitignore exists
     int gitignore_exists = file_exists(".gitignore");
     
-    // Auto backup if enabled and file exists
-    if (g_config && g_config->auto_backup && gitignore_exists) {
-        if (g_config->verbose) {
-            print_info("Auto-backup enabled, creating backup...");
-        }
-        backup_gitignore();
-    }
-    
     // If no languages specified, check for auto.gitignore
     if (langs == NULL || count == 0) {
-        char *auto_path = get_template_path(AUTO_TEMPLATE);
-        if (auto_path && file_exists(auto_path)) {
+        char auto_path[MAX_PATH_LEN];
+        if (template_path(AUTO_TEMPLATE, auto_path) == 0 && file_exists(auto_path)) {
             // Use auto.gitignore - append mode
             char *auto_langs[] = {"auto"};
-            free(auto_path);
-            return merge_templates(auto_langs, 1, ".gitignore", 
-                                 gitignore_exists ? MERGE_SMART : MERGE_REPLACE);
+            int result = merge_templates(auto_langs, 1, ".gitignore",
+                                         merge_default_strategy(gitignore_exists));
+            if (result == EXIT_UNCHANGED) {
+                print_info(".gitignore is already up to date");
+            }
+            return result;
         }
-        free(auto_path);
         
         // Create empty if file doesn't exist
         if (!gitignore_exists) {
@@ -42,7 +36,7 @@ int init_gitignore(char **langs, int count, int dry_run) {
         }
         
         print_info(".gitignore already exists (no changes)");
-        return 0;
+        return EXIT_UNCHANGED;
     }
     
     // Remove duplicates and filter comments
@@ -53,14 +47,16 @@ int init_gitignore(char **langs, int count, int dry_run) {
         if (!gitignore_exists) {
             return create_empty_gitignore();
         }
-        return 0;
+        return EXIT_UNCHANGED;
     }
     
     // FIXED: Always use SMART merge (append + dedup)
     int result = merge_templates(langs, count, ".gitignore", 
-                                gitignore_exists ? MERGE_SMART : MERGE_REPLACE);
+                                merge_default_strategy(gitignore_exists));
     
-    if (result == 0) {
+    if (result == EXIT_UNCHANGED) {
+        print_info(".gitignore is already up to date");
+    } else if (result == 0) {
         if (gitignore_exists) {
             print_success(".gitignore updated successfully");
         } else {
@@ -86,25 +82,20 @@ int append_gitignore(char **langs, int count, merge_strategy_t strategy, int dry
         print_info("[DRY RUN] Would append to .gitignore");
         printf("  Strategy: %s\n", 
                strategy == MERGE_APPEND ? "append" : 
-               strategy == MERGE_REPLACE ? "replace" : "smart");
+               strategy == MERGE_REPLACE ? "replace" :
+               strategy == MERGE_MINIMAL ? "minimal" : "smart");
         return 0;
     }
     
-    // Auto backup if enabled
-    if (g_config && g_config->auto_backup) {
-        if (g_config->verbose) {
-            print_info("Auto-backup enabled, creating backup...");
-        }
-        backup_gitignore();
-    }
-    
     // Remove duplicates
     langs = remove_duplicates(langs, &count);
     
     // FIXED: Default to SMART merge
-    int result = merge_templates(langs, count, ".gitignore", MERGE_SMART);
+    int result = merge_templates(langs, count, ".gitignore", merge_default_strategy(1));
     
-    if (result == 0) {
+    if (result == EXIT_UNCHANGED) {
+        print_info(".gitignore is already up to date");
+    } else if (result == 0) {
         print_success("Templates added to .gitignore");
     }
     
@@ -126,174 +117,386 @@ int create_empty_gitignore(void) {
     return 0;
 }
 
-int merge_templates(char **langs, int count, const char *output, merge_strategy_t strategy) {
-    // FIXED: Read existing patterns for deduplication
-    char **existing_patterns = NULL;
-    int existing_count = 0;
-    
-    if (strategy == MERGE_SMART && file_exists(output)) {
-        FILE *existing = fopen(output, "r");
-        if (existing) {
-            existing_patterns = malloc(sizeof(char*) * 10000);
-            char line[MAX_LINE_LEN];
-            
-            while (fgets(line, sizeof(line), existing)) {
-                // Skip comments and empty lines
-                if (!is_comment(line) && strlen(line) > 1) {
-                    // Trim newline and whitespace
-                    line[strcspn(line, "\n\r")] = 0;
-                    
-                    // Trim leading/trailing whitespace
-                    char *trimmed = line;
-                    while (*trimmed == ' ' || *trimmed == '\t') trimmed++;
-                    
-                    if (strlen(trimmed) > 0) {
-                        existing_patterns[existing_count++] = strdup(trimmed);
-                    }
-                }
-            }
-            fclose(existing);
+// Write a template body line by line. With a pattern set, patterns that
+// are already present (in the existing file or an earlier template) are
+// skipped and new ones are recorded; comments and blank lines always pass.
+void merge_template_content(out_buf_t *out, const char *content, size_t size, pattern_set_t *seen) {
+    const char *p = content;
+    const char *end = content + size;
+    
+    while (p < end) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        const char *line_end = nl ? nl : end;
+        size_t len = (size_t)(line_end - p);
+        
+        if (!seen || is_comment_span(p, len) || pattern_set_insert(seen, p, len) != 0) {
+            out_add_line(out, p, len, end);
+        }
+        
+        p = nl ? nl + 1 : end;
+    }
+}
+
+// Same as merge_template_content() for a built-in, using the line table
+// generated at build time: no splitting, trimming or hashing at runtime
+void merge_builtin_template(out_buf_t *out, const builtin_template_t *t, pattern_set_t *seen) {
+    for (int i = 0; i < t->line_count; i++) {
+        const builtin_line_t *line = &t->lines[i];
+        
+        if (!seen || (line->flags & BUILTIN_LINE_COMMENT) ||
+            pattern_set_insert_hashed(seen, t->content + line->norm_offset,
+                                      line->norm_len, line->hash) != 0) {
+            // Every built-in line is followed by its newline
+            out_add(out, t->content + line->offset, line->len + 1);
         }
     }
+}
+
+// MERGE_MINIMAL: drop merged rules that other rules already cover. Only
+// rules inside the merged sections (ranges holds their start and end
+// offsets in out, in order) may go; the rest of the file stays as it is.
+// The rebuilt buffer points into *flat, which the caller frees after commit.
+static error_code_t merge_minimize(out_buf_t *out, const size_t *ranges, int range_count, char **flat) {
+    *flat = out_flatten(out);
+    if (!*flat) return ERR_OUT_OF_MEMORY;
     
-    // Open output file
-    FILE *out = fopen(output, strategy == MERGE_REPLACE ? "w" : "a");
-    if (!out) {
-        print_error("Could not open output file", ERR_PERMISSION_DENIED);
+    const char *data = *flat;
+    const char *end = data + out->size;
+    
+    ignore_matcher_t matcher;
+    matcher_init(&matcher);
+    rule_cover_t *covers = NULL;
+    unsigned char *fixed = NULL;
+    error_code_t result = ERR_OUT_OF_MEMORY;
+    
+    if (matcher_add_buffer(&matcher, "merge", data, out->size) != 0) goto done;
+    covers = calloc((size_t)(matcher.count > 0 ? matcher.count : 1), sizeof(rule_cover_t));
+    fixed = calloc((size_t)(matcher.count > 0 ? matcher.count : 1), 1);
+    if (!covers || !fixed) goto done;
+    
+    int r = 0, k = 0, line = 1;
+    for (const char *p = data; p < end && r < matcher.count; line++) {
+        size_t offset = (size_t)(p - data);
+        while (k < range_count && ranges[2 * k + 1] <= offset) k++;
+        int merged = k < range_count && ranges[2 * k] <= offset;
         
-        // Free existing patterns
-        if (existing_patterns) {
-            for (int i = 0; i < existing_count; i++) {
-                free(existing_patterns[i]);
-            }
-            free(existing_patterns);
+        for (; r < matcher.count && matcher.rules[r].line <= line; r++) {
+            fixed[r] = !merged;
         }
-        return 1;
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        p = nl ? nl + 1 : end;
     }
     
-    // Add header only for new files
-    if (strategy == MERGE_REPLACE) {
-        fprintf(out, "# Generated by gitignore tool v%s\n", VERSION);
-        fprintf(out, "# https://github.com/yourusername/gitignore\n\n");
+    if (matcher_minimize(&matcher, fixed, covers) < 0) goto done;
+    
+    out_free(out);
+    
+    line = 0;
+    r = 0;
+    for (const char *p = data; p < end;) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        size_t len = nl ? (size_t)(nl - p) + 1 : (size_t)(end - p);
+        line++;
+        
+        while (r < matcher.count && matcher.rules[r].line < line) r++;
+        if (!(r < matcher.count && matcher.rules[r].line == line && covers[r].by >= 0)) {
+            out_add(out, p, len);
+        }
+        p += len;
+    }
+    result = ERR_SUCCESS;
+    
+done:
+    free(fixed);
+    free(covers);
+    matcher_free(&matcher);
+    return result;
+}
+
+// What merge_section() needs to write one template's section
+typedef struct {
+    const resolved_template_t *templates;
+    const uint64_t *hashes;
+    pattern_set_t *dedup;
+    pattern_set_t *seen;
+    size_t *ranges;             // where each section landed, for MERGE_MINIMAL
+    int range_count;
+} merge_ctx_t;
+
+static int merge_section(out_buf_t *out, int slot, void *ctx) {
+    merge_ctx_t *mc = ctx;
+    const resolved_template_t *t = &mc->templates[slot];
+    
+    mc->ranges[2 * mc->range_count] = out->size;
+    section_begin(out, t->name);
+    if (t->builtin) {
+        merge_builtin_template(out, t->builtin, mc->dedup);
     } else {
-        // Add separator for appended content
-        fprintf(out, "\n# Added by gitignore tool\n");
+        merge_template_content(out, t->data, t->size, mc->dedup);
+    }
+    section_end(out, t->name, mc->hashes[slot]);
+    mc->ranges[2 * mc->range_count + 1] = out->size;
+    mc->range_count++;
+    
+    // APPEND writes templates verbatim; their patterns still count when
+    // deciding what an old section being replaced would lose
+    if (!mc->dedup) {
+        if (t->builtin) return pattern_set_add_lines(mc->seen, t->builtin->content, t->builtin->size);
+        return pattern_set_add_lines(mc->seen, t->data, t->size);
+    }
+    return 0;
+}
+
+// Merge already-resolved template bodies into output. Does no lookups and
+// prints nothing, so it is safe to run from several threads at once on
+// different outputs. Templates with neither a body nor a built-in are
+// skipped.
+//
+// A template the output already has a section for is merged in place of
+// that section, and not at all when the section was made from the same
+// template body. An output that would come out byte-identical is not
+// rewritten (nor before_write called) and ERR_UNCHANGED is returned.
+error_code_t merge_resolved(const resolved_template_t *templates, int count,
+                            const char *output, merge_strategy_t strategy, merge_write_fn before_write) {
+    // Every table this merge builds lives in one arena, released at the
+    // end; batch workers each run their own merge, so it is per call
+    arena_t arena;
+    arena_init(&arena);
+    
+    // Patterns already in the output plus everything merged so far. SMART
+    // and REPLACE both dedup across templates; APPEND writes them verbatim.
+    pattern_set_t seen;
+    pattern_set_init_arena(&seen, &arena);
+    pattern_set_t *dedup = strategy == MERGE_APPEND ? NULL : &seen;
+    
+    // The file is rewritten whole, so it must be read back completely. The
+    // view maps large files; the merge references their bytes in place.
+    // REPLACE only reads it to tell whether the result differs.
+    file_view_t view;
+    file_view_init(&view);
+    int have_view = 0;
+    
+    if (file_exists(output)) {
+        int span = timing_begin("read");
+        timing_note(span, "%s", output);
+        have_view = file_view_open(&view, output) == 0;
+        timing_end(span);
+        if (!have_view && strategy != MERGE_REPLACE) {
+            arena_free(&arena);
+            return ERR_FILE_NOT_FOUND;
+        }
+    }
+    int have_existing = have_view && strategy != MERGE_REPLACE;
+    const char *existing = have_existing ? view.data : "";
+    size_t existing_size = have_existing ? view.size : 0;
+    
+    uint64_t *hashes = arena_calloc(&arena, (size_t)count + 1, sizeof(uint64_t));
+    int *placed = arena_calloc(&arena, (size_t)count + 1, sizeof(int));
+    size_t *ranges = arena_calloc(&arena, 2 * (size_t)count + 2, sizeof(size_t));
+    section_index_t index = { existing, existing_size, NULL, 0 };
+    
+    if (!hashes || !placed || !ranges ||
+        (have_existing && section_index_build(&index, &arena, existing, existing_size) != 0)) {
+        file_view_close(&view);
+        arena_free(&arena);
+        return ERR_OUT_OF_MEMORY;
     }
     
+    // Match templates to the sections the output already has
+    int span = timing_begin("sections");
+    int appended = 0;
     for (int i = 0; i < count; i++) {
-        const char *template_content = NULL;
-        char *custom_path = NULL;
-        FILE *tmpl = NULL;
+        const resolved_template_t *t = &templates[i];
+        if (t->builtin) hashes[i] = hash_bytes(t->builtin->content, t->builtin->size);
+        else if (t->data) hashes[i] = hash_bytes(t->data, t->size);
+        else continue;
         
-        // Priority 1: Check custom template
-        custom_path = get_template_path(langs[i]);
-        if (custom_path && file_exists(custom_path)) {
-            tmpl = fopen(custom_path, "r");
-            if (g_config && g_config->verbose) {
-                printf("  Using custom template: %s\n", langs[i]);
-            }
+        int section = have_existing ? section_claim(&index, t->name, i) : -1;
+        if (section < 0) {
+            appended++;
+            continue;
+        }
+        placed[i] = 1;
+        if (section_current(&index, section, hashes[i])) section_keep(&index, section, NULL);
+    }
+    timing_note(span, "%d section(s), %d new", index.count, appended);
+    timing_end(span);
+    
+    if (have_existing && appended == 0 && !section_dirty(&index)) {
+        file_view_close(&view);
+        arena_free(&arena);
+        return ERR_UNCHANGED;
+    }
+    
+    // One table sized for every line that can reach it, so a large merge
+    // never rehashes
+    span = timing_begin("dedup");
+    size_t lines = count_lines(existing, existing_size);
+    for (int i = 0; i < count; i++) {
+        if (templates[i].builtin) lines += (size_t)templates[i].builtin->line_count;
+        else if (templates[i].data) lines += count_lines(templates[i].data, templates[i].size);
+    }
+    timing_note(span, "room for %zu line(s)", lines);
+    if (pattern_set_reserve(&seen, lines) != 0 ||
+        (have_existing && section_seed(&index, &seen) != 0)) {
+        timing_end(span);
+        file_view_close(&view);
+        arena_free(&arena);
+        return ERR_OUT_OF_MEMORY;
+    }
+    timing_end(span);
+    
+    // The new file is assembled in memory and replaces the old one at once
+    span = timing_begin("merge");
+    timing_note(span, "%d template(s)", count);
+    out_buf_t out;
+    out_init_arena(&out, &arena);
+    merge_ctx_t ctx = { templates, hashes, dedup, &seen, ranges, 0 };
+    error_code_t result = ERR_SUCCESS;
+    
+    // Add header only for new files
+    if (strategy == MERGE_REPLACE || (strategy == MERGE_MINIMAL && !have_existing)) {
+        out_printf(&out, "# Generated by gitignore tool v%s\n", VERSION);
+        out_printf(&out, "# https://github.com/yourusername/gitignore\n\n");
+    } else if (section_rewrite(&index, &out, &seen, merge_section, &ctx) != 0) {
+        result = ERR_OUT_OF_MEMORY;
+    } else if (appended > 0) {
+        // Sections for templates the file did not have go at the end
+        out_printf(&out, "\n# Added by gitignore tool\n");
+    }
+    
+    for (int i = 0; i < count && result == ERR_SUCCESS; i++) {
+        const resolved_template_t *t = &templates[i];
+        if ((!t->data && !t->builtin) || placed[i]) continue;
+        if (merge_section(&out, i, &ctx) != 0) result = ERR_OUT_OF_MEMORY;
+    }
+    
+    char *flat = NULL;
+    if (result == ERR_SUCCESS && strategy == MERGE_MINIMAL) {
+        result = merge_minimize(&out, ranges, ctx.range_count, &flat);
+    }
+    timing_end(span);
+    
+    if (result == ERR_SUCCESS && have_view && out_equals(&out, view.data, view.size)) {
+        result = ERR_UNCHANGED;
+    }
+    if (result == ERR_SUCCESS && have_view && before_write) {
+        before_write(output);
+    }
+    if (result == ERR_SUCCESS && out_commit(&out, output) != 0) {
+        result = ERR_PERMISSION_DENIED;
+    }
+    
+    out_free(&out);
+    pattern_set_free(&seen);
+    arena_free(&arena);
+    file_view_close(&view);
+    free(flat);
+    
+    return result;
+}
+
+// Strategy for merging templates into an output that may already exist
+merge_strategy_t merge_default_strategy(int exists) {
+    if (g_config && g_config->minimal_merge) return MERGE_MINIMAL;
+    return exists ? MERGE_SMART : MERGE_REPLACE;
+}
+
+// Back up .gitignore when auto_backup is on, once a merge is about to
+// change it
+static void merge_auto_backup(const char *output) {
+    if (!g_config || !g_config->auto_backup || strcmp(output, ".gitignore") != 0) return;
+    
+    if (g_config->verbose) {
+        print_info("Auto-backup enabled, creating backup...");
+    }
+    backup_gitignore();
+}
+
+// Returns 0 once output is written, EXIT_UNCHANGED if it already had the
+// merged content, 1 on failure
+int merge_templates(char **langs, int count, const char *output, merge_strategy_t strategy) {
+    arena_t arena;
+    arena_init(&arena);
+    resolved_template_t *templates = arena_calloc(&arena, (size_t)count + 1, sizeof(resolved_template_t));
+    // Custom template bodies are referenced by the merge until the end
+    file_view_t *custom_bodies = arena_calloc(&arena, (size_t)count + 1, sizeof(file_view_t));
+    if (!templates || !custom_bodies) {
+        print_error("Out of memory", ERR_OUT_OF_MEMORY);
+        arena_free(&arena);
+        return 1;
+    }
+    
+    int span = timing_begin("resolve");
+    int found = 0;
+    for (int i = 0; i < count; i++) {
+        resolved_template_t *t = &templates[i];
+        t->name = langs[i];
+        
+        // Priority 1: Check custom template (held by gitignore serve, or read now)
+        char custom_path[MAX_PATH_LEN];
+        int have_path = template_path(langs[i], custom_path) == 0;
+        const char *resident = have_path ? serve_file(custom_path, &t->size) : NULL;
+        if (resident) {
+            t->data = resident;
+        } else if (have_path && file_view_open(&custom_bodies[i], custom_path) == 0) {
+            t->data = custom_bodies[i].data;
+            t->size = custom_bodies[i].size;
+        }
+        if (t->data && g_config && g_config->verbose) {
+            printf("  Using custom template: %s\n", langs[i]);
         }
         
         // Priority 2: Check built-in template
-        if (!tmpl) {
-            template_content = get_builtin_template(langs[i]);
-            if (template_content && g_config && g_config->verbose) {
+        if (!t->data) {
+            t->builtin = find_builtin_template(langs[i]);
+            if (t->builtin && g_config && g_config->verbose) {
                 printf("  Using built-in template: %s\n", langs[i]);
             }
         }
         
-        if (tmpl || template_content) {
-            fprintf(out, "\n# ===== %s =====\n", langs[i]);
-            
-            if (tmpl) {
-                // Read from custom file
-                char line[MAX_LINE_LEN];
-                while (fgets(line, sizeof(line), tmpl)) {
-                    // Check for duplicates in SMART mode
-                    if (strategy == MERGE_SMART && !is_comment(line)) {
-                        char clean_line[MAX_LINE_LEN];
-                        strncpy(clean_line, line, sizeof(clean_line));
-                        clean_line[strcspn(clean_line, "\n\r")] = 0;
-                        
-                        // Trim whitespace
-                        char *trimmed = clean_line;
-                        while (*trimmed == ' ' || *trimmed == '\t') trimmed++;
-                        
-                        // Check if already exists
-                        int is_duplicate = 0;
-                        for (int j = 0; j < existing_count; j++) {
-                            if (strcmp(trimmed, existing_patterns[j]) == 0) {
-                                is_duplicate = 1;
-                                break;
-                            }
-                        }
-                        
-                        if (is_duplicate) continue;
-                    }
-                    
-                    fputs(line, out);
-                }
-                fclose(tmpl);
-            } else {
-                // Write built-in content
-                const char *line_start = template_content;
-                const char *line_end;
-                
-                while (*line_start) {
-                    line_end = strchr(line_start, '\n');
-                    if (!line_end) line_end = line_start + strlen(line_start);
-                    
-                    int line_len = line_end - line_start;
-                    char line[MAX_LINE_LEN];
-                    strncpy(line, line_start, line_len);
-                    line[line_len] = '\0';
-                    
-                    // Check for duplicates in SMART mode
-                    if (strategy == MERGE_SMART && line_len > 0 && line[0] != '#') {
-                        // Trim whitespace
-                        char *trimmed = line;
-                        while (*trimmed == ' ' || *trimmed == '\t') trimmed++;
-                        
-                        // Check if already exists
-                        int is_duplicate = 0;
-                        for (int j = 0; j < existing_count; j++) {
-                            if (strcmp(trimmed, existing_patterns[j]) == 0) {
-                                is_duplicate = 1;
-                                break;
-                            }
-                        }
-                        
-                        if (!is_duplicate) {
-                            fprintf(out, "%s\n", line);
-                        }
-                    } else {
-                        fprintf(out, "%s\n", line);
-                    }
-                    
-                    line_start = *line_end ? line_end + 1 : line_end;
-                }
-            }
-            
-            if (g_config && g_config->verbose) {
-                printf("  %s+%s %s\n", COLOR_GREEN, COLOR_RESET, langs[i]);
-            }
-        } else {
+        if (!t->data && !t->builtin) {
             print_warning("Template not found, skipping");
             printf("  %s\n", langs[i]);
+        } else {
+            found++;
         }
-        
-        if (custom_path) free(custom_path);
     }
+    timing_end(span);
     
-    fclose(out);
+    // Nothing to merge is an error, not an up-to-date file
+    if (found == 0) {
+        print_error("None of the requested templates were found", ERR_INVALID_TEMPLATE);
+        for (int i = 0; i < count; i++) {
+            file_view_close(&custom_bodies[i]);
+        }
+        arena_free(&arena);
+        return 1;
+    }
     
-    // Free existing patterns
-    if (existing_patterns) {
-        for (int i = 0; i < existing_count; i++) {
-            free(existing_patterns[i]);
+    error_code_t rc = merge_resolved(templates, count, output, strategy, merge_auto_backup);
+    
+    if (rc == ERR_SUCCESS && g_config && g_config->verbose) {
+        for (int i = 0; i < count; i++) {
+            if (templates[i].data || templates[i].builtin) {
+                printf("  %s+%s %s\n", COLOR_GREEN, COLOR_RESET, langs[i]);
+            }
         }
-        free(existing_patterns);
     }
     
-    return 0;
-}
\ No newline at end of file
+    if (rc == ERR_FILE_NOT_FOUND) {
+        print_error("Could not read output file", rc);
+    } else if (rc == ERR_OUT_OF_MEMORY) {
+        print_error("Out of memory", rc);
+    } else if (rc != ERR_SUCCESS && rc != ERR_UNCHANGED) {
+        print_error("Could not write output file", rc);
+    }
+    
+    for (int i = 0; i < count; i++) {
+        file_view_close(&custom_bodies[i]);
+    }
+    arena_free(&arena);
+    
+    if (rc == ERR_UNCHANGED) return EXIT_UNCHANGED;
+    return rc == ERR_SUCCESS ? 0 : 1;
+}
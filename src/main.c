@@ -1,24 +1,52 @@
 // main.c - Enhanced main with FIXED pattern handling
 #include "gitignore.h"
+#include <limits.h>
 
 config_t *g_config = NULL;
 
 int main(int argc, char *argv[]) {
-    // Load configuration
-    g_config = load_config();
-    apply_config(g_config);
+    // A running gitignore serve daemon takes the command if there is one
+    int status;
+    if (argc > 1 && strcmp(argv[1], "serve") != 0 && serve_forward(argc, argv, &status) == 0) {
+        return status;
+    }
     
-    if (argc == 1) {
+    // Help needs neither the config file nor anything under $HOME
+    if (argc == 1 || strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0) {
         show_help();
-        free_config(g_config);
         return 0;
     }
+    
+    // Load configuration; paths and directories are resolved on first use
+    int span = timing_begin("config");
+    g_config = load_config();
+    timing_end(span);
+    span = timing_begin("setup");
+    apply_config(g_config);
+    timing_end(span);
 
+    span = timing_begin("run");
     int result = parse_flags(argc, argv);
+    timing_end(span);
+    
+    if (g_config && g_config->timings) {
+        timing_report(stderr, g_config->timings == TIMINGS_JSON);
+    }
+    
+    fetch_cleanup();
+    pack_close();
+    source_close();
     free_config(g_config);
     return result;
 }
 
+// --jobs takes a whole number of at least 1; returns -1 otherwise
+static int parse_jobs(const char *s) {
+    char *end;
+    long n = strtol(s, &end, 10);
+    return *s && *end == '\0' && n >= 1 && n <= INT_MAX ? (int)n : -1;
+}
+
 int parse_flags(int argc, char *argv[]) {
     const char *flag = argv[1];
     int dry_run = 0;
@@ -48,6 +76,51 @@ int parse_flags(int argc, char *argv[]) {
             }
             argc--;
             i--;
+        } else if (strcmp(argv[i], "--fsync") == 0) {
+            g_config->fsync_writes = 1;
+            for (int j = i; j < argc - 1; j++) {
+                argv[j] = argv[j + 1];
+            }
+            argc--;
+            i--;
+        } else if (strcmp(argv[i], "--minimal") == 0) {
+            g_config->minimal_merge = 1;
+            strategy = MERGE_MINIMAL;
+            for (int j = i; j < argc - 1; j++) {
+                argv[j] = argv[j + 1];
+            }
+            argc--;
+            i--;
+        } else if (strcmp(argv[i], "--timings") == 0 || strcmp(argv[i], "--timings=table") == 0 ||
+                   strcmp(argv[i], "--timings=json") == 0) {
+            g_config->timings = strcmp(argv[i], "--timings=json") == 0 ? TIMINGS_JSON : TIMINGS_TABLE;
+            for (int j = i; j < argc - 1; j++) {
+                argv[j] = argv[j + 1];
+            }
+            argc--;
+            i--;
+        } else if (strncmp(argv[i], "--jobs=", 7) == 0) {
+            g_config->max_parallel = parse_jobs(argv[i] + 7);
+            if (g_config->max_parallel < 1) {
+                print_error("--jobs requires a number of at least 1", ERR_INVALID_ARGUMENT);
+                return 1;
+            }
+            for (int j = i; j < argc - 1; j++) {
+                argv[j] = argv[j + 1];
+            }
+            argc--;
+            i--;
+        } else if ((strcmp(argv[i], "--jobs") == 0 || strcmp(argv[i], "-j") == 0) && i + 1 < argc) {
+            g_config->max_parallel = parse_jobs(argv[i + 1]);
+            if (g_config->max_parallel < 1) {
+                print_error("--jobs requires a number of at least 1", ERR_INVALID_ARGUMENT);
+                return 1;
+            }
+            for (int j = i; j < argc - 2; j++) {
+                argv[j] = argv[j + 2];
+            }
+            argc -= 2;
+            i--;
         }
     }
     
@@ -72,12 +145,13 @@ int parse_flags(int argc, char *argv[]) {
     
     // List templates
     if (strcmp(flag, "list") == 0 || strcmp(flag, "--list") == 0 || strcmp(flag, "-l") == 0) {
-        int show_local = 0, show_builtin = 0;
+        int show_local = 0, show_builtin = 0, show_stats = 0;
         const char *filter = NULL;
         
         for (int i = 2; i < argc; i++) {
             if (strcmp(argv[i], "--local") == 0) show_local = 1;
             else if (strcmp(argv[i], "--builtin") == 0) show_builtin = 1;
+            else if (strcmp(argv[i], "--stats") == 0) show_stats = 1;
             else filter = argv[i];
         }
         
@@ -85,7 +159,7 @@ int parse_flags(int argc, char *argv[]) {
             show_local = show_builtin = 1;
         }
         
-        return list_templates(filter, show_local, show_builtin);
+        return list_templates(filter, show_local, show_builtin, show_stats);
     }
     
     // Show template
@@ -99,6 +173,9 @@ int parse_flags(int argc, char *argv[]) {
     
     // Auto-detect
     if (strcmp(flag, "auto") == 0 || strcmp(flag, "--auto") == 0) {
+        if (argc > 2 && (strcmp(argv[2], "--recursive") == 0 || strcmp(argv[2], "-r") == 0)) {
+            return auto_detect_recursive(dry_run);
+        }
         return auto_detect(dry_run);
     }
     
@@ -143,15 +220,37 @@ int parse_flags(int argc, char *argv[]) {
     // Cache commands
     if (strcmp(flag, "cache") == 0) {
         if (argc < 3) {
-            print_error("cache requires a subcommand (clear)", ERR_INVALID_ARGUMENT);
+            print_error("cache requires a subcommand (clear/compact/prefetch)", ERR_INVALID_ARGUMENT);
             return 1;
         }
         
         if (strcmp(argv[2], "clear") == 0) {
             return clear_cache();
+        } else if (strcmp(argv[2], "compact") == 0) {
+            return compact_cache();
+        } else if (strcmp(argv[2], "prefetch") == 0) {
+            int force = argc > 3 && strcmp(argv[3], "--force") == 0;
+            return prefetch_cache(force);
         }
     }
     
+    // Resident daemon for editors and hooks
+    if (strcmp(flag, "serve") == 0) {
+        const char *socket_path = NULL;
+        int idle = 0;
+        for (int i = 2; i < argc; i++) {
+            if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+                socket_path = argv[++i];
+            } else if (strcmp(argv[i], "--idle") == 0 && i + 1 < argc) {
+                idle = atoi(argv[++i]);
+            } else {
+                print_error("usage: gitignore serve [--socket PATH] [--idle SECONDS]", ERR_INVALID_ARGUMENT);
+                return 1;
+            }
+        }
+        return serve_daemon(socket_path, idle);
+    }
+    
     // FIXED: --add flag now only for conflicting names
     if (strcmp(flag, "-a") == 0 || strcmp(flag, "--add") == 0) {
         if (argc < 3) {
@@ -178,10 +277,63 @@ int parse_flags(int argc, char *argv[]) {
             return 1;
         }
         
-        strategy = strcmp(flag, "append") == 0 ? MERGE_APPEND : MERGE_SMART;
+        if (strategy != MERGE_MINIMAL) {
+            strategy = strcmp(flag, "append") == 0 ? MERGE_APPEND : MERGE_SMART;
+        }
         return append_gitignore(&argv[2], argc - 2, strategy, dry_run);
     }
     
+    // Apply templates to every repository listed in a manifest
+    if (strcmp(flag, "batch") == 0) {
+        if (argc != 3) {
+            print_error("batch requires a manifest file", ERR_INVALID_ARGUMENT);
+            return 1;
+        }
+        return batch_apply(argv[2], dry_run);
+    }
+    
+    // Drop rules other rules already cover
+    if (strcmp(flag, "minimize") == 0) {
+        return minimize_gitignore(argc > 2 ? argv[2] : ".gitignore", dry_run);
+    }
+    
+    // Report what each rule of a .gitignore matches in the working tree
+    if (strcmp(flag, "audit") == 0) {
+        return audit_gitignore(argc > 2 ? argv[2] : ".gitignore");
+    }
+    
+    // Match paths against ignore rules
+    if (strcmp(flag, "check") == 0) {
+        int nul = 0, explain = 0, path_count = 0, source_count = 0, options = 1;
+        char **paths = &argv[2];
+        char *sources[16];
+        
+        for (int i = 2; i < argc; i++) {
+            if (options && strcmp(argv[i], "--") == 0) {
+                options = 0;
+            } else if (options && strcmp(argv[i], "-z") == 0) {
+                nul = 1;
+            } else if (options && (strcmp(argv[i], "--explain") == 0 || strcmp(argv[i], "-v") == 0)) {
+                explain = 1;
+            } else if (options && strcmp(argv[i], "--stdin") == 0) {
+                // Reading stdin is the default when no paths are given
+            } else if (options && (strcmp(argv[i], "--from") == 0 || strcmp(argv[i], "-f") == 0)) {
+                if (i + 1 >= argc) {
+                    print_error("--from requires an ignore file", ERR_INVALID_ARGUMENT);
+                    return 2;
+                }
+                if (source_count == (int)(sizeof(sources) / sizeof(sources[0]))) {
+                    print_error("Too many ignore files", ERR_INVALID_ARGUMENT);
+                    return 2;
+                }
+                sources[source_count++] = argv[++i];
+            } else {
+                paths[path_count++] = argv[i];
+            }
+        }
+        return check_paths(paths, path_count, sources, source_count, nul, explain);
+    }
+    
     // Sync flag
     if (strcmp(flag, "sync") == 0 || strcmp(flag, "--sync") == 0 || strcmp(flag, "-s") == 0) {
         if (argc == 2) {
@@ -210,7 +362,7 @@ int is_command_name(const char *name) {
     const char *commands[] = {
         "init", "sync", "list", "show", "cat", "auto", "interactive",
         "append", "update", "global", "backup", "restore", "backups",
-        "history", "cache", NULL
+        "history", "cache", "batch", "check", "audit", "minimize", "serve", NULL
     };
     
     for (int i = 0; commands[i] != NULL; i++) {
@@ -0,0 +1,564 @@
+// matcher.c - Compile .gitignore rules and match paths against them
+//
+// Rules follow git's semantics: the last matching rule wins, "!" re-includes,
+// a trailing "/" restricts a rule to directories, and a rule containing a
+// slash is anchored to the directory of its .gitignore while one without
+// matches the basename at any depth. Nothing inside an excluded directory
+// can be re-included, so every leading directory of a path is checked first.
+//
+// Most real rules need no wildcard matching, so rules are bucketed when
+// compiled: literal names and anchored literal paths go into hash tables,
+// "*.ext" suffixes into a table keyed by extension, and only the rest are
+// run through the wildcard matcher. A lookup walks the buckets and keeps
+// the highest rule index that matches; wildcard rules are tried newest
+// first and only while they could still beat the best rule found so far.
+#include "gitignore.h"
+#include <ctype.h>
+
+#define RULE_TABLE_MIN_CAPACITY 64
+
+#define WILD_NOMATCH            0
+#define WILD_MATCH              1
+#define WILD_ABORT_ALL          (-1)
+#define WILD_ABORT_TO_STARSTAR  (-2)
+
+typedef struct {
+    const char *path;       // NUL-terminated at len while it is queried
+    size_t len;
+    size_t base;            // offset of the basename
+    int is_dir;             // 1, 0, or -1 until looked up
+} match_query_t;
+
+void matcher_init(ignore_matcher_t *m) {
+    memset(m, 0, sizeof(*m));
+}
+
+void matcher_free(ignore_matcher_t *m) {
+    for (int i = 0; i < m->count; i++) {
+        free(m->rules[i].pattern);
+    }
+    for (int i = 0; i < m->source_count; i++) {
+        free(m->sources[i]);
+    }
+    for (int i = 0; i < m->buffer_count; i++) {
+        free(m->buffers[i]);
+    }
+    free(m->rules);
+    free(m->names.slots);
+    free(m->paths.slots);
+    free(m->exts.slots);
+    free(m->globs);
+    free(m->sources);
+    free(m->buffers);
+    matcher_init(m);
+}
+
+// Wildcard matching with git's pathname rules: "*", "?" and classes never
+// match "/", and "**" spans directories when it makes up a whole path
+// component. The abort codes cut the backtracking short once no later
+// starting point can succeed.
+static int wild_class(const char **pp, unsigned char t) {
+    const char *p = *pp;
+    int negated = 0, matched = 0;
+    unsigned char prev = 0;
+
+    if (*p == '!' || *p == '^') {
+        negated = 1;
+        p++;
+    }
+
+    unsigned char c = (unsigned char)*p;
+    do {
+        if (c == '\0') return WILD_ABORT_ALL;
+
+        if (c == '\\') {
+            c = (unsigned char)*++p;
+            if (c == '\0') return WILD_ABORT_ALL;
+            if (t == c) matched = 1;
+        } else if (c == '-' && prev && p[1] && p[1] != ']') {
+            c = (unsigned char)*++p;
+            if (c == '\\') {
+                c = (unsigned char)*++p;
+                if (c == '\0') return WILD_ABORT_ALL;
+            }
+            if (t >= prev && t <= c) matched = 1;
+            c = 0;
+        } else if (c == '[' && p[1] == ':') {
+            const char *name = p + 2;
+            const char *end = name;
+            while (*end && *end != ']') end++;
+            if (*end == '\0') return WILD_ABORT_ALL;
+
+            if (end - name < 1 || end[-1] != ':') {
+                // No ":]", so the "[" is an ordinary member
+                if (t == '[') matched = 1;
+            } else {
+                size_t n = (size_t)(end - name - 1);
+                int in;
+                if (n == 5 && strncmp(name, "alnum", 5) == 0) in = isalnum(t);
+                else if (n == 5 && strncmp(name, "alpha", 5) == 0) in = isalpha(t);
+                else if (n == 5 && strncmp(name, "blank", 5) == 0) in = t == ' ' || t == '\t';
+                else if (n == 5 && strncmp(name, "cntrl", 5) == 0) in = iscntrl(t);
+                else if (n == 5 && strncmp(name, "digit", 5) == 0) in = isdigit(t);
+                else if (n == 5 && strncmp(name, "graph", 5) == 0) in = isgraph(t);
+                else if (n == 5 && strncmp(name, "lower", 5) == 0) in = islower(t);
+                else if (n == 5 && strncmp(name, "print", 5) == 0) in = isprint(t);
+                else if (n == 5 && strncmp(name, "punct", 5) == 0) in = ispunct(t);
+                else if (n == 5 && strncmp(name, "space", 5) == 0) in = isspace(t);
+                else if (n == 5 && strncmp(name, "upper", 5) == 0) in = isupper(t);
+                else if (n == 6 && strncmp(name, "xdigit", 6) == 0) in = isxdigit(t);
+                else return WILD_ABORT_ALL;
+
+                if (in) matched = 1;
+                p = end;
+                c = 0;
+            }
+        } else if (t == c) {
+            matched = 1;
+        }
+        prev = c;
+        c = (unsigned char)*++p;
+    } while (c != ']');
+
+    *pp = p;
+    return matched != negated && t != '/' ? WILD_MATCH : WILD_NOMATCH;
+}
+
+static int wild_match(const char *start, const char *p, const char *text) {
+    for (; *p; p++, text++) {
+        unsigned char t = (unsigned char)*text;
+        unsigned char c = (unsigned char)*p;
+
+        if (t == '\0' && c != '*') return WILD_ABORT_ALL;
+
+        switch (c) {
+        case '\\':
+            c = (unsigned char)*++p;
+            if (c == '\0' || t != c) return WILD_NOMATCH;
+            break;
+
+        case '?':
+            if (t == '/') return WILD_NOMATCH;
+            break;
+
+        case '[': {
+            p++;
+            int r = wild_class(&p, t);
+            if (r != WILD_MATCH) return r;
+            break;
+        }
+
+        case '*': {
+            int match_slash = 0;
+            const char *star = p;
+            while (p[1] == '*') p++;
+
+            if (p > star) {
+                // "**" only spans directories as a whole component
+                if ((star == start || star[-1] == '/') && (p[1] == '\0' || p[1] == '/')) {
+                    if (p[1] == '/' && wild_match(start, p + 2, text) == WILD_MATCH) return WILD_MATCH;
+                    match_slash = 1;
+                }
+            }
+            p++;
+
+            if (*p == '\0') {
+                if (!match_slash && strchr(text, '/')) return WILD_ABORT_TO_STARSTAR;
+                return WILD_MATCH;
+            }
+            if (!match_slash && *p == '/') {
+                // A single "*" runs up to the next slash and no further
+                const char *slash = strchr(text, '/');
+                if (!slash) return WILD_ABORT_ALL;
+                text = slash;
+                break;
+            }
+
+            unsigned char lit = (unsigned char)*p;
+            int literal = lit != '*' && lit != '?' && lit != '[' && lit != '\\';
+            for (; *text; text++) {
+                if (!literal || (unsigned char)*text == lit) {
+                    int r = wild_match(start, p, text);
+                    if (r != WILD_NOMATCH) {
+                        if (!match_slash || r != WILD_ABORT_TO_STARSTAR) return r;
+                    } else if (!match_slash && *text == '/') {
+                        return WILD_ABORT_TO_STARSTAR;
+                    }
+                } else if (!match_slash && *text == '/') {
+                    return WILD_ABORT_TO_STARSTAR;
+                }
+            }
+            return WILD_ABORT_ALL;
+        }
+
+        default:
+            if (t != c) return WILD_NOMATCH;
+            break;
+        }
+    }
+
+    return *text == '\0' ? WILD_MATCH : WILD_NOMATCH;
+}
+
+static int rule_table_grow(rule_table_t *t) {
+    size_t capacity = t->capacity ? t->capacity * 2 : RULE_TABLE_MIN_CAPACITY;
+    rule_slot_t *slots = calloc(capacity, sizeof(rule_slot_t));
+    if (!slots) return 1;
+
+    size_t mask = capacity - 1;
+    for (size_t i = 0; i < t->capacity; i++) {
+        const rule_slot_t *s = &t->slots[i];
+        if (!s->key) continue;
+
+        size_t j = (size_t)s->hash & mask;
+        while (slots[j].key) j = (j + 1) & mask;
+        slots[j] = *s;
+    }
+
+    free(t->slots);
+    t->slots = slots;
+    t->capacity = capacity;
+    return 0;
+}
+
+static rule_slot_t* rule_table_probe(const rule_table_t *t, const char *key, size_t len, uint64_t hash) {
+    size_t mask = t->capacity - 1;
+    size_t i = (size_t)hash & mask;
+
+    for (;;) {
+        rule_slot_t *s = &t->slots[i];
+        if (!s->key) return s;
+        if (s->hash == hash && s->len == len && memcmp(s->key, key, len) == 0) return s;
+        i = (i + 1) & mask;
+    }
+}
+
+// Latest rule filed under key, or -1; older ones follow through rule.next
+static int rule_table_find(const rule_table_t *t, const char *key, size_t len) {
+    if (t->count == 0) return -1;
+    const rule_slot_t *s = rule_table_probe(t, key, len, hash_bytes(key, len));
+    return s->key ? s->head : -1;
+}
+
+static int rule_table_add(ignore_matcher_t *m, rule_table_t *t, int rule, const char *key, size_t len) {
+    if ((t->count + 1) * 10 > t->capacity * 7 && rule_table_grow(t) != 0) return 1;
+
+    uint64_t hash = hash_bytes(key, len);
+    rule_slot_t *s = rule_table_probe(t, key, len, hash);
+    if (s->key) {
+        m->rules[rule].next = s->head;
+    } else {
+        s->hash = hash;
+        s->key = key;
+        s->len = (uint32_t)len;
+        t->count++;
+    }
+    s->head = rule;
+    return 0;
+}
+
+static int has_wildcard(const char *p, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (p[i] == '*' || p[i] == '?' || p[i] == '[' || p[i] == '\\') return 1;
+    }
+    return 0;
+}
+
+// Compile one line; blanks and comments add nothing
+static int matcher_add_line(ignore_matcher_t *m, int source, int line_no, const char *line, size_t len) {
+    if (len > 0 && line[len - 1] == '\r') len--;
+
+    // Trailing spaces are dropped unless escaped
+    while (len > 0 && line[len - 1] == ' ') {
+        if (len > 1 && line[len - 2] == '\\') break;
+        len--;
+    }
+    if (len == 0 || line[0] == '#') return 0;
+
+    const char *text = line;
+    size_t text_len = len;
+    uint32_t flags = 0;
+
+    if (line[0] == '!') {
+        flags |= RULE_NEGATE;
+        line++;
+        len--;
+    }
+    if (len > 0 && line[len - 1] == '/') {
+        flags |= RULE_DIR_ONLY;
+        len--;
+    }
+    if (memchr(line, '/', len)) {
+        flags |= RULE_ANCHORED;
+        if (line[0] == '/') {
+            line++;
+            len--;
+        }
+    }
+    if (len == 0) return 0;
+
+    if (m->count == m->cap) {
+        int cap = m->cap ? m->cap * 2 : 64;
+        ignore_rule_t *rules = realloc(m->rules, (size_t)cap * sizeof(ignore_rule_t));
+        if (!rules) return 1;
+        m->rules = rules;
+        m->cap = cap;
+    }
+
+    int index = m->count;
+    ignore_rule_t *rule = &m->rules[index];
+    memset(rule, 0, sizeof(*rule));
+    rule->pattern = strndup(line, len);
+    if (!rule->pattern) return 1;
+    rule->len = (uint32_t)len;
+    rule->text = text;
+    rule->text_len = (uint32_t)text_len;
+    rule->source = source;
+    rule->line = line_no;
+    rule->next = -1;
+    m->count++;
+
+    const char *pat = rule->pattern;
+    if (!has_wildcard(pat, len)) {
+        rule->flags = flags;
+        return rule_table_add(m, flags & RULE_ANCHORED ? &m->paths : &m->names, index, pat, len);
+    }
+
+    const char *dot = len > 1 ? memrchr(pat + 1, '.', len - 1) : NULL;
+    if (!(flags & RULE_ANCHORED) && pat[0] == '*' && dot && !has_wildcard(pat + 1, len - 1)) {
+        rule->flags = flags;
+        return rule_table_add(m, &m->exts, index, dot + 1, (size_t)(pat + len - dot - 1));
+    }
+
+    rule->flags = flags | RULE_GLOB;
+    if (!strchr("*?[\\", pat[0])) rule->first = pat[0];
+    if (!strchr("*?]", pat[len - 1])) rule->last = pat[len - 1];
+
+    if (m->glob_count == m->glob_cap) {
+        int cap = m->glob_cap ? m->glob_cap * 2 : 32;
+        int *globs = realloc(m->globs, (size_t)cap * sizeof(int));
+        if (!globs) return 1;
+        m->globs = globs;
+        m->glob_cap = cap;
+    }
+    m->globs[m->glob_count++] = index;
+    return 0;
+}
+
+// Compile every rule in data, which must outlive the matcher
+int matcher_add_buffer(ignore_matcher_t *m, const char *source, const char *data, size_t size) {
+    char **sources = realloc(m->sources, (size_t)(m->source_count + 1) * sizeof(char *));
+    if (!sources) return 1;
+    m->sources = sources;
+    m->sources[m->source_count] = strdup(source);
+    if (!m->sources[m->source_count]) return 1;
+    int index = m->source_count++;
+
+    const char *p = data;
+    const char *end = data + size;
+    int line_no = 0;
+    while (p < end) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        size_t len = nl ? (size_t)(nl - p) : (size_t)(end - p);
+        line_no++;
+
+        if (matcher_add_line(m, index, line_no, p, len) != 0) return 1;
+        p += len + (nl ? 1 : 0);
+    }
+    return 0;
+}
+
+int matcher_add_file(ignore_matcher_t *m, const char *path) {
+    size_t size;
+    char *data = read_file(path, &size);
+    if (!data) return 1;
+
+    char **buffers = realloc(m->buffers, (size_t)(m->buffer_count + 1) * sizeof(char *));
+    if (!buffers) {
+        free(data);
+        return 1;
+    }
+    m->buffers = buffers;
+    m->buffers[m->buffer_count++] = data;
+
+    return matcher_add_buffer(m, path, data, size);
+}
+
+static int query_is_dir(match_query_t *q) {
+    if (q->is_dir < 0) {
+        struct stat st;
+        q->is_dir = lstat(q->path, &st) == 0 && S_ISDIR(st.st_mode);
+    }
+    return q->is_dir;
+}
+
+static int rule_applies(const ignore_rule_t *rule, match_query_t *q) {
+    return !(rule->flags & RULE_DIR_ONLY) || query_is_dir(q);
+}
+
+// The latest rule matching this one path, without looking at its parents
+static int matcher_decide(const ignore_matcher_t *m, match_query_t *q) {
+    const char *base = q->path + q->base;
+    size_t base_len = q->len - q->base;
+    int best = -1;
+
+    for (int r = rule_table_find(&m->names, base, base_len); r > best; r = m->rules[r].next) {
+        if (rule_applies(&m->rules[r], q)) {
+            best = r;
+            break;
+        }
+    }
+
+    if (m->exts.count > 0) {
+        const char *dot = memrchr(base, '.', base_len);
+        if (dot) {
+            size_t key_len = (size_t)(base + base_len - dot - 1);
+            for (int r = rule_table_find(&m->exts, dot + 1, key_len); r > best; r = m->rules[r].next) {
+                const ignore_rule_t *rule = &m->rules[r];
+                size_t suffix = rule->len - 1;
+                if (suffix <= base_len && memcmp(base + base_len - suffix, rule->pattern + 1, suffix) == 0 &&
+                    rule_applies(rule, q)) {
+                    best = r;
+                    break;
+                }
+            }
+        }
+    }
+
+    for (int r = rule_table_find(&m->paths, q->path, q->len); r > best; r = m->rules[r].next) {
+        if (rule_applies(&m->rules[r], q)) {
+            best = r;
+            break;
+        }
+    }
+
+    for (int i = m->glob_count - 1; i >= 0 && m->globs[i] > best; i--) {
+        const ignore_rule_t *rule = &m->rules[m->globs[i]];
+        const char *text = base;
+        size_t text_len = base_len;
+        if (rule->flags & RULE_ANCHORED) {
+            text = q->path;
+            text_len = q->len;
+        }
+
+        if (rule->first && text[0] != rule->first) continue;
+        if (rule->last && (text_len == 0 || text[text_len - 1] != rule->last)) continue;
+        if ((rule->flags & RULE_DIR_ONLY) && q->is_dir == 0) continue;
+        if (wild_match(rule->pattern, rule->pattern, text) != WILD_MATCH) continue;
+        if (!rule_applies(rule, q)) continue;
+
+        best = m->globs[i];
+        break;
+    }
+
+    return best;
+}
+
+// Find the rule deciding path, relative to the rules' directory, or -1 if
+// none matches. is_dir is 1 or 0 when known and -1 to look it up on disk
+// only if a directory-only rule needs it. path is modified while matching
+// and restored before returning.
+int matcher_check(const ignore_matcher_t *m, char *path, size_t len, int is_dir) {
+    while (len >= 2 && path[0] == '.' && path[1] == '/') {
+        path += 2;
+        len -= 2;
+    }
+    if (len > 1 && path[len - 1] == '/') {
+        is_dir = 1;
+        len--;
+    }
+    if (len == 0 || m->count == 0) return -1;
+
+    match_query_t q;
+    q.path = path;
+    q.base = 0;
+
+    // Leading directories first: a file in an excluded directory stays out
+    for (size_t i = 0; i < len; i++) {
+        if (path[i] != '/') continue;
+
+        if (i > q.base) {
+            path[i] = '\0';
+            q.len = i;
+            q.is_dir = 1;
+            int r = matcher_decide(m, &q);
+            path[i] = '/';
+            if (matcher_is_ignored(m, r)) return r;
+        }
+        q.base = i + 1;
+    }
+
+    char saved = path[len];
+    path[len] = '\0';
+    q.len = len;
+    q.is_dir = is_dir;
+    int r = matcher_decide(m, &q);
+    path[len] = saved;
+    return r;
+}
+
+int matcher_is_ignored(const ignore_matcher_t *m, int rule) {
+    return rule >= 0 && !(m->rules[rule].flags & RULE_NEGATE);
+}
+
+// Every rule matching path itself, newest first, without looking at its
+// parents; audit uses the full list to tell deciding rules from shadowed
+// ones. base is the offset of the basename and path must be NUL-terminated.
+// Returns the number of rules stored, at most max.
+int matcher_match_all(const ignore_matcher_t *m, const char *path, size_t len, size_t base,
+                      int is_dir, int *rules, int max) {
+    match_query_t q;
+    q.path = path;
+    q.len = len;
+    q.base = base;
+    q.is_dir = is_dir;
+
+    const char *name = path + base;
+    size_t name_len = len - base;
+    int n = 0;
+
+    for (int r = rule_table_find(&m->names, name, name_len); r >= 0 && n < max; r = m->rules[r].next) {
+        if (rule_applies(&m->rules[r], &q)) rules[n++] = r;
+    }
+
+    const char *dot = m->exts.count > 0 ? memrchr(name, '.', name_len) : NULL;
+    if (dot) {
+        size_t key_len = (size_t)(name + name_len - dot - 1);
+        for (int r = rule_table_find(&m->exts, dot + 1, key_len); r >= 0 && n < max; r = m->rules[r].next) {
+            const ignore_rule_t *rule = &m->rules[r];
+            size_t suffix = rule->len - 1;
+            if (suffix <= name_len && memcmp(name + name_len - suffix, rule->pattern + 1, suffix) == 0 &&
+                rule_applies(rule, &q)) {
+                rules[n++] = r;
+            }
+        }
+    }
+
+    for (int r = rule_table_find(&m->paths, path, len); r >= 0 && n < max; r = m->rules[r].next) {
+        if (rule_applies(&m->rules[r], &q)) rules[n++] = r;
+    }
+
+    for (int i = 0; i < m->glob_count && n < max; i++) {
+        const ignore_rule_t *rule = &m->rules[m->globs[i]];
+        const char *text = rule->flags & RULE_ANCHORED ? path : name;
+        if (wild_match(rule->pattern, rule->pattern, text) == WILD_MATCH && rule_applies(rule, &q)) {
+            rules[n++] = m->globs[i];
+        }
+    }
+
+    // Newest first; lists are a handful of rules long
+    for (int i = 1; i < n; i++) {
+        int r = rules[i], j = i;
+        while (j > 0 && rules[j - 1] < r) {
+            rules[j] = rules[j - 1];
+            j--;
+        }
+        rules[j] = r;
+    }
+    return n;
+}
+
+// Match text against one wildcard pattern with the rules above
+int matcher_glob(const char *pattern, const char *text) {
+    return wild_match(pattern, pattern, text) == WILD_MATCH;
+}
@@ -0,0 +1,423 @@
+// minimize.c - Drop rules whose matches other rules already cover
+//
+// A rule is redundant when removing it cannot change whether any path is
+// ignored. Three cases are recognized, each checked against the rules
+// still kept, so removals can be chained safely:
+//
+//   - a later rule matches everything it matches, so it never decides;
+//   - an earlier rule of the same kind ("!" or not) matches everything it
+//     matches and no rule of the other kind sits in between;
+//   - it only matches below a directory some rule excludes and no "!"
+//     rule follows that one, so nothing below can be re-included.
+//
+// "Matches everything it matches" is decided on the patterns themselves:
+// patterns are split into tokens and one pattern covers another when each
+// token of the covered one can be absorbed by the covering one ("*" takes
+// any run of non-slash tokens, "**" any run at all). This never claims a
+// cover that does not hold; it may miss some exotic ones.
+#include "gitignore.h"
+
+#define TOK_LIT     0
+#define TOK_ANY     1       // ?
+#define TOK_CLASS   2       // [...]
+#define TOK_STAR    3       // * or ** inside a component
+#define TOK_DSTAR   4       // ** as a whole component
+
+#define MINIMIZE_STACK_CELLS 4096
+
+typedef struct {
+    unsigned char kind;
+    char c;                 // TOK_LIT byte
+    const char *cls;        // TOK_CLASS text, "[" through "]"
+    int cls_len;
+} pat_token_t;
+
+typedef struct {
+    pat_token_t *toks;
+    int count;
+    int start;              // first token of the unanchored form, -1 if anchored
+    int ok;                 // tokenized; malformed patterns take no part
+} pat_info_t;
+
+static int tokenize(const char *p, pat_info_t *info) {
+    size_t len = strlen(p);
+    info->toks = malloc((len + 1) * sizeof(pat_token_t));
+    info->count = 0;
+    info->ok = 0;
+    if (!info->toks) return 1;
+
+    for (size_t i = 0; i < len;) {
+        pat_token_t *t = &info->toks[info->count++];
+        memset(t, 0, sizeof(*t));
+
+        if (p[i] == '\\') {
+            if (i + 1 >= len) return 0;
+            t->c = p[i + 1];
+            i += 2;
+        } else if (p[i] == '*') {
+            size_t end = i;
+            while (p[end] == '*') end++;
+            int whole = (i == 0 || p[i - 1] == '/') && (p[end] == '\0' || p[end] == '/');
+            t->kind = end - i >= 2 && whole ? TOK_DSTAR : TOK_STAR;
+            i = end;
+        } else if (p[i] == '?') {
+            t->kind = TOK_ANY;
+            i++;
+        } else if (p[i] == '[') {
+            size_t j = i + 1;
+            if (p[j] == '!' || p[j] == '^') j++;
+            if (p[j] == ']') j++;
+            while (j < len && p[j] != ']') {
+                if (p[j] == '\\' && j + 1 < len) {
+                    j += 2;
+                } else if (p[j] == '[' && p[j + 1] == ':') {
+                    const char *close = strstr(p + j + 2, ":]");
+                    j = close ? (size_t)(close - p) + 2 : j + 1;
+                } else {
+                    j++;
+                }
+            }
+            if (j >= len) return 0;
+            t->kind = TOK_CLASS;
+            t->cls = p + i;
+            t->cls_len = (int)(j - i + 1);
+            i = j + 1;
+        } else {
+            t->c = p[i];
+            i++;
+        }
+    }
+
+    info->ok = 1;
+    return 0;
+}
+
+static int tok_is_slash(const pat_token_t *t) {
+    return t->kind == TOK_LIT && t->c == '/';
+}
+
+// One non-slash character
+static int tok_is_single(const pat_token_t *t) {
+    return t->kind == TOK_ANY || t->kind == TOK_CLASS || (t->kind == TOK_LIT && t->c != '/');
+}
+
+static int class_has(const pat_token_t *cls, char c) {
+    char pattern[256];
+    char text[2] = { c, '\0' };
+    if (cls->cls_len >= (int)sizeof(pattern)) return 0;
+    memcpy(pattern, cls->cls, (size_t)cls->cls_len);
+    pattern[cls->cls_len] = '\0';
+    return matcher_glob(pattern, text);
+}
+
+// Does pattern p[0..np) match every path pattern q[0..nq) matches?
+// dp[i][j] answers it for the suffixes p[i..] and q[j..].
+static int tokens_cover(const pat_token_t *p, int np, const pat_token_t *q, int nq) {
+    size_t cells = (size_t)(np + 1) * (size_t)(nq + 1);
+    unsigned char stack_dp[MINIMIZE_STACK_CELLS];
+    unsigned char *dp = cells <= sizeof(stack_dp) ? stack_dp : malloc(cells);
+    if (!dp) return 0;
+
+#define DP(i, j) dp[(size_t)(i) * (size_t)(nq + 1) + (size_t)(j)]
+    for (int j = 0; j <= nq; j++) DP(np, j) = j == nq;
+
+    for (int i = np - 1; i >= 0; i--) {
+        const pat_token_t *pt = &p[i];
+        for (int j = nq; j >= 0; j--) {
+            const pat_token_t *qt = j < nq ? &q[j] : NULL;
+            int v = 0;
+
+            switch (pt->kind) {
+            case TOK_STAR:
+                v = DP(i + 1, j) ||
+                    (qt && (tok_is_single(qt) || qt->kind == TOK_STAR) && DP(i, j + 1));
+                break;
+            case TOK_DSTAR:
+                v = DP(i + 1, j) || (qt && DP(i, j + 1)) ||
+                    (i + 1 < np && tok_is_slash(&p[i + 1]) && DP(i + 2, j));
+                break;
+            case TOK_ANY:
+                v = qt && tok_is_single(qt) && DP(i + 1, j + 1);
+                break;
+            case TOK_CLASS:
+                v = qt && DP(i + 1, j + 1) &&
+                    ((qt->kind == TOK_LIT && qt->c != '/' && class_has(pt, qt->c)) ||
+                     (qt->kind == TOK_CLASS && qt->cls_len == pt->cls_len &&
+                      memcmp(qt->cls, pt->cls, (size_t)pt->cls_len) == 0));
+                break;
+            default:
+                v = qt && qt->kind == TOK_LIT && qt->c == pt->c && DP(i + 1, j + 1);
+                break;
+            }
+            DP(i, j) = (unsigned char)v;
+        }
+    }
+
+    int covered = DP(0, 0);
+#undef DP
+    if (dp != stack_dp) free(dp);
+    return covered;
+}
+
+// Start of the last path component of toks[0..n), or -1 when that
+// component is "**" and so could be any name
+static int last_component(const pat_token_t *toks, int n) {
+    int start = 0;
+    for (int i = 0; i < n; i++) {
+        if (tok_is_slash(&toks[i])) start = i + 1;
+    }
+    if (start < n && toks[start].kind == TOK_DSTAR) return -1;
+    return start;
+}
+
+// Does rule a's pattern match every path of length-n prefix q of another
+// pattern? Unanchored rules only see the last component.
+static int rule_covers_tokens(const pat_info_t *a, const pat_token_t *q, int n) {
+    static const pat_token_t any_name = { TOK_STAR, 0, NULL, 0 };
+
+    if (a->start < 0) return tokens_cover(a->toks, a->count, q, n);
+
+    int start = last_component(q, n);
+    if (start < 0) return tokens_cover(a->toks + a->start, a->count - a->start, &any_name, 1);
+    return tokens_cover(a->toks + a->start, a->count - a->start, q + start, n - start);
+}
+
+// Does rule a match every path rule b matches?
+static int rule_covers(const ignore_rule_t *ra, const pat_info_t *a,
+                       const ignore_rule_t *rb, const pat_info_t *b) {
+    if (!a->ok || !b->ok) return 0;
+    if ((ra->flags & RULE_DIR_ONLY) && !(rb->flags & RULE_DIR_ONLY)) return 0;
+
+    // Both unanchored: compare the patterns; an anchored rule never covers
+    // an unanchored one, which matches at every depth
+    if (b->start >= 0) {
+        return a->start >= 0 && tokens_cover(a->toks + a->start, a->count - a->start,
+                                             b->toks + b->start, b->count - b->start);
+    }
+    return rule_covers_tokens(a, b->toks, b->count);
+}
+
+// Literal bytes a component starts with (from the front) or ends with
+static int literal_run(const pat_token_t *toks, int n, int from_end) {
+    int run = 0;
+    while (run < n && toks[from_end ? n - 1 - run : run].kind == TOK_LIT) run++;
+    return run;
+}
+
+static int literal_runs_differ(const pat_token_t *a, int na, const pat_token_t *b, int nb, int from_end) {
+    int ra = literal_run(a, na, from_end);
+    int rb = literal_run(b, nb, from_end);
+    int n = ra < rb ? ra : rb;
+    for (int i = 0; i < n; i++) {
+        char ca = a[from_end ? na - 1 - i : i].c;
+        char cb = b[from_end ? nb - 1 - i : i].c;
+        if (ca != cb) return 1;
+    }
+    // Two fully literal names must be equal
+    return ra == na && rb == nb && na != nb;
+}
+
+// Can no path match both rule x and the pattern q[0..n)? Only the last
+// components are compared: a name must start and end with the literal
+// text of both.
+static int rule_disjoint(const pat_info_t *x, const pat_token_t *q, int n) {
+    if (!x->ok) return 0;
+
+    int xs = last_component(x->toks, x->count);
+    int qs = last_component(q, n);
+    if (xs < 0 || qs < 0) return 0;
+
+    const pat_token_t *xt = x->toks + xs;
+    int xn = x->count - xs;
+    return literal_runs_differ(xt, xn, q + qs, n - qs, 0) ||
+           literal_runs_differ(xt, xn, q + qs, n - qs, 1);
+}
+
+// Does rule a exclude a directory that every path of rule b lies below,
+// with no kept "!" rule after a that could re-include that directory?
+static int rule_covers_parent(const ignore_matcher_t *m, const pat_info_t *info,
+                              const rule_cover_t *covers, int a, int b) {
+    const pat_info_t *pa = &info[a];
+    const pat_info_t *pb = &info[b];
+    if (!pa->ok || !pb->ok || pb->start >= 0) return 0;
+
+    for (int k = 1; k < pb->count; k++) {
+        // "**/" may match nothing, leaving no parent behind
+        if (!tok_is_slash(&pb->toks[k]) || pb->toks[k - 1].kind == TOK_DSTAR) continue;
+        if (!rule_covers_tokens(pa, pb->toks, k)) continue;
+
+        int reincluded = 0;
+        for (int r = a + 1; r < m->count && !reincluded; r++) {
+            if (r == b || covers[r].by >= 0 || !(m->rules[r].flags & RULE_NEGATE)) continue;
+            if (!rule_disjoint(&info[r], pb->toks, k)) reincluded = 1;
+        }
+        if (!reincluded) return 1;
+    }
+    return 0;
+}
+
+static void pat_info_init(const ignore_rule_t *rule, pat_info_t *info) {
+    memset(info, 0, sizeof(*info));
+    if (tokenize(rule->pattern, info) != 0 || !info->ok) {
+        info->ok = 0;
+        return;
+    }
+
+    // "**/name" is just "name" at any depth
+    info->start = -1;
+    if (!(rule->flags & RULE_ANCHORED)) {
+        info->start = 0;
+    } else if (info->count > 2 && info->toks[0].kind == TOK_DSTAR && tok_is_slash(&info->toks[1])) {
+        int nested = 0;
+        for (int i = 2; i < info->count; i++) {
+            if (tok_is_slash(&info->toks[i]) || info->toks[i].kind == TOK_DSTAR) nested = 1;
+        }
+        if (!nested) info->start = 2;
+    }
+}
+
+// Decide which rules are redundant. Rules with fixed[r] set (fixed may be
+// NULL) are kept but may still make others redundant. covers[r].by is -1
+// for kept rules. Returns the number of rules dropped, or -1 on allocation
+// failure.
+int matcher_minimize(const ignore_matcher_t *m, const unsigned char *fixed, rule_cover_t *covers) {
+    int n = m->count;
+    pat_info_t *info = calloc((size_t)(n > 0 ? n : 1), sizeof(pat_info_t));
+    if (!info) return -1;
+
+    for (int r = 0; r < n; r++) {
+        pat_info_init(&m->rules[r], &info[r]);
+        covers[r].by = -1;
+        covers[r].inside = 0;
+    }
+
+    // Walking backwards keeps the first of two equivalent rules
+    int dropped = 0;
+    for (int b = n - 1; b >= 0; b--) {
+        if (fixed && fixed[b]) continue;
+        const ignore_rule_t *rb = &m->rules[b];
+        uint32_t negate = rb->flags & RULE_NEGATE;
+        int by = -1, inside = 0;
+
+        // An earlier rule of the same kind, with nothing opposing between
+        for (int a = b - 1; a >= 0 && by < 0; a--) {
+            if (covers[a].by >= 0) continue;
+            const ignore_rule_t *ra = &m->rules[a];
+            if ((ra->flags & RULE_NEGATE) != negate) {
+                if (!rule_disjoint(&info[a], info[b].toks, info[b].count)) break;
+                continue;
+            }
+            if (rule_covers(ra, &info[a], rb, &info[b])) by = a;
+        }
+
+        // A later rule of either kind; it always wins
+        for (int a = b + 1; a < n && by < 0; a++) {
+            if (covers[a].by < 0 && rule_covers(&m->rules[a], &info[a], rb, &info[b])) by = a;
+        }
+
+        // An excluded parent directory that nothing re-includes
+        for (int a = n - 1; a >= 0 && by < 0; a--) {
+            if (a == b || covers[a].by >= 0 || (m->rules[a].flags & RULE_NEGATE)) continue;
+            if (rule_covers_parent(m, info, covers, a, b)) {
+                by = a;
+                inside = 1;
+            }
+        }
+
+        if (by >= 0) {
+            covers[b].by = by;
+            covers[b].inside = inside;
+            dropped++;
+        }
+    }
+
+    for (int r = 0; r < n; r++) {
+        free(info[r].toks);
+    }
+    free(info);
+    return dropped;
+}
+
+// Remove redundant rules from a .gitignore, keeping comments and layout
+int minimize_gitignore(const char *path, int dry_run) {
+    ignore_matcher_t matcher;
+    matcher_init(&matcher);
+
+    if (matcher_add_file(&matcher, path) != 0) {
+        char msg[MAX_PATH_LEN + 32];
+        snprintf(msg, sizeof(msg), "Cannot read %s", path);
+        print_error(msg, ERR_FILE_NOT_FOUND);
+        return 1;
+    }
+
+    rule_cover_t *covers = calloc((size_t)(matcher.count > 0 ? matcher.count : 1), sizeof(rule_cover_t));
+    int dropped = covers ? matcher_minimize(&matcher, NULL, covers) : -1;
+    if (dropped < 0) {
+        print_error("Out of memory", ERR_OUT_OF_MEMORY);
+        free(covers);
+        matcher_free(&matcher);
+        return 1;
+    }
+
+    if (dropped == 0) {
+        print_info("No redundant rules found");
+        free(covers);
+        matcher_free(&matcher);
+        return 0;
+    }
+
+    for (int r = 0; r < matcher.count; r++) {
+        if (covers[r].by < 0) continue;
+        // Name a rule that stays, not one dropped after this one
+        int cover = covers[r].by;
+        while (covers[cover].by >= 0) cover = covers[cover].by;
+        const ignore_rule_t *rule = &matcher.rules[r];
+        const ignore_rule_t *by = &matcher.rules[cover];
+        printf("  %s-%s line %d: %.*s  (%s line %d: %.*s)\n", COLOR_RED, COLOR_RESET,
+               rule->line, (int)rule->text_len, rule->text,
+               covers[r].inside ? "inside" : "covered by",
+               by->line, (int)by->text_len, by->text);
+    }
+
+    int rc = 0;
+    if (dry_run) {
+        printf("\n");
+        print_info("[DRY RUN] Would remove the rules above");
+    } else {
+        if (g_config && g_config->auto_backup && strcmp(path, ".gitignore") == 0) {
+            backup_gitignore();
+        }
+
+        // Rules are in line order, so one pass over the file drops them
+        const char *data = matcher.buffers[0];
+        const char *end = data + strlen(data);
+        out_buf_t out;
+        out_init(&out);
+
+        int line = 0, r = 0;
+        for (const char *p = data; p < end;) {
+            const char *nl = memchr(p, '\n', (size_t)(end - p));
+            size_t len = nl ? (size_t)(nl - p) : (size_t)(end - p);
+            line++;
+
+            while (r < matcher.count && matcher.rules[r].line < line) r++;
+            int drop = r < matcher.count && matcher.rules[r].line == line && covers[r].by >= 0;
+            if (!drop) out_add(&out, p, len + (nl ? 1 : 0));
+            p += len + (nl ? 1 : 0);
+        }
+
+        if (out_commit(&out, path) != 0) {
+            print_error("Could not write output file", ERR_PERMISSION_DENIED);
+            rc = 1;
+        } else {
+            char msg[MAX_PATH_LEN + 64];
+            snprintf(msg, sizeof(msg), "Removed %d redundant rule(s) from %s", dropped, path);
+            print_success(msg);
+        }
+        out_free(&out);
+    }
+
+    free(covers);
+    matcher_free(&matcher);
+    return rc;
+}
@@ -0,0 +1,249 @@
+// output.c - Build a file as a list of iovecs and replace it atomically
+//
+// Writers describe the new contents as spans pointing at bytes they
+// already hold (the existing file, template bodies, cache mappings), so
+// nothing is copied. out_commit() writes every span with one writev into
+// a temp file next to the target and renames it into place: readers see
+// either the old file or the complete new one, never a partial write.
+#include "gitignore.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdarg.h>
+
+#define OUT_MIN_IOV 64
+
+// umask() can only be read by setting it, so it is read once: doing the
+// swap on every commit would race when batch workers commit concurrently
+static pthread_once_t out_umask_once = PTHREAD_ONCE_INIT;
+static mode_t out_umask_value;
+
+static void out_read_umask(void) {
+    out_umask_value = umask(0);
+    umask(out_umask_value);
+}
+
+void out_init(out_buf_t *ob) {
+    memset(ob, 0, sizeof(*ob));
+}
+
+// A buffer whose span table and formatted text come from an arena; it
+// stays valid until the arena is freed and out_free() releases nothing
+void out_init_arena(out_buf_t *ob, arena_t *arena) {
+    out_init(ob);
+    ob->arena = arena;
+}
+
+void out_free(out_buf_t *ob) {
+    arena_t *arena = ob->arena;
+    if (!arena) {
+        for (int i = 0; i < ob->owned_count; i++) {
+            free(ob->owned[i]);
+        }
+        free(ob->owned);
+        free(ob->iov);
+    }
+    out_init(ob);
+    ob->arena = arena;
+}
+
+// Append a span by reference. The bytes must outlive the buffer. A span
+// that continues the previous one in memory extends it instead.
+int out_add(out_buf_t *ob, const void *data, size_t len) {
+    if (len == 0) return 0;
+
+    if (ob->count > 0) {
+        struct iovec *last = &ob->iov[ob->count - 1];
+        if ((const char *)last->iov_base + last->iov_len == (const char *)data) {
+            last->iov_len += len;
+            ob->size += len;
+            return 0;
+        }
+    }
+
+    if (ob->count == ob->cap) {
+        int cap = ob->cap ? ob->cap * 2 : OUT_MIN_IOV;
+        struct iovec *iov = ob->arena
+            ? arena_realloc(ob->arena, ob->iov, (size_t)ob->cap * sizeof(struct iovec),
+                            (size_t)cap * sizeof(struct iovec))
+            : realloc(ob->iov, (size_t)cap * sizeof(struct iovec));
+        if (!iov) return 1;
+        ob->iov = iov;
+        ob->cap = cap;
+    }
+
+    ob->iov[ob->count].iov_base = (void *)data;
+    ob->iov[ob->count].iov_len = len;
+    ob->count++;
+    ob->size += len;
+    return 0;
+}
+
+// Append one line and its newline. When the source already has a newline
+// right after the line it is referenced too, so consecutive lines of one
+// body collapse into a single span.
+int out_add_line(out_buf_t *ob, const char *line, size_t len, const char *end) {
+    if (line + len < end && line[len] == '\n') {
+        return out_add(ob, line, len + 1);
+    }
+    if (out_add(ob, line, len) != 0) return 1;
+    return out_add(ob, "\n", 1);
+}
+
+// Append formatted text; the buffer (or its arena) owns the copy
+int out_printf(out_buf_t *ob, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    if (ob->arena) {
+        size_t arena_len;
+        char *arena_text = arena_vprintf(ob->arena, &arena_len, fmt, ap);
+        va_end(ap);
+        return arena_text ? out_add(ob, arena_text, arena_len) : 1;
+    }
+    char *text = NULL;
+    int len = vasprintf(&text, fmt, ap);
+    va_end(ap);
+    if (len < 0) return 1;
+
+    char **owned = realloc(ob->owned, (size_t)(ob->owned_count + 1) * sizeof(char *));
+    if (!owned) {
+        free(text);
+        return 1;
+    }
+    ob->owned = owned;
+    ob->owned[ob->owned_count++] = text;
+
+    return out_add(ob, text, (size_t)len);
+}
+
+// Copy the buffer's contents into one NUL-terminated allocation
+char* out_flatten(const out_buf_t *ob) {
+    char *data = malloc(ob->size + 1);
+    if (!data) return NULL;
+
+    size_t off = 0;
+    for (int i = 0; i < ob->count; i++) {
+        memcpy(data + off, ob->iov[i].iov_base, ob->iov[i].iov_len);
+        off += ob->iov[i].iov_len;
+    }
+    data[off] = '\0';
+    return data;
+}
+
+static int out_writev_all(int fd, struct iovec *iov, int count) {
+    while (count > 0) {
+        int n = count < IOV_MAX ? count : IOV_MAX;
+        ssize_t written = writev(fd, iov, n);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return 1;
+        }
+
+        // Skip the spans that went out completely, then trim a partial one
+        while (count > 0 && (size_t)written >= iov->iov_len) {
+            written -= (ssize_t)iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char *)iov->iov_base + written;
+            iov->iov_len -= (size_t)written;
+        }
+    }
+    return 0;
+}
+
+static int out_sync_dir(const char *path) {
+    char dir[MAX_PATH_LEN];
+    const char *slash = strrchr(path, '/');
+    if (slash) {
+        snprintf(dir, sizeof(dir), "%.*s", (int)(slash - path) + (slash == path), path);
+    } else {
+        snprintf(dir, sizeof(dir), ".");
+    }
+
+    int fd = open(dir, O_RDONLY | O_DIRECTORY);
+    if (fd < 0) return 1;
+    int rc = fsync(fd);
+    close(fd);
+    return rc == 0 ? 0 : 1;
+}
+
+// Whether the buffer holds exactly these bytes, e.g. the file it would
+// replace. Spans that still point at the same bytes are not compared.
+int out_equals(const out_buf_t *ob, const void *data, size_t size) {
+    if (ob->size != size) return 0;
+    
+    const char *p = data;
+    for (int i = 0; i < ob->count; i++) {
+        const struct iovec *v = &ob->iov[i];
+        if (v->iov_base != p && memcmp(v->iov_base, p, v->iov_len) != 0) return 0;
+        p += v->iov_len;
+    }
+    return 1;
+}
+
+// Replace path with the buffer's contents. The original file's mode is
+// kept and a symlinked target is written through, not replaced.
+int out_commit(out_buf_t *ob, const char *path) {
+    char target[MAX_PATH_LEN];
+    struct stat st;
+    int have_st = 0;
+
+    if (strlen(path) >= sizeof(target)) return 1;
+
+    snprintf(target, sizeof(target), "%s", path);
+    if (lstat(path, &st) == 0) {
+        if (S_ISLNK(st.st_mode)) {
+            char *resolved = realpath(path, NULL);
+            if (resolved) {
+                // A truncated target would write somewhere else entirely
+                if (strlen(resolved) >= sizeof(target)) {
+                    free(resolved);
+                    return 1;
+                }
+                memcpy(target, resolved, strlen(resolved) + 1);
+                free(resolved);
+            }
+            have_st = stat(target, &st) == 0;
+        } else {
+            have_st = 1;
+        }
+    }
+
+    char tmp[MAX_PATH_LEN + 16];
+    snprintf(tmp, sizeof(tmp), "%s.tmp.XXXXXX", target);
+    int span = timing_begin("write");
+    timing_note(span, "%s", path);
+    int fd = mkstemp(tmp);
+    if (fd < 0) {
+        timing_end(span);
+        return 1;
+    }
+
+    mode_t mode;
+    if (have_st) {
+        mode = st.st_mode & 07777;
+    } else {
+        pthread_once(&out_umask_once, out_read_umask);
+        mode = 0666 & ~out_umask_value;
+    }
+
+    int rc = fchmod(fd, mode) == 0 ? 0 : 1;
+    if (rc == 0) rc = out_writev_all(fd, ob->iov, ob->count);
+    if (rc == 0 && g_config && g_config->fsync_writes) rc = fsync(fd) == 0 ? 0 : 1;
+    if (close(fd) != 0) rc = 1;
+
+    if (rc == 0 && rename(tmp, target) != 0) rc = 1;
+    if (rc != 0) {
+        unlink(tmp);
+        timing_end(span);
+        return 1;
+    }
+
+    if (g_config && g_config->fsync_writes) {
+        out_sync_dir(target);
+    }
+    timing_end(span);
+    return 0;
+}
@@ -0,0 +1,463 @@
+// prefetch.c - Warm the cache with every upstream template in one transfer
+//
+// `cache prefetch` downloads the whole repository as one archive
+// (archive_url, a .tar.gz from codeload by default) and unpacks it while
+// it arrives: curl hands the compressed bytes to zlib, and the inflated tar
+// stream runs through a small state machine that keeps the *.gitignore
+// members and stores each one in the template cache under the name sync
+// asks for ("Python", "Global/macOS", "community/..."). Nothing is staged
+// on disk.
+//
+// The commit the archive was made from (git archive writes it into a pax
+// global header) and the response's ETag are recorded next to the cache.
+// A later prefetch sends the ETag, and against a server that ignores it the
+// transfer is cut off as soon as the archive names the recorded commit.
+//
+// Templates are cached with that commit and do not expire while the record
+// names it: a prefetched cache is renewed by the next prefetch, not by
+// revalidating each template after cache_duration.
+#include "fetch_curl.h"
+#include <zlib.h>
+
+#define PREFETCH_RECORD_FILE "prefetch.meta"
+#define PREFETCH_CHUNK 65536
+#define PREFETCH_MAX_HEADER_DATA 65536
+#define PREFETCH_SUFFIX ".gitignore"
+
+typedef struct {
+    char commit[64];
+    char etag[128];
+    char url[MAX_PATH_LEN];
+    long fetched_at;
+    int templates;
+} prefetch_record_t;
+
+enum { TAR_HEADER, TAR_DATA, TAR_PAD, TAR_END };
+enum { KEEP_NONE, KEEP_TEMPLATE, KEEP_META };
+
+typedef struct {
+    const prefetch_record_t *previous;  // NULL with --force
+    long http_code;
+    char etag[128];
+    int up_to_date;
+    int failed;
+
+    // Decompression
+    int format;                 // 0 until the first byte, then 1 gzip, 2 tar
+    z_stream z;
+    unsigned char out[PREFETCH_CHUNK];
+    size_t received;
+    size_t unpacked;
+
+    // Tar state
+    int state;
+    unsigned char header[512];
+    size_t header_have;
+    uint64_t remaining;
+    uint64_t pad;
+    char type;
+    int keep;
+    char key[MAX_PATH_LEN];
+    char long_name[MAX_PATH_LEN];
+    char *member;
+    size_t member_have;
+
+    char commit[64];
+    int stored;
+    int failed_stores;
+} prefetch_t;
+
+// The record as this process last read it; reloaded after any change
+static struct {
+    int loaded;
+    int valid;
+    prefetch_record_t record;
+} g_prefetch;
+
+static char* prefetch_record_path(void) {
+    const app_paths_t *paths = app_paths();
+    if (!paths) return NULL;
+
+    char *path = malloc(MAX_PATH_LEN);
+    if (path && path_join(path, paths->cache_dir, PREFETCH_RECORD_FILE) != 0) {
+        free(path);
+        return NULL;
+    }
+    return path;
+}
+
+static int prefetch_read_record(prefetch_record_t *r) {
+    memset(r, 0, sizeof(*r));
+
+    char *path = prefetch_record_path();
+    if (!path) return 1;
+    FILE *f = fopen(path, "r");
+    free(path);
+    if (!f) return 1;
+
+    char line[MAX_PATH_LEN + 32];
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\n")] = '\0';
+        char *v = strchr(line, '=');
+        if (!v) continue;
+        *v++ = '\0';
+
+        if (strcmp(line, "commit") == 0) snprintf(r->commit, sizeof(r->commit), "%s", v);
+        else if (strcmp(line, "etag") == 0) snprintf(r->etag, sizeof(r->etag), "%s", v);
+        else if (strcmp(line, "url") == 0) snprintf(r->url, sizeof(r->url), "%s", v);
+        else if (strcmp(line, "fetched_at") == 0) r->fetched_at = atol(v);
+        else if (strcmp(line, "templates") == 0) r->templates = atoi(v);
+    }
+    fclose(f);
+    return r->url[0] ? 0 : 1;
+}
+
+static int prefetch_write_record(const prefetch_record_t *r) {
+    g_prefetch.loaded = 0;
+    char *path = prefetch_record_path();
+    if (!path || app_paths_ensure(APP_DIR_CACHE) != 0) {
+        free(path);
+        return 1;
+    }
+
+    char tmp[MAX_PATH_LEN + 8];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+    int rc = 1;
+    FILE *f = fopen(tmp, "w");
+    if (f) {
+        fprintf(f, "commit=%s\netag=%s\nurl=%s\nfetched_at=%ld\ntemplates=%d\n",
+                r->commit, r->etag, r->url, r->fetched_at, r->templates);
+        rc = fclose(f) != 0 || rename(tmp, path) != 0;
+        if (rc != 0) unlink(tmp);
+    }
+    free(path);
+    return rc;
+}
+
+// Forget the recorded commit, e.g. because the cache was cleared under it
+void prefetch_reset(void) {
+    g_prefetch.loaded = 0;
+    char *path = prefetch_record_path();
+    if (!path) return;
+    unlink(path);
+    free(path);
+}
+
+// Whether commit is the one the last prefetch recorded
+int prefetch_pinned(const char *commit) {
+    if (!g_prefetch.loaded) {
+        g_prefetch.valid = prefetch_read_record(&g_prefetch.record) == 0;
+        g_prefetch.loaded = 1;
+    }
+    return g_prefetch.valid && g_prefetch.record.commit[0] &&
+           strcmp(g_prefetch.record.commit, commit) == 0;
+}
+
+// Decide what to do with the member whose header was just read
+static void prefetch_member_begin(prefetch_t *p) {
+    const char *h = (const char *)p->header;
+
+    char name[MAX_PATH_LEN];
+    if (p->long_name[0]) {
+        snprintf(name, sizeof(name), "%s", p->long_name);
+        p->long_name[0] = '\0';
+    } else if (memcmp(h + 257, "ustar", 5) == 0 && h[345]) {
+        snprintf(name, sizeof(name), "%.155s/%.100s", h + 345, h);
+    } else {
+        snprintf(name, sizeof(name), "%.100s", h);
+    }
+
+    p->type = h[156];
+    p->remaining = tar_octal(h + 124, 12);
+    p->pad = ((p->remaining + 511) & ~(uint64_t)511) - p->remaining;
+    p->keep = KEEP_NONE;
+
+    if (p->type == 'g' || p->type == 'x' || p->type == 'L') {
+        if (p->remaining < PREFETCH_MAX_HEADER_DATA) p->keep = KEEP_META;
+    } else if (p->type == '0' || p->type == '\0') {
+        // Archives of a repository have one top directory; it is dropped
+        const char *rel = strchr(name, '/');
+        rel = rel ? rel + 1 : name;
+
+        size_t len = strlen(rel);
+        size_t suffix = strlen(PREFETCH_SUFFIX);
+        if (len > suffix && strcmp(rel + len - suffix, PREFETCH_SUFFIX) == 0) {
+            snprintf(p->key, sizeof(p->key), "%.*s", (int)(len - suffix), rel);
+            p->keep = KEEP_TEMPLATE;
+        }
+    }
+
+    p->member_have = 0;
+    if (p->keep != KEEP_NONE) {
+        p->member = malloc((size_t)p->remaining + 1);
+        if (!p->member) p->keep = KEEP_NONE;
+    }
+}
+
+// A kept member is complete; returns nonzero to stop the transfer
+static int prefetch_member_end(prefetch_t *p) {
+    int stop = 0;
+
+    if (p->keep == KEEP_TEMPLATE) {
+        cache_meta_t meta;
+        memset(&meta, 0, sizeof(meta));
+        snprintf(meta.commit, sizeof(meta.commit), "%s", p->commit);
+        if (cache_store(p->key, p->member, p->member_have, &meta) == 0) {
+            p->stored++;
+        } else {
+            p->failed_stores++;
+            if (g_config && g_config->verbose) print_warning("Could not cache template");
+        }
+    } else if (p->keep == KEEP_META && p->type == 'g') {
+        tar_pax_value(p->member, p->member_have, "comment", p->commit, sizeof(p->commit));
+        if (p->previous && p->commit[0] && strcmp(p->commit, p->previous->commit) == 0) {
+            p->up_to_date = 1;
+            stop = 1;
+        }
+    } else if (p->keep == KEEP_META && p->type == 'x') {
+        tar_pax_value(p->member, p->member_have, "path", p->long_name, sizeof(p->long_name));
+    } else if (p->keep == KEEP_META && p->type == 'L') {
+        size_t n = p->member_have < sizeof(p->long_name) ? p->member_have : sizeof(p->long_name) - 1;
+        memcpy(p->long_name, p->member, n);
+        p->long_name[n] = '\0';
+    }
+
+    free(p->member);
+    p->member = NULL;
+    p->keep = KEEP_NONE;
+    return stop;
+}
+
+// Feed inflated bytes through the tar state machine
+static int prefetch_tar(prefetch_t *p, const unsigned char *data, size_t len) {
+    p->unpacked += len;
+
+    while (len > 0 && p->state != TAR_END) {
+        size_t n;
+
+        switch (p->state) {
+        case TAR_HEADER:
+            n = sizeof(p->header) - p->header_have;
+            if (n > len) n = len;
+            memcpy(p->header + p->header_have, data, n);
+            p->header_have += n;
+            if (p->header_have < sizeof(p->header)) break;
+
+            p->header_have = 0;
+            if (p->header[0] == '\0') {
+                p->state = TAR_END;         // end-of-archive blocks
+                break;
+            }
+            prefetch_member_begin(p);
+            p->state = TAR_DATA;
+            if (p->remaining == 0 && prefetch_member_end(p) != 0) return 1;
+            if (p->remaining == 0) p->state = TAR_HEADER;
+            break;
+
+        case TAR_DATA:
+            n = p->remaining < len ? (size_t)p->remaining : len;
+            if (p->keep != KEEP_NONE) {
+                memcpy(p->member + p->member_have, data, n);
+                p->member_have += n;
+            }
+            p->remaining -= n;
+            if (p->remaining == 0) {
+                if (prefetch_member_end(p) != 0) return 1;
+                p->state = p->pad > 0 ? TAR_PAD : TAR_HEADER;
+            }
+            break;
+
+        default:    // TAR_PAD
+            n = p->pad < len ? (size_t)p->pad : len;
+            p->pad -= n;
+            if (p->pad == 0) p->state = TAR_HEADER;
+            break;
+        }
+
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
+
+// curl write callback: inflate (or pass through a plain tar) and unpack
+static size_t prefetch_write(char *contents, size_t size, size_t nmemb, void *userp) {
+    size_t len = size * nmemb;
+    prefetch_t *p = (prefetch_t *)userp;
+
+    if (p->http_code != 200 || len == 0) return len;
+    p->received += len;
+
+    if (p->format == 0) {
+        p->format = ((const unsigned char *)contents)[0] == 0x1f ? 1 : 2;
+        if (p->format == 1 && inflateInit2(&p->z, 16 + MAX_WBITS) != Z_OK) {
+            p->failed = 1;
+            return 0;
+        }
+    }
+
+    if (p->format == 2) {
+        return prefetch_tar(p, (const unsigned char *)contents, len) == 0 ? len : 0;
+    }
+
+    p->z.next_in = (Bytef *)contents;
+    p->z.avail_in = (uInt)len;
+    for (;;) {
+        p->z.next_out = p->out;
+        p->z.avail_out = sizeof(p->out);
+
+        int zrc = inflate(&p->z, Z_NO_FLUSH);
+        if (zrc != Z_OK && zrc != Z_STREAM_END && zrc != Z_BUF_ERROR) {
+            p->failed = 1;
+            return 0;
+        }
+
+        size_t n = sizeof(p->out) - p->z.avail_out;
+        if (n > 0 && prefetch_tar(p, p->out, n) != 0) return 0;
+        if (zrc == Z_STREAM_END) break;
+        if (p->z.avail_in == 0 && p->z.avail_out > 0) break;
+    }
+    return len;
+}
+
+static size_t prefetch_header(char *buffer, size_t size, size_t nitems, void *userp) {
+    size_t len = size * nitems;
+    prefetch_t *p = (prefetch_t *)userp;
+
+    if (len > 5 && strncmp(buffer, "HTTP/", 5) == 0) {
+        const char *sp = memchr(buffer, ' ', len);
+        p->http_code = sp ? strtol(sp + 1, NULL, 10) : 0;
+        p->etag[0] = '\0';
+        return len;
+    }
+
+    fetch_header_value(buffer, len, "ETag", p->etag, sizeof(p->etag));
+    return len;
+}
+
+static void prefetch_print_commit(const char *label, const char *commit) {
+    if (commit[0]) {
+        printf("  %s %.12s\n", label, commit);
+    }
+}
+
+int prefetch_cache(int force) {
+    if (!g_config || !g_config->cache_enabled) {
+        print_error("Cache is disabled (cache_enabled=false)", ERR_CACHE_ERROR);
+        return 1;
+    }
+    // file: templates are read in place and never cached
+    if (strncasecmp(g_config->template_url, "file:", 5) == 0) {
+        print_error("Nothing to prefetch: templates from a file: template_url are not cached",
+                    ERR_CACHE_ERROR);
+        return 1;
+    }
+    if (fetch_init() != 0) return 1;
+
+    const char *url = g_config->archive_url;
+    // The commit identifies the templates wherever they come from, but an
+    // ETag only means something to the server that sent it
+    prefetch_record_t previous;
+    int have_previous = !force && prefetch_read_record(&previous) == 0;
+    int same_url = have_previous && strcmp(previous.url, url) == 0;
+
+    prefetch_t *p = calloc(1, sizeof(prefetch_t));
+    CURL *curl = g_curl.easy_init();
+    if (!p || !curl) {
+        free(p);
+        if (curl) g_curl.easy_cleanup(curl);
+        print_error("Out of memory", ERR_OUT_OF_MEMORY);
+        return 1;
+    }
+    p->previous = have_previous ? &previous : NULL;
+
+    // file:// and other non-HTTP sources have no status line to parse
+    if (strncasecmp(url, "http://", 7) != 0 && strncasecmp(url, "https://", 8) != 0) {
+        p->http_code = 200;
+    }
+
+    struct curl_slist *headers = NULL;
+    if (same_url && previous.etag[0]) {
+        char header[160];
+        snprintf(header, sizeof(header), "If-None-Match: %s", previous.etag);
+        headers = g_curl.slist_append(headers, header);
+    }
+
+    fetch_setopt_ptr(curl, CURLOPT_URL, url);
+    fetch_setopt_fn(curl, CURLOPT_WRITEFUNCTION, prefetch_write);
+    fetch_setopt_ptr(curl, CURLOPT_WRITEDATA, (void *)p);
+    fetch_setopt_fn(curl, CURLOPT_HEADERFUNCTION, prefetch_header);
+    fetch_setopt_ptr(curl, CURLOPT_HEADERDATA, (void *)p);
+    fetch_setopt_ptr(curl, CURLOPT_USERAGENT, "gitignore-tool/2.0");
+    fetch_setopt_long(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    fetch_setopt_long(curl, CURLOPT_TIMEOUT, 300L);
+    if (headers) fetch_setopt_ptr(curl, CURLOPT_HTTPHEADER, headers);
+
+    if (!g_config || !g_config->quiet) print_info("Downloading template archive...");
+
+    int span = timing_begin("prefetch");
+    CURLcode res = g_curl.easy_perform(curl);
+    long code = 0;
+    if (fetch_getinfo_long(curl, CURLINFO_RESPONSE_CODE, &code) == CURLE_OK && code != 0) {
+        p->http_code = code;
+    }
+    timing_note(span, "%zu bytes, %d template(s)", p->received, p->stored);
+    timing_end(span);
+
+    g_curl.slist_free_all(headers);
+    g_curl.easy_cleanup(curl);
+    if (p->format == 1) inflateEnd(&p->z);
+    free(p->member);
+
+    int rc = 0;
+    if (p->http_code == 304 || p->up_to_date) {
+        // Checked just now, so the record is as good as a new download
+        snprintf(previous.url, sizeof(previous.url), "%s", url);
+        if (p->etag[0]) snprintf(previous.etag, sizeof(previous.etag), "%s", p->etag);
+        previous.fetched_at = (long)time(NULL);
+        if (prefetch_write_record(&previous) != 0) {
+            print_warning("Could not record the prefetched commit");
+        }
+        print_success("Template cache is up to date");
+        prefetch_print_commit("Commit:", previous.commit);
+    } else if (p->failed) {
+        print_error("Template archive is corrupt", ERR_NETWORK_ERROR);
+        rc = 1;
+    } else if (res != CURLE_OK) {
+        char msg[MAX_PATH_LEN + 64];
+        snprintf(msg, sizeof(msg), "Could not download %s: %s", url, g_curl.easy_strerror(res));
+        print_error(msg, ERR_NETWORK_ERROR);
+        rc = 1;
+    } else if (p->http_code != 200) {
+        char msg[MAX_PATH_LEN + 64];
+        snprintf(msg, sizeof(msg), "Could not download %s (HTTP %ld)", url, p->http_code);
+        print_error(msg, ERR_NETWORK_ERROR);
+        rc = 1;
+    } else if (p->state != TAR_END && (p->state != TAR_HEADER || p->header_have != 0 || p->stored == 0)) {
+        print_error("Template archive ended early", ERR_NETWORK_ERROR);
+        rc = 1;
+    } else {
+        prefetch_record_t record;
+        memset(&record, 0, sizeof(record));
+        snprintf(record.commit, sizeof(record.commit), "%s", p->commit);
+        snprintf(record.etag, sizeof(record.etag), "%s", p->etag);
+        snprintf(record.url, sizeof(record.url), "%s", url);
+        record.fetched_at = (long)time(NULL);
+        record.templates = p->stored;
+        if (prefetch_write_record(&record) != 0) {
+            print_warning("Could not record the prefetched commit");
+        }
+
+        print_success("Template cache warmed");
+        printf("  Cached %d template(s) from %zu KB (%zu KB unpacked)\n",
+               p->stored, (p->received + 1023) / 1024, (p->unpacked + 1023) / 1024);
+        prefetch_print_commit("Commit:", p->commit);
+        if (p->failed_stores > 0) {
+            printf("  %d template(s) could not be cached\n", p->failed_stores);
+        }
+    }
+
+    free(p);
+    return rc;
+}
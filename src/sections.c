@@ -0,0 +1,291 @@
+// sections.c - Index of the template sections the tool writes into a .gitignore
+//
+// init, append and sync write each template as a section:
+//
+//     # ===== Python =====
+//     ...template lines...
+//     # ===== end Python [9f3c2a71d04b8e65] =====
+//
+// The end marker records a hash of the template body the section was made
+// from. Re-applying a template finds its section here, leaves it alone
+// when the hash still matches, and otherwise rewrites just those bytes;
+// everything outside the tool's sections is copied through untouched.
+//
+// Sections written before end markers existed run up to the next section
+// or "Added by gitignore tool" line. Their extent may include hand-added
+// lines, so when one is rewritten, any pattern of it that the output would
+// otherwise lose is kept below the new section.
+#include "gitignore.h"
+
+#define SECTION_PREFIX      "# ===== "
+#define SECTION_SUFFIX      " ====="
+#define SECTION_END_WORD    "end "
+
+static int section_is_blank(const char *p, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (p[i] != ' ' && p[i] != '\t' && p[i] != '\r') return 0;
+    }
+    return 1;
+}
+
+static int section_hex(const char *p, size_t len, uint64_t *out) {
+    uint64_t v = 0;
+    if (len != 16) return 0;
+    for (size_t i = 0; i < len; i++) {
+        char c = p[i];
+        int d = c >= '0' && c <= '9' ? c - '0' :
+                c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+        if (d < 0) return 0;
+        v = (v << 4) | (uint64_t)d;
+    }
+    *out = v;
+    return 1;
+}
+
+// Classify one line (without its newline). Headers and end markers report
+// the template name; end markers also report the recorded hash.
+section_line_t section_line(const char *p, size_t len, const char **name, size_t *name_len,
+                            uint64_t *hash) {
+    static const char added[] = "# Added by gitignore tool";
+    // "# Synced from SOURCE by gitignore tool", SOURCE being GitHub or the
+    // configured template source
+    static const char synced[] = "# Synced from ";
+    static const char synced_by[] = " by gitignore tool";
+
+    while (len > 0 && (p[len - 1] == '\r' || p[len - 1] == ' ')) len--;
+
+    if (len == strlen(added) && memcmp(p, added, len) == 0) return SECTION_LINE_MARKER;
+    size_t s_len = strlen(synced), by_len = strlen(synced_by);
+    if (len > s_len + by_len && memcmp(p, synced, s_len) == 0 &&
+        memcmp(p + len - by_len, synced_by, by_len) == 0) {
+        return SECTION_LINE_MARKER;
+    }
+
+    size_t pre = strlen(SECTION_PREFIX), suf = strlen(SECTION_SUFFIX);
+    if (len <= pre + suf || memcmp(p, SECTION_PREFIX, pre) != 0 ||
+        memcmp(p + len - suf, SECTION_SUFFIX, suf) != 0) {
+        return SECTION_LINE_OTHER;
+    }
+
+    const char *n = p + pre;
+    size_t n_len = len - pre - suf;
+    size_t end_len = strlen(SECTION_END_WORD);
+
+    // "end NAME [hash]"
+    if (n_len > end_len + 19 && memcmp(n, SECTION_END_WORD, end_len) == 0 &&
+        n[n_len - 1] == ']' && n[n_len - 18] == '[' && n[n_len - 19] == ' ') {
+        uint64_t h;
+        if (section_hex(n + n_len - 17, 16, &h)) {
+            *name = n + end_len;
+            *name_len = n_len - end_len - 19;
+            if (hash) *hash = h;
+            return SECTION_LINE_END;
+        }
+    }
+
+    *name = n;
+    *name_len = n_len;
+    return SECTION_LINE_HEADER;
+}
+
+static int section_push(section_index_t *idx, arena_t *arena, int *cap, section_t **out) {
+    if (idx->count == *cap) {
+        int grown = *cap ? *cap * 2 : 16;
+        section_t *items = arena_realloc(arena, idx->items, (size_t)*cap * sizeof(section_t),
+                                         (size_t)grown * sizeof(section_t));
+        if (!items) return 1;
+        idx->items = items;
+        *cap = grown;
+    }
+    section_t *s = &idx->items[idx->count++];
+    memset(s, 0, sizeof(*s));
+    s->slot = -1;
+    *out = s;
+    return 0;
+}
+
+// Index the sections and markers of data, which must outlive the index
+int section_index_build(section_index_t *idx, arena_t *arena, const char *data, size_t size) {
+    idx->data = data;
+    idx->size = size;
+    idx->items = NULL;
+    idx->count = 0;
+
+    int cap = 0;
+    section_t *open = NULL;     // section whose end marker has not been seen
+    size_t content_end = 0;     // end of the last non-blank line
+    size_t pos = 0;
+
+    while (pos < size) {
+        const char *p = data + pos;
+        const char *nl = memchr(p, '\n', size - pos);
+        size_t len = nl ? (size_t)(nl - p) : size - pos;
+        size_t next = pos + len + (nl ? 1 : 0);
+
+        const char *name = NULL;
+        size_t name_len = 0;
+        uint64_t hash = 0;
+        section_line_t kind = section_line(p, len, &name, &name_len, &hash);
+
+        if (kind == SECTION_LINE_END && open && open->name_len == name_len &&
+            memcmp(open->name, name, name_len) == 0) {
+            open->end = next;
+            open->hash = hash;
+            open->managed = 1;
+            open = NULL;
+        } else if (kind == SECTION_LINE_HEADER || kind == SECTION_LINE_MARKER) {
+            // An unterminated section ends at its last non-blank line
+            if (open) open->end = content_end > open->body ? content_end : open->body;
+
+            section_t *s;
+            if (section_push(idx, arena, &cap, &s) != 0) return 1;
+            // The blank lines before it are its separator
+            s->start = content_end;
+            s->body = next;
+            s->end = next;
+            if (kind == SECTION_LINE_HEADER) {
+                s->name = name;
+                s->name_len = name_len;
+                open = s;
+            } else {
+                s->marker = 1;
+                open = NULL;
+            }
+        }
+
+        if (!section_is_blank(p, len)) content_end = next;
+        pos = next;
+    }
+
+    if (open) open->end = content_end > open->body ? content_end : open->body;
+    return 0;
+}
+
+// Claim the first section of a template for merge slot `slot`. It is
+// marked SECTION_REPLACE and any later section of the same template
+// SECTION_DROP. Returns the section, or -1 if the file has none.
+int section_claim(section_index_t *idx, const char *name, int slot) {
+    size_t len = strlen(name);
+    int first = -1;
+
+    for (int i = 0; i < idx->count; i++) {
+        section_t *s = &idx->items[i];
+        if (s->marker || s->slot >= 0 || s->name_len != len || strncasecmp(s->name, name, len) != 0) {
+            continue;
+        }
+        s->slot = slot;
+        s->action = first < 0 ? SECTION_REPLACE : SECTION_DROP;
+        if (first < 0) first = i;
+    }
+
+    return first;
+}
+
+// Whether a claimed section was made from a template body with this hash
+int section_current(const section_index_t *idx, int section, uint64_t hash) {
+    return section >= 0 && idx->items[section].managed && idx->items[section].hash == hash;
+}
+
+// Keep a section as it is. Its patterns join seen (if given), which
+// section_seed() left out while the section was claimed.
+int section_keep(section_index_t *idx, int section, pattern_set_t *seen) {
+    section_t *s = &idx->items[section];
+    s->action = SECTION_KEEP;
+    if (!seen) return 0;
+    return pattern_set_add_lines(seen, idx->data + s->start, s->end - s->start);
+}
+
+// Keep every section claimed for slot, e.g. when its template could not
+// be fetched: a failed download must not remove what the file has
+int section_release(section_index_t *idx, int slot, pattern_set_t *seen) {
+    for (int i = 0; i < idx->count; i++) {
+        if (idx->items[i].slot == slot && idx->items[i].action != SECTION_KEEP &&
+            section_keep(idx, i, seen) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Whether section_rewrite() would change anything
+int section_dirty(const section_index_t *idx) {
+    for (int i = 0; i < idx->count; i++) {
+        if (idx->items[i].action != SECTION_KEEP) return 1;
+    }
+    return 0;
+}
+
+// Add the patterns of everything that stays, i.e. all but the sections
+// being replaced or dropped
+int section_seed(const section_index_t *idx, pattern_set_t *seen) {
+    size_t pos = 0;
+
+    for (int i = 0; i < idx->count; i++) {
+        const section_t *s = &idx->items[i];
+        if (s->action == SECTION_KEEP) continue;
+        if (pattern_set_add_lines(seen, idx->data + pos, s->start - pos) != 0) return 1;
+        pos = s->end;
+    }
+
+    return pattern_set_add_lines(seen, idx->data + pos, idx->size - pos);
+}
+
+void section_begin(out_buf_t *out, const char *name) {
+    out_printf(out, "\n" SECTION_PREFIX "%s" SECTION_SUFFIX "\n", name);
+}
+
+void section_end(out_buf_t *out, const char *name, uint64_t hash) {
+    out_printf(out, SECTION_PREFIX SECTION_END_WORD "%s [%016llx]" SECTION_SUFFIX "\n",
+               name, (unsigned long long)hash);
+}
+
+// Patterns of an old-style section's body that nothing else in the
+// output has
+static void section_keep_orphans(out_buf_t *out, const char *data, size_t size, pattern_set_t *seen) {
+    const char *p = data;
+    const char *end = data + size;
+
+    while (p < end) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        const char *line_end = nl ? nl : end;
+        size_t len = (size_t)(line_end - p);
+
+        if (!is_comment_span(p, len) && pattern_set_insert(seen, p, len) > 0) {
+            out_add_line(out, p, len, end);
+        }
+        p = nl ? nl + 1 : end;
+    }
+}
+
+// A marker is dropped with the sections it introduced when all of them go
+static int section_marker_orphaned(const section_index_t *idx, int i) {
+    int j = i + 1;
+    for (; j < idx->count && !idx->items[j].marker && idx->items[j].start == idx->items[j - 1].end; j++) {
+        if (idx->items[j].action != SECTION_DROP) return 0;
+    }
+    return j > i + 1;
+}
+
+// Write the file with claimed sections rewritten by render() and dropped
+// ones removed. Bytes outside them are referenced, not copied.
+int section_rewrite(const section_index_t *idx, out_buf_t *out, pattern_set_t *seen,
+                    section_render_fn render, void *ctx) {
+    size_t pos = 0;
+
+    for (int i = 0; i < idx->count; i++) {
+        const section_t *s = &idx->items[i];
+        int drop_marker = s->marker && section_marker_orphaned(idx, i);
+        if (s->action == SECTION_KEEP && !drop_marker) continue;
+
+        out_add(out, idx->data + pos, s->start - pos);
+        pos = s->end;
+
+        if (s->action == SECTION_REPLACE && render(out, s->slot, ctx) != 0) return 1;
+        if (s->action != SECTION_KEEP && !s->managed && !s->marker && seen) {
+            section_keep_orphans(out, idx->data + s->body, s->end - s->body, seen);
+        }
+    }
+
+    out_add(out, idx->data + pos, idx->size - pos);
+    return 0;
+}
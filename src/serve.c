@@ -0,0 +1,860 @@
+// serve.c - Resident daemon that runs commands for short-lived clients
+//
+// `gitignore serve` listens on a Unix socket (GITIGNORE_SOCKET, or
+// serve.sock in the config directory). Every other invocation first tries
+// to connect to it. When that works, the client sends its arguments,
+// working directory and environment, hands over stdin, stdout and stderr
+// with SCM_RIGHTS and exits with the status the daemon sends back. When
+// nothing listens, it runs the command itself as before.
+//
+// The daemon forks a child per request, so a command runs exactly as it
+// would in-process (the client's descriptors, directory and environment)
+// and can neither crash nor leak into the daemon. What the fork saves is
+// everything before the command starts: exec and dynamic loading, libcurl
+// and TLS setup, reading the config and creating its directories. The
+// daemon also keeps an LRU of the files requests read: custom templates,
+// and ignore files already compiled into matchers. Entries are checked
+// against stat before each request that needs them, and children borrow
+// them through serve_file() and serve_rules().
+//
+// Frames, in native byte order since both ends are the same binary:
+//   request:  serve_request_t, then argv, cwd and environ as C strings
+//   response: serve_response_t carrying the exit status
+//
+// The daemon needs the peer's credentials and the path of the running
+// binary, which it knows how to get on Linux and macOS. Elsewhere
+// serve_forward() always runs commands in-process and `gitignore serve`
+// refuses to start.
+#include "gitignore.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#ifdef __APPLE__
+#include <mach-o/dyld.h>
+#endif
+
+#if defined(__linux__) || defined(__APPLE__)
+#define SERVE_SUPPORTED 1
+#endif
+
+// macOS has SO_NOSIGPIPE on the socket instead
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+extern char **environ;
+
+#define SERVE_SOCKET_FILE "serve.sock"
+#define SERVE_MAGIC 0x31534947u         // "GIS1"
+#define SERVE_MAX_PAYLOAD (4 * 1024 * 1024)
+#define SERVE_MAX_CLIENTS 64
+#define SERVE_LRU_SIZE 64
+#define SERVE_MAX_FILES 16
+#define SERVE_REFUSED (-1)              // client should run the command itself
+
+typedef struct {
+    uint32_t magic;
+    uint32_t argc;
+    uint32_t envc;
+    uint32_t payload;           // bytes of strings that follow
+    uint64_t exe_dev;           // the client binary, which must be ours
+    uint64_t exe_ino;
+    int64_t exe_mtime;
+} serve_request_t;
+
+typedef struct {
+    uint32_t magic;
+    int32_t status;
+} serve_response_t;
+
+typedef struct {
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    int64_t mtime;              // nanoseconds
+} serve_stamp_t;
+
+enum { SERVE_FILE = 1, SERVE_RULES = 2 };
+
+typedef struct {
+    int kind;                   // 0 marks a free entry
+    char *key;                  // path, or cwd and ignore files for rules
+    uint64_t used;              // last request that used it, for eviction
+    serve_stamp_t stamps[SERVE_MAX_FILES];
+    int stamp_count;
+    char *data;                 // SERVE_FILE
+    size_t size;
+    ignore_matcher_t matcher;   // SERVE_RULES
+} serve_entry_t;
+
+typedef struct {
+    int fd;                     // -1 once the client hung up
+    pid_t pid;                  // 0 marks a free slot
+} serve_client_t;
+
+static struct {
+    int child;                  // running a request in a forked child
+    uint64_t request;
+    char cwd[MAX_PATH_LEN];
+    serve_entry_t lru[SERVE_LRU_SIZE];
+    serve_client_t clients[SERVE_MAX_CLIENTS];
+    serve_stamp_t exe;
+    serve_stamp_t config;
+    int listen_fd;
+    int wake[2];                // self-pipe written by the signal handlers
+} g_serve = { .listen_fd = -1, .wake = { -1, -1 } };
+
+static volatile sig_atomic_t g_serve_stop;
+
+static int serve_socket_path(char *path, size_t len) {
+    const char *env = getenv(SOCKET_ENV);
+    if (env) {
+        if (!env[0]) return 1;      // set but empty: never use a daemon
+        snprintf(path, len, "%s", env);
+    } else {
+        const char *home = getenv("HOME");
+        if (!home) return 1;
+        snprintf(path, len, "%s/%s/%s", home, CONFIG_DIR, SERVE_SOCKET_FILE);
+    }
+    return 0;
+}
+
+// Fails for paths that do not fit in sun_path
+static int serve_address(const char *path, struct sockaddr_un *addr) {
+    size_t len = strlen(path);
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (len >= sizeof(addr->sun_path)) return 1;
+    memcpy(addr->sun_path, path, len);
+    return 0;
+}
+
+static int serve_stamp(const char *path, serve_stamp_t *s) {
+    struct stat st;
+    memset(s, 0, sizeof(*s));
+    if (stat(path, &st) != 0) return 1;
+
+    s->dev = st.st_dev;
+    s->ino = st.st_ino;
+    s->size = st.st_size;
+    s->mtime = stat_mtime_ns(&st);
+    return 0;
+}
+
+// The running binary, so a client of another build is told apart
+static int serve_exe_stamp(serve_stamp_t *s) {
+#if defined(__linux__)
+    return serve_stamp("/proc/self/exe", s);
+#elif defined(__APPLE__)
+    char path[MAX_PATH_LEN];
+    uint32_t size = sizeof(path);
+    if (_NSGetExecutablePath(path, &size) != 0) return 1;
+    return serve_stamp(path, s);
+#else
+    memset(s, 0, sizeof(*s));
+    return 1;
+#endif
+}
+
+// Whether the peer of a connection runs as the user who started the daemon
+static int serve_peer_trusted(int fd) {
+#if defined(SO_PEERCRED)
+    struct ucred cred;
+    socklen_t cred_len = sizeof(cred);
+    return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len) == 0 && cred.uid == geteuid();
+#else
+    // getpeereid() reads LOCAL_PEERCRED on macOS and the BSDs
+    uid_t uid;
+    gid_t gid;
+    return getpeereid(fd, &uid, &gid) == 0 && uid == geteuid();
+#endif
+}
+
+// Mark a new descriptor close-on-exec, and non-blocking if asked. Plain
+// socket/accept/pipe plus fcntl instead of the Linux-only flags: the
+// daemon is single-threaded, so nothing forks in between.
+static int serve_fd_flags(int fd, int nonblock) {
+    if (fd < 0) return fd;
+    if (fcntl(fd, F_SETFD, FD_CLOEXEC) != 0 ||
+        (nonblock && fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) != 0)) {
+        close(fd);
+        return -1;
+    }
+#ifdef SO_NOSIGPIPE
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+    return fd;
+}
+
+static int serve_socket(void) {
+    return serve_fd_flags(socket(AF_UNIX, SOCK_STREAM, 0), 0);
+}
+
+static int serve_stamp_equal(const serve_stamp_t *a, const serve_stamp_t *b) {
+    return a->dev == b->dev && a->ino == b->ino && a->size == b->size &&
+           a->mtime == b->mtime;
+}
+
+static int serve_write_all(int fd, const void *data, size_t len) {
+    const char *p = data;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return 1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int serve_read_all(int fd, void *data, size_t len) {
+    char *p = data;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// --- Client ---------------------------------------------------------------
+
+static int serve_append(char **buf, size_t *len, size_t *cap, const char *s) {
+    size_t n = strlen(s) + 1;
+    if (*len + n > *cap) {
+        size_t grown = *cap ? *cap * 2 : 4096;
+        while (grown < *len + n) grown *= 2;
+        char *p = realloc(*buf, grown);
+        if (!p) return 1;
+        *buf = p;
+        *cap = grown;
+    }
+    memcpy(*buf + *len, s, n);
+    *len += n;
+    return 0;
+}
+
+// Hand the command to a running daemon. Returns 0 with *status set when it
+// ran there, nonzero when the caller should run it in-process.
+int serve_forward(int argc, char *argv[], int *status) {
+#ifndef SERVE_SUPPORTED
+    return 1;
+#endif
+    char path[MAX_PATH_LEN];
+    if (serve_socket_path(path, sizeof(path)) != 0) return 1;
+
+    // Usually there is no daemon: one access() instead of socket+connect+close
+    struct sockaddr_un addr;
+    if (serve_address(path, &addr) != 0 || access(path, F_OK) != 0) return 1;
+    int fd = serve_socket();
+    if (fd < 0) return 1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return 1;
+    }
+
+    char cwd[MAX_PATH_LEN];
+    char *payload = NULL;
+    size_t len = 0, cap = 0;
+    int rc = getcwd(cwd, sizeof(cwd)) ? 0 : 1;
+    for (int i = 0; rc == 0 && i < argc; i++) rc = serve_append(&payload, &len, &cap, argv[i]);
+    if (rc == 0) rc = serve_append(&payload, &len, &cap, cwd);
+
+    uint32_t envc = 0;
+    for (char **e = environ; rc == 0 && *e; e++, envc++) rc = serve_append(&payload, &len, &cap, *e);
+    if (rc != 0 || len > SERVE_MAX_PAYLOAD) {
+        free(payload);
+        close(fd);
+        return 1;
+    }
+
+    serve_request_t req;
+    serve_stamp_t exe;
+    memset(&req, 0, sizeof(req));
+    if (serve_exe_stamp(&exe) != 0) {
+        free(payload);
+        close(fd);
+        return 1;
+    }
+    req.magic = SERVE_MAGIC;
+    req.argc = (uint32_t)argc;
+    req.envc = envc;
+    req.payload = (uint32_t)len;
+    req.exe_dev = (uint64_t)exe.dev;
+    req.exe_ino = (uint64_t)exe.ino;
+    req.exe_mtime = exe.mtime;
+
+    // stdin, stdout and stderr travel with the first byte of the request
+    int fds[3] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+    char control[CMSG_SPACE(sizeof(fds))];
+    memset(control, 0, sizeof(control));
+
+    struct iovec iov[2] = { { &req, sizeof(req) }, { payload, len } };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    ssize_t sent;
+    do {
+        sent = sendmsg(fd, &msg, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+
+    // Nothing has run yet if the request did not go out
+    if (sent < (ssize_t)sizeof(req)) {
+        free(payload);
+        close(fd);
+        return 1;
+    }
+    rc = serve_write_all(fd, payload + (sent - (ssize_t)sizeof(req)),
+                         len - (size_t)(sent - (ssize_t)sizeof(req)));
+    free(payload);
+
+    serve_response_t resp;
+    if (rc == 0) rc = serve_read_all(fd, &resp, sizeof(resp));
+    close(fd);
+
+    if (rc == 0 && resp.magic == SERVE_MAGIC && resp.status == SERVE_REFUSED) return 1;
+    if (rc != 0 || resp.magic != SERVE_MAGIC) {
+        print_error("Lost connection to gitignore serve", ERR_NETWORK_ERROR);
+        *status = 1;
+        return 0;
+    }
+
+    *status = resp.status;
+    return 0;
+}
+
+// --- Resident files -------------------------------------------------------
+
+static void serve_entry_free(serve_entry_t *e) {
+    if (e->kind == SERVE_RULES) matcher_free(&e->matcher);
+    free(e->data);
+    free(e->key);
+    memset(e, 0, sizeof(*e));
+}
+
+static serve_entry_t* serve_find(int kind, const char *key) {
+    for (int i = 0; i < SERVE_LRU_SIZE; i++) {
+        serve_entry_t *e = &g_serve.lru[i];
+        if (e->kind == kind && strcmp(e->key, key) == 0) return e;
+    }
+    return NULL;
+}
+
+// A free entry, or the least recently used one emptied
+static serve_entry_t* serve_evict(void) {
+    serve_entry_t *victim = &g_serve.lru[0];
+    for (int i = 0; i < SERVE_LRU_SIZE; i++) {
+        serve_entry_t *e = &g_serve.lru[i];
+        if (!e->kind) return e;
+        if (e->used < victim->used) victim = e;
+    }
+    serve_entry_free(victim);
+    return victim;
+}
+
+// Whether every file an entry was built from is unchanged
+static int serve_entry_current(const serve_entry_t *e, char **paths, int count) {
+    if (e->stamp_count != count) return 0;
+    for (int i = 0; i < count; i++) {
+        serve_stamp_t now;
+        if (serve_stamp(paths[i], &now) != 0 || !serve_stamp_equal(&now, &e->stamps[i])) return 0;
+    }
+    return 1;
+}
+
+static int serve_rules_key(char *key, size_t len, const char *cwd, char **sources, int count) {
+    size_t n = (size_t)snprintf(key, len, "%s", cwd);
+    for (int i = 0; i < count && n < len; i++) {
+        n += (size_t)snprintf(key + n, len - n, "\n%s", sources[i]);
+    }
+    return n < len ? 0 : 1;
+}
+
+static void serve_load_file(const char *path) {
+    serve_entry_t *e = serve_find(SERVE_FILE, path);
+    char *paths[] = { (char *)path };
+    if (e && serve_entry_current(e, paths, 1)) {
+        e->used = g_serve.request;
+        return;
+    }
+    if (e) serve_entry_free(e);
+
+    serve_stamp_t stamp;
+    if (serve_stamp(path, &stamp) != 0) return;
+
+    e = serve_evict();
+    e->key = strdup(path);
+    e->data = read_file(path, &e->size);
+    if (!e->key || !e->data) {
+        serve_entry_free(e);
+        return;
+    }
+    e->kind = SERVE_FILE;
+    e->stamps[0] = stamp;
+    e->stamp_count = 1;
+    e->used = g_serve.request;
+}
+
+// Compile the ignore files a check reads, relative to the client's cwd
+static void serve_load_rules(char **sources, int count) {
+    char key[MAX_PATH_LEN * 4];
+    if (count > SERVE_MAX_FILES || serve_rules_key(key, sizeof(key), g_serve.cwd, sources, count) != 0) {
+        return;
+    }
+
+    serve_entry_t *e = serve_find(SERVE_RULES, key);
+    if (e && serve_entry_current(e, sources, count)) {
+        e->used = g_serve.request;
+        return;
+    }
+    if (e) serve_entry_free(e);
+
+    e = serve_evict();
+    matcher_init(&e->matcher);
+    e->kind = SERVE_RULES;
+    e->key = strdup(key);
+    for (int i = 0; i < count; i++) {
+        if (!e->key || serve_stamp(sources[i], &e->stamps[i]) != 0 ||
+            matcher_add_file(&e->matcher, sources[i]) != 0) {
+            serve_entry_free(e);
+            return;
+        }
+    }
+    e->stamp_count = count;
+    e->used = g_serve.request;
+}
+
+static int serve_is_global_flag(const char *arg, int *takes_value) {
+    static const char *flags[] = {
+        "--dry-run", "--verbose", "-V", "--quiet", "-q", "--fsync", "--minimal",
+        "--timings", "--timings=table", "--timings=json", NULL
+    };
+    *takes_value = strcmp(arg, "--jobs") == 0 || strcmp(arg, "-j") == 0;
+    if (*takes_value || strncmp(arg, "--jobs=", 7) == 0) return 1;
+    for (int i = 0; flags[i]; i++) {
+        if (strcmp(arg, flags[i]) == 0) return 1;
+    }
+    return 0;
+}
+
+// Bring the files this request will read into the LRU, so the child
+// inherits them. Runs in the client's working directory.
+static void serve_prepare(int argc, char **argv) {
+    int i = 1, takes_value;
+    while (i < argc && serve_is_global_flag(argv[i], &takes_value)) i += takes_value ? 2 : 1;
+    if (i >= argc) return;
+
+    const char *cmd = argv[i++];
+    if (strcmp(cmd, "check") == 0) {
+        char *fallback = ".gitignore";
+        char *sources[SERVE_MAX_FILES];
+        int count = 0;
+        for (; i < argc && strcmp(argv[i], "--") != 0; i++) {
+            if ((strcmp(argv[i], "--from") == 0 || strcmp(argv[i], "-f") == 0) && i + 1 < argc) {
+                if (count == SERVE_MAX_FILES) return;
+                sources[count++] = argv[++i];
+            }
+        }
+        if (count == 0) sources[count++] = fallback;
+        serve_load_rules(sources, count);
+    } else if (strcmp(cmd, "init") == 0 || strcmp(cmd, "--init") == 0 || strcmp(cmd, "-i") == 0 ||
+               strcmp(cmd, "append") == 0 || strcmp(cmd, "update") == 0) {
+        for (; i < argc; i++) {
+            if (argv[i][0] == '-') continue;
+            char path[MAX_PATH_LEN];
+            if (template_path(argv[i], path) == 0) serve_load_file(path);
+        }
+    }
+}
+
+// Contents of a custom template the daemon holds, for a forked request
+const char* serve_file(const char *path, size_t *size) {
+    if (!g_serve.child) return NULL;
+
+    serve_entry_t *e = serve_find(SERVE_FILE, path);
+    if (!e || e->used != g_serve.request) return NULL;
+    *size = e->size;
+    return e->data;
+}
+
+// Rules compiled by the daemon from these ignore files, for a forked request
+const ignore_matcher_t* serve_rules(char **sources, int count) {
+    if (!g_serve.child) return NULL;
+
+    char key[MAX_PATH_LEN * 4];
+    if (serve_rules_key(key, sizeof(key), g_serve.cwd, sources, count) != 0) return NULL;
+    serve_entry_t *e = serve_find(SERVE_RULES, key);
+    if (!e || e->used != g_serve.request) return NULL;
+    return &e->matcher;
+}
+
+// --- Daemon ---------------------------------------------------------------
+
+static void serve_on_signal(int sig) {
+    int saved = errno;
+    if (sig != SIGCHLD) g_serve_stop = 1;
+    if (write(g_serve.wake[1], "", 1) < 0) {
+        // The pipe is full, so a wakeup is already pending
+    }
+    errno = saved;
+}
+
+static void serve_respond(int fd, int status) {
+    serve_response_t resp = { SERVE_MAGIC, status };
+    serve_write_all(fd, &resp, sizeof(resp));
+}
+
+// Settings come from the config file; each client's environment is
+// applied on top in its child
+static void serve_load_config(void) {
+    const app_paths_t *paths = app_paths();
+    serve_stamp_t now;
+    serve_stamp(paths ? paths->config_file : CONFIG_FILE, &now);
+    if (g_config && serve_stamp_equal(&now, &g_serve.config)) return;
+
+    config_t *config = load_config();
+    if (!config) return;
+    free_config(g_config);
+    g_config = config;
+    g_serve.config = now;
+}
+
+static void serve_child(int fds[3], int argc, char **argv, char **env, int envc) {
+    signal(SIGCHLD, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    signal(SIGINT, SIG_DFL);
+    signal(SIGPIPE, SIG_DFL);
+
+    close(g_serve.listen_fd);
+    close(g_serve.wake[0]);
+    close(g_serve.wake[1]);
+    for (int i = 0; i < SERVE_MAX_CLIENTS; i++) {
+        if (g_serve.clients[i].pid && g_serve.clients[i].fd >= 0) close(g_serve.clients[i].fd);
+    }
+
+    for (int i = 0; i < 3; i++) {
+        if (fds[i] != i) {
+            dup2(fds[i], i);
+            close(fds[i]);
+        }
+    }
+
+    if (chdir(g_serve.cwd) != 0) {
+        print_error("Cannot enter the working directory", ERR_FILE_NOT_FOUND);
+        _exit(1);
+    }
+
+    // The environment and settings a fresh process would have seen
+    const char *home = getenv("HOME");
+    char *daemon_home = home ? strdup(home) : NULL;
+    static char *no_env[] = { NULL };
+    environ = no_env;
+    for (int i = 0; i < envc; i++) putenv(env[i]);
+    g_serve.child = 1;
+
+    home = getenv("HOME");
+    if (!home || !daemon_home || strcmp(home, daemon_home) != 0) {
+        free_config(g_config);
+        g_config = load_config();
+    } else {
+        config_apply_env(g_config);
+        if (!g_config->use_color_set) g_config->use_color = isatty(STDOUT_FILENO);
+    }
+    free(daemon_home);
+
+    timing_reset();
+    int span = timing_begin("run");
+    int result = parse_flags(argc, argv);
+    timing_end(span);
+
+    if (g_config && g_config->timings) {
+        timing_report(stderr, g_config->timings == TIMINGS_JSON);
+    }
+    fflush(NULL);
+    _exit(result);
+}
+
+// Take one request off a new connection and start its child
+static void serve_accept(int fd) {
+    serve_request_t req;
+    int fds[3] = { -1, -1, -1 };
+    char control[CMSG_SPACE(sizeof(fds))];
+
+    struct iovec iov = { &req, sizeof(req) };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    // A client that stalls must not hold up the others for long
+    struct timeval timeout = { 2, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    ssize_t n;
+    do {
+        n = recvmsg(fd, &msg, MSG_WAITALL);
+    } while (n < 0 && errno == EINTR);
+
+    struct cmsghdr *cmsg = n > 0 ? CMSG_FIRSTHDR(&msg) : NULL;
+    if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS &&
+        cmsg->cmsg_len == CMSG_LEN(sizeof(fds))) {
+        memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+        for (int i = 0; i < 3; i++) {
+            if (fds[i] >= 0) fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+        }
+    }
+
+    // Only the user who started the daemon may run commands through it
+    int same_user = serve_peer_trusted(fd);
+
+    char *payload = NULL;
+    char **strings = NULL;
+    int ok = same_user && n == (ssize_t)sizeof(req) && fds[0] >= 0 && req.magic == SERVE_MAGIC &&
+             req.payload <= SERVE_MAX_PAYLOAD && req.argc >= 1 &&
+             // argc + envc + 1 strings of at least one byte each, checked
+             // one count at a time so the sum cannot wrap
+             req.argc < req.payload && req.envc < req.payload - req.argc;
+
+    // A different build answers for itself
+    int same_build = req.exe_dev == (uint64_t)g_serve.exe.dev && req.exe_ino == (uint64_t)g_serve.exe.ino &&
+                     req.exe_mtime == g_serve.exe.mtime;
+
+    if (ok && same_build) {
+        payload = malloc((size_t)req.payload + 1);
+        strings = malloc(((size_t)req.argc + req.envc + 2) * sizeof(char *));
+        ok = payload && strings && serve_read_all(fd, payload, req.payload) == 0;
+    }
+
+    // Split the payload: argv, cwd, environ
+    uint32_t count = 0;
+    if (ok && same_build) {
+        payload[req.payload] = '\0';
+        for (char *p = payload; p < payload + req.payload && count < req.argc + req.envc + 1;
+             p += strlen(p) + 1) {
+            strings[count++] = p;
+        }
+        ok = count == req.argc + req.envc + 1;
+    }
+
+    int slot = -1;
+    for (int i = 0; i < SERVE_MAX_CLIENTS && slot < 0; i++) {
+        if (!g_serve.clients[i].pid) slot = i;
+    }
+
+    if (!ok || !same_build || slot < 0) {
+        if (!same_build || slot < 0) serve_respond(fd, SERVE_REFUSED);
+        for (int i = 0; i < 3; i++) if (fds[i] >= 0) close(fds[i]);
+        free(strings);
+        free(payload);
+        close(fd);
+        return;
+    }
+
+    char **argv = strings;
+    char **env = strings + req.argc + 1;
+    strings[req.argc + req.envc + 1] = NULL;
+    snprintf(g_serve.cwd, sizeof(g_serve.cwd), "%s", strings[req.argc]);
+    g_serve.request++;
+
+    serve_load_config();
+    if (chdir(g_serve.cwd) == 0) {
+        serve_prepare((int)req.argc, argv);
+        if (chdir("/") != 0) {
+            // The daemon has no use for its own working directory
+        }
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fd);
+        serve_child(fds, (int)req.argc, argv, env, (int)req.envc);
+    }
+
+    for (int i = 0; i < 3; i++) close(fds[i]);
+    free(strings);
+    free(payload);
+
+    if (pid < 0) {
+        serve_respond(fd, SERVE_REFUSED);
+        close(fd);
+        return;
+    }
+
+    g_serve.clients[slot].fd = fd;
+    g_serve.clients[slot].pid = pid;
+    if (g_config && g_config->verbose) fprintf(stderr, "serve: request %llu in %s (pid %d)\n",
+                                   (unsigned long long)g_serve.request, g_serve.cwd, (int)pid);
+}
+
+// Send the exit status of every finished child to its client
+static void serve_reap(void) {
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        for (int i = 0; i < SERVE_MAX_CLIENTS; i++) {
+            serve_client_t *c = &g_serve.clients[i];
+            if (c->pid != pid) continue;
+
+            if (c->fd >= 0) {
+                serve_respond(c->fd, WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status));
+                close(c->fd);
+            }
+            c->pid = 0;
+            c->fd = -1;
+        }
+    }
+}
+
+static int serve_active(void) {
+    int active = 0;
+    for (int i = 0; i < SERVE_MAX_CLIENTS; i++) active += g_serve.clients[i].pid != 0;
+    return active;
+}
+
+int serve_daemon(const char *socket_path, int idle_seconds) {
+#ifndef SERVE_SUPPORTED
+    print_error("gitignore serve is not supported on this platform", ERR_INVALID_ARGUMENT);
+    return 1;
+#endif
+    char path[MAX_PATH_LEN];
+    if (socket_path) {
+        snprintf(path, sizeof(path), "%s", socket_path);
+    } else if (serve_socket_path(path, sizeof(path)) != 0) {
+        print_error("No usable socket path (HOME unset or GITIGNORE_SOCKET empty)", ERR_INVALID_ARGUMENT);
+        return 1;
+    } else if (!getenv(SOCKET_ENV)) {
+        app_paths_ensure(APP_DIR_CONFIG);
+    }
+
+    struct sockaddr_un addr;
+    if (serve_address(path, &addr) != 0) {
+        print_error("Socket path is too long", ERR_INVALID_ARGUMENT);
+        return 1;
+    }
+
+    // A socket nobody answers on is left over from a daemon that died
+    int probe = serve_socket();
+    if (probe >= 0 && connect(probe, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+        close(probe);
+        print_error("gitignore serve is already running on this socket", ERR_INVALID_ARGUMENT);
+        return 1;
+    }
+    if (probe >= 0) close(probe);
+    unlink(path);
+
+    // Environment overrides belong to each client, not to the daemon
+    unsetenv(TEMPLATE_URL_ENV);
+    unsetenv(TEMPLATE_SOURCE_ENV);
+    unsetenv(ARCHIVE_URL_ENV);
+    serve_load_config();
+    if (serve_exe_stamp(&g_serve.exe) != 0) {
+        print_error("Cannot locate the gitignore binary", ERR_FILE_NOT_FOUND);
+        return 1;
+    }
+    if (fetch_init() != 0) return 1;
+
+    g_serve.listen_fd = serve_socket();
+    mode_t old_mask = umask(077);
+    int bound = g_serve.listen_fd >= 0 && bind(g_serve.listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == 0;
+    umask(old_mask);
+    if (!bound || listen(g_serve.listen_fd, SERVE_MAX_CLIENTS) != 0 ||
+        pipe(g_serve.wake) != 0 || serve_fd_flags(g_serve.wake[0], 1) < 0 ||
+        serve_fd_flags(g_serve.wake[1], 1) < 0) {
+        char msg[MAX_PATH_LEN + 64];
+        snprintf(msg, sizeof(msg), "Cannot listen on %s: %s", path, strerror(errno));
+        print_error(msg, ERR_PERMISSION_DENIED);
+        if (g_serve.listen_fd >= 0) close(g_serve.listen_fd);
+        return 1;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = serve_on_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGCHLD, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGINT, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    for (int i = 0; i < SERVE_MAX_CLIENTS; i++) g_serve.clients[i].fd = -1;
+    if (chdir("/") != 0) {
+        // Only relative paths would notice, and requests never use ours
+    }
+
+    print_success("gitignore serve is listening");
+    printf("  Socket: %s\n", path);
+    fflush(stdout);
+
+    struct pollfd pfds[2 + SERVE_MAX_CLIENTS];
+    int slots[SERVE_MAX_CLIENTS];
+    while (!g_serve_stop) {
+        int n = 0;
+        pfds[n++] = (struct pollfd){ g_serve.listen_fd, POLLIN, 0 };
+        pfds[n++] = (struct pollfd){ g_serve.wake[0], POLLIN, 0 };
+        for (int i = 0; i < SERVE_MAX_CLIENTS; i++) {
+            if (g_serve.clients[i].pid && g_serve.clients[i].fd >= 0) {
+                slots[n - 2] = i;
+                pfds[n++] = (struct pollfd){ g_serve.clients[i].fd, POLLIN, 0 };
+            }
+        }
+
+        int timeout = idle_seconds > 0 && !serve_active() ? idle_seconds * 1000 : -1;
+        int ready = poll(pfds, (nfds_t)n, timeout);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (ready == 0) break;      // idle for long enough
+
+        if (pfds[1].revents) {
+            char drain[64];
+            while (read(g_serve.wake[0], drain, sizeof(drain)) > 0) {}
+            serve_reap();
+        }
+
+        // A client that goes away (Ctrl-C) takes its command with it
+        for (int k = 2; k < n; k++) {
+            serve_client_t *c = &g_serve.clients[slots[k - 2]];
+            if (pfds[k].revents && c->pid && c->fd == pfds[k].fd) {
+                kill(c->pid, SIGTERM);
+                close(c->fd);
+                c->fd = -1;
+            }
+        }
+
+        if (pfds[0].revents & POLLIN) {
+            int fd = serve_fd_flags(accept(g_serve.listen_fd, NULL, NULL), 0);
+            if (fd >= 0) serve_accept(fd);
+        }
+    }
+
+    close(g_serve.listen_fd);
+    unlink(path);
+    for (int i = 0; i < SERVE_LRU_SIZE; i++) {
+        if (g_serve.lru[i].kind) serve_entry_free(&g_serve.lru[i]);
+    }
+    if (!g_config || !g_config->quiet) print_info("gitignore serve stopped");
+    return 0;
+}
@@ -0,0 +1,607 @@
+// source.c - Templates from a local copy of github/gitignore
+//
+// template_source (or GITIGNORE_TEMPLATE_SOURCE) names a clone of the
+// upstream repository, or a .tar / .tar.gz of one. Templates are found in
+// its top level, Global/ and community/, in that order of preference.
+//
+// The first lookup builds an index in the cache directory:
+//
+//   [header][slots (open addressing on the case-folded name)][strings]
+//
+// Slots hold a template's path in a clone, or its offset in the tar. The
+// header records the source's path and modification stamp, and a changed
+// source is indexed again. A compressed tarball is inflated once next to
+// the index, so every lookup is a hash probe plus an mmap.
+#include "gitignore.h"
+#include <ctype.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <zlib.h>
+
+#define SOURCE_INDEX_FILE "source.idx"
+#define SOURCE_TAR_FILE "source.tar"
+#define SOURCE_MAGIC "GISRCX1"
+#define SOURCE_VERSION 1
+#define SOURCE_SUFFIX ".gitignore"
+#define SOURCE_MAX_DEPTH 4
+
+enum { SOURCE_DIR = 1, SOURCE_TAR = 2, SOURCE_TAR_GZ = 3 };
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t kind;
+    uint32_t slot_count;
+    uint32_t entry_count;
+    uint64_t path_hash;         // of the configured source path
+    int64_t stamp;              // modification stamp of the source
+    int64_t source_size;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+} source_header_t;
+
+typedef struct {
+    uint64_t name_hash;         // of the case-folded name; 0 marks an empty slot
+    uint64_t offset;            // tar: member data; clone: path in the strings
+    uint64_t size;              // tar: member size; clone: path length
+    uint32_t name_offset;
+    uint16_t name_len;
+    uint16_t rank;              // 0 top level, 1 Global/, 2 community/
+} source_slot_t;
+
+typedef struct source_mapping {
+    void *addr;
+    size_t len;
+    struct source_mapping *next;
+} source_mapping_t;
+
+// Index under construction
+typedef struct {
+    source_slot_t *slots;
+    uint32_t slot_count;
+    uint32_t count;
+    char *strings;
+    size_t strings_size;
+    size_t strings_cap;
+} source_build_t;
+
+static struct {
+    int loaded;
+    int failed;
+    const uint8_t *index;
+    size_t index_len;
+    const uint8_t *tar;         // mapped archive for tar sources
+    size_t tar_len;
+    source_mapping_t *files;    // template files mapped from a clone
+} g_source;
+
+int source_enabled(void) {
+    return g_config && g_config->template_source[0] != '\0';
+}
+
+static uint64_t source_name_hash(const char *name, size_t len) {
+    char folded[256];
+    if (len >= sizeof(folded)) len = sizeof(folded) - 1;
+    for (size_t i = 0; i < len; i++) {
+        folded[i] = (char)tolower((unsigned char)name[i]);
+    }
+    uint64_t h = hash_bytes(folded, len);
+    return h ? h : 1;
+}
+
+// Rank of a path relative to the repository root, or -1 to ignore it
+static int source_rank(const char *rel) {
+    const char *slash = strchr(rel, '/');
+    if (!slash) return 0;
+    if (strncmp(rel, "Global/", 7) == 0) return 1;
+    if (strncmp(rel, "community/", 10) == 0) return 2;
+    return -1;
+}
+
+static int source_add_string(source_build_t *b, const char *s, size_t len, uint32_t *offset) {
+    if (b->strings_size + len + 1 > b->strings_cap) {
+        size_t cap = b->strings_cap ? b->strings_cap * 2 : 64 * 1024;
+        while (cap < b->strings_size + len + 1) cap *= 2;
+        char *grown = realloc(b->strings, cap);
+        if (!grown) return 1;
+        b->strings = grown;
+        b->strings_cap = cap;
+    }
+    memcpy(b->strings + b->strings_size, s, len);
+    b->strings[b->strings_size + len] = '\0';
+    *offset = (uint32_t)b->strings_size;
+    b->strings_size += len + 1;
+    return 0;
+}
+
+static int source_grow(source_build_t *b) {
+    uint32_t count = b->slot_count ? b->slot_count * 2 : 1024;
+    source_slot_t *slots = calloc(count, sizeof(source_slot_t));
+    if (!slots) return 1;
+
+    for (uint32_t i = 0; i < b->slot_count; i++) {
+        source_slot_t *s = &b->slots[i];
+        if (s->name_hash == 0) continue;
+        uint32_t j = (uint32_t)s->name_hash & (count - 1);
+        while (slots[j].name_hash != 0) j = (j + 1) & (count - 1);
+        slots[j] = *s;
+    }
+
+    free(b->slots);
+    b->slots = slots;
+    b->slot_count = count;
+    return 0;
+}
+
+// Record a template found at rel (relative to the repository root). A name
+// seen before keeps whichever copy ranks first.
+static int source_add(source_build_t *b, const char *rel, uint64_t offset, uint64_t size) {
+    int rank = source_rank(rel);
+    const char *base = strrchr(rel, '/');
+    base = base ? base + 1 : rel;
+    size_t base_len = strlen(base);
+    size_t suffix_len = strlen(SOURCE_SUFFIX);
+    if (rank < 0 || base_len <= suffix_len || base_len - suffix_len > 200 ||
+        strcmp(base + base_len - suffix_len, SOURCE_SUFFIX) != 0) {
+        return 0;
+    }
+    size_t name_len = base_len - suffix_len;
+
+    if ((b->count + 1) * 2 > b->slot_count && source_grow(b) != 0) return 1;
+
+    uint64_t hash = source_name_hash(base, name_len);
+    uint32_t mask = b->slot_count - 1;
+    uint32_t i = (uint32_t)hash & mask;
+    for (; b->slots[i].name_hash != 0; i = (i + 1) & mask) {
+        source_slot_t *s = &b->slots[i];
+        if (s->name_hash == hash && s->name_len == name_len &&
+            strncasecmp(b->strings + s->name_offset, base, name_len) == 0) {
+            if (rank >= s->rank) return 0;
+            break;
+        }
+    }
+
+    source_slot_t slot;
+    memset(&slot, 0, sizeof(slot));
+    slot.name_hash = hash;
+    slot.name_len = (uint16_t)name_len;
+    slot.rank = (uint16_t)rank;
+    slot.offset = offset;
+    slot.size = size;
+    if (source_add_string(b, base, name_len, &slot.name_offset) != 0) return 1;
+
+    if (b->slots[i].name_hash == 0) b->count++;
+    b->slots[i] = slot;
+    return 0;
+}
+
+// Templates of a clone: the top level, then Global/ and community/ below it
+static int source_scan_dir(source_build_t *b, const char *root, const char *rel, int depth) {
+    char path[MAX_PATH_LEN * 2];
+    snprintf(path, sizeof(path), "%s%s%s", root, rel[0] ? "/" : "", rel);
+
+    DIR *dir = opendir(path);
+    if (!dir) return depth == 0 ? 1 : 0;
+
+    int rc = 0;
+    struct dirent *d;
+    while (rc == 0 && (d = readdir(dir)) != NULL) {
+        if (d->d_name[0] == '.') continue;
+
+        char child[MAX_PATH_LEN];
+        int n = snprintf(child, sizeof(child), "%s%s%s", rel, rel[0] ? "/" : "", d->d_name);
+        if (n < 0 || (size_t)n >= sizeof(child)) continue;
+
+        int is_dir = d->d_type == DT_DIR;
+        if (d->d_type == DT_UNKNOWN) {
+            char full[MAX_PATH_LEN * 2];
+            struct stat st;
+            snprintf(full, sizeof(full), "%s/%s", root, child);
+            is_dir = stat(full, &st) == 0 && S_ISDIR(st.st_mode);
+        }
+
+        if (is_dir) {
+            if (depth == 0 && strcmp(d->d_name, "Global") != 0 && strcmp(d->d_name, "community") != 0) continue;
+            if (depth < SOURCE_MAX_DEPTH) rc = source_scan_dir(b, root, child, depth + 1);
+        } else if ((size_t)n > strlen(SOURCE_SUFFIX) &&
+                   strcmp(child + n - strlen(SOURCE_SUFFIX), SOURCE_SUFFIX) == 0) {
+            uint32_t path_offset;
+            rc = source_add_string(b, child, (size_t)n, &path_offset);
+            if (rc == 0) rc = source_add(b, child, path_offset, (uint64_t)n);
+        }
+    }
+
+    closedir(dir);
+    return rc;
+}
+
+// Numeric tar header field: octal digits, space or NUL padded
+uint64_t tar_octal(const char *field, size_t len) {
+    uint64_t v = 0;
+    for (size_t i = 0; i < len && field[i]; i++) {
+        if (field[i] == ' ') continue;
+        if (field[i] < '0' || field[i] > '7') break;
+        v = v * 8 + (uint64_t)(field[i] - '0');
+    }
+    return v;
+}
+
+// Value of one record ("path", "comment", ...) of a pax extended header
+int tar_pax_value(const char *data, size_t size, const char *key, char *out, size_t out_len) {
+    size_t key_len = strlen(key);
+    const char *p = data, *end = data + size;
+    while (p < end) {
+        char *rec_end;
+        unsigned long len = strtoul(p, &rec_end, 10);
+        if (len == 0 || rec_end >= end || p + len > end) break;
+
+        const char *kv = rec_end + 1;
+        if ((size_t)(p + len - kv) > key_len + 1 && strncmp(kv, key, key_len) == 0 &&
+            kv[key_len] == '=') {
+            const char *value = kv + key_len + 1;
+            size_t n = (size_t)(p + len - 1 - value);
+            if (n >= out_len) n = out_len - 1;
+            memcpy(out, value, n);
+            out[n] = '\0';
+            return 1;
+        }
+        p += len;
+    }
+    return 0;
+}
+
+// Templates of an uncompressed tar. Archives of a repository usually have
+// one top directory (github's are "gitignore-main/"); it is dropped.
+static int source_scan_tar(source_build_t *b, const uint8_t *tar, size_t len) {
+    char long_name[MAX_PATH_LEN] = "";
+    size_t off = 0;
+
+    while (off + 512 <= len) {
+        const char *h = (const char *)tar + off;
+        if (h[0] == '\0') break;        // end-of-archive blocks
+
+        uint64_t size = tar_octal(h + 124, 12);
+        char type = h[156];
+        size_t data = off + 512;
+        if (data + size > len) break;
+
+        char name[MAX_PATH_LEN];
+        if (long_name[0]) {
+            snprintf(name, sizeof(name), "%s", long_name);
+            long_name[0] = '\0';
+        } else if (memcmp(h + 257, "ustar", 5) == 0 && h[345]) {
+            snprintf(name, sizeof(name), "%.155s/%.100s", h + 345, h);
+        } else {
+            snprintf(name, sizeof(name), "%.100s", h);
+        }
+
+        if (type == 'L') {
+            size_t n = size < sizeof(long_name) ? (size_t)size : sizeof(long_name) - 1;
+            memcpy(long_name, tar + data, n);
+            long_name[n] = '\0';
+        } else if (type == 'x') {
+            tar_pax_value((const char *)tar + data, (size_t)size, "path", long_name, sizeof(long_name));
+        } else if (type == '0' || type == '\0') {
+            const char *rel = name;
+            const char *slash = strchr(name, '/');
+            if (slash && strncmp(name, "Global/", 7) != 0 && strncmp(name, "community/", 10) != 0) {
+                rel = slash + 1;
+            }
+            if (source_add(b, rel, data, size) != 0) return 1;
+        }
+
+        off = data + ((size + 511) & ~(uint64_t)511);
+    }
+    return 0;
+}
+
+static char* source_cache_file(const char *name) {
+    const app_paths_t *paths = app_paths();
+    if (!paths || app_paths_ensure(APP_DIR_CACHE) != 0) return NULL;
+
+    char *path = malloc(MAX_PATH_LEN);
+    if (path && path_join(path, paths->cache_dir, name) != 0) {
+        free(path);
+        return NULL;
+    }
+    return path;
+}
+
+static void source_stamp_path(const char *path, int64_t *stamp) {
+    struct stat st;
+    if (stat(path, &st) == 0) {
+        int64_t t = stat_mtime_ns(&st);
+        if (t > *stamp) *stamp = t;
+    }
+}
+
+// What the index is keyed on. A clone's stamp covers the directories that
+// hold templates and the git index, which every checkout or pull rewrites.
+static int source_stamp(const char *source, int *kind, int64_t *stamp, int64_t *size) {
+    struct stat st;
+    if (stat(source, &st) != 0) return 1;
+
+    *stamp = stat_mtime_ns(&st);
+    *size = S_ISDIR(st.st_mode) ? 0 : (int64_t)st.st_size;
+
+    if (!S_ISDIR(st.st_mode)) {
+        unsigned char magic[2] = { 0, 0 };
+        int fd = open(source, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return 1;
+        ssize_t n = read(fd, magic, 2);
+        close(fd);
+        *kind = n == 2 && magic[0] == 0x1f && magic[1] == 0x8b ? SOURCE_TAR_GZ : SOURCE_TAR;
+        return 0;
+    }
+
+    *kind = SOURCE_DIR;
+    static const char *parts[] = { "Global", "community", ".git/index", NULL };
+    char path[MAX_PATH_LEN * 2];
+    for (int i = 0; parts[i]; i++) {
+        snprintf(path, sizeof(path), "%s/%s", source, parts[i]);
+        source_stamp_path(path, stamp);
+    }
+
+    // community/ groups templates one level down
+    snprintf(path, sizeof(path), "%s/community", source);
+    DIR *dir = opendir(path);
+    struct dirent *d;
+    while (dir && (d = readdir(dir)) != NULL) {
+        if (d->d_name[0] == '.' || (d->d_type != DT_DIR && d->d_type != DT_UNKNOWN)) continue;
+        snprintf(path, sizeof(path), "%s/community/%s", source, d->d_name);
+        source_stamp_path(path, stamp);
+    }
+    if (dir) closedir(dir);
+    return 0;
+}
+
+static const uint8_t* source_map_file(const char *path, size_t *len) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    void *addr = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        addr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (addr == MAP_FAILED) return NULL;
+
+    *len = (size_t)st.st_size;
+    return addr;
+}
+
+// Inflate a .tar.gz into the cache so it can be mapped
+static int source_inflate(const char *source, const char *dest) {
+    gzFile in = gzopen(source, "rb");
+    if (!in) return 1;
+
+    char tmp[MAX_PATH_LEN + 16];
+    snprintf(tmp, sizeof(tmp), "%s.XXXXXX", dest);
+    int fd = mkstemp(tmp);
+    if (fd < 0) {
+        gzclose(in);
+        return 1;
+    }
+
+    static char buf[256 * 1024];
+    int rc = 0, n;
+    while ((n = gzread(in, buf, sizeof(buf))) > 0) {
+        if (write(fd, buf, (size_t)n) != n) {
+            rc = 1;
+            break;
+        }
+    }
+    if (n < 0) rc = 1;
+    gzclose(in);
+    if (close(fd) != 0) rc = 1;
+
+    if (rc == 0 && rename(tmp, dest) != 0) rc = 1;
+    if (rc != 0) unlink(tmp);
+    return rc;
+}
+
+static int source_write_index(const char *path, const source_header_t *h, const source_build_t *b) {
+    char tmp[MAX_PATH_LEN + 16];
+    snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path);
+    int fd = mkstemp(tmp);
+    if (fd < 0) return 1;
+
+    struct iovec iov[3] = {
+        { (void *)h, sizeof(*h) },
+        { b->slots, (size_t)b->slot_count * sizeof(source_slot_t) },
+        { b->strings, b->strings_size },
+    };
+    size_t want = iov[0].iov_len + iov[1].iov_len + iov[2].iov_len;
+    int rc = writev(fd, iov, 3) == (ssize_t)want ? 0 : 1;
+    if (close(fd) != 0) rc = 1;
+
+    if (rc == 0 && rename(tmp, path) != 0) rc = 1;
+    if (rc != 0) unlink(tmp);
+    return rc;
+}
+
+static int source_index_valid(const source_header_t *h, size_t len, uint64_t path_hash,
+                              int kind, int64_t stamp, int64_t size) {
+    return len >= sizeof(*h) &&
+           memcmp(h->magic, SOURCE_MAGIC, sizeof(SOURCE_MAGIC)) == 0 &&
+           h->version == SOURCE_VERSION &&
+           h->path_hash == path_hash && h->kind == (uint32_t)kind &&
+           h->stamp == stamp && h->source_size == size &&
+           h->slot_count > 0 && (h->slot_count & (h->slot_count - 1)) == 0 &&
+           h->strings_offset == sizeof(*h) + (uint64_t)h->slot_count * sizeof(source_slot_t) &&
+           h->strings_offset + h->strings_size <= len;
+}
+
+static int source_build(const char *source, const char *index_path, const char *tar_path,
+                        int kind, uint64_t path_hash, int64_t stamp, int64_t size) {
+    source_build_t b;
+    memset(&b, 0, sizeof(b));
+    int rc = source_grow(&b);
+
+    if (rc == 0 && kind == SOURCE_DIR) {
+        rc = source_scan_dir(&b, source, "", 0);
+    } else if (rc == 0) {
+        if (kind == SOURCE_TAR_GZ) rc = source_inflate(source, tar_path);
+        size_t len = 0;
+        const uint8_t *tar = rc == 0 ? source_map_file(kind == SOURCE_TAR_GZ ? tar_path : source, &len) : NULL;
+        rc = tar ? source_scan_tar(&b, tar, len) : 1;
+        if (tar) munmap((void *)tar, len);
+    }
+
+    if (rc == 0) {
+        source_header_t h;
+        memset(&h, 0, sizeof(h));
+        memcpy(h.magic, SOURCE_MAGIC, sizeof(SOURCE_MAGIC));
+        h.version = SOURCE_VERSION;
+        h.kind = (uint32_t)kind;
+        h.slot_count = b.slot_count;
+        h.entry_count = b.count;
+        h.path_hash = path_hash;
+        h.stamp = stamp;
+        h.source_size = size;
+        h.strings_offset = sizeof(h) + (uint64_t)b.slot_count * sizeof(source_slot_t);
+        h.strings_size = b.strings_size;
+        rc = source_write_index(index_path, &h, &b);
+
+        if (rc == 0 && g_config && g_config->verbose) {
+            char msg[MAX_PATH_LEN + 64];
+            snprintf(msg, sizeof(msg), "Indexed %u template(s) in %s", b.count, source);
+            print_info(msg);
+        }
+    }
+
+    free(b.slots);
+    free(b.strings);
+    return rc;
+}
+
+// Map the index, rebuilding it first when the source has changed
+static int source_load(void) {
+    if (g_source.loaded) return g_source.failed;
+    g_source.loaded = 1;
+    g_source.failed = 1;
+
+    const char *source = g_config->template_source;
+    int kind;
+    int64_t stamp, size;
+    if (source_stamp(source, &kind, &stamp, &size) != 0) {
+        char msg[MAX_PATH_LEN + 64];
+        snprintf(msg, sizeof(msg), "Template source not found: %s", source);
+        print_error(msg, ERR_FILE_NOT_FOUND);
+        return 1;
+    }
+
+    char *index_path = source_cache_file(SOURCE_INDEX_FILE);
+    char *tar_path = source_cache_file(SOURCE_TAR_FILE);
+    uint64_t path_hash = hash_bytes(source, strlen(source));
+
+    int span = timing_begin("source index");
+    const uint8_t *map = index_path ? source_map_file(index_path, &g_source.index_len) : NULL;
+    if (!map || !source_index_valid((const source_header_t *)map, g_source.index_len,
+                                    path_hash, kind, stamp, size)) {
+        if (map) munmap((void *)map, g_source.index_len);
+        map = NULL;
+        timing_note(span, "rebuilt");
+        if (index_path && tar_path &&
+            source_build(source, index_path, tar_path, kind, path_hash, stamp, size) == 0) {
+            map = source_map_file(index_path, &g_source.index_len);
+        }
+    }
+    timing_end(span);
+
+    if (map && source_index_valid((const source_header_t *)map, g_source.index_len,
+                                  path_hash, kind, stamp, size)) {
+        g_source.index = map;
+        g_source.failed = 0;
+        if (kind != SOURCE_DIR) {
+            g_source.tar = source_map_file(kind == SOURCE_TAR_GZ ? tar_path : source, &g_source.tar_len);
+            if (!g_source.tar) g_source.failed = 1;
+        }
+    } else {
+        if (map) munmap((void *)map, g_source.index_len);
+        print_error("Could not index template source", ERR_CACHE_ERROR);
+    }
+
+    free(index_path);
+    free(tar_path);
+    return g_source.failed;
+}
+
+// Find a template by case-insensitive name. data stays valid until
+// source_close(). Returns 1 when the source has no such template.
+int source_lookup(const char *name, const char **data, size_t *size) {
+    *data = NULL;
+    *size = 0;
+    if (!source_enabled() || source_load() != 0) return 1;
+
+    const source_header_t *h = (const source_header_t *)g_source.index;
+    const source_slot_t *slots = (const source_slot_t *)(g_source.index + sizeof(*h));
+    const char *strings = (const char *)g_source.index + h->strings_offset;
+    size_t name_len = strlen(name);
+    uint64_t hash = source_name_hash(name, name_len);
+    uint32_t mask = h->slot_count - 1;
+
+    const source_slot_t *slot = NULL;
+    for (uint32_t probe = 0, i = (uint32_t)hash & mask; probe < h->slot_count; probe++, i = (i + 1) & mask) {
+        if (slots[i].name_hash == 0) break;
+        if (slots[i].name_hash == hash && slots[i].name_len == name_len &&
+            slots[i].name_offset + name_len < h->strings_size &&
+            strncasecmp(strings + slots[i].name_offset, name, name_len) == 0) {
+            slot = &slots[i];
+            break;
+        }
+    }
+    if (!slot) return 1;
+
+    if (h->kind != SOURCE_DIR) {
+        if (slot->offset + slot->size > g_source.tar_len) return 1;
+        *data = (const char *)g_source.tar + slot->offset;
+        *size = (size_t)slot->size;
+        return 0;
+    }
+
+    if (slot->offset + slot->size >= h->strings_size) return 1;
+    char path[MAX_PATH_LEN * 2];
+    snprintf(path, sizeof(path), "%s/%.*s", g_config->template_source,
+             (int)slot->size, strings + slot->offset);
+
+    size_t len = 0;
+    const uint8_t *map = source_map_file(path, &len);
+    if (!map) {
+        // Empty templates cannot be mapped
+        struct stat st;
+        if (stat(path, &st) != 0) return 1;
+        *data = "";
+        return 0;
+    }
+
+    source_mapping_t *m = malloc(sizeof(source_mapping_t));
+    if (!m) {
+        munmap((void *)map, len);
+        return 1;
+    }
+    m->addr = (void *)map;
+    m->len = len;
+    m->next = g_source.files;
+    g_source.files = m;
+
+    *data = (const char *)map;
+    *size = len;
+    return 0;
+}
+
+void source_close(void) {
+    if (g_source.index) munmap((void *)g_source.index, g_source.index_len);
+    if (g_source.tar) munmap((void *)g_source.tar, g_source.tar_len);
+
+    source_mapping_t *m = g_source.files;
+    while (m) {
+        source_mapping_t *next = m->next;
+        munmap(m->addr, m->len);
+        free(m);
+        m = next;
+    }
+
+    memset(&g_source, 0, sizeof(g_source));
+}
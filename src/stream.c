@@ -0,0 +1,177 @@
+// stream.c - Segmented receive buffer with an incremental line splitter
+//
+// Downloaded bodies are appended into a chain of blocks that never move
+// once allocated, so line slices handed to the merge stage stay valid for
+// the lifetime of the buffer. Block sizes grow geometrically. When a chunk
+// does not fit, only the unfinished last line is carried into the next
+// block, so every line is contiguous within one block.
+#include "gitignore.h"
+
+#define STREAM_MIN_BLOCK 16384
+#define STREAM_MAX_BLOCK (1 << 20)
+
+struct stream_block {
+    struct stream_block *next;
+    size_t len;
+    size_t cap;
+    char data[];
+};
+
+void stream_init(stream_buf_t *sb) {
+    memset(sb, 0, sizeof(*sb));
+}
+
+void stream_free(stream_buf_t *sb) {
+    stream_block_t *b = sb->head;
+    while (b) {
+        stream_block_t *next = b->next;
+        free(b);
+        b = next;
+    }
+    stream_init(sb);
+}
+
+static stream_block_t* stream_new_block(stream_buf_t *sb, size_t need) {
+    size_t cap = sb->next_block ? sb->next_block : STREAM_MIN_BLOCK;
+    while (cap < need) cap *= 2;
+
+    stream_block_t *b = malloc(sizeof(stream_block_t) + cap);
+    if (!b) return NULL;
+
+    b->next = NULL;
+    b->len = 0;
+    b->cap = cap;
+
+    if (sb->next_block < STREAM_MAX_BLOCK) {
+        sb->next_block = cap * 2 < STREAM_MAX_BLOCK ? cap * 2 : STREAM_MAX_BLOCK;
+    }
+
+    return b;
+}
+
+int stream_append(stream_buf_t *sb, const char *data, size_t len) {
+    while (len > 0) {
+        stream_block_t *tail = sb->tail;
+        size_t room = tail ? tail->cap - tail->len : 0;
+
+        if (room == 0) {
+            // Carry the unfinished last line so it stays contiguous
+            size_t carry = 0;
+            if (tail) {
+                size_t from = tail == sb->cur ? sb->cur_off : 0;
+                const char *nl = NULL;
+                for (size_t i = tail->len; i > from; i--) {
+                    if (tail->data[i - 1] == '\n') {
+                        nl = &tail->data[i - 1];
+                        break;
+                    }
+                }
+                size_t line_start = nl ? (size_t)(nl - tail->data) + 1 : from;
+                carry = tail->len - line_start;
+            }
+
+            stream_block_t *b = stream_new_block(sb, carry + len);
+            if (!b) return 1;
+
+            if (carry > 0) {
+                memcpy(b->data, tail->data + tail->len - carry, carry);
+                b->len = carry;
+                tail->len -= carry;
+                if (sb->scan_block == tail) {
+                    sb->scan_block = NULL;
+                }
+            }
+
+            if (tail) {
+                tail->next = b;
+            } else {
+                sb->head = b;
+                sb->cur = b;
+            }
+            sb->tail = b;
+            sb->blocks++;
+            continue;
+        }
+
+        size_t n = len < room ? len : room;
+        memcpy(tail->data + tail->len, data, n);
+        tail->len += n;
+        sb->size += n;
+        data += n;
+        len -= n;
+    }
+
+    return 0;
+}
+
+// Return the next complete line (without its newline; the newline byte
+// still follows it in memory). With final set, a trailing line without a
+// newline is returned as well. Returns 1 for a terminated line, 2 for an
+// unterminated final line and 0 when no line is available yet.
+int stream_next_line(stream_buf_t *sb, int final, const char **line, size_t *len) {
+    while (sb->cur) {
+        stream_block_t *b = sb->cur;
+
+        if (sb->cur_off < b->len) {
+            // Resume scanning where the last incomplete search stopped
+            size_t scan = sb->cur_off;
+            if (sb->scan_block == b && sb->scan_off > scan) scan = sb->scan_off;
+
+            const char *nl = memchr(b->data + scan, '\n', b->len - scan);
+            if (nl) {
+                *line = b->data + sb->cur_off;
+                *len = (size_t)(nl - *line);
+                sb->cur_off = (size_t)(nl - b->data) + 1;
+                sb->scan_block = NULL;
+                return 1;
+            }
+
+            if (!b->next) {
+                if (final) {
+                    *line = b->data + sb->cur_off;
+                    *len = b->len - sb->cur_off;
+                    sb->cur_off = b->len;
+                    sb->scan_block = NULL;
+                    return 2;
+                }
+                sb->scan_block = b;
+                sb->scan_off = b->len;
+                return 0;
+            }
+        }
+
+        if (!b->next) return 0;
+        sb->cur = b->next;
+        sb->cur_off = 0;
+    }
+
+    return 0;
+}
+
+// Describe the body as iovecs, one per block. Returns the block count.
+int stream_iov(const stream_buf_t *sb, struct iovec *iov, int max) {
+    int n = 0;
+    for (stream_block_t *b = sb->head; b && n < max; b = b->next) {
+        if (b->len == 0) continue;
+        iov[n].iov_base = b->data;
+        iov[n].iov_len = b->len;
+        n++;
+    }
+    return n;
+}
+
+// Copy the body into one NUL-terminated heap buffer
+char* stream_flatten(const stream_buf_t *sb, size_t *size) {
+    char *out = malloc(sb->size + 1);
+    if (!out) return NULL;
+
+    size_t off = 0;
+    for (stream_block_t *b = sb->head; b; b = b->next) {
+        memcpy(out + off, b->data, b->len);
+        off += b->len;
+    }
+    out[off] = '\0';
+
+    if (size) *size = off;
+    return out;
+}
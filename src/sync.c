@@ -1,109 +1,258 @@
 // sync.c - FIXED: Download from GitHub and merge smartly
+//
+// Downloads stream straight into the merge: each body chunk is split into
+// lines as it arrives and fed to the dedup set, in section order, and the
+// lines kept point into the receive buffer itself. Nothing is copied
+// between the network and the output, and there is no size limit.
 #include "gitignore.h"
 
-// Callback for curl to write data
-static size_t write_callback(void *contents, size_t size, size_t nmemb, void *userp) {
-    size_t realsize = size * nmemb;
-    struct {
-        char *data;
-        size_t size;
-    } *mem = (void *)userp;
-    
-    char *ptr = realloc(mem->data, mem->size + realsize + 1);
-    if (!ptr) {
-        print_error("Out of memory", ERR_OUT_OF_MEMORY);
-        return 0;
+// Fetch one template, preferring a fresh cached copy. The body either
+// points into the cache or is owned by the caller via body->owned.
+int download_template(const char *lang, template_body_t *body) {
+    body->data = NULL;
+    body->size = 0;
+    body->owned = NULL;
+    
+    if (source_enabled()) {
+        return source_lookup(lang, &body->data, &body->size);
     }
     
-    mem->data = ptr;
-    memcpy(&(mem->data[mem->size]), contents, realsize);
-    mem->size += realsize;
-    mem->data[mem->size] = 0;
+    const char *cached_content = NULL;
+    size_t cached_size = 0;
+    cache_meta_t meta;
+    cache_state_t state = cache_lookup(lang, &cached_content, &cached_size, &meta);
     
-    return realsize;
-}
-
-int download_template(const char *lang, char *buffer, size_t *size) {
-    // Check cache first
-    char *cached_content = NULL;
-    if (get_cached_template(lang, &cached_content) == 0) {
-        strncpy(buffer, cached_content, *size - 1);
-        buffer[*size - 1] = '\0';
-        *size = strlen(cached_content);
-        free(cached_content);
+    if (state == CACHE_FRESH) {
+        body->data = cached_content;
+        body->size = cached_size;
         return 0;
     }
     
-    CURL *curl;
-    CURLcode res;
-    char url[512];
+    fetch_job_t job = { .lang = lang };
+    if (state == CACHE_STALE) {
+        job.validators = &meta;
+    }
     
-    // Construct GitHub raw URL
-    snprintf(url, sizeof(url), "%s%s.gitignore", GITHUB_RAW_URL, lang);
+    if (fetch_templates(&job, 1, 1) != 0) {
+        stream_free(&job.body);
+        return 1;
+    }
     
-    struct {
-        char *data;
-        size_t size;
-    } chunk = {0};
+    if (job.not_modified) {
+        cache_touch(lang, &meta);
+        body->data = cached_content;
+        body->size = cached_size;
+        return 0;
+    }
     
-    curl = curl_easy_init();
-    if (!curl) {
-        print_error("Could not initialize curl", ERR_CURL_INIT_FAILED);
+    // Callers want one contiguous body, so this is the one place it is joined
+    body->owned = stream_flatten(&job.body, &body->size);
+    stream_free(&job.body);
+    if (!body->owned) {
         return 1;
     }
     
-    curl_easy_setopt(curl, CURLOPT_URL, url);
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void *)&chunk);
-    curl_easy_setopt(curl, CURLOPT_USERAGENT, "gitignore-tool/2.0");
-    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
+    body->data = body->owned;
+    cache_store(lang, body->data, body->size, &job.meta);
+    return 0;
+}
+
+void template_body_free(template_body_t *body) {
+    free(body->owned);
+    body->owned = NULL;
+    body->data = NULL;
+    body->size = 0;
+}
+
+// One kept output line, pointing into a cache mapping or a receive buffer
+typedef struct {
+    const char *data;
+    size_t len;
+    int has_newline;        // the source's newline follows the line
+    int inserted;           // added to the dedup set by this section
+} sync_line_t;
+
+typedef struct {
+    const char *lang;
+    const char *cached;     // cached body, fresh or stale
+    size_t cached_size;
+    cache_meta_t meta;
+    fetch_job_t *job;       // NULL when served from a fresh cache entry
+    sync_line_t *lines;
+    size_t line_count;
+    size_t line_cap;
+    uint64_t hash;          // of the body, as the section's end marker records it
+    int section;            // its section in .gitignore, or -1
+    int current;            // that section was made from this same body
+    int ok;
+} sync_section_t;
+
+// Sections are merged strictly in order: a section's lines are only fed to
+// the dedup set once every section before it is complete, so a fast
+// download never claims a pattern that an earlier template also has.
+typedef struct {
+    sync_section_t *sections;
+    int count;
+    int head;
+    pattern_set_t *seen;
+    section_index_t *index;
+    arena_t *arena;         // line tables; the fetch loop is single-threaded
+    int oom;
+} sync_pipeline_t;
+
+static void sync_keep_line(sync_pipeline_t *pl, sync_section_t *sec, const char *p, size_t len,
+                           int has_newline) {
+    int inserted = 0;
     
-    res = curl_easy_perform(curl);
+    if (!is_comment_span(p, len)) {
+        int rc = pattern_set_insert(pl->seen, p, len);
+        if (rc == 0) return;
+        inserted = rc > 0;
+    }
     
-    if (res != CURLE_OK) {
-        if (g_config && !g_config->quiet) {
-            fprintf(stderr, "%sError downloading %s: %s%s\n", 
-                    COLOR_RED, lang, curl_easy_strerror(res), COLOR_RESET);
+    if (sec->line_count == sec->line_cap) {
+        size_t cap = sec->line_cap ? sec->line_cap * 2 : 64;
+        sync_line_t *lines = arena_realloc(pl->arena, sec->lines, sec->line_cap * sizeof(sync_line_t),
+                                           cap * sizeof(sync_line_t));
+        if (!lines) {
+            if (inserted) pattern_set_remove(pl->seen, p, len);
+            pl->oom = 1;
+            return;
         }
-        curl_easy_cleanup(curl);
-        if (chunk.data) free(chunk.data);
-        return 1;
+        sec->lines = lines;
+        sec->line_cap = cap;
     }
     
-    long response_code;
-    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &response_code);
-    
-    curl_easy_cleanup(curl);
+    sec->lines[sec->line_count].data = p;
+    sec->lines[sec->line_count].len = len;
+    sec->lines[sec->line_count].has_newline = has_newline;
+    sec->lines[sec->line_count].inserted = inserted;
+    sec->line_count++;
+}
+
+static void sync_keep_buffer(sync_pipeline_t *pl, sync_section_t *sec, const char *data, size_t size) {
+    const char *p = data;
+    const char *end = data + size;
     
-    if (response_code != 200) {
-        if (g_config && !g_config->quiet) {
-            fprintf(stderr, "%sTemplate '%s' not found on GitHub (HTTP %ld)%s\n", 
-                    COLOR_RED, lang, response_code, COLOR_RESET);
+    sec->hash = hash_bytes(data, size);
+    while (p < end) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        const char *line_end = nl ? nl : end;
+        sync_keep_line(pl, sec, p, (size_t)(line_end - p), nl != NULL);
+        p = nl ? nl + 1 : end;
+    }
+}
+
+// Forget a section that failed part-way through its download
+static void sync_rollback(sync_pipeline_t *pl, sync_section_t *sec) {
+    for (size_t k = 0; k < sec->line_count; k++) {
+        if (sec->lines[k].inserted) {
+            pattern_set_remove(pl->seen, sec->lines[k].data, sec->lines[k].len);
         }
-        if (chunk.data) free(chunk.data);
-        return 1;
     }
+    sec->line_count = 0;
+}
+
+// A finished section either keeps what .gitignore already has for it,
+// when that was made from the same body, or replaces it
+static void sync_settle(sync_pipeline_t *pl, sync_section_t *sec) {
+    int slot = (int)(sec - pl->sections);
     
-    if (chunk.data && chunk.size > 0) {
-        strncpy(buffer, chunk.data, *size - 1);
-        buffer[*size - 1] = '\0';
-        *size = chunk.size;
+    if (!sec->ok) {
+        if (section_release(pl->index, slot, pl->seen) != 0) pl->oom = 1;
+    } else if (section_current(pl->index, sec->section, sec->hash)) {
+        sync_rollback(pl, sec);
+        sec->current = 1;
+        if (section_keep(pl->index, sec->section, pl->seen) != 0) pl->oom = 1;
+    }
+}
+
+// Merge as far as the data received so far allows
+static void sync_pump(sync_pipeline_t *pl) {
+    while (pl->head < pl->count) {
+        sync_section_t *sec = &pl->sections[pl->head];
+        fetch_job_t *job = sec->job;
         
-        // Cache the downloaded template
-        cache_template(lang, chunk.data);
+        if (sec->current) {
+            // Already known to be up to date
+        } else if (job) {
+            const char *line;
+            size_t len;
+            int rc;
+            while ((rc = stream_next_line(&job->body, job->finished, &line, &len)) != 0) {
+                sec->hash = hash_bytes_update(sec->hash, line, len);
+                if (rc == 1) sec->hash = hash_bytes_update(sec->hash, "\n", 1);
+                sync_keep_line(pl, sec, line, len, rc == 1);
+            }
+            
+            if (!job->finished) return;
+            
+            if (job->status == ERR_SUCCESS && !job->not_modified) {
+                sec->ok = 1;
+            } else {
+                // Not modified, or failed: fall back to the cached copy
+                sync_rollback(pl, sec);
+                if (sec->cached) {
+                    sync_keep_buffer(pl, sec, sec->cached, sec->cached_size);
+                    sec->ok = 1;
+                }
+            }
+            sync_settle(pl, sec);
+        } else {
+            if (sec->cached) {
+                sync_keep_buffer(pl, sec, sec->cached, sec->cached_size);
+                sec->ok = 1;
+            }
+            sync_settle(pl, sec);
+        }
         
-        free(chunk.data);
-        return 0;
+        pl->head++;
     }
+}
+
+static void sync_on_data(fetch_job_t *job, void *ctx) {
+    (void)job;
+    sync_pump((sync_pipeline_t *)ctx);
+}
+
+// Store a downloaded body from its receive blocks, without joining them
+static void sync_cache_body(arena_t *arena, const char *lang, const fetch_job_t *job) {
+    struct iovec *iov = arena_alloc(arena, (job->body.blocks > 0 ? job->body.blocks : 1) * sizeof(struct iovec));
+    if (!iov) return;
     
-    if (chunk.data) free(chunk.data);
-    return 1;
+    int n = stream_iov(&job->body, iov, (int)job->body.blocks);
+    cache_store_iov(lang, iov, n, &job->meta);
+}
+
+// Write a template's section from the lines kept for it
+static int sync_render(out_buf_t *out, int slot, void *ctx) {
+    sync_pipeline_t *pl = ctx;
+    const sync_section_t *sec = &pl->sections[slot];
+    
+    section_begin(out, sec->lang);
+    for (size_t k = 0; k < sec->line_count; k++) {
+        const sync_line_t *line = &sec->lines[k];
+        out_add(out, line->data, line->len + (line->has_newline ? 1 : 0));
+        if (!line->has_newline) out_add(out, "\n", 1);
+    }
+    section_end(out, sec->lang, sec->hash);
+    return 0;
+}
+
+// Where templates come from, for messages and markers: the local template
+// source, a custom template_url, or `upstream` for the default repository
+static const char *sync_source(int offline, const char *upstream) {
+    if (offline) return g_config->template_source;
+    if (g_config && strcmp(g_config->template_url, GITHUB_RAW_URL) != 0) return g_config->template_url;
+    return upstream;
 }
 
 int sync_gitignore(char **langs, int count, int dry_run) {
     if (dry_run) {
-        print_info("[DRY RUN] Would sync templates from GitHub");
+        char msg[MAX_PATH_LEN + 64];
+        snprintf(msg, sizeof(msg), "[DRY RUN] Would sync templates from %s",
+                 sync_source(source_enabled(), "GitHub"));
+        print_info(msg);
         printf("  Templates: ");
         for (int i = 0; i < count; i++) {
             printf("%s%s", langs[i], i < count - 1 ? ", " : "\n");
@@ -114,14 +263,6 @@ int sync_gitignore(char **langs, int count, int dry_run) {
     // Check if .gitignore exists
     int gitignore_exists = file_exists(".gitignore");
     
-    // Auto backup if enabled and file exists
-    if (g_config && g_config->auto_backup && gitignore_exists) {
-        if (g_config->verbose) {
-            print_info("Auto-backup enabled, creating backup...");
-        }
-        backup_gitignore();
-    }
-    
     // Remove duplicates and filter comments
     langs = remove_duplicates(langs, &count);
     
@@ -130,110 +271,173 @@ int sync_gitignore(char **langs, int count, int dry_run) {
         return 1;
     }
     
-    // FIXED: Read existing patterns for deduplication
-    char **existing_patterns = NULL;
-    int existing_count = 0;
+    // Tables, line lists and headers for this sync, released in one step
+    arena_t arena;
+    arena_init(&arena);
+    
+    // Existing patterns plus everything merged so far, for deduplication
+    pattern_set_t seen;
+    pattern_set_init_arena(&seen, &arena);
+    file_view_t view;
+    file_view_init(&view);
     
     if (gitignore_exists) {
-        FILE *existing = fopen(".gitignore", "r");
-        if (existing) {
-            existing_patterns = malloc(sizeof(char*) * 10000);
-            char line[MAX_LINE_LEN];
-            
-            while (fgets(line, sizeof(line), existing)) {
-                if (!is_comment(line) && strlen(line) > 1) {
-                    line[strcspn(line, "\n\r")] = 0;
-                    char *trimmed = line;
-                    while (*trimmed == ' ' || *trimmed == '\t') trimmed++;
-                    
-                    if (strlen(trimmed) > 0) {
-                        existing_patterns[existing_count++] = strdup(trimmed);
-                    }
-                }
-            }
-            fclose(existing);
+        int span = timing_begin("read");
+        timing_note(span, ".gitignore");
+        if (file_view_open(&view, ".gitignore") != 0) {
+            timing_end(span);
+            print_error("Could not read .gitignore", ERR_PERMISSION_DENIED);
+            arena_free(&arena);
+            return 1;
         }
+        timing_end(span);
     }
     
-    // Open for append if exists, create if not
-    FILE *out = fopen(".gitignore", gitignore_exists ? "a" : "w");
-    if (!out) {
-        print_error("Could not create .gitignore", ERR_PERMISSION_DENIED);
-        
-        if (existing_patterns) {
-            for (int i = 0; i < existing_count; i++) {
-                free(existing_patterns[i]);
-            }
-            free(existing_patterns);
-        }
+    // The sections earlier runs wrote; templates whose body has not changed
+    // keep theirs, others are rewritten in place
+    section_index_t index = { view.data, view.size, NULL, 0 };
+    if (gitignore_exists && section_index_build(&index, &arena, view.data, view.size) != 0) {
+        print_error("Out of memory", ERR_OUT_OF_MEMORY);
+        file_view_close(&view);
+        arena_free(&arena);
         return 1;
     }
     
-    // Add header
-    if (!gitignore_exists) {
-        fprintf(out, "# Generated by gitignore tool v%s\n", VERSION);
-        fprintf(out, "# Synced from https://github.com/github/gitignore\n\n");
-    } else {
-        fprintf(out, "\n# Synced from GitHub by gitignore tool\n");
+    int offline = source_enabled();
+    if (!g_config || !g_config->quiet) {
+        printf("%sSyncing templates from %s...%s\n", COLOR_BOLD, sync_source(offline, "GitHub"), COLOR_RESET);
     }
     
-    if (!g_config || !g_config->quiet) {
-        printf("%sSyncing templates from GitHub...%s\n", COLOR_BOLD, COLOR_RESET);
+    sync_section_t *sections = arena_calloc(&arena, (size_t)count, sizeof(sync_section_t));
+    fetch_job_t *jobs = arena_calloc(&arena, (size_t)count, sizeof(fetch_job_t));
+    
+    if (!sections || !jobs) {
+        print_error("Out of memory", ERR_OUT_OF_MEMORY);
+        file_view_close(&view);
+        arena_free(&arena);
+        return 1;
     }
     
-    int success_count = 0;
+    sync_pipeline_t pipeline = { sections, count, 0, &seen, &index, &arena, 0 };
     
+    // Serve what we can from the cache, then fetch every miss and
+    // revalidate every stale entry concurrently
+    int job_count = 0;
     for (int i = 0; i < count; i++) {
-        char buffer[65536];
-        size_t size = sizeof(buffer);
+        sync_section_t *sec = &sections[i];
+        sec->lang = langs[i];
+        sec->hash = hash_bytes(NULL, 0);
+        sec->section = section_claim(&index, langs[i], i);
         
-        if (!g_config || !g_config->quiet) {
-            print_progress(langs[i], i + 1, count);
+        // A local source is read directly; it needs neither cache nor network
+        cache_state_t state = CACHE_FRESH;
+        if (offline) {
+            source_lookup(langs[i], &sec->cached, &sec->cached_size);
+        } else {
+            state = cache_lookup(langs[i], &sec->cached, &sec->cached_size, &sec->meta);
         }
         
-        if (download_template(langs[i], buffer, &size) == 0) {
-            fprintf(out, "\n# ===== %s =====\n", langs[i]);
-            
-            // Write line by line, checking for duplicates
-            const char *line_start = buffer;
-            const char *line_end;
-            
-            while (*line_start) {
-                line_end = strchr(line_start, '\n');
-                if (!line_end) line_end = line_start + strlen(line_start);
-                
-                int line_len = line_end - line_start;
-                char line[MAX_LINE_LEN];
-                strncpy(line, line_start, line_len);
-                line[line_len] = '\0';
-                
-                // Check for duplicates
-                if (gitignore_exists && line_len > 0 && line[0] != '#') {
-                    char *trimmed = line;
-                    while (*trimmed == ' ' || *trimmed == '\t') trimmed++;
-                    
-                    int is_duplicate = 0;
-                    for (int j = 0; j < existing_count; j++) {
-                        if (strcmp(trimmed, existing_patterns[j]) == 0) {
-                            is_duplicate = 1;
-                            break;
-                        }
-                    }
-                    
-                    if (!is_duplicate) {
-                        fprintf(out, "%s\n", line);
-                    }
-                } else {
-                    fprintf(out, "%s\n", line);
-                }
-                
-                line_start = *line_end ? line_end + 1 : line_end;
+        // A body already in hand settles its section before anything is read
+        if (state == CACHE_FRESH && sec->cached &&
+            section_current(&index, sec->section, hash_bytes(sec->cached, sec->cached_size))) {
+            section_keep(&index, sec->section, NULL);
+            sec->current = 1;
+            sec->ok = 1;
+            continue;
+        }
+        
+        if (state != CACHE_FRESH) {
+            fetch_job_t *job = &jobs[job_count++];
+            job->lang = langs[i];
+            job->validators = state == CACHE_STALE ? &sec->meta : NULL;
+            job->on_data = sync_on_data;
+            job->ctx = &pipeline;
+            sec->job = job;
+        }
+    }
+    
+    // Every template served locally and matching its section: nothing to do
+    int pending = job_count > 0 || section_dirty(&index);
+    for (int i = 0; i < count && !pending; i++) {
+        pending = !sections[i].current && sections[i].cached;
+    }
+    
+    // Existing patterns, except in the sections that may be replaced, are
+    // what the merged templates are deduplicated against
+    if (pending && gitignore_exists) {
+        int span = timing_begin("dedup");
+        if (pattern_set_reserve(&seen, count_lines(view.data, view.size)) != 0 ||
+            section_seed(&index, &seen) != 0) {
+            pipeline.oom = 1;
+        }
+        timing_end(span);
+    }
+    
+    if (job_count > 0 && !pipeline.oom) {
+        fetch_templates(jobs, job_count, g_config ? g_config->max_parallel : MAX_PARALLEL);
+    }
+    if (!pipeline.oom) sync_pump(&pipeline);
+    
+    int span = timing_begin("cache store");
+    for (int i = 0; i < count; i++) {
+        fetch_job_t *job = sections[i].job;
+        if (!job) continue;
+        
+        if (job->status != ERR_SUCCESS) {
+            // Keep serving a stale copy rather than dropping the section
+            if (sections[i].cached && g_config && !g_config->quiet) {
+                printf("  %s⚠%s  %s (using stale cached copy)\n",
+                       COLOR_YELLOW, COLOR_RESET, langs[i]);
             }
-            
-            success_count++;
+        } else if (job->not_modified) {
+            cache_touch(langs[i], &sections[i].meta);
+        } else {
+            sync_cache_body(&arena, langs[i], job);
+        }
+    }
+    
+    timing_end(span);
+    
+    // Assemble the new file from the existing bytes and the kept lines,
+    // then swap it in with a single write
+    span = timing_begin("merge");
+    out_buf_t out;
+    out_init_arena(&out, &arena);
+    int success_count = 0;
+    int failed = pipeline.oom;
+    
+    if (pipeline.oom) {
+        print_error("Out of memory", ERR_OUT_OF_MEMORY);
+    }
+    
+    int appended = 0;
+    for (int i = 0; i < count; i++) {
+        if (sections[i].ok) success_count++;
+        if (sections[i].ok && sections[i].section < 0) appended++;
+    }
+    int changed = appended > 0 || section_dirty(&index);
+    
+    if (!gitignore_exists) {
+        out_printf(&out, "# Generated by gitignore tool v%s\n", VERSION);
+        out_printf(&out, "# Synced from %s\n\n", sync_source(offline, "https://github.com/github/gitignore"));
+    } else if (changed && !failed) {
+        if (section_rewrite(&index, &out, &seen, sync_render, &pipeline) != 0) {
+            print_error("Out of memory", ERR_OUT_OF_MEMORY);
+            failed = 1;
+        } else if (appended > 0) {
+            out_printf(&out, "\n# Synced from %s by gitignore tool\n", sync_source(offline, "GitHub"));
+        }
+    }
+    
+    for (int i = 0; i < count && !failed; i++) {
+        sync_section_t *sec = &sections[i];
+        
+        if (sec->ok) {
+            if (sec->section < 0) sync_render(&out, i, &pipeline);
             
             if (g_config && !g_config->quiet) {
-                printf("  %s✓%s %s\n", COLOR_GREEN, COLOR_RESET, langs[i]);
+                printf("  %s✓%s %s%s\n", COLOR_GREEN, COLOR_RESET, langs[i],
+                       sec->current ? " (unchanged)" : "");
             }
         } else {
             if (g_config && !g_config->quiet) {
@@ -243,18 +447,43 @@ int sync_gitignore(char **langs, int count, int dry_run) {
         }
     }
     
-    fclose(out);
+    timing_end(span);
     
-    // Free existing patterns
-    if (existing_patterns) {
-        for (int i = 0; i < existing_count; i++) {
-            free(existing_patterns[i]);
+    // A rewrite can still come out byte-identical
+    if (changed && gitignore_exists && out_equals(&out, view.data, view.size)) {
+        changed = 0;
+    }
+    
+    // Back up only what is about to be replaced
+    if (!failed && changed && gitignore_exists && g_config && g_config->auto_backup) {
+        if (g_config->verbose) {
+            print_info("Auto-backup enabled, creating backup...");
         }
-        free(existing_patterns);
+        backup_gitignore();
+    }
+    
+    if (!failed && changed && out_commit(&out, ".gitignore") != 0) {
+        print_error("Could not write .gitignore", ERR_PERMISSION_DENIED);
+        failed = 1;
+    }
+    
+    out_free(&out);
+    for (int j = 0; j < job_count; j++) {
+        stream_free(&jobs[j].body);
+    }
+    
+    pattern_set_free(&seen);
+    arena_free(&arena);
+    file_view_close(&view);
+    
+    if (failed) {
+        return 1;
     }
     
     if (success_count > 0) {
-        if (gitignore_exists) {
+        if (!changed) {
+            print_info(".gitignore is already up to date");
+        } else if (gitignore_exists) {
             print_success(".gitignore updated successfully");
         } else {
             print_success(".gitignore synced successfully");
@@ -266,5 +495,5 @@ int sync_gitignore(char **langs, int count, int dry_run) {
         return 1;
     }
     
-    return 0;
-}
\ No newline at end of file
+    return changed ? 0 : EXIT_UNCHANGED;
+}
@@ -3,25 +3,34 @@
 
 #include "gitignore.h"
 
-// Built-in template structure
+// Perfect hash slot: a case-folded name or alias and its template
 typedef struct {
-    const char *name;
-    const char *content;
-} builtin_template_t;
+    const char *key;
+    int template_index;
+} builtin_slot_t;
 
 // c template
-static const char c_template[] = 
+static const char c_template_0[] = 
 "# C\n"
 "*.o\n"
 "*.a\n"
 "*.so\n"
 "*.out\n"
 "*.exe\n"
-"*.dylib\n"
-;
+"*.dylib\n";
+
+static const builtin_line_t c_template_0_lines[] = {
+    {0, 0, 3, 0, 0, BUILTIN_LINE_COMMENT},
+    {0x1a2e2117ffa6a652ULL, 4, 3, 4, 3, 0},
+    {0x1a2e2317ffa6a9b8ULL, 8, 3, 8, 3, 0},
+    {0x234c58c768661013ULL, 12, 4, 12, 4, 0},
+    {0xb39409d603530f43ULL, 17, 5, 17, 5, 0},
+    {0xe9b70ed62299fda3ULL, 23, 5, 23, 5, 0},
+    {0xc2382931199f2ff9ULL, 29, 7, 29, 7, 0},
+};
 
 // cpp template
-static const char cpp_template[] = 
+static const char cpp_template_1[] = 
 "# C++\n"
 "*.o\n"
 "*.obj\n"
@@ -29,20 +38,37 @@ static const char cpp_template[] =
 "*.out\n"
 "*.a\n"
 "*.so\n"
-"*.dylib\n"
-;
+"*.dylib\n";
+
+static const builtin_line_t cpp_template_1_lines[] = {
+    {0, 0, 5, 0, 0, BUILTIN_LINE_COMMENT},
+    {0x1a2e2117ffa6a652ULL, 6, 3, 6, 3, 0},
+    {0xb3b31dd6036de1ceULL, 10, 5, 10, 5, 0},
+    {0xe9b70ed62299fda3ULL, 16, 5, 16, 5, 0},
+    {0xb39409d603530f43ULL, 22, 5, 22, 5, 0},
+    {0x1a2e2317ffa6a9b8ULL, 28, 3, 28, 3, 0},
+    {0x234c58c768661013ULL, 32, 4, 32, 4, 0},
+    {0xc2382931199f2ff9ULL, 37, 7, 37, 7, 0},
+};
 
 // go template
-static const char go_template[] = 
+static const char go_template_2[] = 
 "# Go\n"
 "*.exe\n"
 "*.test\n"
 "*.out\n"
-"vendor/\n"
-;
+"vendor/\n";
+
+static const builtin_line_t go_template_2_lines[] = {
+    {0, 0, 4, 0, 0, BUILTIN_LINE_COMMENT},
+    {0xe9b70ed62299fda3ULL, 5, 5, 5, 5, 0},
+    {0xdfec6e6647b75721ULL, 11, 6, 11, 6, 0},
+    {0xb39409d603530f43ULL, 18, 5, 18, 5, 0},
+    {0x4189008d7c24d5b4ULL, 24, 7, 24, 7, 0},
+};
 
 // java template
-static const char java_template[] = 
+static const char java_template_3[] = 
 "# Java\n"
 "*.class\n"
 "*.jar\n"
@@ -50,26 +76,47 @@ static const char java_template[] =
 "*.ear\n"
 "target/\n"
 ".gradle/\n"
-"build/\n"
-;
+"build/\n";
+
+static const builtin_line_t java_template_3_lines[] = {
+    {0, 0, 6, 0, 0, BUILTIN_LINE_COMMENT},
+    {0xbb8601ad0ac29b53ULL, 7, 7, 7, 7, 0},
+    {0x9a939ad5f571a0ceULL, 15, 5, 15, 5, 0},
+    {0x8553dfd67aa80d69ULL, 21, 5, 21, 5, 0},
+    {0xe96915d62257e837ULL, 27, 5, 27, 5, 0},
+    {0xef50d6ab38ed0b25ULL, 33, 7, 33, 7, 0},
+    {0x5afa96a661600b7fULL, 41, 8, 41, 8, 0},
+    {0x8612c2099a37fbc4ULL, 50, 6, 50, 6, 0},
+};
 
 // linux template
-static const char linux_template[] = 
+static const char linux_template_4[] = 
 "# Linux\n"
 "*~\n"
-".directory\n"
-;
+".directory\n";
+
+static const builtin_line_t linux_template_4_lines[] = {
+    {0, 0, 7, 0, 0, BUILTIN_LINE_COMMENT},
+    {0x07e74a07b4ab1b19ULL, 8, 2, 8, 2, 0},
+    {0xfee0818184ddf1ecULL, 11, 10, 11, 10, 0},
+};
 
 // macos template
-static const char macos_template[] = 
+static const char macos_template_5[] = 
 "# macOS\n"
 ".DS_Store\n"
 ".AppleDouble\n"
-".LSOverride\n"
-;
+".LSOverride\n";
+
+static const builtin_line_t macos_template_5_lines[] = {
+    {0, 0, 7, 0, 0, BUILTIN_LINE_COMMENT},
+    {0xac12dcbd94dc03aaULL, 8, 9, 8, 9, 0},
+    {0x2683b7964d0d8dceULL, 18, 12, 18, 12, 0},
+    {0xadee8da099ee73a4ULL, 31, 11, 31, 11, 0},
+};
 
 // node template
-static const char node_template[] = 
+static const char node_template_6[] = 
 "# Node.js\n"
 "node_modules/\n"
 "npm-debug.log*\n"
@@ -80,11 +127,24 @@ static const char node_template[] =
 "build/\n"
 ".next/\n"
 ".nuxt/\n"
-"package-lock.json\n"
-;
+"package-lock.json\n";
+
+static const builtin_line_t node_template_6_lines[] = {
+    {0, 0, 9, 0, 0, BUILTIN_LINE_COMMENT},
+    {0xc20e604ce4dfbea4ULL, 10, 13, 10, 13, 0},
+    {0xb104c9afa90e2bb6ULL, 24, 14, 24, 14, 0},
+    {0x68c31c0f50b40cd5ULL, 39, 15, 39, 15, 0},
+    {0x409ec31668039aeaULL, 55, 15, 55, 15, 0},
+    {0x9b141aa7bd2181deULL, 71, 4, 71, 4, 0},
+    {0x4243d399c8fc58f2ULL, 76, 5, 76, 5, 0},
+    {0x8612c2099a37fbc4ULL, 82, 6, 82, 6, 0},
+    {0x0a80e927e1f686c9ULL, 89, 6, 89, 6, 0},
+    {0xcb0a49ab6eaf34d9ULL, 96, 6, 96, 6, 0},
+    {0x8f6ab3eb1a61d627ULL, 103, 17, 103, 17, 0},
+};
 
 // python template
-static const char python_template[] = 
+static const char python_template_7[] = 
 "# Byte-compiled / optimized / DLL files\n"
 "__pycache__/\n"
 "*.py[cod]\n"
@@ -125,73 +185,203 @@ static const char python_template[] =
 "\n"
 "# Environment\n"
 ".env\n"
-".env.local\n"
-;
+".env.local\n";
+
+static const builtin_line_t python_template_7_lines[] = {
+    {0, 0, 39, 0, 0, BUILTIN_LINE_COMMENT},
+    {0xd24eb6bea183254dULL, 40, 12, 40, 12, 0},
+    {0x88d845cd4432b80eULL, 53, 9, 53, 9, 0},
+    {0x2855862c89128032ULL, 63, 10, 63, 10, 0},
+    {0, 74, 0, 0, 0, BUILTIN_LINE_COMMENT},
+    {0, 75, 14, 0, 0, BUILTIN_LINE_COMMENT},
+    {0x234c58c768661013ULL, 90, 4, 90, 4, 0},
+    {0, 95, 0, 0, 0, BUILTIN_LINE_COMMENT},
+    {0, 96, 26, 0, 0, BUILTIN_LINE_COMMENT},
+    {0xe7ad1014ab39c6fbULL, 123, 7, 123, 7, 0},
+    {0x8612c2099a37fbc4ULL, 131, 6, 131, 6, 0},
+    {0xea76fd8300dec8b0ULL, 138, 13, 138, 13, 0},
+    {0x4243d399c8fc58f2ULL, 152, 5, 152, 5, 0},
+    {0x3544ee53ee873283ULL, 158, 10, 158, 10, 0},
+    {0x6c4df2834563ed60ULL, 169, 5, 169, 5, 0},
+    {0xcae15da045ae1314ULL, 175, 6, 175, 6, 0},
+    {0xbf3dbfad694347d9ULL, 182, 4, 182, 4, 0},
+    {0x4e56a7a384cbc273ULL, 187, 6, 187, 6, 0},
+    {0xe807cdd83ab2159eULL, 194, 6, 194, 6, 0},
+    {0xcfcb1bdc851057abULL, 201, 6, 201, 6, 0},
+    {0x43520400edc123e3ULL, 208, 4, 208, 4, 0},
+    {0xf364791ac1692296ULL, 213, 7, 213, 7, 0},
+    {0xd259aadbb4ab3caeULL, 221, 11, 221, 11, 0},
+    {0xa761772b5c3bc6c5ULL, 233, 14, 233, 14, 0},
+    {0xe96220d62251dc3aULL, 248, 5, 248, 5, 0},
+    {0, 254, 0, 0, 0, BUILTIN_LINE_COMMENT},
+    {0, 255, 22, 0, 0, BUILTIN_LINE_COMMENT},
+    {0x7e9c05b6f57ddd15ULL, 278, 5, 278, 5, 0},
+    {0x915508605db9af81ULL, 284, 4, 284, 4, 0},
+    {0xcef2296cfa5b25a1ULL, 289, 4, 289, 4, 0},
+    {0x4427054057fd87d4ULL, 294, 5, 294, 5, 0},
+    {0, 300, 0, 0, 0, BUILTIN_LINE_COMMENT},
+    {0, 301, 6, 0, 0, BUILTIN_LINE_COMMENT},
+    {0x02500a8a8b0e37bbULL, 308, 6, 308, 6, 0},
+    {0xf8b91b3b42b43be0ULL, 315, 8, 315, 8, 0},
+    {0x611c4dd665b24a91ULL, 324, 5, 324, 5, 0},
+    {0x611c56d665b259dcULL, 330, 5, 330, 5, 0},
+    {0, 336, 0, 0, 0, BUILTIN_LINE_COMMENT},
+    {0, 337, 13, 0, 0, BUILTIN_LINE_COMMENT},
+    {0x3d265ca7884fe860ULL, 351, 4, 351, 4, 0},
+    {0x03f198d79466fa21ULL, 356, 10, 356, 10, 0},
+};
 
 // rust template
-static const char rust_template[] = 
+static const char rust_template_8[] = 
 "# Rust\n"
 "target/\n"
 "Cargo.lock\n"
 "**/*.rs.bk\n"
-"*.pdb\n"
-;
+"*.pdb\n";
+
+static const builtin_line_t rust_template_8_lines[] = {
+    {0, 0, 6, 0, 0, BUILTIN_LINE_COMMENT},
+    {0xef50d6ab38ed0b25ULL, 7, 7, 7, 7, 0},
+    {0x419e0795a69dac44ULL, 15, 10, 15, 10, 0},
+    {0x635654b1780f2eceULL, 26, 10, 26, 10, 0},
+    {0x5a0e1ad66227c8ddULL, 37, 5, 37, 5, 0},
+};
 
 // vscode template
-static const char vscode_template[] = 
+static const char vscode_template_9[] = 
 "# VS Code\n"
 ".vscode/\n"
-"*.code-workspace\n"
-;
+"*.code-workspace\n";
+
+static const builtin_line_t vscode_template_9_lines[] = {
+    {0, 0, 9, 0, 0, BUILTIN_LINE_COMMENT},
+    {0xf8b91b3b42b43be0ULL, 10, 8, 10, 8, 0},
+    {0x6045af84ab0eea0cULL, 19, 16, 19, 16, 0},
+};
 
 // windows template
-static const char windows_template[] = 
+static const char windows_template_10[] = 
 "# Windows\n"
 "Thumbs.db\n"
 "ehthumbs.db\n"
-"Desktop.ini\n"
-;
-
-// All built-in templates
-static const builtin_template_t builtin_templates[] = {
-    {"c", c_template},
-    {"cpp", cpp_template},
-    {"go", go_template},
-    {"java", java_template},
-    {"linux", linux_template},
-    {"macos", macos_template},
-    {"node", node_template},
-    {"python", python_template},
-    {"rust", rust_template},
-    {"vscode", vscode_template},
-    {"windows", windows_template},
-    {NULL, NULL}
+"Desktop.ini\n";
+
+static const builtin_line_t windows_template_10_lines[] = {
+    {0, 0, 9, 0, 0, BUILTIN_LINE_COMMENT},
+    {0x51f0c993913378c8ULL, 10, 9, 10, 9, 0},
+    {0x2559bd29858978ebULL, 20, 11, 20, 11, 0},
+    {0xf1e584560a03c1dfULL, 32, 11, 32, 11, 0},
 };
 
-// Get built-in template by name
-const char* get_builtin_template(const char *name) {
-    for (int i = 0; builtin_templates[i].name != NULL; i++) {
-        if (strcasecmp(builtin_templates[i].name, name) == 0) {
-            return builtin_templates[i].content;
-        }
+// All built-in templates, sorted by case-folded name
+static const builtin_template_t builtin_templates[11] = {
+    {"c", c_template_0, sizeof(c_template_0) - 1, c_template_0_lines, 7, 6},
+    {"cpp", cpp_template_1, sizeof(cpp_template_1) - 1, cpp_template_1_lines, 8, 7},
+    {"go", go_template_2, sizeof(go_template_2) - 1, go_template_2_lines, 5, 4},
+    {"java", java_template_3, sizeof(java_template_3) - 1, java_template_3_lines, 8, 7},
+    {"linux", linux_template_4, sizeof(linux_template_4) - 1, linux_template_4_lines, 3, 2},
+    {"macos", macos_template_5, sizeof(macos_template_5) - 1, macos_template_5_lines, 4, 3},
+    {"node", node_template_6, sizeof(node_template_6) - 1, node_template_6_lines, 11, 10},
+    {"python", python_template_7, sizeof(python_template_7) - 1, python_template_7_lines, 41, 30},
+    {"rust", rust_template_8, sizeof(rust_template_8) - 1, rust_template_8_lines, 5, 4},
+    {"vscode", vscode_template_9, sizeof(vscode_template_9) - 1, vscode_template_9_lines, 3, 2},
+    {"windows", windows_template_10, sizeof(windows_template_10) - 1, windows_template_10_lines, 4, 3},
+};
+
+static const char *builtin_names[12] = {
+    "c",
+    "cpp",
+    "go",
+    "java",
+    "linux",
+    "macos",
+    "node",
+    "python",
+    "rust",
+    "vscode",
+    "windows",
+    NULL
+};
+
+#define BUILTIN_KEY_COUNT 27
+#define BUILTIN_BUCKET_COUNT 7
+#define BUILTIN_MAX_KEY 16
+
+static const uint32_t builtin_displace[BUILTIN_BUCKET_COUNT] = {
+    6, 1, 3, 1, 156, 15, 13
+};
+
+static const builtin_slot_t builtin_slots[BUILTIN_KEY_COUNT] = {
+    {"c++", 1},
+    {"win32", 10},
+    {"win", 10},
+    {"cpp", 1},
+    {"js", 6},
+    {"osx", 5},
+    {"c", 0},
+    {"python", 7},
+    {"mac", 5},
+    {"macos", 5},
+    {"go", 2},
+    {"cxx", 1},
+    {"linux", 4},
+    {"python3", 7},
+    {"java", 3},
+    {"node", 6},
+    {"windows", 10},
+    {"py", 7},
+    {"golang", 2},
+    {"darwin", 5},
+    {"visualstudiocode", 9},
+    {"vscode", 9},
+    {"vs-code", 9},
+    {"javascript", 6},
+    {"rust", 8},
+    {"nodejs", 6},
+    {"rs", 8},
+};
+
+static uint64_t builtin_hash(const char *key, uint64_t seed) {
+    uint64_t h = 14695981039346656037ULL ^ (seed * 0x9E3779B97F4A7C15ULL);
+    for (const unsigned char *p = (const unsigned char *)key; *p; p++) {
+        h ^= *p;
+        h *= 1099511628211ULL;
     }
-    return NULL;
+    h ^= h >> 29;
+    return h;
+}
+
+// Look up a built-in by name or alias (case-insensitive)
+const builtin_template_t* find_builtin_template(const char *name) {
+    char folded[BUILTIN_MAX_KEY + 1];
+    size_t len = 0;
+
+    for (; name[len]; len++) {
+        if (len == BUILTIN_MAX_KEY) return NULL;
+        unsigned char c = (unsigned char)name[len];
+        folded[len] = (char)(c >= 'A' && c <= 'Z' ? c + 32 : c);
+    }
+    folded[len] = '\0';
+
+    uint32_t bucket = (uint32_t)(builtin_hash(folded, 0) % BUILTIN_BUCKET_COUNT);
+    uint32_t slot = (uint32_t)(builtin_hash(folded, builtin_displace[bucket]) % BUILTIN_KEY_COUNT);
+
+    const builtin_slot_t *s = &builtin_slots[slot];
+    return strcmp(s->key, folded) == 0 ? &builtin_templates[s->template_index] : NULL;
+}
+
+// Get built-in template by name or alias (case-insensitive)
+const char* get_builtin_template(const char *name) {
+    const builtin_template_t *t = find_builtin_template(name);
+    return t ? t->content : NULL;
 }
 
 // Check if template is built-in
 int is_builtin_template(const char *name) {
-    return get_builtin_template(name) != NULL;
+    return find_builtin_template(name) != NULL;
 }
 
-// Get all built-in template names
+// Get all built-in template names, sorted and NULL-terminated
 const char** get_builtin_template_names(void) {
-    static const char *names[64];
-    int count = 0;
-    
-    for (int i = 0; builtin_templates[i].name != NULL && count < 63; i++) {
-        names[count++] = builtin_templates[i].name;
-    }
-    names[count] = NULL;
-    
-    return names;
+    return builtin_names;
 }
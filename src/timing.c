@@ -0,0 +1,183 @@
+// timing.c - Phase spans reported by --timings
+//
+// Spans are recorded whether or not --timings was given, because the
+// config is loaded before any flag is parsed. A span costs two monotonic
+// clock reads and a slot in a fixed table, so leaving it on is cheap.
+// Nesting depth is kept per thread, which keeps the merges batch runs in
+// worker threads correctly indented.
+//
+// make dev builds also count heap allocations between a span's start and
+// end (process-wide, so spans of concurrent threads see each other's).
+#include "gitignore.h"
+#include <stdarg.h>
+
+#define TIMING_MAX_SPANS 1024
+
+typedef struct {
+    const char *name;
+    char detail[80];
+    uint64_t start;         // ns since the first span
+    uint64_t end;           // 0 while open
+    int depth;
+#if GITIGNORE_ALLOC_COUNTS
+    uint64_t allocs_start;
+    uint64_t allocs_end;
+#endif
+} timing_span_t;
+
+static timing_span_t g_spans[TIMING_MAX_SPANS];
+static int g_span_count;
+static int g_span_dropped;
+static uint64_t g_epoch;
+static _Thread_local int t_depth;
+
+static uint64_t timing_clock(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Forget every span, e.g. in a request forked from the serve daemon
+void timing_reset(void) {
+    g_span_count = 0;
+    g_span_dropped = 0;
+    g_epoch = 0;
+    t_depth = 0;
+}
+
+// Milliseconds since the first span, the timeline every report uses
+double timing_elapsed_ms(void) {
+    if (g_epoch == 0) g_epoch = timing_clock();
+    return (double)(timing_clock() - g_epoch) / 1e6;
+}
+
+// Open a span; returns its id for timing_end and timing_note
+int timing_begin(const char *name) {
+    if (g_epoch == 0) g_epoch = timing_clock();
+
+    int depth = t_depth++;
+    int id = __atomic_fetch_add(&g_span_count, 1, __ATOMIC_RELAXED);
+    if (id >= TIMING_MAX_SPANS) {
+        __atomic_fetch_add(&g_span_dropped, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+
+    timing_span_t *s = &g_spans[id];
+    s->name = name;
+    s->detail[0] = '\0';
+    s->depth = depth;
+    s->end = 0;
+#if GITIGNORE_ALLOC_COUNTS
+    s->allocs_start = heap_alloc_count();
+    s->allocs_end = 0;
+#endif
+    s->start = timing_clock() - g_epoch;
+    return id;
+}
+
+void timing_end(int id) {
+    t_depth--;
+    if (id < 0) return;
+    g_spans[id].end = timing_clock() - g_epoch;
+#if GITIGNORE_ALLOC_COUNTS
+    g_spans[id].allocs_end = heap_alloc_count();
+#endif
+}
+
+#if GITIGNORE_ALLOC_COUNTS
+// Heap allocations made while a span was open (so far, for open ones)
+static uint64_t timing_allocs(const timing_span_t *s) {
+    return (s->end ? s->allocs_end : heap_alloc_count()) - s->allocs_start;
+}
+#endif
+
+// Attach a short description, e.g. the template and whether the cache hit
+void timing_note(int id, const char *fmt, ...) {
+    if (id < 0) return;
+
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(g_spans[id].detail, sizeof(g_spans[id].detail), fmt, ap);
+    va_end(ap);
+}
+
+void timing_json_string(FILE *out, const char *s) {
+    fputc('"', out);
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') fprintf(out, "\\%c", c);
+        else if (c < 0x20) fprintf(out, "\\u%04x", c);
+        else fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+static void timing_report_json(FILE *out, int count, uint64_t now) {
+    fprintf(out, "{\"total_ms\": %.3f, \"spans\": [", (double)now / 1e6);
+
+    for (int i = 0; i < count; i++) {
+        const timing_span_t *s = &g_spans[i];
+        uint64_t end = s->end ? s->end : now;
+
+        fprintf(out, "%s\n  {\"name\": ", i > 0 ? "," : "");
+        timing_json_string(out, s->name);
+        fprintf(out, ", \"detail\": ");
+        timing_json_string(out, s->detail);
+        fprintf(out, ", \"depth\": %d, \"start_ms\": %.3f, \"duration_ms\": %.3f",
+                s->depth, (double)s->start / 1e6, (double)(end - s->start) / 1e6);
+#if GITIGNORE_ALLOC_COUNTS
+        fprintf(out, ", \"heap_allocs\": %llu", (unsigned long long)timing_allocs(s));
+#endif
+        fputc('}', out);
+    }
+
+    fprintf(out, "%s], \"dropped_spans\": %d, ", count > 0 ? "\n" : "", g_span_dropped);
+#if GITIGNORE_ALLOC_COUNTS
+    fprintf(out, "\"heap_allocs\": %llu, ", (unsigned long long)heap_alloc_count());
+#endif
+    fprintf(out, "\"transfers\": ");
+    fetch_report_timings(out, 1);
+    fprintf(out, "}\n");
+}
+
+// Print every span and the network transfers, as a table or as one JSON
+// object. Spans still open (the report runs inside "run") end now.
+void timing_report(FILE *out, int json) {
+    uint64_t now = timing_clock() - g_epoch;
+    int count = g_span_count < TIMING_MAX_SPANS ? g_span_count : TIMING_MAX_SPANS;
+
+    if (json) {
+        timing_report_json(out, count, now);
+        return;
+    }
+
+    fprintf(out, "\n%sTimings (ms):%s\n", COLOR_BOLD, COLOR_RESET);
+    fprintf(out, "  %-24s %9s %9s", "phase", "start", "time");
+#if GITIGNORE_ALLOC_COUNTS
+    fprintf(out, " %7s", "allocs");
+#endif
+    fprintf(out, "  %s\n", "detail");
+
+    for (int i = 0; i < count; i++) {
+        const timing_span_t *s = &g_spans[i];
+        uint64_t end = s->end ? s->end : now;
+        int indent = s->depth * 2;
+        if (indent > 12) indent = 12;
+
+        fprintf(out, "  %*s%-*s %9.2f %9.2f", indent, "", 24 - indent, s->name,
+                (double)s->start / 1e6, (double)(end - s->start) / 1e6);
+#if GITIGNORE_ALLOC_COUNTS
+        fprintf(out, " %7llu", (unsigned long long)timing_allocs(s));
+#endif
+        fprintf(out, "  %s\n", s->detail);
+    }
+    if (g_span_dropped > 0) {
+        fprintf(out, "  (%d more span(s) not recorded)\n", g_span_dropped);
+    }
+    fprintf(out, "  %d span(s), %.2f ms since startup\n", count, (double)now / 1e6);
+#if GITIGNORE_ALLOC_COUNTS
+    fprintf(out, "  %llu heap allocation(s)\n", (unsigned long long)heap_alloc_count());
+#endif
+
+    fetch_report_timings(out, 0);
+}
@@ -1,53 +1,105 @@
 // utils.c - Enhanced utility functions
 #include "gitignore.h"
+#include <stddef.h>
 
-char* get_config_path(void) {
+// dir/name into out (MAX_PATH_LEN bytes); fails instead of truncating
+int path_join(char *out, const char *dir, const char *name) {
+    size_t dir_len = strlen(dir), name_len = strlen(name);
+    if (dir_len + 1 + name_len >= MAX_PATH_LEN) return 1;
+    
+    memcpy(out, dir, dir_len);
+    out[dir_len] = '/';
+    memcpy(out + dir_len + 1, name, name_len + 1);
+    return 0;
+}
+
+// Resolved once per process, and again only if HOME changes (serve's
+// children take on the client's environment). Building the strings costs
+// no system calls; nothing is created until a command asks for it.
+const app_paths_t* app_paths(void) {
+    static app_paths_t paths;
+    static int resolved;
+    
     const char *home = getenv("HOME");
     if (!home) {
         print_error("HOME environment variable not set", ERR_INVALID_ARGUMENT);
         return NULL;
     }
+    if (resolved && strcmp(paths.home, home) == 0) return &paths;
     
-    char *path = malloc(MAX_PATH_LEN);
-    if (!path) return NULL;
-    
-    snprintf(path, MAX_PATH_LEN, "%s/%s/%s", home, CONFIG_DIR, TEMPLATES_DIR);
-    
-    // Create directory if it doesn't exist
-    char dir_path[MAX_PATH_LEN];
-    snprintf(dir_path, sizeof(dir_path), "%s/%s", home, CONFIG_DIR);
-    
-    struct stat st = {0};
-    if (stat(dir_path, &st) == -1) {
-        mkdir(dir_path, 0755);
-    }
-    
-    if (stat(path, &st) == -1) {
-        mkdir(path, 0755);
+    memset(&paths, 0, sizeof(paths));
+    resolved = 0;
+    if (path_join(paths.config_dir, home, CONFIG_DIR) != 0 ||
+        path_join(paths.templates_dir, paths.config_dir, TEMPLATES_DIR) != 0 ||
+        path_join(paths.cache_dir, paths.config_dir, CACHE_DIR) != 0 ||
+        path_join(paths.backup_dir, paths.config_dir, BACKUP_DIR) != 0 ||
+        path_join(paths.config_file, paths.config_dir, CONFIG_FILE) != 0) {
+        print_error("HOME path is too long", ERR_INVALID_ARGUMENT);
+        return NULL;
     }
-    
-    return path;
+    memcpy(paths.home, home, strlen(home) + 1);
+    resolved = 1;
+    return &paths;
 }
 
-char* get_template_path(const char *lang) {
-    char *config_path = get_config_path();
-    if (!config_path) return NULL;
+// Make sure the given APP_DIR_* directories exist. Each costs one mkdir
+// the first time it is asked for (more only when parents are missing) and
+// nothing after that.
+int app_paths_ensure(unsigned dirs) {
+    app_paths_t *paths = (app_paths_t *)app_paths();
+    if (!paths) return 1;
     
-    char *full_path = malloc(MAX_PATH_LEN);
-    if (!full_path) {
-        free(config_path);
-        return NULL;
+    static const struct { unsigned bit; size_t offset; } dir_table[] = {
+        { APP_DIR_CONFIG,    offsetof(app_paths_t, config_dir) },
+        { APP_DIR_TEMPLATES, offsetof(app_paths_t, templates_dir) },
+        { APP_DIR_CACHE,     offsetof(app_paths_t, cache_dir) },
+        { APP_DIR_BACKUP,    offsetof(app_paths_t, backup_dir) },
+    };
+    
+    int rc = 0;
+    for (size_t i = 0; i < sizeof(dir_table) / sizeof(dir_table[0]); i++) {
+        if (!(dirs & dir_table[i].bit) || (paths->ensured & dir_table[i].bit)) continue;
+        
+        const char *dir = (const char *)paths + dir_table[i].offset;
+        if (mkdir(dir, 0755) == 0 || errno == EEXIST ||
+            (errno == ENOENT && make_dirs(dir) == 0)) {
+            paths->ensured |= dir_table[i].bit;
+        } else {
+            rc = 1;
+        }
     }
+    return rc;
+}
+
+// Directory holding custom templates (caller frees)
+char* get_config_path(void) {
+    const app_paths_t *paths = app_paths();
+    return paths ? strdup(paths->templates_dir) : NULL;
+}
+
+// Path of a custom template into out (MAX_PATH_LEN bytes)
+int template_path(const char *lang, char *out) {
+    const app_paths_t *paths = app_paths();
+    if (!paths) return 1;
     
     // Check if it already has .gitignore extension
-    if (strstr(lang, ".gitignore")) {
-        snprintf(full_path, MAX_PATH_LEN, "%s/%s", config_path, lang);
-    } else {
-        snprintf(full_path, MAX_PATH_LEN, "%s/%s.gitignore", config_path, lang);
-    }
+    const char *ext = strstr(lang, ".gitignore") ? "" : ".gitignore";
+    int n = snprintf(out, MAX_PATH_LEN, "%s/%s%s", paths->templates_dir, lang, ext);
+    return n < 0 || n >= MAX_PATH_LEN;
+}
+
+// Number of lines in a buffer, counting an unterminated last one
+size_t count_lines(const char *data, size_t size) {
+    size_t lines = 0;
+    const char *p = data;
+    const char *end = data + size;
     
-    free(config_path);
-    return full_path;
+    while (p < end) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        lines++;
+        p = nl ? nl + 1 : end;
+    }
+    return lines;
 }
 
 int file_exists(const char *path) {
@@ -55,6 +107,50 @@ int file_exists(const char *path) {
     return (stat(path, &buffer) == 0);
 }
 
+// Modification time in nanoseconds; macOS calls the field st_mtimespec
+int64_t stat_mtime_ns(const struct stat *st) {
+#ifdef __APPLE__
+    const struct timespec *ts = &st->st_mtimespec;
+#else
+    const struct timespec *ts = &st->st_mtim;
+#endif
+    return (int64_t)ts->tv_sec * 1000000000 + ts->tv_nsec;
+}
+
+// Create path and any missing parents (like mkdir -p)
+int make_dirs(const char *path) {
+    char buf[MAX_PATH_LEN];
+    snprintf(buf, sizeof(buf), "%s", path);
+    
+    for (char *p = buf + 1; *p; p++) {
+        if (*p == '/') {
+            *p = '\0';
+            if (mkdir(buf, 0755) != 0 && errno != EEXIST) return 1;
+            *p = '/';
+        }
+    }
+    
+    if (mkdir(buf, 0755) != 0 && errno != EEXIST) return 1;
+    return 0;
+}
+
+// 64-bit FNV-1a
+uint64_t hash_bytes(const void *data, size_t len) {
+    return hash_bytes_update(14695981039346656037ULL, data, len);
+}
+
+// Continue an FNV-1a hash over more bytes (for data split across buffers)
+uint64_t hash_bytes_update(uint64_t h, const void *data, size_t len) {
+    const unsigned char *p = data;
+    
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    
+    return h;
+}
+
 int is_comment(const char *line) {
     if (!line) return 1;
     
@@ -67,11 +163,33 @@ int is_comment(const char *line) {
     return (*line == '#' || *line == '\0' || *line == '\n');
 }
 
+// Same as is_comment() for a line that is not NUL-terminated
+int is_comment_span(const char *line, size_t len) {
+    size_t i = 0;
+    while (i < len && (line[i] == ' ' || line[i] == '\t')) {
+        i++;
+    }
+    
+    return i == len || line[i] == '#' || line[i] == '\n' || line[i] == '\r';
+}
+
+// Whole file as a NUL-terminated heap buffer, for data that must outlive
+// the file or be modified; pipes work too
+char* read_file(const char *path, size_t *size) {
+    file_view_t fv;
+    if (file_view_open(&fv, path) != 0) return NULL;
+    
+    char *data = file_view_detach(&fv, size);
+    file_view_close(&fv);
+    return data;
+}
+
 char** remove_duplicates(char **langs, int *count) {
     if (!langs || *count == 0) return langs;
     
+    // Kept names are compacted to the front in place
     int new_count = 0;
-    char **filtered = malloc(sizeof(char*) * (*count));
+    char **filtered = langs;
     
     for (int i = 0; i < *count; i++) {
         // Skip if starts with # (comment)
@@ -101,14 +219,7 @@ char** remove_duplicates(char **langs, int *count) {
         }
     }
     
-    // Update the original array
-    for (int i = 0; i < new_count; i++) {
-        langs[i] = filtered[i];
-    }
-    
     *count = new_count;
-    free(filtered);
-    
     return langs;
 }
 
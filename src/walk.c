@@ -0,0 +1,412 @@
+// walk.c - Parallel directory walker
+//
+// Worker threads share a stack of directories still to read. Each worker
+// opens its directory with openat() relative to the start directory and
+// on Linux reads entries in bulk with getdents64, so a directory costs one
+// open and a few syscalls regardless of how many files it holds (other
+// systems fall back to readdir). A visitor sees each directory's entries
+// at once and decides which subdirectories to descend into and what state
+// they inherit.
+//
+// walk_projects() is the visitor behind auto --recursive. A directory is a
+// subproject root when its entries indicate a language that no ancestor
+// root already covers. That keeps, say, every nested CMakeLists.txt of one
+// C project from getting its own .gitignore.
+#include "gitignore.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <dirent.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#define WALK_BUF_SIZE (64 * 1024)
+
+// Directories that never hold subprojects worth ignoring
+static const char *walk_skip[] = {
+    ".git", ".hg", ".svn", "node_modules", "target", "vendor", "build",
+    "dist", "out", "__pycache__", ".venv", "venv", ".tox", ".gradle",
+    ".idea", ".vscode", ".cache", ".next", ".terraform", NULL
+};
+
+#ifdef __linux__
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+#endif
+
+typedef struct {
+    char *path;             // relative to the start directory, "." for it
+    uint32_t state;         // visitor state inherited from the parent
+} walk_item_t;
+
+typedef struct {
+    int start_fd;
+    walk_visit_fn visit;
+    void *ctx;
+
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    walk_item_t *stack;
+    int stack_count;
+    int stack_cap;
+    int active;             // workers currently reading a directory
+    int next_worker;
+    int failed;
+} walk_t;
+
+typedef struct {
+    walk_t *w;
+    int worker;
+    char *buf;
+    size_t buf_cap;
+    walk_entry_t *entries;
+    int entry_cap;
+} walk_worker_t;
+
+int walk_default_threads(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (int)cpus : 4;
+}
+
+// Called with the lock held
+static int walk_push(walk_t *w, char *path, uint32_t state) {
+    if (w->stack_count == w->stack_cap) {
+        int cap = w->stack_cap ? w->stack_cap * 2 : 256;
+        walk_item_t *stack = realloc(w->stack, (size_t)cap * sizeof(walk_item_t));
+        if (!stack) return 1;
+        w->stack = stack;
+        w->stack_cap = cap;
+    }
+
+    w->stack[w->stack_count].path = path;
+    w->stack[w->stack_count].state = state;
+    w->stack_count++;
+    return 0;
+}
+
+static char* walk_join(const char *dir, const char *name) {
+    if (strcmp(dir, ".") == 0) return strdup(name);
+
+    size_t dir_len = strlen(dir);
+    size_t name_len = strlen(name);
+    char *path = malloc(dir_len + name_len + 2);
+    if (!path) return NULL;
+
+    memcpy(path, dir, dir_len);
+    path[dir_len] = '/';
+    memcpy(path + dir_len + 1, name, name_len + 1);
+    return path;
+}
+
+// Make room for need more bytes at used. Names already collected point
+// into the buffer, so it grows instead of being reused.
+static int walk_reserve(walk_worker_t *ww, int count, size_t used, size_t need) {
+    if (used + need <= ww->buf_cap) return 0;
+
+    size_t cap = used + (need > WALK_BUF_SIZE ? need : WALK_BUF_SIZE);
+    char *grown = malloc(cap);
+    if (!grown) return 1;
+    memcpy(grown, ww->buf, used);
+    // Rebase the names already collected
+    for (int i = 0; i < count; i++) {
+        ww->entries[i].name = grown + (ww->entries[i].name - ww->buf);
+    }
+    free(ww->buf);
+    ww->buf = grown;
+    ww->buf_cap = cap;
+    return 0;
+}
+
+// Add one directory entry (name must stay valid for the visit)
+static int walk_add(walk_worker_t *ww, int *count, int fd, const char *name, unsigned char type) {
+    if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) return 0;
+
+    if (*count == ww->entry_cap) {
+        int cap = ww->entry_cap ? ww->entry_cap * 2 : 256;
+        walk_entry_t *grown = realloc(ww->entries, (size_t)cap * sizeof(walk_entry_t));
+        if (!grown) return 1;
+        ww->entries = grown;
+        ww->entry_cap = cap;
+    }
+
+    int is_dir = type == DT_DIR;
+    if (type == DT_UNKNOWN) {
+        struct stat st;
+        is_dir = fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode);
+    }
+
+    walk_entry_t *e = &ww->entries[(*count)++];
+    e->name = name;
+    e->is_dir = is_dir;
+    e->descend = is_dir;
+    return 0;
+}
+
+#ifdef __linux__
+// Read the entries of fd in bulk straight into the worker's buffer
+static int walk_read(walk_worker_t *ww, int fd) {
+    size_t used = 0;
+    int count = 0;
+    for (;;) {
+        long n = syscall(SYS_getdents64, fd, ww->buf + used, WALK_BUF_SIZE);
+        if (n <= 0) break;
+
+        for (long off = 0; off < n;) {
+            struct linux_dirent64 *d = (struct linux_dirent64 *)(ww->buf + used + off);
+            off += d->d_reclen;
+            if (walk_add(ww, &count, fd, d->d_name, d->d_type) != 0) return count;
+        }
+
+        used += (size_t)n;
+        if (walk_reserve(ww, count, used, WALK_BUF_SIZE) != 0) break;
+    }
+    return count;
+}
+#else
+// Portable fallback: readdir on a duplicate of fd (closedir closes the
+// descriptor it was given), copying each name into the worker's buffer
+static int walk_read(walk_worker_t *ww, int fd) {
+    int dup_fd = dup(fd);
+    DIR *dir = dup_fd >= 0 ? fdopendir(dup_fd) : NULL;
+    if (!dir) {
+        if (dup_fd >= 0) close(dup_fd);
+        return 0;
+    }
+
+    size_t used = 0;
+    int count = 0;
+    struct dirent *d;
+    while ((d = readdir(dir)) != NULL) {
+        size_t len = strlen(d->d_name) + 1;
+        if (walk_reserve(ww, count, used, len) != 0) break;
+        char *name = ww->buf + used;
+        memcpy(name, d->d_name, len);
+        used += len;
+        if (walk_add(ww, &count, fd, name, d->d_type) != 0) break;
+    }
+    closedir(dir);
+    return count;
+}
+#endif
+
+// Read one directory, hand its entries to the visitor, queue the
+// subdirectories it kept
+static void walk_dir(walk_worker_t *ww, walk_item_t item) {
+    walk_t *w = ww->w;
+    int fd = openat(w->start_fd, item.path, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) {
+        free(item.path);
+        return;
+    }
+
+    int count = walk_read(ww, fd);
+
+    uint32_t state = item.state;
+    w->visit(w->ctx, ww->worker, fd, item.path, ww->entries, count, &state);
+    close(fd);
+
+    char **children = NULL;
+    int child_count = 0;
+    for (int i = 0; i < count; i++) {
+        if (ww->entries[i].descend) child_count++;
+    }
+    if (child_count > 0) {
+        children = malloc((size_t)child_count * sizeof(char *));
+        child_count = 0;
+        for (int i = 0; children && i < count; i++) {
+            if (!ww->entries[i].descend) continue;
+            children[child_count] = walk_join(item.path, ww->entries[i].name);
+            if (children[child_count]) child_count++;
+        }
+    }
+
+    pthread_mutex_lock(&w->lock);
+    for (int i = 0; i < child_count; i++) {
+        if (walk_push(w, children[i], state) != 0) {
+            free(children[i]);
+            w->failed = 1;
+        }
+    }
+    if (child_count > 0) pthread_cond_broadcast(&w->wake);
+    pthread_mutex_unlock(&w->lock);
+
+    free(children);
+    free(item.path);
+}
+
+static void* walk_worker(void *arg) {
+    walk_t *w = arg;
+    walk_worker_t ww;
+    memset(&ww, 0, sizeof(ww));
+    ww.w = w;
+    ww.buf = malloc(WALK_BUF_SIZE);
+    ww.buf_cap = WALK_BUF_SIZE;
+
+    pthread_mutex_lock(&w->lock);
+    ww.worker = w->next_worker++;
+    if (!ww.buf) {
+        w->failed = 1;
+        pthread_mutex_unlock(&w->lock);
+        return NULL;
+    }
+
+    for (;;) {
+        while (w->stack_count == 0 && w->active > 0) {
+            pthread_cond_wait(&w->wake, &w->lock);
+        }
+        if (w->stack_count == 0) break;     // nothing queued, nobody working
+
+        walk_item_t item = w->stack[--w->stack_count];
+        w->active++;
+        pthread_mutex_unlock(&w->lock);
+
+        walk_dir(&ww, item);
+
+        pthread_mutex_lock(&w->lock);
+        w->active--;
+        if (w->active == 0 && w->stack_count == 0) pthread_cond_broadcast(&w->wake);
+    }
+    pthread_mutex_unlock(&w->lock);
+
+    free(ww.buf);
+    free(ww.entries);
+    return NULL;
+}
+
+// Walk everything below start with up to threads workers. The visitor is
+// called concurrently, once per directory, with worker numbers below
+// threads so it can keep per-worker state without locking.
+int walk_tree(const char *start, int threads, walk_visit_fn visit, void *ctx) {
+    walk_t w;
+    memset(&w, 0, sizeof(w));
+    w.visit = visit;
+    w.ctx = ctx;
+
+    w.start_fd = open(start, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (w.start_fd < 0) return 1;
+
+    pthread_mutex_init(&w.lock, NULL);
+    pthread_cond_init(&w.wake, NULL);
+
+    char *top = strdup(".");
+    if (!top || walk_push(&w, top, 0) != 0) {
+        free(top);
+        w.failed = 1;
+    }
+
+    if (threads < 1) threads = 1;
+    pthread_t *ids = malloc((size_t)threads * sizeof(pthread_t));
+    int started = 0;
+    for (int i = 0; ids && i < threads; i++) {
+        if (pthread_create(&ids[i], NULL, walk_worker, &w) != 0) break;
+        started++;
+    }
+    if (started == 0) {
+        walk_worker(&w);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(ids[i], NULL);
+    }
+    free(ids);
+
+    close(w.start_fd);
+    pthread_mutex_destroy(&w.lock);
+    pthread_cond_destroy(&w.wake);
+    for (int i = 0; i < w.stack_count; i++) {
+        free(w.stack[i].path);
+    }
+    free(w.stack);
+
+    return w.failed;
+}
+
+typedef struct {
+    pthread_mutex_t lock;
+    project_root_t *roots;
+    int root_count;
+    int root_cap;
+    int failed;
+} project_walk_t;
+
+static int walk_skipped(const char *name) {
+    for (int i = 0; walk_skip[i] != NULL; i++) {
+        if (name[0] == walk_skip[i][0] && strcmp(name, walk_skip[i]) == 0) return 1;
+    }
+    return 0;
+}
+
+// state carries the root languages covered by ancestors
+static void project_visit(void *ctx, int worker, int dirfd, const char *path,
+                          walk_entry_t *entries, int count, uint32_t *state) {
+    project_walk_t *pw = ctx;
+    (void)worker;
+    (void)dirfd;
+
+    uint32_t langs = 0;
+    for (int i = 0; i < count; i++) {
+        langs |= project_indicator_mask(entries[i].name);
+        if (entries[i].is_dir && walk_skipped(entries[i].name)) entries[i].descend = 0;
+    }
+
+    uint32_t root_langs = project_root_mask(langs);
+    uint32_t inherited = *state;
+    *state = inherited | root_langs;
+    if (!(root_langs & ~inherited)) return;
+
+    char *copy = strdup(path);
+
+    pthread_mutex_lock(&pw->lock);
+    if (pw->root_count == pw->root_cap) {
+        int cap = pw->root_cap ? pw->root_cap * 2 : 64;
+        project_root_t *roots = realloc(pw->roots, (size_t)cap * sizeof(project_root_t));
+        if (roots) {
+            pw->roots = roots;
+            pw->root_cap = cap;
+        }
+    }
+    if (copy && pw->root_count < pw->root_cap) {
+        pw->roots[pw->root_count].path = copy;
+        pw->roots[pw->root_count].langs = langs;
+        pw->root_count++;
+    } else {
+        free(copy);
+        pw->failed = 1;
+    }
+    pthread_mutex_unlock(&pw->lock);
+}
+
+static int walk_cmp_root(const void *a, const void *b) {
+    return strcmp(((const project_root_t *)a)->path, ((const project_root_t *)b)->path);
+}
+
+// Find every subproject root below start. Roots come back sorted by path.
+int walk_projects(const char *start, int threads, project_root_t **roots, int *count) {
+    project_walk_t pw;
+    memset(&pw, 0, sizeof(pw));
+    pthread_mutex_init(&pw.lock, NULL);
+
+    int rc = walk_tree(start, threads, project_visit, &pw);
+    pthread_mutex_destroy(&pw.lock);
+
+    if (rc != 0 || pw.failed) {
+        free_project_roots(pw.roots, pw.root_count);
+        return 1;
+    }
+
+    qsort(pw.roots, (size_t)pw.root_count, sizeof(project_root_t), walk_cmp_root);
+    *roots = pw.roots;
+    *count = pw.root_count;
+    return 0;
+}
+
+void free_project_roots(project_root_t *roots, int count) {
+    for (int i = 0; i < count; i++) {
+        free(roots[i].path);
+    }
+    free(roots);
+}
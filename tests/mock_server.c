@@ -0,0 +1,318 @@
+// mock_server.c - Stand-in for the template host in tests and benchmarks
+//
+// Serves the files of a directory over HTTP/1.1 on 127.0.0.1 with
+// keep-alive and ETags (If-None-Match gets a 304), so sync can be
+// exercised without network access. Latency, bandwidth and failures can be
+// injected, and every request can be logged for tests to check what the
+// client actually asked for.
+//
+//   mock_server --root DIR [--port N] [--latency MS] [--rate BYTES_PER_SEC]
+//               [--status FILE=CODE]... [--fail-every N] [--no-etag] [--log FILE]
+//
+// The port actually bound is printed on stdout, which lets --port 0 pick a
+// free one. The server runs until it is killed.
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MOCK_MAX_STATUS 32
+#define MOCK_REQUEST_MAX 8192
+
+typedef struct {
+    char name[128];
+    int code;
+} mock_status_t;
+
+static const char *g_root = NULL;
+static int g_port = 0;
+static long g_latency_ms = 0;
+static long g_rate = 0;
+static int g_fail_every = 0;
+static int g_etag = 1;
+static mock_status_t g_status[MOCK_MAX_STATUS];
+static int g_status_count = 0;
+
+static FILE *g_log = NULL;
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static long g_requests = 0;
+
+static void sleep_ms(long ms) {
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {}
+}
+
+static const char* status_text(int code) {
+    switch (code) {
+    case 200: return "OK";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 500: return "Internal Server Error";
+    case 502: return "Bad Gateway";
+    case 503: return "Service Unavailable";
+    default:  return "Status";
+    }
+}
+
+static int write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return 1;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// Send the body in slices of a tenth of the rate, ten times a second
+static int write_body(int fd, const char *data, size_t len) {
+    if (g_rate <= 0) return write_all(fd, data, len);
+
+    size_t slice = (size_t)(g_rate / 10);
+    if (slice == 0) slice = 1;
+    while (len > 0) {
+        size_t n = len < slice ? len : slice;
+        if (write_all(fd, data, n) != 0) return 1;
+        data += n;
+        len -= n;
+        if (len > 0) sleep_ms(100);
+    }
+    return 0;
+}
+
+static void log_request(const char *path, int code, const char *inm) {
+    pthread_mutex_lock(&g_lock);
+    if (g_log) {
+        fprintf(g_log, "GET %s %d%s\n", path, code, inm ? " conditional" : "");
+        fflush(g_log);
+    }
+    pthread_mutex_unlock(&g_lock);
+}
+
+static char* read_whole(const char *path, size_t *size, struct stat *st) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    if (fstat(fd, st) != 0 || !S_ISREG(st->st_mode)) {
+        close(fd);
+        return NULL;
+    }
+
+    char *data = malloc((size_t)st->st_size + 1);
+    size_t got = 0;
+    while (data && got < (size_t)st->st_size) {
+        ssize_t n = read(fd, data + got, (size_t)st->st_size - got);
+        if (n <= 0) break;
+        got += (size_t)n;
+    }
+    close(fd);
+    *size = got;
+    return data;
+}
+
+// Answer one request; returns nonzero when the connection must close
+static int handle_request(int fd, char *req) {
+    char method[16], target[1024];
+    if (sscanf(req, "%15s %1023s", method, target) != 2) return 1;
+
+    char *inm = strcasestr(req, "\r\nIf-None-Match:");
+    char etag_in[128] = "";
+    if (inm) {
+        inm += 16;
+        while (*inm == ' ') inm++;
+        size_t n = strcspn(inm, "\r\n");
+        if (n >= sizeof(etag_in)) n = sizeof(etag_in) - 1;
+        memcpy(etag_in, inm, n);
+        etag_in[n] = '\0';
+    }
+
+    pthread_mutex_lock(&g_lock);
+    long seq = ++g_requests;
+    pthread_mutex_unlock(&g_lock);
+
+    if (g_latency_ms > 0) sleep_ms(g_latency_ms);
+
+    int code = 200;
+    const char *name = target[0] == '/' ? target + 1 : target;
+    if (strcmp(method, "GET") != 0 || strstr(name, "..") || name[0] == '\0') code = 400;
+    for (int i = 0; code == 200 && i < g_status_count; i++) {
+        if (strcmp(g_status[i].name, name) == 0) code = g_status[i].code;
+    }
+    if (code == 200 && g_fail_every > 0 && seq % g_fail_every == 0) code = 503;
+
+    char *body = NULL;
+    size_t size = 0;
+    char etag[64] = "";
+    if (code == 200) {
+        char path[2048];
+        struct stat st;
+        snprintf(path, sizeof(path), "%s/%s", g_root, name);
+        body = read_whole(path, &size, &st);
+        if (!body) {
+            code = 404;
+        } else if (g_etag) {
+            snprintf(etag, sizeof(etag), "\"%lx-%lx\"", (unsigned long)st.st_size,
+                     (unsigned long)st.st_mtime);
+            if (etag_in[0] && strcmp(etag_in, etag) == 0) code = 304;
+        }
+    }
+
+    const char *payload = code == 200 ? body : "";
+    size_t payload_len = code == 200 ? size : 0;
+    char error_body[64];
+    if (code != 200 && code != 304) {
+        payload_len = (size_t)snprintf(error_body, sizeof(error_body), "%d: %s\n", code, status_text(code));
+        payload = error_body;
+    }
+
+    char head[512];
+    int head_len = snprintf(head, sizeof(head),
+                            "HTTP/1.1 %d %s\r\nContent-Type: text/plain\r\nContent-Length: %zu\r\n%s%s%s\r\n",
+                            code, status_text(code), payload_len,
+                            etag[0] ? "ETag: " : "", etag, etag[0] ? "\r\n" : "");
+
+    log_request(target, code, inm ? etag_in : NULL);
+
+    int rc = write_all(fd, head, (size_t)head_len);
+    if (rc == 0 && payload_len > 0) rc = write_body(fd, payload, payload_len);
+    free(body);
+
+    return rc != 0 || strcasestr(req, "\r\nConnection: close") != NULL;
+}
+
+static void* serve_connection(void *arg) {
+    int fd = (int)(intptr_t)arg;
+    char buf[MOCK_REQUEST_MAX];
+    size_t have = 0;
+
+    for (;;) {
+        char *end = have >= 4 ? memmem(buf, have, "\r\n\r\n", 4) : NULL;
+        if (!end) {
+            if (have == sizeof(buf) - 1) break;
+            ssize_t n = read(fd, buf + have, sizeof(buf) - 1 - have);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            have += (size_t)n;
+            continue;
+        }
+
+        size_t req_len = (size_t)(end - buf) + 4;
+        char saved = buf[req_len];
+        buf[req_len] = '\0';
+        int done = handle_request(fd, buf);
+        buf[req_len] = saved;
+
+        memmove(buf, buf + req_len, have - req_len);
+        have -= req_len;
+        if (done) break;
+    }
+
+    close(fd);
+    return NULL;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s --root DIR [--port N] [--latency MS] [--rate BYTES_PER_SEC]\n"
+                    "       [--status FILE=CODE]... [--fail-every N] [--no-etag] [--log FILE]\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    const char *log_path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (strcmp(arg, "--no-etag") == 0) {
+            g_etag = 0;
+            continue;
+        }
+        if (!val) {
+            usage(argv[0]);
+            return 2;
+        }
+        i++;
+
+        if (strcmp(arg, "--root") == 0) g_root = val;
+        else if (strcmp(arg, "--port") == 0) g_port = atoi(val);
+        else if (strcmp(arg, "--latency") == 0) g_latency_ms = atol(val);
+        else if (strcmp(arg, "--rate") == 0) g_rate = atol(val);
+        else if (strcmp(arg, "--fail-every") == 0) g_fail_every = atoi(val);
+        else if (strcmp(arg, "--log") == 0) log_path = val;
+        else if (strcmp(arg, "--status") == 0 && strchr(val, '=') && g_status_count < MOCK_MAX_STATUS) {
+            mock_status_t *s = &g_status[g_status_count++];
+            snprintf(s->name, sizeof(s->name), "%.*s", (int)(strchr(val, '=') - val), val);
+            s->code = atoi(strchr(val, '=') + 1);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (!g_root) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (log_path) {
+        g_log = fopen(log_path, "a");
+        if (!g_log) {
+            perror(log_path);
+            return 1;
+        }
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+
+    int listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int one = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)g_port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (listen_fd < 0 || bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(listen_fd, 128) != 0 || getsockname(listen_fd, (struct sockaddr *)&addr, &addr_len) != 0) {
+        fprintf(stderr, "mock_server: cannot listen on 127.0.0.1:%d: %s\n", g_port, strerror(errno));
+        return 1;
+    }
+
+    printf("%d\n", ntohs(addr.sin_port));
+    fflush(stdout);
+
+    for (;;) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            perror("mock_server: accept");
+            return 1;
+        }
+
+        // Headers and body go out in separate writes
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        pthread_t id;
+        if (pthread_create(&id, NULL, serve_connection, (void *)(intptr_t)fd) != 0) {
+            close(fd);
+            continue;
+        }
+        pthread_detach(id);
+    }
+}
@@ -0,0 +1,105 @@
+#!/bin/sh
+# test_check.sh - gitignore check against git check-ignore --no-index on a
+# fixed rule set: wildmatch, negation, anchoring, "**" and dir-only rules
+#
+# usage: sh tests/test_check.sh ./gitignore
+
+TOOL=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+WORK=$(mktemp -d)
+FAILURES=0
+
+cleanup() {
+    rm -rf "$WORK"
+}
+trap cleanup EXIT
+
+pass() { echo "  ✓ $1"; }
+fail() { echo "  ✗ $1"; FAILURES=$((FAILURES + 1)); }
+
+echo "Check tests (against git check-ignore):"
+
+if ! command -v git > /dev/null 2>&1; then
+    echo "  - git not found, skipping"
+    exit 0
+fi
+
+mkdir -p "$WORK/repo"
+cd "$WORK/repo" || exit 1
+# Only the .gitignore below may contribute rules
+export HOME="$WORK" XDG_CONFIG_HOME="$WORK" GIT_CONFIG_NOSYSTEM=1
+git init -q . || exit 1
+
+cat > .gitignore <<'RULES'
+# wildmatch
+*.o
+!keep.o
+*.py[co]
+file?.tmp
+[Dd]ebug/
+\#literal
+*.[!a-m]z
+# anchoring
+/root-only.txt
+doc/*.pdf
+/vendor/lib
+# "**"
+**/logs
+src/**/gen/
+a/**/b
+cache/**
+# dir-only
+out/
+build
+!build/keep.txt
+# negation
+*.log
+!important.log
+tmp/*
+!tmp/keep/
+dist/
+!dist/
+RULES
+
+# Files and directories the paths below name, so dir-only rules can tell
+for d in src src/x/y/gen src/gen gen debug Debug lib/debug out sub/out \
+         build/sub sub/build logs deep/er/logs a/b a/x/y/b x/a/b cache/sub \
+         doc/sub/x src/doc vendor/lib sub/vendor/lib tmp/keep tmp/other dist; do
+    mkdir -p "$d"
+done
+for f in main.o src/main.o keep.o src/keep.o mod.pyc mod.pyo mod.py \
+         file1.tmp file12.tmp sub/fileA.tmp '#literal' literal pkg.tz pkg.gz \
+         root-only.txt src/root-only.txt doc/a.pdf doc/sub/x/b.pdf src/doc/a.pdf \
+         src/x/y/gen/file.c src/gen/file.c gen/file.c out.txt sub/out.txt \
+         build/keep.txt build/sub/a.c sub/build/a.c a/b/f x/a/b/f cache/sub/file \
+         cache.txt app.log important.log logs/important.log tmp/a.txt \
+         tmp/keep/a.txt tmp/other/a.txt dist/a.js; do
+    : > "$f"
+done
+
+find . -path ./.git -prune -o -print | sed 's|^\./||' | grep -v '^\.$' | sort > "$WORK/paths"
+
+# Same verdict for every path
+git check-ignore --no-index --stdin < "$WORK/paths" > "$WORK/expected"
+"$TOOL" check < "$WORK/paths" > "$WORK/actual"
+if diff "$WORK/expected" "$WORK/actual" > "$WORK/diff"; then
+    pass "ignores the same $(wc -l < "$WORK/expected" | tr -d ' ') of $(wc -l < "$WORK/paths" | tr -d ' ') paths"
+else
+    fail "ignores the same paths"
+    sed 's/^/      /' "$WORK/diff"
+fi
+
+# And credits the same rule, "!" re-includes included
+git check-ignore --no-index -v --stdin < "$WORK/paths" > "$WORK/expected"
+"$TOOL" check --explain < "$WORK/paths" > "$WORK/actual"
+if diff "$WORK/expected" "$WORK/actual" > "$WORK/diff"; then
+    pass "reports the same matching rule"
+else
+    fail "reports the same matching rule"
+    sed 's/^/      /' "$WORK/diff"
+fi
+
+if [ $FAILURES -ne 0 ]; then
+    echo "✗ $FAILURES check test(s) failed"
+    exit 1
+fi
+echo "✓ Check tests passed"
@@ -0,0 +1,116 @@
+#!/bin/sh
+# test_minimize.sh - minimize and init --minimal: which covered rules are
+# dropped and which must stay
+#
+# usage: sh tests/test_minimize.sh ./gitignore
+
+TOOL=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+WORK=$(mktemp -d)
+TEMPLATES="$WORK/home/.config/gitignore/templates"
+FAILURES=0
+
+cleanup() {
+    rm -rf "$WORK"
+}
+trap cleanup EXIT
+
+pass() { echo "  ✓ $1"; }
+fail() { echo "  ✗ $1"; FAILURES=$((FAILURES + 1)); }
+
+# Run the tool in the scratch repository; output goes to $WORK/out
+run() {
+    (cd "$WORK/repo" && HOME="$WORK/home" "$TOOL" "$@") > "$WORK/out" 2>&1
+}
+
+# The rules of a file, without comments and blank lines
+rules() {
+    grep -v '^#' "$1" | grep -v '^$'
+}
+
+echo "Minimize tests:"
+mkdir -p "$WORK/repo" "$TEMPLATES"
+
+# lib/*.so and /build/ are covered by the rules before them and
+# vendor/pkg/*.o sits in an excluded directory. The "!" between *.tmp and
+# scratch/*.tmp keeps the latter, and a dir-only out/ gives way to a
+# later plain out, never the other way round.
+cat > "$WORK/repo/.gitignore" <<'RULES'
+*.so
+lib/*.so
+build/
+/build/
+vendor/
+vendor/pkg/*.o
+*.tmp
+!keep.tmp
+scratch/*.tmp
+out/
+out
+RULES
+cp "$WORK/repo/.gitignore" "$WORK/original"
+
+cat > "$WORK/expected" <<'RULES'
+*.so
+build/
+vendor/
+*.tmp
+!keep.tmp
+scratch/*.tmp
+out
+RULES
+
+run --dry-run minimize
+rc=$?
+if [ $rc -eq 0 ] && cmp -s "$WORK/original" "$WORK/repo/.gitignore" &&
+   grep -q "line 6: vendor/pkg/\*.o  (inside line 5: vendor/)" "$WORK/out"; then
+    pass "--dry-run lists the redundant rules and leaves the file alone"
+else
+    fail "--dry-run lists the redundant rules and leaves the file alone"
+fi
+
+run minimize
+rc=$?
+if [ $rc -eq 0 ] && diff "$WORK/expected" "$WORK/repo/.gitignore" > "$WORK/diff"; then
+    pass "drops covered rules and keeps exceptions and plain rules"
+else
+    fail "drops covered rules and keeps exceptions and plain rules"
+    sed 's/^/      /' "$WORK/diff"
+fi
+
+run minimize
+rc=$?
+if [ $rc -eq 0 ] && diff "$WORK/expected" "$WORK/repo/.gitignore" > /dev/null; then
+    pass "leaves a minimal file as it is"
+else
+    fail "leaves a minimal file as it is"
+fi
+
+# The same rules split over two templates merged by init --minimal
+printf '*.so\nbuild/\nvendor/\n*.tmp\n!keep.tmp\nout/\n' > "$TEMPLATES/first.gitignore"
+printf 'lib/*.so\n/build/\nvendor/pkg/*.o\nscratch/*.tmp\nout\n' > "$TEMPLATES/second.gitignore"
+
+rm -f "$WORK/repo/.gitignore"
+run --minimal init first second
+rc=$?
+rules "$WORK/repo/.gitignore" > "$WORK/merged"
+if [ $rc -eq 0 ] && diff "$WORK/expected" "$WORK/merged" > "$WORK/diff"; then
+    pass "init --minimal leaves out the same rules"
+else
+    fail "init --minimal leaves out the same rules"
+    sed 's/^/      /' "$WORK/diff"
+fi
+
+rm -f "$WORK/repo/.gitignore"
+run init first second
+rules "$WORK/repo/.gitignore" > "$WORK/merged"
+if [ "$(wc -l < "$WORK/merged")" -eq 11 ]; then
+    pass "init without --minimal keeps every rule"
+else
+    fail "init without --minimal keeps every rule"
+fi
+
+if [ $FAILURES -ne 0 ]; then
+    echo "✗ $FAILURES minimize test(s) failed"
+    exit 1
+fi
+echo "✓ Minimize tests passed"
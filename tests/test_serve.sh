@@ -0,0 +1,119 @@
+#!/bin/sh
+# test_serve.sh - gitignore serve: forwarding, exit codes, stdin, stale
+# files, idle shutdown and falling back when no daemon is running
+#
+# usage: sh tests/test_serve.sh ./gitignore
+
+TOOL=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+WORK=$(mktemp -d)
+SOCKET="$WORK/serve.sock"
+DAEMON_PID=
+FAILURES=0
+
+cleanup() {
+    stop_daemon
+    rm -rf "$WORK"
+}
+trap cleanup EXIT
+
+pass() { echo "  ✓ $1"; }
+fail() { echo "  ✗ $1"; FAILURES=$((FAILURES + 1)); }
+
+stop_daemon() {
+    if [ -n "$DAEMON_PID" ]; then
+        kill "$DAEMON_PID" 2>/dev/null
+        wait "$DAEMON_PID" 2>/dev/null
+        DAEMON_PID=
+    fi
+}
+
+# Start a verbose daemon that logs each request to $WORK/daemon.log
+start_daemon() {
+    stop_daemon
+    rm -f "$SOCKET"
+    HOME="$WORK/home" "$TOOL" --verbose serve --socket "$SOCKET" "$@" > "$WORK/daemon.log" 2>&1 &
+    DAEMON_PID=$!
+    tries=0
+    while [ ! -S "$SOCKET" ] && [ $tries -lt 50 ]; do
+        sleep 0.1
+        tries=$((tries + 1))
+    done
+}
+
+# Run the tool in the scratch repository; output goes to $WORK/out
+run() {
+    (cd "$WORK/repo" && HOME="$WORK/home" GITIGNORE_SOCKET="$SOCKET" "$TOOL" "$@") > "$WORK/out" 2>&1
+}
+
+served() {
+    grep -c "serve: request" "$WORK/daemon.log"
+}
+
+mkdir -p "$WORK/home/.config/gitignore" "$WORK/repo"
+printf '*.log\nbuild/\n' > "$WORK/repo/.gitignore"
+
+echo "Serve tests:"
+
+start_daemon
+run check app.log src/main.c
+if [ $? -eq 0 ] && [ "$(cat "$WORK/out")" = "app.log" ] && [ "$(served)" -eq 1 ]; then
+    pass "forwards commands to the daemon"
+else
+    fail "forwards commands to the daemon"
+fi
+
+run check src/main.c
+if [ $? -eq 1 ] && [ ! -s "$WORK/out" ]; then
+    pass "returns the command's exit status"
+else
+    fail "returns the command's exit status"
+fi
+
+(cd "$WORK/repo" && printf 'a.log\nb.c\nbuild/x.o\n' |
+    HOME="$WORK/home" GITIGNORE_SOCKET="$SOCKET" "$TOOL" check) > "$WORK/out" 2>&1
+if [ $? -eq 0 ] && [ "$(wc -l < "$WORK/out")" -eq 2 ] && [ "$(served)" -eq 3 ]; then
+    pass "passes stdin through to the command"
+else
+    fail "passes stdin through to the command"
+fi
+
+# The daemon must notice the edit rather than reuse its compiled rules
+sleep 1
+printf '*.c\n' > "$WORK/repo/.gitignore"
+run check app.log b.c
+if [ $? -eq 0 ] && [ "$(cat "$WORK/out")" = "b.c" ]; then
+    pass "picks up an edited .gitignore"
+else
+    fail "picks up an edited .gitignore"
+fi
+
+HOME="$WORK/home" "$TOOL" serve --socket "$SOCKET" > "$WORK/out" 2>&1
+if [ $? -ne 0 ] && grep -q "already running" "$WORK/out"; then
+    pass "refuses to start a second daemon on the same socket"
+else
+    fail "refuses to start a second daemon on the same socket"
+fi
+
+stop_daemon
+run check b.c
+if [ $? -eq 0 ] && [ "$(cat "$WORK/out")" = "b.c" ]; then
+    pass "runs in-process when no daemon is listening"
+else
+    fail "runs in-process when no daemon is listening"
+fi
+
+start_daemon --idle 1
+sleep 2
+if ! kill -0 "$DAEMON_PID" 2>/dev/null && [ ! -e "$SOCKET" ]; then
+    pass "exits and removes its socket after --idle seconds"
+else
+    fail "exits and removes its socket after --idle seconds"
+fi
+wait "$DAEMON_PID" 2>/dev/null
+DAEMON_PID=
+
+if [ $FAILURES -ne 0 ]; then
+    echo "✗ $FAILURES serve test(s) failed"
+    exit 1
+fi
+echo "✓ Serve tests passed"
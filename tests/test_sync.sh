@@ -0,0 +1,386 @@
+#!/bin/sh
+# test_sync.sh - sync against tests/mock_server: downloads, caching,
+# revalidation, upstream errors, concurrency, file:// and offline sources,
+# and re-syncing a .gitignore section by section
+#
+# usage: sh tests/test_sync.sh ./gitignore ./tests/mock_server
+
+TOOL=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+SERVER=$(cd "$(dirname "$2")" && pwd)/$(basename "$2")
+WORK=$(mktemp -d)
+CONFIG="$WORK/home/.config/gitignore/config.conf"
+SERVER_PID=
+FAILURES=0
+
+cleanup() {
+    stop_server
+    rm -rf "$WORK"
+}
+trap cleanup EXIT
+
+pass() { echo "  ✓ $1"; }
+fail() { echo "  ✗ $1"; FAILURES=$((FAILURES + 1)); }
+
+stop_server() {
+    if [ -n "$SERVER_PID" ]; then
+        kill "$SERVER_PID" 2>/dev/null
+        wait "$SERVER_PID" 2>/dev/null
+        SERVER_PID=
+    fi
+}
+
+# Start the mock server on a free port with extra options
+start_server() {
+    stop_server
+    : > "$WORK/requests.log"
+    : > "$WORK/port"
+    "$SERVER" --root "$WORK/upstream" --port 0 --log "$WORK/requests.log" "$@" > "$WORK/port" &
+    SERVER_PID=$!
+    tries=0
+    while [ ! -s "$WORK/port" ] && [ $tries -lt 50 ]; do
+        sleep 0.1
+        tries=$((tries + 1))
+    done
+    GITIGNORE_TEMPLATE_URL="http://127.0.0.1:$(cat "$WORK/port")/"
+    export GITIGNORE_TEMPLATE_URL
+}
+
+# Run the tool in the scratch repository; output goes to $WORK/out
+run() {
+    (cd "$WORK/repo" && HOME="$WORK/home" "$TOOL" "$@") > "$WORK/out" 2>&1
+}
+
+fresh_repo() {
+    rm -rf "$WORK/repo"
+    mkdir -p "$WORK/repo"
+}
+
+requests() {
+    grep -c "$1" "$WORK/requests.log"
+}
+
+now_ms() {
+    echo $(($(date +%s%N) / 1000000))
+}
+
+mkdir -p "$WORK/upstream" "$WORK/home/.config/gitignore"
+for name in Alpha Beta Gamma Delta Epsilon Zeta; do
+    printf '# %s\n%s-build/\n*.%s\n' "$name" "$name" "$name" > "$WORK/upstream/$name.gitignore"
+done
+
+echo "Sync tests (mock server):"
+
+start_server
+fresh_repo
+run sync Alpha Beta
+if [ $? -eq 0 ] && grep -q "^# ===== Alpha =====" "$WORK/repo/.gitignore" &&
+   grep -q "^Beta-build/" "$WORK/repo/.gitignore" && [ "$(requests '200$')" -eq 2 ]; then
+    pass "downloads templates into a new .gitignore"
+else
+    fail "downloads templates into a new .gitignore"
+fi
+
+: > "$WORK/requests.log"
+fresh_repo
+run sync Alpha Beta
+if [ $? -eq 0 ] && [ ! -s "$WORK/requests.log" ] && grep -q "^Alpha-build/" "$WORK/repo/.gitignore"; then
+    pass "serves fresh cache entries without a request"
+else
+    fail "serves fresh cache entries without a request"
+fi
+
+# Every entry is stale from here on
+echo "cache_duration=-1" > "$CONFIG"
+
+: > "$WORK/requests.log"
+fresh_repo
+run sync Alpha
+if [ $? -eq 0 ] && [ "$(requests 'Alpha.gitignore 304 conditional')" -eq 1 ] &&
+   grep -q "^Alpha-build/" "$WORK/repo/.gitignore"; then
+    pass "revalidates stale entries with If-None-Match"
+else
+    fail "revalidates stale entries with If-None-Match"
+fi
+
+echo "alpha-changed/" >> "$WORK/upstream/Alpha.gitignore"
+: > "$WORK/requests.log"
+fresh_repo
+run sync Alpha
+if [ $? -eq 0 ] && [ "$(requests 'Alpha.gitignore 200 conditional')" -eq 1 ] &&
+   grep -q "^alpha-changed/" "$WORK/repo/.gitignore"; then
+    pass "picks up changed upstream templates"
+else
+    fail "picks up changed upstream templates"
+fi
+
+# Same port, so the cached copy belongs to the same template_url
+start_server --status Alpha.gitignore=503 --port "$(cat "$WORK/port")"
+fresh_repo
+run sync Alpha
+if [ $? -eq 0 ] && grep -q "^alpha-changed/" "$WORK/repo/.gitignore"; then
+    pass "falls back to a stale copy when upstream fails"
+else
+    fail "falls back to a stale copy when upstream fails"
+fi
+
+rm -f "$CONFIG"
+start_server --status Broken.gitignore=500
+fresh_repo
+run sync Beta Missing
+if [ $? -eq 0 ] && [ "$(requests 'Missing.gitignore 404')" -eq 1 ] &&
+   grep -q "^Beta-build/" "$WORK/repo/.gitignore" && ! grep -q "Missing" "$WORK/repo/.gitignore"; then
+    pass "skips templates upstream does not have"
+else
+    fail "skips templates upstream does not have"
+fi
+
+fresh_repo
+run sync Broken
+if [ $? -ne 0 ] && [ "$(requests 'Broken.gitignore 500')" -eq 1 ] && [ ! -f "$WORK/repo/.gitignore" ]; then
+    pass "fails cleanly on server errors"
+else
+    fail "fails cleanly on server errors"
+fi
+
+# Six 300 ms responses take 1.8 s one after another
+start_server --latency 300
+run cache clear
+fresh_repo
+start=$(now_ms)
+run sync Alpha Beta Gamma Delta Epsilon Zeta
+rc=$?
+elapsed=$(($(now_ms) - start))
+if [ $rc -eq 0 ] && [ "$(requests '200$')" -eq 6 ] && [ "$elapsed" -lt 1200 ]; then
+    pass "downloads concurrently (${elapsed} ms for 6 x 300 ms)"
+else
+    fail "downloads concurrently (${elapsed} ms for 6 x 300 ms)"
+fi
+
+: > "$WORK/requests.log"
+run sync Alpha --jobs 0
+jobs_rc=$?
+run sync Alpha --jobs=-2
+rc=$?
+if [ $jobs_rc -eq 1 ] && [ $rc -eq 1 ] && grep -q "at least 1" "$WORK/out" && [ "$(requests 'Alpha')" -eq 0 ]; then
+    pass "rejects --jobs below 1"
+else
+    fail "rejects --jobs below 1"
+fi
+
+echo "template_url=http://127.0.0.1:1/" > "$CONFIG"
+run cache clear
+fresh_repo
+run sync Gamma
+if [ $? -eq 0 ] && grep -q "^Gamma-build/" "$WORK/repo/.gitignore"; then
+    pass "GITIGNORE_TEMPLATE_URL overrides template_url"
+else
+    fail "GITIGNORE_TEMPLATE_URL overrides template_url"
+fi
+
+# The cache is per server: another template_url never sees its bodies
+printf 'Gamma-other/\n' > "$WORK/upstream/Gamma.gitignore"
+start_server
+fresh_repo
+run sync Gamma
+if [ $? -eq 0 ] && [ "$(requests '200$')" -eq 1 ] && grep -q "^Gamma-other/" "$WORK/repo/.gitignore" &&
+   grep -q "^# Synced from $GITIGNORE_TEMPLATE_URL\$" "$WORK/repo/.gitignore"; then
+    pass "keeps the cache separate for each template_url"
+else
+    fail "keeps the cache separate for each template_url"
+fi
+
+stop_server
+unset GITIGNORE_TEMPLATE_URL
+echo "template_url=file://$WORK/upstream/" > "$CONFIG"
+run cache clear
+fresh_repo
+run sync Delta Missing
+if [ $? -eq 0 ] && grep -q "^Delta-build/" "$WORK/repo/.gitignore" && grep -q "Missing" "$WORK/out"; then
+    pass "reads templates from a file:// source"
+else
+    fail "reads templates from a file:// source"
+fi
+
+# Environment overrides apply even without HOME (and so without a config)
+rm -f "$WORK/repo/.gitignore"
+(cd "$WORK/repo" && env -u HOME GITIGNORE_TEMPLATE_URL="file://$WORK/upstream/" "$TOOL" sync Delta) > "$WORK/out" 2>&1
+if [ $? -eq 0 ] && grep -q "^Delta-build/" "$WORK/repo/.gitignore"; then
+    pass "applies GITIGNORE_TEMPLATE_URL when HOME is unset"
+else
+    fail "applies GITIGNORE_TEMPLATE_URL when HOME is unset"
+fi
+
+# Re-running a sync rewrites only the sections whose template changed
+printf 'mine/\n' > "$WORK/repo/.gitignore"
+run sync Delta Epsilon
+echo "hand-added/" >> "$WORK/repo/.gitignore"
+cp "$WORK/repo/.gitignore" "$WORK/before"
+touch -d @0 "$WORK/repo/.gitignore"
+echo "auto_backup=true" >> "$CONFIG"
+run sync Delta Epsilon
+rc=$?
+if [ $rc -eq 3 ] && cmp -s "$WORK/before" "$WORK/repo/.gitignore" && grep -q "up to date" "$WORK/out" &&
+   [ "$(stat -c %Y "$WORK/repo/.gitignore")" -eq 0 ] && [ -z "$(find "$WORK/home" -name '*.bak')" ]; then
+    pass "leaves .gitignore alone and exits 3 when no template changed"
+else
+    fail "leaves .gitignore alone and exits 3 when no template changed"
+fi
+
+# file:// templates are not cached, so an edit shows up right away
+echo "delta-changed/" >> "$WORK/upstream/Delta.gitignore"
+run sync Delta Epsilon
+if [ $? -eq 0 ] && [ "$(grep -c '^# ===== Delta =====' "$WORK/repo/.gitignore")" -eq 1 ] &&
+   [ "$(grep -c "^# Synced from file://$WORK/upstream/ by gitignore tool" "$WORK/repo/.gitignore")" -eq 1 ] &&
+   grep -q "^delta-changed/" "$WORK/repo/.gitignore" && grep -q "^mine/" "$WORK/repo/.gitignore" &&
+   [ "$(tail -n 1 "$WORK/repo/.gitignore")" = "hand-added/" ]; then
+    pass "rewrites a changed template's section in place"
+else
+    fail "rewrites a changed template's section in place"
+fi
+
+if [ "$(find "$WORK/home" -name '*.bak' | wc -l)" -eq 1 ]; then
+    pass "backs up .gitignore only when it changes"
+else
+    fail "backs up .gitignore only when it changes"
+fi
+sed -i '/^auto_backup=/d' "$CONFIG"
+
+# init with a template whose section is current writes nothing
+mkdir -p "$WORK/home/.config/gitignore/templates"
+printf 'local-build/\n' > "$WORK/home/.config/gitignore/templates/local.gitignore"
+run init local
+cp "$WORK/repo/.gitignore" "$WORK/before"
+run init local
+init_rc=$?
+run update local
+update_rc=$?
+if [ $init_rc -eq 3 ] && [ $update_rc -eq 3 ] && cmp -s "$WORK/before" "$WORK/repo/.gitignore"; then
+    pass "init and update exit 3 when .gitignore is already up to date"
+else
+    fail "init and update exit 3 when .gitignore is already up to date"
+fi
+
+run init '#python'
+if [ $? -eq 3 ] && cmp -s "$WORK/before" "$WORK/repo/.gitignore"; then
+    pass "init exits 3 when every argument is filtered out"
+else
+    fail "init exits 3 when every argument is filtered out"
+fi
+
+run append nosuchtemplate
+if [ $? -eq 1 ] && ! grep -q "up to date" "$WORK/out" && cmp -s "$WORK/before" "$WORK/repo/.gitignore"; then
+    pass "fails when none of the requested templates exist"
+else
+    fail "fails when none of the requested templates exist"
+fi
+rm -rf "$WORK/home/.config/gitignore/templates"
+
+# A section from before end markers is replaced, keeping lines added to it
+printf '# ===== Epsilon =====\nEpsilon-build/\nlegacy-local/\n' > "$WORK/repo/.gitignore"
+run sync Epsilon
+if [ $? -eq 0 ] && [ "$(grep -c '^Epsilon-build/' "$WORK/repo/.gitignore")" -eq 1 ] &&
+   grep -q "^# ===== end Epsilon \[" "$WORK/repo/.gitignore" && grep -q "^legacy-local/" "$WORK/repo/.gitignore"; then
+    pass "upgrades an old section without losing hand-added lines"
+else
+    fail "upgrades an old section without losing hand-added lines"
+fi
+
+# A tarball of the upstream repository, used with no server at all
+mkdir -p "$WORK/archive/gitignore-main/Global" "$WORK/archive/gitignore-main/community/Misc"
+printf 'top-alpha/\n' > "$WORK/archive/gitignore-main/Alpha.gitignore"
+printf 'global-alpha/\n' > "$WORK/archive/gitignore-main/Global/Alpha.gitignore"
+printf 'global-editor/\n' > "$WORK/archive/gitignore-main/Global/Editor.gitignore"
+printf 'community-tool/\n' > "$WORK/archive/gitignore-main/community/Misc/Tool.gitignore"
+(cd "$WORK/archive" && tar czf upstream.tar.gz gitignore-main)
+rm -f "$CONFIG"
+fresh_repo
+GITIGNORE_TEMPLATE_SOURCE="$WORK/archive/upstream.tar.gz" run sync alpha EDITOR tool
+if [ $? -eq 0 ] && grep -q "^top-alpha/" "$WORK/repo/.gitignore" && ! grep -q "^global-alpha/" "$WORK/repo/.gitignore" &&
+   grep -q "^global-editor/" "$WORK/repo/.gitignore" && grep -q "^community-tool/" "$WORK/repo/.gitignore"; then
+    pass "reads templates from a local tarball of the repository"
+else
+    fail "reads templates from a local tarball of the repository"
+fi
+
+# batch (and auto --recursive through it) resolves from the source too
+fresh_repo
+mkdir -p "$WORK/repo/sub"
+echo "sub alpha tool" > "$WORK/repo/manifest"
+GITIGNORE_TEMPLATE_URL=http://127.0.0.1:1/ GITIGNORE_TEMPLATE_SOURCE="$WORK/archive/upstream.tar.gz" \
+    run batch manifest
+if [ $? -eq 0 ] && grep -q "^top-alpha/" "$WORK/repo/sub/.gitignore" &&
+   grep -q "^community-tool/" "$WORK/repo/sub/.gitignore"; then
+    pass "batch reads templates from the offline source"
+else
+    fail "batch reads templates from the offline source"
+fi
+
+# cache prefetch unpacks a git archive of the repository into the cache
+if command -v git > /dev/null 2>&1; then
+    (cd "$WORK/archive/gitignore-main" && git init -q && git add . &&
+     git -c user.name=test -c user.email=test@example.com commit -qm upstream &&
+     git archive --prefix=gitignore-main/ -o "$WORK/upstream/main.tar.gz" HEAD)
+    start_server
+    export GITIGNORE_ARCHIVE_URL="${GITIGNORE_TEMPLATE_URL}main.tar.gz"
+    run cache clear
+    fresh_repo
+    run cache prefetch
+    rc=$?
+    : > "$WORK/requests.log"
+    run sync Alpha Global/Editor community/Misc/Tool
+    if [ $rc -eq 0 ] && grep -q "3/3" "$WORK/out" && [ "$(requests '200$')" -eq 0 ] && grep -q "^top-alpha/" "$WORK/repo/.gitignore" &&
+       grep -q "^global-editor/" "$WORK/repo/.gitignore" && grep -q "^community-tool/" "$WORK/repo/.gitignore"; then
+        pass "prefetches the whole repository into the cache"
+    else
+        fail "prefetches the whole repository into the cache"
+    fi
+
+    : > "$WORK/requests.log"
+    run cache prefetch
+    if [ $? -eq 0 ] && [ "$(requests 'main.tar.gz 304 conditional')" -eq 1 ] && grep -q "up to date" "$WORK/out"; then
+        pass "skips a prefetch when the archive is unchanged"
+    else
+        fail "skips a prefetch when the archive is unchanged"
+    fi
+
+    start_server --no-etag --port "$(cat "$WORK/port")"
+    export GITIGNORE_ARCHIVE_URL="${GITIGNORE_TEMPLATE_URL}main.tar.gz"
+    run cache prefetch
+    if [ $? -eq 0 ] && grep -q "up to date" "$WORK/out"; then
+        pass "stops reading an archive of the commit already cached"
+    else
+        fail "stops reading an archive of the commit already cached"
+    fi
+
+    # Prefetched templates stay fresh while the record names their commit
+    echo "cache_duration=-1" > "$CONFIG"
+    : > "$WORK/requests.log"
+    fresh_repo
+    run sync Alpha
+    if [ $? -eq 0 ] && [ "$(requests 'Alpha')" -eq 0 ] && grep -q "^top-alpha/" "$WORK/repo/.gitignore"; then
+        pass "keeps prefetched templates past cache_duration"
+    else
+        fail "keeps prefetched templates past cache_duration"
+    fi
+    rm -f "$CONFIG"
+
+    # The cache never holds file: templates, so there is nothing to fill
+    : > "$WORK/requests.log"
+    http_url=$GITIGNORE_TEMPLATE_URL
+    GITIGNORE_TEMPLATE_URL="file://$WORK/upstream/"
+    run cache prefetch
+    rc=$?
+    GITIGNORE_TEMPLATE_URL=$http_url
+    if [ $rc -ne 0 ] && grep -q "Nothing to prefetch" "$WORK/out" && [ "$(requests 'main.tar.gz')" -eq 0 ]; then
+        pass "refuses to prefetch for a file: template_url"
+    else
+        fail "refuses to prefetch for a file: template_url"
+    fi
+    unset GITIGNORE_ARCHIVE_URL
+fi
+
+if [ $FAILURES -ne 0 ]; then
+    echo "✗ $FAILURES sync test(s) failed"
+    exit 1
+fi
+echo "✓ Sync tests passed"